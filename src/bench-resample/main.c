@@ -0,0 +1,121 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2017 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// times dt_interpolation_resample() for all interpolators, downscaling a 24 MP buffer to the usual export
+// sizes. the first call of every geometry includes building the resampling plans, later ones find them in
+// the cache. with avx2 available both codepaths are run and compared.
+
+#include "common/darktable.h"
+#include "common/interpolation.h"
+#include "control/conf.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define IN_WIDTH 6000
+#define IN_HEIGHT 4000
+
+static const char *interpolators[] = { "bilinear", "bicubic", "lanczos2", "lanczos3" };
+static const int sizes[] = { 3840, 2048, 1920, 1024, 512 }; // long edge
+
+static double _run(const struct dt_interpolation *itor, float *out, const dt_iop_roi_t *roi_out,
+                   const float *in, const dt_iop_roi_t *roi_in, const int runs)
+{
+  const double start = dt_get_wtime();
+  for(int k = 0; k < runs; k++)
+    dt_interpolation_resample(itor, out, roi_out, roi_out->width * 4 * sizeof(float), in, roi_in,
+                              roi_in->width * 4 * sizeof(float));
+  return (dt_get_wtime() - start) / runs;
+}
+
+int main(int argc, char *arg[])
+{
+  // no library, no gui
+  char *m_arg[] = { "--library", ":memory:" };
+  const int m_argc = sizeof(m_arg) / sizeof(m_arg[0]);
+  char **argv = malloc((argc + m_argc) * sizeof(arg[0]));
+  if(!argv) exit(1);
+  argv[0] = arg[0];
+  for(int i = 0; i < m_argc; i++) argv[1 + i] = m_arg[i];
+  if(dt_init(1 + m_argc, argv, FALSE, FALSE, NULL)) exit(1);
+
+  const int runs = argc > 1 ? MAX(1, atoi(arg[1])) : 5;
+
+  float *in = dt_alloc_align(64, sizeof(float) * 4 * IN_WIDTH * IN_HEIGHT);
+  float *out = dt_alloc_align(64, sizeof(float) * 4 * IN_WIDTH * IN_HEIGHT);
+  float *ref = dt_alloc_align(64, sizeof(float) * 4 * IN_WIDTH * IN_HEIGHT);
+  if(!in || !out || !ref) exit(1);
+  unsigned int seed = 1;
+  for(size_t k = 0; k < (size_t)4 * IN_WIDTH * IN_HEIGHT; k++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    in[k] = (seed >> 8) / (float)(1 << 24);
+  }
+
+  // the interpolators are picked through the export preference, leave it as it was
+  gchar *pref = dt_conf_get_string("plugins/lighttable/export/pixel_interpolator");
+  const int avx2 = darktable.codepath.AVX2;
+
+  printf("%-10s %11s %10s %10s %10s  %s\n", "", "size", "first ms", "sse ms", "avx2 ms", "max diff");
+  for(int i = 0; i < (int)(sizeof(interpolators) / sizeof(interpolators[0])); i++)
+  {
+    dt_conf_set_string("plugins/lighttable/export/pixel_interpolator", interpolators[i]);
+    const struct dt_interpolation *itor = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
+
+    for(int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++)
+    {
+      const float scale = sizes[s] / (float)IN_WIDTH;
+      const dt_iop_roi_t roi_in = { 0, 0, IN_WIDTH, IN_HEIGHT, 1.0f };
+      const dt_iop_roi_t roi_out = { 0, 0, sizes[s], (int)(IN_HEIGHT * scale), scale };
+
+      darktable.codepath.AVX2 = 0;
+      const double first = _run(itor, ref, &roi_out, in, &roi_in, 1);
+      const double sse = _run(itor, ref, &roi_out, in, &roi_in, runs);
+      double vec = NAN, diff = NAN;
+      if(avx2)
+      {
+        darktable.codepath.AVX2 = 1;
+        vec = _run(itor, out, &roi_out, in, &roi_in, runs);
+        diff = 0.0;
+        for(size_t k = 0; k < (size_t)4 * roi_out.width * roi_out.height; k++)
+          if(k % 4 != 3) diff = MAX(diff, fabs(out[k] - ref[k]));
+      }
+      printf("%-10s %5dx%-5d %10.2f %10.2f %10.2f  %g\n", interpolators[i], roi_out.width, roi_out.height,
+             first * 1000.0, sse * 1000.0, vec * 1000.0, diff);
+    }
+  }
+
+  darktable.codepath.AVX2 = avx2;
+  dt_conf_set_string("plugins/lighttable/export/pixel_interpolator", pref);
+  g_free(pref);
+  dt_free_align(in);
+  dt_free_align(out);
+  dt_free_align(ref);
+  dt_cleanup();
+  free(argv);
+  exit(0);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
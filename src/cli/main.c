@@ -37,9 +37,11 @@
 #include "common/imageio_jpeg.h"
 #include "common/imageio_module.h"
 #include "common/points.h"
+#include "common/utility.h"
 #include "control/conf.h"
 #include "develop/imageop.h"
 
+#include <glib/gstdio.h>
 #include <inttypes.h>
 #include <libintl.h>
 #include <sys/time.h>
@@ -54,6 +56,411 @@ static void usage(const char *progname)
   fprintf(stderr, "usage: %s <input file> [<xmp file>] <output file> [--width <max width>,--height <max "
                   "height>,--bpp <bpp>,--hq <0|1|true|false>,--upscale <0|1|true|false>,--verbose] [--core <darktable options>]\n",
           progname);
+  fprintf(stderr, "       %s --batch <job file|-> [--jobs <n>,--log <log file|->,--width <max width>,--height <max "
+                  "height>,--bpp <bpp>,--hq <0|1|true|false>,--upscale <0|1|true|false>,--verbose] [--core <darktable options>]\n",
+          progname);
+}
+
+// export settings shared by all jobs
+typedef struct cli_settings_t
+{
+  int width, height;
+  gboolean high_quality, upscale, verbose;
+} cli_settings_t;
+
+// one line of the job file: <input> [<xmp>] <output>
+typedef struct cli_job_t
+{
+  int line;
+  char *input, *xmp, *output;
+} cli_job_t;
+
+// shared between the worker threads of a batch
+typedef struct cli_batch_t
+{
+  const cli_settings_t *settings;
+  int omp_threads;
+  GPtrArray *jobs;
+  dt_pthread_mutex_t import_mutex; // importing goes through the database, one at a time
+  dt_pthread_mutex_t mutex;        // protects the rest
+  size_t next, done, failed;
+  FILE *log;
+} cli_batch_t;
+
+static gchar *_check_output(const char *output_filename)
+{
+  if(g_file_test(output_filename, G_FILE_TEST_IS_DIR))
+    return g_strdup(_("error: output file is a directory. please specify file name"));
+  return NULL;
+}
+
+// import a file or a whole folder, returns the image ids or NULL and an error message
+static GList *_import(const char *input_filename, gchar **error)
+{
+  GList *id_list = NULL;
+
+  if(g_file_test(input_filename, G_FILE_TEST_IS_DIR))
+  {
+    int filmid = dt_film_import(input_filename);
+    if(!filmid)
+    {
+      *error = g_strdup_printf(_("error: can't open folder %s"), input_filename);
+      return NULL;
+    }
+    id_list = dt_film_get_image_ids(filmid);
+  }
+  else
+  {
+    dt_film_t film;
+    int id = 0;
+    int filmid = 0;
+
+    gchar *directory = g_path_get_dirname(input_filename);
+    filmid = dt_film_new(&film, directory);
+    id = dt_image_import(filmid, input_filename, TRUE);
+    g_free(directory);
+    if(!id)
+    {
+      *error = g_strdup_printf(_("error: can't open file %s"), input_filename);
+      return NULL;
+    }
+
+    id_list = g_list_append(id_list, GINT_TO_POINTER(id));
+  }
+
+  if(!id_list) *error = g_strchomp(g_strdup(_("no images to export, aborting\n")));
+  return id_list;
+}
+
+static void _attach_xmp(GList *id_list, const char *xmp_filename)
+{
+  for(GList *iter = id_list; iter; iter = g_list_next(iter))
+  {
+    int id = GPOINTER_TO_INT(iter->data);
+    dt_image_t *image = dt_image_cache_get(darktable.image_cache, id, 'w');
+    dt_exif_xmp_read(image, xmp_filename, 1);
+    // don't write new xmp:
+    dt_image_cache_write_release(darktable.image_cache, image, DT_IMAGE_CACHE_RELAXED);
+  }
+}
+
+static void _remove_duplicates(GList *dup_list)
+{
+  for(GList *iter = dup_list; iter; iter = g_list_next(iter)) dt_image_remove(GPOINTER_TO_INT(iter->data));
+}
+
+// jobs on the same input share its image ids, so one job's xmp must not go onto them while another
+// job might be exporting the very same image. the xmp goes onto a private duplicate instead, which is
+// removed again by _remove_duplicates(). returns NULL if not all images could be duplicated.
+static GList *_duplicate(GList *id_list, gchar **error)
+{
+  GList *dup_list = NULL;
+  for(GList *iter = id_list; iter; iter = g_list_next(iter))
+  {
+    const int32_t id = dt_image_duplicate(GPOINTER_TO_INT(iter->data));
+    if(id <= 0)
+    {
+      *error = g_strdup(_("error: can't duplicate image"));
+      _remove_duplicates(dup_list);
+      g_list_free(dup_list);
+      return NULL;
+    }
+    dup_list = g_list_append(dup_list, GINT_TO_POINTER(id));
+  }
+  return dup_list;
+}
+
+// export all images to output_filename. returns the number of images which failed to export and an error
+// message, or -1 if nothing could be exported at all.
+static int _export(GList *id_list, const char *output_filename, const cli_settings_t *settings, gchar **error)
+{
+  // try to find out the export format from the output_filename
+  gchar *output = g_strdup(output_filename);
+  char *ext = output + strlen(output);
+  while(ext > output && *ext != '.') ext--;
+  *ext = '\0';
+  ext++;
+
+  if(!strcmp(ext, "jpg")) ext = "jpeg";
+
+  if(!strcmp(ext, "tif")) ext = "tiff";
+
+  // init the export data structures
+  dt_imageio_module_format_t *format;
+  dt_imageio_module_storage_t *storage;
+  dt_imageio_module_data_t *sdata, *fdata;
+
+  storage = dt_imageio_get_storage_by_name("disk"); // only exporting to disk makes sense
+  if(storage == NULL)
+  {
+    *error = g_strdup(
+        _("cannot find disk storage module. please check your installation, something seems to be broken."));
+    g_free(output);
+    return -1;
+  }
+
+  sdata = storage->get_params(storage);
+  if(sdata == NULL)
+  {
+    *error = g_strdup(_("failed to get parameters from storage module, aborting export ..."));
+    g_free(output);
+    return -1;
+  }
+
+  // and now for the really ugly hacks. don't tell your children about this one or they won't sleep at night
+  // any longer ...
+  g_strlcpy((char *)sdata, output, DT_MAX_PATH_FOR_PARAMS);
+  // all is good now, the last line didn't happen.
+
+  format = dt_imageio_get_format_by_name(ext);
+  if(format == NULL)
+  {
+    *error = g_strdup_printf(_("unknown extension '.%s'"), ext);
+    storage->free_params(storage, sdata);
+    g_free(output);
+    return -1;
+  }
+
+  fdata = format->get_params(format);
+  if(fdata == NULL)
+  {
+    *error = g_strdup(_("failed to get parameters from format module, aborting export ..."));
+    storage->free_params(storage, sdata);
+    g_free(output);
+    return -1;
+  }
+
+  uint32_t w, h, fw, fh, sw, sh;
+  fw = fh = sw = sh = 0;
+  storage->dimension(storage, sdata, &sw, &sh);
+  format->dimension(format, fdata, &fw, &fh);
+
+  if(sw == 0 || fw == 0)
+    w = sw > fw ? sw : fw;
+  else
+    w = sw < fw ? sw : fw;
+
+  if(sh == 0 || fh == 0)
+    h = sh > fh ? sh : fh;
+  else
+    h = sh < fh ? sh : fh;
+
+  fdata->max_width = settings->width;
+  fdata->max_height = settings->height;
+  fdata->max_width = (w != 0 && fdata->max_width > w) ? w : fdata->max_width;
+  fdata->max_height = (h != 0 && fdata->max_height > h) ? h : fdata->max_height;
+  fdata->style[0] = '\0';
+  fdata->style_append = 0;
+
+  if(storage->initialize_store)
+  {
+    storage->initialize_store(storage, sdata, &format, &fdata, &id_list, settings->high_quality,
+                              settings->upscale);
+
+    format->set_params(format, fdata, format->params_size(format));
+    storage->set_params(storage, sdata, storage->params_size(storage));
+  }
+
+  // TODO: add a callback to set the bpp without going through the config
+
+  const int total = g_list_length(id_list);
+  int num = 1, failed = 0;
+  for(GList *iter = id_list; iter; iter = g_list_next(iter), num++)
+  {
+    int id = GPOINTER_TO_INT(iter->data);
+    if(storage->store(storage, sdata, id, format, fdata, num, total, settings->high_quality, settings->upscale))
+      failed++;
+  }
+  if(failed) *error = g_strdup_printf(_("error: failed to export %d of %d images"), failed, total);
+
+  // cleanup time
+  if(storage->finalize_store) storage->finalize_store(storage, sdata);
+  storage->free_params(storage, sdata);
+  format->free_params(format, fdata);
+  g_free(output);
+
+  return failed;
+}
+
+// read the whole job file, "-" is stdin. every non-empty line not starting with '#' is a job with
+// tab separated fields, or space separated if there is no tab.
+static GPtrArray *_read_jobs(const char *filename)
+{
+  gchar *contents = NULL;
+  if(!strcmp(filename, "-"))
+  {
+    GString *str = g_string_new(NULL);
+    char chunk[4096];
+    size_t rd;
+    while((rd = fread(chunk, 1, sizeof(chunk), stdin)) > 0) g_string_append_len(str, chunk, rd);
+    contents = g_string_free(str, FALSE);
+  }
+  else if(!g_file_get_contents(filename, &contents, NULL, NULL))
+  {
+    fprintf(stderr, _("error: can't open file %s"), filename);
+    fprintf(stderr, "\n");
+    return NULL;
+  }
+
+  GPtrArray *jobs = g_ptr_array_new();
+  gchar **lines = g_strsplit(contents, "\n", -1);
+  for(int l = 0; lines[l]; l++)
+  {
+    gchar *line = g_strstrip(lines[l]);
+    if(!*line || *line == '#') continue;
+
+    gchar **fields = g_strsplit_set(line, strchr(line, '\t') ? "\t" : " ", -1);
+    char *field[3] = { NULL };
+    int count = 0;
+    for(int f = 0; fields[f]; f++)
+    {
+      if(!*fields[f]) continue;
+      if(count < 3) field[count] = fields[f];
+      count++;
+    }
+
+    if(count < 2 || count > 3)
+    {
+      fprintf(stderr, _("error: line %d of %s should be '<input file> [<xmp file>] <output file>'"), l + 1,
+              filename);
+      fprintf(stderr, "\n");
+      g_strfreev(fields);
+      continue;
+    }
+
+    cli_job_t *job = (cli_job_t *)calloc(1, sizeof(cli_job_t));
+    job->line = l + 1;
+    job->input = g_strdup(field[0]);
+    job->xmp = count == 3 ? g_strdup(field[1]) : NULL;
+    job->output = g_strdup(field[count - 1]);
+    g_ptr_array_add(jobs, job);
+    g_strfreev(fields);
+  }
+  g_strfreev(lines);
+  g_free(contents);
+  return jobs;
+}
+
+static void _free_job(gpointer data)
+{
+  cli_job_t *job = (cli_job_t *)data;
+  g_free(job->input);
+  g_free(job->xmp);
+  g_free(job->output);
+  free(job);
+}
+
+// one json object per line, so the log can be parsed while it is still being written
+static void _log_job(FILE *log, const cli_job_t *job, const int images, const double seconds, const gchar *error)
+{
+  GString *str = g_string_new("{\"line\": ");
+  g_string_append_printf(str, "%d, \"input\": ", job->line);
+  dt_util_json_append_string(str, job->input);
+  g_string_append(str, ", \"xmp\": ");
+  dt_util_json_append_string(str, job->xmp);
+  g_string_append(str, ", \"output\": ");
+  dt_util_json_append_string(str, job->output);
+  g_string_append_printf(str, ", \"images\": %d, \"status\": \"%s\", \"seconds\": %.3f, \"error\": ", images,
+                         error ? "failed" : "ok", seconds);
+  dt_util_json_append_string(str, error);
+  g_string_append(str, "}\n");
+  fputs(str->str, log);
+  fflush(log);
+  g_string_free(str, TRUE);
+}
+
+static void *_batch_thread(void *data)
+{
+  cli_batch_t *b = (cli_batch_t *)data;
+#ifdef _OPENMP
+  omp_set_num_threads(b->omp_threads);
+#endif
+  while(TRUE)
+  {
+    dt_pthread_mutex_lock(&b->mutex);
+    if(b->next >= b->jobs->len)
+    {
+      dt_pthread_mutex_unlock(&b->mutex);
+      break;
+    }
+    const cli_job_t *job = (const cli_job_t *)g_ptr_array_index(b->jobs, b->next++);
+    dt_pthread_mutex_unlock(&b->mutex);
+
+    const double start = dt_get_wtime();
+    gchar *error = _check_output(job->output);
+    GList *id_list = NULL;
+    if(!error)
+    {
+      dt_pthread_mutex_lock(&b->import_mutex);
+      id_list = _import(job->input, &error);
+      if(id_list && job->xmp)
+      {
+        GList *dup_list = _duplicate(id_list, &error);
+        g_list_free(id_list);
+        id_list = dup_list;
+        if(id_list) _attach_xmp(id_list, job->xmp);
+      }
+      dt_pthread_mutex_unlock(&b->import_mutex);
+    }
+    const int images = g_list_length(id_list);
+    if(id_list) _export(id_list, job->output, b->settings, &error);
+    if(id_list && job->xmp)
+    {
+      dt_pthread_mutex_lock(&b->import_mutex);
+      _remove_duplicates(id_list);
+      dt_pthread_mutex_unlock(&b->import_mutex);
+    }
+    g_list_free(id_list);
+    const double seconds = dt_get_wtime() - start;
+
+    dt_pthread_mutex_lock(&b->mutex);
+    b->done++;
+    if(error)
+    {
+      b->failed++;
+      fprintf(stderr, "[%zu/%u] %s: %s\n", b->done, b->jobs->len, job->input, error);
+    }
+    else if(b->settings->verbose)
+      printf("[%zu/%u] %s -> %s (%.3f s)\n", b->done, b->jobs->len, job->input, job->output, seconds);
+    if(b->log) _log_job(b->log, job, images, seconds, error);
+    dt_pthread_mutex_unlock(&b->mutex);
+    g_free(error);
+  }
+  return NULL;
+}
+
+// process all jobs in this one process, so dt_init() and module loading are only paid for once.
+// returns the number of failed jobs.
+static size_t _run_batch(GPtrArray *jobs, const cli_settings_t *settings, int threads, FILE *log)
+{
+  cli_batch_t b = { 0 };
+  b.settings = settings;
+  b.jobs = jobs;
+  b.log = log;
+  // every thread runs its own pipe, and gets a share of the cores for it
+  threads = CLAMP(threads, 1, MAX(1, (int)jobs->len));
+  b.omp_threads = MAX(1, darktable.num_openmp_threads / threads);
+  dt_pthread_mutex_init(&b.mutex, NULL);
+  dt_pthread_mutex_init(&b.import_mutex, NULL);
+
+  const double start = dt_get_wtime();
+  pthread_t *thread = (pthread_t *)calloc(threads, sizeof(pthread_t));
+  int started = 0;
+  for(; started < threads; started++)
+    if(dt_pthread_create(&thread[started], _batch_thread, &b)) break;
+  // no threads at all? do it ourselves
+  if(!started) _batch_thread(&b);
+  for(int k = 0; k < started; k++) pthread_join(thread[k], NULL);
+  const double elapsed = MAX(dt_get_wtime() - start, 1e-6);
+  free(thread);
+
+  if(settings->verbose)
+    printf("%zu jobs in %.1f s with %d threads: %.2f jobs/s, %zu failed\n", b.done, elapsed, threads,
+           b.done / elapsed, b.failed);
+
+  dt_pthread_mutex_destroy(&b.import_mutex);
+  dt_pthread_mutex_destroy(&b.mutex);
+  return b.failed;
 }
 
 int main(int argc, char *arg[])
@@ -68,9 +475,12 @@ int main(int argc, char *arg[])
   char *input_filename = NULL;
   char *xmp_filename = NULL;
   char *output_filename = NULL;
+  char *batch_filename = NULL;
+  char *log_filename = NULL;
   int file_counter = 0;
-  int width = 0, height = 0, bpp = 0;
-  gboolean verbose = FALSE, high_quality = TRUE, upscale = FALSE;
+  int bpp = 0, threads = 1;
+  cli_settings_t settings = { 0 };
+  settings.high_quality = TRUE;
 
   int k;
   for(k = 1; k < argc; k++)
@@ -91,12 +501,12 @@ int main(int argc, char *arg[])
       else if(!strcmp(arg[k], "--width") && argc > k + 1)
       {
         k++;
-        width = MAX(atoi(arg[k]), 0);
+        settings.width = MAX(atoi(arg[k]), 0);
       }
       else if(!strcmp(arg[k], "--height") && argc > k + 1)
       {
         k++;
-        height = MAX(atoi(arg[k]), 0);
+        settings.height = MAX(atoi(arg[k]), 0);
       }
       else if(!strcmp(arg[k], "--bpp") && argc > k + 1)
       {
@@ -110,9 +520,9 @@ int main(int argc, char *arg[])
         k++;
         gchar *str = g_ascii_strup(arg[k], -1);
         if(!g_strcmp0(str, "0") || !g_strcmp0(str, "FALSE"))
-          high_quality = FALSE;
+          settings.high_quality = FALSE;
         else if(!g_strcmp0(str, "1") || !g_strcmp0(str, "TRUE"))
-          high_quality = TRUE;
+          settings.high_quality = TRUE;
         else
         {
           fprintf(stderr, "%s: %s\n", _("unknown option for --hq"), arg[k]);
@@ -126,9 +536,9 @@ int main(int argc, char *arg[])
         k++;
         gchar *str = g_ascii_strup(arg[k], -1);
         if(!g_strcmp0(str, "0") || !g_strcmp0(str, "FALSE"))
-          upscale = FALSE;
+          settings.upscale = FALSE;
         else if(!g_strcmp0(str, "1") || !g_strcmp0(str, "TRUE"))
-          upscale= TRUE;
+          settings.upscale= TRUE;
         else
         {
           fprintf(stderr, "%s: %s\n", _("unknown option for --upscale"), arg[k]);
@@ -137,9 +547,24 @@ int main(int argc, char *arg[])
         }
         g_free(str);
       }
+      else if(!strcmp(arg[k], "--batch") && argc > k + 1)
+      {
+        k++;
+        batch_filename = arg[k];
+      }
+      else if((!strcmp(arg[k], "-j") || !strcmp(arg[k], "--jobs")) && argc > k + 1)
+      {
+        k++;
+        threads = MAX(atoi(arg[k]), 1);
+      }
+      else if(!strcmp(arg[k], "--log") && argc > k + 1)
+      {
+        k++;
+        log_filename = arg[k];
+      }
       else if(!strcmp(arg[k], "-v") || !strcmp(arg[k], "--verbose"))
       {
-        verbose = TRUE;
+        settings.verbose = TRUE;
       }
       else if(!strcmp(arg[k], "--core"))
       {
@@ -170,6 +595,55 @@ int main(int argc, char *arg[])
   for(; k < argc; k++) m_arg[m_argc++] = arg[k];
   m_arg[m_argc] = NULL;
 
+  if(batch_filename)
+  {
+    if(file_counter)
+    {
+      usage(arg[0]);
+      free(m_arg);
+      exit(1);
+    }
+
+    GPtrArray *jobs = _read_jobs(batch_filename);
+    if(!jobs)
+    {
+      free(m_arg);
+      exit(1);
+    }
+
+    FILE *log = NULL;
+    if(log_filename)
+    {
+      log = strcmp(log_filename, "-") ? g_fopen(log_filename, "w") : stdout;
+      if(!log)
+      {
+        fprintf(stderr, _("error: can't open file %s"), log_filename);
+        fprintf(stderr, "\n");
+        g_ptr_array_free(jobs, TRUE);
+        free(m_arg);
+        exit(1);
+      }
+    }
+
+    // init dt without gui and without data.db, once for all jobs:
+    if(dt_init(m_argc, m_arg, FALSE, FALSE, NULL))
+    {
+      free(m_arg);
+      exit(1);
+    }
+
+    const size_t failed = _run_batch(jobs, &settings, threads, log);
+
+    if(log && log != stdout) fclose(log);
+    g_ptr_array_set_free_func(jobs, _free_job);
+    g_ptr_array_free(jobs, TRUE);
+
+    dt_cleanup();
+
+    free(m_arg);
+    exit(failed ? 1 : 0);
+  }
+
   if(file_counter < 2 || file_counter > 3)
   {
     usage(arg[0]);
@@ -183,10 +657,11 @@ int main(int argc, char *arg[])
     xmp_filename = NULL;
   }
 
-  if(g_file_test(output_filename, G_FILE_TEST_IS_DIR))
+  gchar *error = _check_output(output_filename);
+  if(error)
   {
-    fprintf(stderr, _("error: output file is a directory. please specify file name"));
-    fprintf(stderr, "\n");
+    fprintf(stderr, "%s\n", error);
+    g_free(error);
     free(m_arg);
     exit(1);
   }
@@ -204,65 +679,20 @@ int main(int argc, char *arg[])
     exit(1);
   }
 
-  GList *id_list = NULL;
-
-  if(g_file_test(input_filename, G_FILE_TEST_IS_DIR))
-  {
-    int filmid = dt_film_import(input_filename);
-    if(!filmid)
-    {
-      fprintf(stderr, _("error: can't open folder %s"), input_filename);
-      fprintf(stderr, "\n");
-      free(m_arg);
-      exit(1);
-    }
-    id_list = dt_film_get_image_ids(filmid);
-  }
-  else
-  {
-    dt_film_t film;
-    int id = 0;
-    int filmid = 0;
-
-    gchar *directory = g_path_get_dirname(input_filename);
-    filmid = dt_film_new(&film, directory);
-    id = dt_image_import(filmid, input_filename, TRUE);
-    if(!id)
-    {
-      fprintf(stderr, _("error: can't open file %s"), input_filename);
-      fprintf(stderr, "\n");
-      free(m_arg);
-      exit(1);
-    }
-    g_free(directory);
-
-    id_list = g_list_append(id_list, GINT_TO_POINTER(id));
-  }
-
-  int total = g_list_length(id_list);
-
-  if(total == 0)
+  GList *id_list = _import(input_filename, &error);
+  if(!id_list)
   {
-    fprintf(stderr, _("no images to export, aborting\n"));
+    fprintf(stderr, "%s\n", error);
+    g_free(error);
     free(m_arg);
     exit(1);
   }
 
   // attach xmp, if requested:
-  if(xmp_filename)
-  {
-    for(GList *iter = id_list; iter; iter = g_list_next(iter))
-    {
-      int id = GPOINTER_TO_INT(iter->data);
-      dt_image_t *image = dt_image_cache_get(darktable.image_cache, id, 'w');
-      dt_exif_xmp_read(image, xmp_filename, 1);
-      // don't write new xmp:
-      dt_image_cache_write_release(darktable.image_cache, image, DT_IMAGE_CACHE_RELAXED);
-    }
-  }
+  if(xmp_filename) _attach_xmp(id_list, xmp_filename);
 
   // print the history stack. only look at the first image and assume all got the same processing applied
-  if(verbose)
+  if(settings.verbose)
   {
     int id = GPOINTER_TO_INT(id_list->data);
     gchar *history = dt_history_get_items_as_string(id);
@@ -272,104 +702,14 @@ int main(int argc, char *arg[])
       printf("[%s]\n", _("empty history stack"));
   }
 
-  // try to find out the export format from the output_filename
-  char *ext = output_filename + strlen(output_filename);
-  while(ext > output_filename && *ext != '.') ext--;
-  *ext = '\0';
-  ext++;
-
-  if(!strcmp(ext, "jpg")) ext = "jpeg";
-
-  if(!strcmp(ext, "tif")) ext = "tiff";
-
-  // init the export data structures
-  dt_imageio_module_format_t *format;
-  dt_imageio_module_storage_t *storage;
-  dt_imageio_module_data_t *sdata, *fdata;
-
-  storage = dt_imageio_get_storage_by_name("disk"); // only exporting to disk makes sense
-  if(storage == NULL)
+  if(_export(id_list, output_filename, &settings, &error) < 0)
   {
-    fprintf(
-        stderr, "%s\n",
-        _("cannot find disk storage module. please check your installation, something seems to be broken."));
+    fprintf(stderr, "%s\n", error);
+    g_free(error);
     free(m_arg);
     exit(1);
   }
-
-  sdata = storage->get_params(storage);
-  if(sdata == NULL)
-  {
-    fprintf(stderr, "%s\n", _("failed to get parameters from storage module, aborting export ..."));
-    free(m_arg);
-    exit(1);
-  }
-
-  // and now for the really ugly hacks. don't tell your children about this one or they won't sleep at night
-  // any longer ...
-  g_strlcpy((char *)sdata, output_filename, DT_MAX_PATH_FOR_PARAMS);
-  // all is good now, the last line didn't happen.
-
-  format = dt_imageio_get_format_by_name(ext);
-  if(format == NULL)
-  {
-    fprintf(stderr, _("unknown extension '.%s'"), ext);
-    fprintf(stderr, "\n");
-    free(m_arg);
-    exit(1);
-  }
-
-  fdata = format->get_params(format);
-  if(fdata == NULL)
-  {
-    fprintf(stderr, "%s\n", _("failed to get parameters from format module, aborting export ..."));
-    free(m_arg);
-    exit(1);
-  }
-
-  uint32_t w, h, fw, fh, sw, sh;
-  fw = fh = sw = sh = 0;
-  storage->dimension(storage, sdata, &sw, &sh);
-  format->dimension(format, fdata, &fw, &fh);
-
-  if(sw == 0 || fw == 0)
-    w = sw > fw ? sw : fw;
-  else
-    w = sw < fw ? sw : fw;
-
-  if(sh == 0 || fh == 0)
-    h = sh > fh ? sh : fh;
-  else
-    h = sh < fh ? sh : fh;
-
-  fdata->max_width = width;
-  fdata->max_height = height;
-  fdata->max_width = (w != 0 && fdata->max_width > w) ? w : fdata->max_width;
-  fdata->max_height = (h != 0 && fdata->max_height > h) ? h : fdata->max_height;
-  fdata->style[0] = '\0';
-  fdata->style_append = 0;
-
-  if(storage->initialize_store)
-  {
-    storage->initialize_store(storage, sdata, &format, &fdata, &id_list, high_quality, upscale);
-
-    format->set_params(format, fdata, format->params_size(format));
-    storage->set_params(storage, sdata, storage->params_size(storage));
-  }
-
-  // TODO: add a callback to set the bpp without going through the config
-
-  int num = 1;
-  for(GList *iter = id_list; iter; iter = g_list_next(iter), num++)
-  {
-    int id = GPOINTER_TO_INT(iter->data);
-    storage->store(storage, sdata, id, format, fdata, num, total, high_quality, upscale);
-  }
-
-  // cleanup time
-  if(storage->finalize_store) storage->finalize_store(storage, sdata);
-  storage->free_params(storage, sdata);
-  format->free_params(format, fdata);
+  g_free(error);
   g_list_free(id_list);
 
   dt_cleanup();
@@ -23,12 +23,15 @@
 #include <inttypes.h>
 #include <stddef.h>
 
+// number of independently locked parts of the cache, must be a power of two.
+#define DT_CACHE_SHARDS 16
+
 typedef struct dt_cache_entry_t
 {
   void *data;
   size_t data_size;
   size_t cost;
-  GList *link;
+  struct dt_cache_entry_t *lru_prev, *lru_next; // neighbours in the lru list of the shard
   dt_pthread_rwlock_t lock;
   int _lock_demoting;
   uint32_t key;
@@ -38,17 +41,24 @@ dt_cache_entry_t;
 typedef void((*dt_cache_allocate_t)(void *userdata, dt_cache_entry_t *entry));
 typedef void((*dt_cache_cleanup_t)(void *userdata, dt_cache_entry_t *entry));
 
+// keys are spread over the shards, so threads working on different images rarely meet on the same lock.
+typedef struct dt_cache_shard_t
+{
+  dt_pthread_mutex_t lock;
+  GHashTable *hashtable; // stores (key, entry) pairs
+  // last element is most recently used, first is about to be kicked from cache.
+  dt_cache_entry_t *lru_first, *lru_last;
+}
+dt_cache_shard_t;
+
 typedef struct dt_cache_t
 {
-  dt_pthread_mutex_t lock; // big fat lock. we're only expecting a couple hand full of cpu threads to use this concurrently.
+  dt_cache_shard_t shard[DT_CACHE_SHARDS];
 
   size_t entry_size; // cache line allocation
-  size_t cost;       // user supplied cost per cache line (bytes?)
+  size_t cost;       // user supplied cost per cache line (bytes?), summed over all shards (atomic).
   size_t cost_quota; // quota to try and meet. but don't use as hard limit.
 
-  GHashTable *hashtable; // stores (key, entry) pairs
-  GList *lru;            // last element is most recently used, first is about to be kicked from cache.
-
   // callback functions for cache misses/garbage collection
   dt_cache_allocate_t allocate;
   dt_cache_allocate_t cleanup;
@@ -83,14 +93,17 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache, const uint32_t key, char m
 #define dt_cache_release(A, B) dt_cache_release_with_caller(A, B, __FILE__, __LINE__)
 void dt_cache_release_with_caller(dt_cache_t *cache, dt_cache_entry_t *entry, const char *file, int line);
 
+// set the cost of an entry whose data has been re-allocated by the caller, who must hold the write lock.
+void dt_cache_update_cost(dt_cache_t *cache, dt_cache_entry_t *entry, const size_t cost);
+
 // 0: not contained
 int32_t dt_cache_contains(dt_cache_t *cache, const uint32_t key);
 // returns 0 on success, 1 if the key was not found.
 int32_t dt_cache_remove(dt_cache_t *cache, const uint32_t key);
-// removes from the tip of the lru list, until the fill ratio of the hashtable
+// removes from the tip of the lru lists, until the fill ratio of the hashtable
 // goes below the given parameter, in terms of the user defined cost measure.
-// will never lock and never fail, but sometimes not free memory (in case all
-// is locked)
+// will never block on entries and never fail, but sometimes not free memory
+// (in case all is locked)
 void dt_cache_gc(dt_cache_t *cache, const float fill_ratio);
 
 // iterate over all currently contained data blocks.
@@ -0,0 +1,357 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2017 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/color_lut.h"
+#include "common/colorspaces_inline_conversions.h"
+#include "common/darktable.h"
+#include "control/conf.h"
+
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+
+// luts nobody uses anymore are kept around up to this number, for the next export or image
+#define DT_COLOR_LUT_UNUSED 8
+
+static uint64_t _hash_bytes(uint64_t hash, const void *data, const size_t size)
+{
+  // fnv-1a
+  const unsigned char *c = (const unsigned char *)data;
+  for(size_t k = 0; k < size; k++) hash = (hash ^ c[k]) * 1099511628211ull;
+  return hash;
+}
+
+static uint64_t _hash_profile(uint64_t hash, cmsHPROFILE profile)
+{
+  cmsUInt32Number size = 0;
+  if(!profile || !cmsSaveProfileToMem(profile, NULL, &size) || !size)
+    return _hash_bytes(hash, &size, sizeof(size));
+
+  void *data = malloc(size);
+  if(data && cmsSaveProfileToMem(profile, data, &size)) hash = _hash_bytes(hash, data, size);
+  free(data);
+  return _hash_bytes(hash, &size, sizeof(size));
+}
+
+static int _format_supported(const cmsUInt32Number format)
+{
+  return T_FLOAT(format) && T_BYTES(format) == 4 && T_CHANNELS(format) == 3 && T_EXTRA(format) == 1
+         && !T_PLANAR(format) && !T_SWAPFIRST(format) && !T_DOSWAP(format);
+}
+
+void dt_color_lut_cache_init(dt_color_lut_cache_t *cache)
+{
+  memset(cache, 0, sizeof(*cache));
+  dt_pthread_mutex_init(&cache->lock, NULL);
+}
+
+static void _lut_free(dt_color_lut_t *lut)
+{
+  dt_free_align(lut->data);
+  free(lut);
+}
+
+void dt_color_lut_cache_cleanup(dt_color_lut_cache_t *cache)
+{
+  for(GList *iter = cache->luts; iter; iter = g_list_next(iter)) _lut_free((dt_color_lut_t *)iter->data);
+  g_list_free(cache->luts);
+  cache->luts = NULL;
+  dt_pthread_mutex_destroy(&cache->lock);
+}
+
+void dt_color_lut_cache_print(dt_color_lut_cache_t *cache)
+{
+  if(!cache) return;
+  size_t bytes = 0;
+  dt_pthread_mutex_lock(&cache->lock);
+  const guint num = g_list_length(cache->luts);
+  for(GList *iter = cache->luts; iter; iter = g_list_next(iter))
+  {
+    const dt_color_lut_t *lut = (const dt_color_lut_t *)iter->data;
+    bytes += sizeof(float) * 4 * lut->size * lut->size * lut->size;
+  }
+  dt_pthread_mutex_unlock(&cache->lock);
+  printf("[color_lut] %u luts, %.2f MB, hit rate so far: %.3f (%ld of %ld)\n", num, bytes / (1024.0 * 1024.0),
+         cache->hits + cache->misses ? cache->hits / (float)(cache->hits + cache->misses) : 0.0f, cache->hits,
+         cache->hits + cache->misses);
+}
+
+static dt_color_lut_t *_lut_create(cmsHTRANSFORM xform, const cmsUInt32Number input_format, const int size,
+                                   const uint64_t hash)
+{
+  dt_color_lut_t *lut = (dt_color_lut_t *)calloc(1, sizeof(dt_color_lut_t));
+  if(!lut) return NULL;
+  lut->data = dt_alloc_align(16, sizeof(float) * 4 * size * size * size);
+  if(!lut->data)
+  {
+    free(lut);
+    return NULL;
+  }
+  lut->hash = hash;
+  lut->size = size;
+  lut->shaper = T_COLORSPACE(input_format) != PT_Lab;
+
+  if(T_COLORSPACE(input_format) == PT_Lab)
+  {
+    lut->lo[0] = 0.0f;
+    lut->hi[0] = 100.0f;
+    lut->lo[1] = lut->lo[2] = -128.0f;
+    lut->hi[1] = lut->hi[2] = 128.0f;
+  }
+  else
+  {
+    for(int c = 0; c < 3; c++)
+    {
+      lut->lo[c] = 0.0f;
+      lut->hi[c] = 1.0f;
+    }
+  }
+  for(int c = 0; c < 3; c++) lut->scale[c] = (size - 1) / (lut->hi[c] - lut->lo[c]);
+
+  float *const data = lut->data;
+  const float *const lo = lut->lo;
+  const float *const scale = lut->scale;
+  const int shaper = lut->shaper;
+
+  // one row of nodes along the last channel per call, transformed in place. the nodes are evenly spaced
+  // on the shaped axes, so they are cubed back before going through lcms.
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) default(none) shared(xform)
+#endif
+  for(int k = 0; k < size * size; k++)
+  {
+    float *row = data + (size_t)4 * size * k;
+    const int i0 = k / size, i1 = k % size;
+    for(int i2 = 0; i2 < size; i2++)
+    {
+      const float node[3] = { lo[0] + i0 / scale[0], lo[1] + i1 / scale[1], lo[2] + i2 / scale[2] };
+      for(int c = 0; c < 3; c++) row[4 * i2 + c] = shaper ? node[c] * node[c] * node[c] : node[c];
+      row[4 * i2 + 3] = 0.0f;
+    }
+    cmsDoTransform(xform, row, row, size);
+  }
+
+  return lut;
+}
+
+dt_color_lut_t *dt_color_lut_get(cmsHTRANSFORM xform, cmsHPROFILE input, const cmsUInt32Number input_format,
+                                 cmsHPROFILE output, const cmsUInt32Number output_format, cmsHPROFILE proof,
+                                 const int intent, const uint32_t flags)
+{
+  dt_color_lut_cache_t *cache = darktable.color_lut_cache;
+  const int size = dt_conf_get_int("color_lut_size");
+  if(!cache || !xform || size < 2 || !_format_supported(input_format) || !_format_supported(output_format))
+    return NULL;
+
+  uint64_t hash = 14695981039346656037ull;
+  hash = _hash_profile(hash, input);
+  hash = _hash_profile(hash, output);
+  hash = _hash_profile(hash, proof);
+  const uint32_t key[5] = { input_format, output_format, intent, flags, size };
+  hash = _hash_bytes(hash, key, sizeof(key));
+
+  dt_pthread_mutex_lock(&cache->lock);
+  for(GList *iter = cache->luts; iter; iter = g_list_next(iter))
+  {
+    dt_color_lut_t *lut = (dt_color_lut_t *)iter->data;
+    if(lut->hash == hash && lut->size == size)
+    {
+      lut->users++;
+      cache->hits++;
+      dt_pthread_mutex_unlock(&cache->lock);
+      return lut;
+    }
+  }
+  cache->misses++;
+  dt_pthread_mutex_unlock(&cache->lock);
+
+  // sample without holding the lock, other pipes might want a different lut meanwhile
+  const double start = dt_get_wtime();
+  dt_color_lut_t *lut = _lut_create(xform, input_format, size, hash);
+  if(!lut) return NULL;
+  dt_print(DT_DEBUG_PERF, "[color_lut] sampled %d^3 lut in %.3f secs\n", size, dt_get_wtime() - start);
+
+  dt_pthread_mutex_lock(&cache->lock);
+  // somebody else may have been faster
+  for(GList *iter = cache->luts; iter; iter = g_list_next(iter))
+  {
+    dt_color_lut_t *other = (dt_color_lut_t *)iter->data;
+    if(other->hash == hash && other->size == size)
+    {
+      other->users++;
+      dt_pthread_mutex_unlock(&cache->lock);
+      _lut_free(lut);
+      return other;
+    }
+  }
+  lut->users = 1;
+  cache->luts = g_list_prepend(cache->luts, lut);
+  dt_pthread_mutex_unlock(&cache->lock);
+  return lut;
+}
+
+void dt_color_lut_release(dt_color_lut_t *lut)
+{
+  dt_color_lut_cache_t *cache = darktable.color_lut_cache;
+  if(!lut || !cache) return;
+
+  dt_pthread_mutex_lock(&cache->lock);
+  lut->users--;
+  lut->age = ++cache->clock;
+
+  // drop the least recently released unused luts
+  int unused = 0;
+  dt_color_lut_t *oldest = NULL;
+  for(GList *iter = cache->luts; iter; iter = g_list_next(iter))
+  {
+    dt_color_lut_t *l = (dt_color_lut_t *)iter->data;
+    if(l->users > 0) continue;
+    unused++;
+    if(!oldest || l->age < oldest->age) oldest = l;
+  }
+  if(unused > DT_COLOR_LUT_UNUSED)
+  {
+    cache->luts = g_list_remove(cache->luts, oldest);
+    _lut_free(oldest);
+  }
+  dt_pthread_mutex_unlock(&cache->lock);
+}
+
+// picks the tetrahedron of the cube around the input which contains it, as the two corners on the way
+// from node 000 to node 111, and the weights of the three edges walked.
+static inline void _tetrahedron(const float fx, const float fy, const float fz, const size_t sx, const size_t sy,
+                                const size_t sz, size_t *a, size_t *b, float *w)
+{
+  if(fx >= fy)
+  {
+    if(fy >= fz)
+    {
+      *a = sx, *b = sx + sy, w[0] = fx, w[1] = fy, w[2] = fz;
+    }
+    else if(fx >= fz)
+    {
+      *a = sx, *b = sx + sz, w[0] = fx, w[1] = fz, w[2] = fy;
+    }
+    else
+    {
+      *a = sz, *b = sx + sz, w[0] = fz, w[1] = fx, w[2] = fy;
+    }
+  }
+  else
+  {
+    if(fz > fy)
+    {
+      *a = sz, *b = sy + sz, w[0] = fz, w[1] = fy, w[2] = fx;
+    }
+    else if(fz > fx)
+    {
+      *a = sy, *b = sy + sz, w[0] = fy, w[1] = fz, w[2] = fx;
+    }
+    else
+    {
+      *a = sy, *b = sx + sy, w[0] = fy, w[1] = fx, w[2] = fz;
+    }
+  }
+}
+
+// position of v on axis c of the lut, in nodes. negative for v outside of a shaped axis and nan.
+static inline float _lut_coord(const dt_color_lut_t *const lut, const int c, float v)
+{
+  if(lut->shaper) v = v > 0.0f ? cbrta_halleyf(cbrt_5f(v), v) : (v == 0.0f ? 0.0f : -1.0f);
+  return (v - lut->lo[c]) * lut->scale[c];
+}
+
+// returns 0 if the pixel is outside of the sampled range (or nan) and has to go through lcms
+static inline int _lut_pixel(const dt_color_lut_t *const lut, const float *const in, float *const out)
+{
+  const int n = lut->size;
+  float x[3];
+  int i[3];
+  for(int c = 0; c < 3; c++)
+  {
+    x[c] = _lut_coord(lut, c, in[c]);
+    if(!(x[c] >= 0.0f && x[c] <= n - 1)) return 0;
+    i[c] = MIN((int)x[c], n - 2);
+    x[c] -= i[c];
+  }
+
+  const size_t sx = (size_t)4 * n * n, sy = (size_t)4 * n, sz = 4;
+  const float *const c0 = lut->data + i[0] * sx + i[1] * sy + i[2] * sz;
+  const float *const c1 = c0 + sx + sy + sz;
+  size_t a, b;
+  float w[3];
+  _tetrahedron(x[0], x[1], x[2], sx, sy, sz, &a, &b, w);
+  const float alpha = in[3];
+
+#if defined(__SSE2__)
+  const __m128 v0 = _mm_load_ps(c0), va = _mm_load_ps(c0 + a), vb = _mm_load_ps(c0 + b);
+  const __m128 v1 = _mm_load_ps(c1);
+  const __m128 res = _mm_add_ps(_mm_add_ps(v0, _mm_mul_ps(_mm_set1_ps(w[0]), _mm_sub_ps(va, v0))),
+                                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(w[1]), _mm_sub_ps(vb, va)),
+                                           _mm_mul_ps(_mm_set1_ps(w[2]), _mm_sub_ps(v1, vb))));
+  _mm_storeu_ps(out, res);
+#else
+  const float *const ca = c0 + a, *const cb = c0 + b;
+  for(int c = 0; c < 3; c++)
+    out[c] = c0[c] + w[0] * (ca[c] - c0[c]) + w[1] * (cb[c] - ca[c]) + w[2] * (c1[c] - cb[c]);
+#endif
+  out[3] = alpha;
+  return 1;
+}
+
+void dt_color_lut_transform(const dt_color_lut_t *lut, cmsHTRANSFORM xform, const float *in, float *out,
+                            const int width)
+{
+  if(!lut)
+  {
+    cmsDoTransform(xform, in, out, width);
+    return;
+  }
+
+  int j = 0;
+  while(j < width)
+  {
+    if(_lut_pixel(lut, in + 4 * j, out + 4 * j))
+    {
+      j++;
+      continue;
+    }
+    // hand the whole run of pixels the lut can't do to lcms at once
+    int end = j + 1;
+    while(end < width)
+    {
+      const float *px = in + 4 * end;
+      int inside = 1;
+      for(int c = 0; c < 3; c++)
+      {
+        const float x = _lut_coord(lut, c, px[c]);
+        inside &= (x >= 0.0f && x <= lut->size - 1);
+      }
+      if(inside) break;
+      end++;
+    }
+    cmsDoTransform(xform, in + 4 * j, out + 4 * j, end - j);
+    j = end;
+  }
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,82 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2017 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/dtpthread.h"
+
+#include <glib.h>
+#include <inttypes.h>
+#include <lcms2.h>
+
+/**
+ * lcms transforms baked into 3d luts, for profiles which can't be reduced to a matrix and curves.
+ * the lut samples the transform on a regular grid of size^3 nodes (color_lut_size) and is
+ * interpolated tetrahedrally, which is a lot faster than cmsDoTransform() on float data.
+ *
+ * luts are shared between all pipes and kept for a while after their last user went away,
+ * keyed by a hash of the profile contents, intent, flags and pixel formats, so that batch
+ * exports with the same print profile only pay for sampling the transform once.
+ *
+ * only 4 channel float formats are supported. input outside of the sampled range
+ * (lab 0..100 / -128..128, rgb and xyz 0..1) is passed to the transform itself.
+ * linear rgb and xyz input is indexed by its cube root, so the nodes are spread evenly in lightness
+ * instead of crowding the highlights, like lab input already is.
+ */
+
+typedef struct dt_color_lut_t
+{
+  uint64_t hash;
+  int size;           // nodes per axis
+  float lo[3], hi[3]; // sampled input range
+  float scale[3];     // (size - 1) / (hi - lo)
+  int shaper;         // 1: the axes are the cube root of the input, lo and hi included
+  float *data;        // size^3 nodes of 4 floats, first channel varies slowest
+  int users;
+  uint32_t age;
+} dt_color_lut_t;
+
+typedef struct dt_color_lut_cache_t
+{
+  dt_pthread_mutex_t lock; // protects the rest
+  GList *luts;
+  uint32_t clock;
+  long int hits, misses;
+} dt_color_lut_cache_t;
+
+void dt_color_lut_cache_init(dt_color_lut_cache_t *cache);
+void dt_color_lut_cache_cleanup(dt_color_lut_cache_t *cache);
+void dt_color_lut_cache_print(dt_color_lut_cache_t *cache);
+
+/**
+ * returns the lut for xform, which has to be created from the other arguments (proof may be NULL),
+ * sampling the transform if it isn't cached yet. returns NULL if luts are switched off or the formats
+ * are unsupported, callers then keep using xform. has to be paired with dt_color_lut_release().
+ */
+dt_color_lut_t *dt_color_lut_get(cmsHTRANSFORM xform, cmsHPROFILE input, const cmsUInt32Number input_format,
+                                 cmsHPROFILE output, const cmsUInt32Number output_format, cmsHPROFILE proof,
+                                 const int intent, const uint32_t flags);
+void dt_color_lut_release(dt_color_lut_t *lut);
+
+/** drop in replacement for cmsDoTransform() on one row, lut may be NULL. in and out may be the same. */
+void dt_color_lut_transform(const dt_color_lut_t *lut, cmsHTRANSFORM xform, const float *in, float *out,
+                            const int width);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
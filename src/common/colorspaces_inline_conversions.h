@@ -88,6 +88,45 @@ static inline __m128 dt_XYZ_to_Lab_sse2(const __m128 XYZ)
                                      _mm_shuffle_ps(f, f, _MM_SHUFFLE(3, 2, 1, 3))));
 }
 
+#ifdef DT_HAVE_AVX2_CODEPATH
+#include <immintrin.h>
+
+/** two pixels at once, lab_f_m_sse2() on each half. */
+__attribute__((target("avx2"))) static inline __m256 lab_f_m_avx2(const __m256 x)
+{
+  const __m256 epsilon = _mm256_set1_ps(216.0f / 24389.0f);
+  const __m256 kappa = _mm256_set1_ps(24389.0f / 27.0f);
+
+  // calculate as if x > epsilon : result = cbrtf(x)
+  // approximate cbrtf(x):
+  const __m256 a = _mm256_castsi256_ps(_mm256_add_epi32(
+      _mm256_cvtps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(_mm256_castps_si256(x)), _mm256_set1_ps(3.0f))),
+      _mm256_set1_epi32(709921077)));
+  const __m256 a3 = _mm256_mul_ps(_mm256_mul_ps(a, a), a);
+  const __m256 res_big = _mm256_div_ps(_mm256_mul_ps(a, _mm256_add_ps(a3, _mm256_add_ps(x, x))),
+                                       _mm256_add_ps(_mm256_add_ps(a3, a3), x));
+
+  // calculate as if x <= epsilon : result = (kappa*x+16)/116
+  const __m256 res_small
+      = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(kappa, x), _mm256_set1_ps(16.0f)), _mm256_set1_ps(116.0f));
+
+  // blend results according to whether each component is > epsilon or not
+  const __m256 mask = _mm256_cmp_ps(x, epsilon, _CMP_GT_OQ);
+  return _mm256_or_ps(_mm256_and_ps(mask, res_big), _mm256_andnot_ps(mask, res_small));
+}
+
+/** two pixels at once, dt_XYZ_to_Lab_sse2() on each half. uses D50 white point. */
+__attribute__((target("avx2"))) static inline __m256 dt_XYZ_to_Lab_avx2(const __m256 XYZ)
+{
+  const __m256 d50_inv = _mm256_set_ps(0.0f, 1.0f / 0.8249f, 1.0f, 1.0f / 0.9642f,
+                                       0.0f, 1.0f / 0.8249f, 1.0f, 1.0f / 0.9642f);
+  const __m256 coef = _mm256_set_ps(0.0f, 200.0f, 500.0f, 116.0f, 0.0f, 200.0f, 500.0f, 116.0f);
+  const __m256 f = lab_f_m_avx2(_mm256_mul_ps(XYZ, d50_inv));
+  return _mm256_mul_ps(coef, _mm256_sub_ps(_mm256_shuffle_ps(f, f, _MM_SHUFFLE(3, 1, 0, 1)),
+                                           _mm256_shuffle_ps(f, f, _MM_SHUFFLE(3, 2, 1, 3))));
+}
+#endif
+
 /** uses D50 white point. */
 // see http://www.brucelindbloom.com/Eqn_RGB_XYZ_Matrix.html for the transformation matrices
 static inline __m128 dt_XYZ_to_sRGB_sse2(__m128 XYZ)
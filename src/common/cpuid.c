@@ -37,11 +37,13 @@
 #define R_BX "rbx"
 #define R_CX "rcx"
 #define R_DX "rdx"
+#define R_SI "rsi"
 #else
 #define R_AX "eax"
 #define R_BX "ebx"
 #define R_CX "ecx"
 #define R_DX "edx"
+#define R_SI "esi"
 #endif
 
 dt_cpu_flags_t dt_detect_cpu_features()
@@ -52,11 +54,19 @@ dt_cpu_flags_t dt_detect_cpu_features()
                  "pop %%" R_BX "\n"                                                                          \
                  : "=a"(ax), "=c"(cx), "=d"(dx)                                                              \
                  : "0"(cmd))
+// same with a sub-leaf, also returning ebx (through esi, as ebx may be the pic register)
+#define cpuid_count(cmd, sub) \
+  __asm volatile("push %%" R_BX "\n"                                                                         \
+                 "cpuid\n"                                                                                   \
+                 "mov %%" R_BX ", %%" R_SI "\n"                                                               \
+                 "pop %%" R_BX "\n"                                                                          \
+                 : "=a"(ax), "=S"(bx), "=c"(cx), "=d"(dx)                                                    \
+                 : "0"(cmd), "2"(sub))
 
 #ifdef __x86_64__
-  guint64 ax, cx, dx, tmp;
+  guint64 ax, bx, cx, dx, tmp;
 #else
-  guint32 ax, cx, dx, tmp;
+  guint32 ax, bx, cx, dx, tmp;
 #endif
 
   static dt_cpu_flags_t cpuflags = -1;
@@ -85,8 +95,9 @@ dt_cpu_flags_t dt_detect_cpu_features()
     {
       /* Get the standard level */
       cpuid(0x00000000);
+      const guint32 max_level = ax;
 
-      if(ax)
+      if(max_level)
       {
         /* Request for standard features */
         cpuid(0x00000001);
@@ -100,6 +111,24 @@ dt_cpu_flags_t dt_detect_cpu_features()
         if(cx & 0x00000200) cpuflags |= CPU_FLAG_SSSE3;
         if(cx & 0x00040000) cpuflags |= CPU_FLAG_SSE4_1;
         if(cx & 0x00080000) cpuflags |= CPU_FLAG_SSE4_2;
+
+        /* AVX needs the OS to save the ymm registers, too (OSXSAVE and XCR0 bits 1 and 2) */
+        if((cx & 0x10000000) && (cx & 0x08000000))
+        {
+          guint32 xcr0, xcr0_high;
+          __asm volatile(".byte 0x0f, 0x01, 0xd0" : "=a"(xcr0), "=d"(xcr0_high) : "c"(0));
+          if((xcr0 & 0x6) == 0x6)
+          {
+            cpuflags |= CPU_FLAG_AVX;
+
+            /* Request for extended features */
+            if(max_level >= 7)
+            {
+              cpuid_count(0x00000007, 0);
+              if(bx & 0x00000020) cpuflags |= CPU_FLAG_AVX2;
+            }
+          }
+        }
       }
 
       /* Are there extensions? */
@@ -134,6 +163,7 @@ dt_cpu_flags_t dt_detect_cpu_features()
     report("SSE4.1", CPU_FLAG_SSE4_1);
     report("SSE4.2", CPU_FLAG_SSE4_2);
     report("AVX", CPU_FLAG_AVX);
+    report("AVX2", CPU_FLAG_AVX2);
 #undef report
   }
 #endif
@@ -141,6 +171,7 @@ dt_cpu_flags_t dt_detect_cpu_features()
   return cpuflags;
 
 #undef cpuid
+#undef cpuid_count
 }
 #else
 dt_cpu_flags_t dt_detect_cpu_features()
@@ -29,6 +29,7 @@
 #endif
 
 #include "common/collection.h"
+#include "common/color_lut.h"
 #include "common/colorspaces.h"
 #include "common/darktable.h"
 #include "common/exif.h"
@@ -45,6 +46,7 @@
 #include "common/image.h"
 #include "common/image_cache.h"
 #include "common/imageio_module.h"
+#include "common/interpolation.h"
 #include "common/mipmap_cache.h"
 #include "common/noiseprofiles.h"
 #include "common/opencl.h"
@@ -58,6 +60,9 @@
 #include "control/signal.h"
 #include "develop/blend.h"
 #include "develop/imageop.h"
+#include "develop/masks.h"
+#include "develop/pixelpipe_cache.h"
+#include "develop/pixelpipe_profile.h"
 #include "gui/gtk.h"
 #include "gui/guides.h"
 #include "gui/presets.h"
@@ -276,15 +281,26 @@ static void dt_codepaths_init()
   {
 #ifdef HAVE_BUILTIN_CPU_SUPPORTS
     darktable.codepath.SSE2 = (__builtin_cpu_supports("sse") && __builtin_cpu_supports("sse2"));
+#ifdef DT_HAVE_AVX2_CODEPATH
+    darktable.codepath.AVX2 = darktable.codepath.SSE2 && __builtin_cpu_supports("avx2");
+#endif
 #else
     dt_cpu_flags_t flags = dt_detect_cpu_features();
     darktable.codepath.SSE2 = ((flags & (CPU_FLAG_SSE)) && (flags & (CPU_FLAG_SSE2)));
+#ifdef DT_HAVE_AVX2_CODEPATH
+    darktable.codepath.AVX2 = darktable.codepath.SSE2 && (flags & (CPU_FLAG_AVX2));
+#endif
 #endif
   }
 
   // second, apply overrides from conf
   // NOTE: all intrinsics sets can only be overridden to OFF
   if(!dt_conf_get_bool("codepaths/sse2")) darktable.codepath.SSE2 = 0;
+  // the AVX2 kernels fall back to SSE2 for the parts they don't cover
+  if(!dt_conf_get_bool("codepaths/avx2") || !darktable.codepath.SSE2) darktable.codepath.AVX2 = 0;
+
+  dt_print(DT_DEBUG_PERF, "[dt_codepaths_init] SSE2 %s, AVX2 %s\n", darktable.codepath.SSE2 ? "on" : "off",
+           darktable.codepath.AVX2 ? "on" : "off");
 
   // last: do we have any intrinsics sets enabled?
   darktable.codepath._no_intrinsics = !(darktable.codepath.SSE2);
@@ -460,6 +476,11 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 #else
                "  SSE2 optimized codepath disabled\n"
 #endif
+#ifdef DT_HAVE_AVX2_CODEPATH
+               "  AVX2 optimized codepath enabled\n"
+#else
+               "  AVX2 optimized codepath disabled\n"
+#endif
 #ifdef _OPENMP
                "  OpenMP support enabled\n"
 #else
@@ -864,6 +885,19 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   darktable.mipmap_cache = (dt_mipmap_cache_t *)calloc(1, sizeof(dt_mipmap_cache_t));
   dt_mipmap_cache_init(darktable.mipmap_cache);
 
+  darktable.pixelpipe_cache
+      = (dt_dev_pixelpipe_cache_shared_t *)calloc(1, sizeof(dt_dev_pixelpipe_cache_shared_t));
+  dt_dev_pixelpipe_cache_shared_init(darktable.pixelpipe_cache);
+
+  darktable.pixelpipe_profile = (dt_dev_pixelpipe_profile_t *)calloc(1, sizeof(dt_dev_pixelpipe_profile_t));
+  dt_dev_pixelpipe_profile_init(darktable.pixelpipe_profile);
+
+  darktable.masks_cache = (dt_masks_cache_t *)calloc(1, sizeof(dt_masks_cache_t));
+  dt_masks_cache_init(darktable.masks_cache);
+
+  darktable.color_lut_cache = (dt_color_lut_cache_t *)calloc(1, sizeof(dt_color_lut_cache_t));
+  dt_color_lut_cache_init(darktable.color_lut_cache);
+
   // The GUI must be initialized before the views, because the init()
   // functions of the views depend on darktable.control->accels_* to register
   // their keyboard accelerators
@@ -1025,6 +1059,17 @@ void dt_cleanup()
     free(darktable.imageio);
     free(darktable.gui);
   }
+  dt_dev_pixelpipe_cache_shared_cleanup(darktable.pixelpipe_cache);
+  free(darktable.pixelpipe_cache);
+  dt_dev_pixelpipe_profile_cleanup(darktable.pixelpipe_profile);
+  free(darktable.pixelpipe_profile);
+  if(darktable.unmuted & (DT_DEBUG_MASKS | DT_DEBUG_PERF)) dt_masks_cache_print(darktable.masks_cache);
+  dt_masks_cache_cleanup(darktable.masks_cache);
+  free(darktable.masks_cache);
+  if(darktable.unmuted & DT_DEBUG_PERF) dt_color_lut_cache_print(darktable.color_lut_cache);
+  dt_color_lut_cache_cleanup(darktable.color_lut_cache);
+  free(darktable.color_lut_cache);
+  dt_interpolation_cleanup();
   dt_image_cache_cleanup(darktable.image_cache);
   free(darktable.image_cache);
   dt_mipmap_cache_cleanup(darktable.mipmap_cache);
@@ -147,6 +147,10 @@ struct dt_control_t;
 struct dt_develop_t;
 struct dt_mipmap_cache_t;
 struct dt_image_cache_t;
+struct dt_dev_pixelpipe_cache_shared_t;
+struct dt_dev_pixelpipe_profile_t;
+struct dt_masks_cache_t;
+struct dt_color_lut_cache_t;
 struct dt_lib_t;
 struct dt_conf_t;
 struct dt_points_t;
@@ -176,9 +180,16 @@ typedef enum dt_debug_thread_t
   DT_DEBUG_CAMERA_SUPPORT = 1 << 16,
 } dt_debug_thread_t;
 
+// functions built for AVX2 with __attribute__((target)), while the rest of the binary stays runnable
+// on every x86_64 cpu. the codepath is only taken if the cpu supports it, see dt_codepaths_init().
+#if defined(__SSE2__) && defined(__x86_64__) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define DT_HAVE_AVX2_CODEPATH 1
+#endif
+
 typedef struct dt_codepath_t
 {
   unsigned int SSE2 : 1;
+  unsigned int AVX2 : 1;
   unsigned int _no_intrinsics : 1;
   unsigned int OPENMP_SIMD : 1; // always stays the last one
 } dt_codepath_t;
@@ -201,6 +212,10 @@ typedef struct darktable_t
   struct dt_gui_gtk_t *gui;
   struct dt_mipmap_cache_t *mipmap_cache;
   struct dt_image_cache_t *image_cache;
+  struct dt_dev_pixelpipe_cache_shared_t *pixelpipe_cache;
+  struct dt_dev_pixelpipe_profile_t *pixelpipe_profile;
+  struct dt_masks_cache_t *masks_cache;
+  struct dt_color_lut_cache_t *color_lut_cache;
   struct dt_bauhaus_t *bauhaus;
   const struct dt_database_t *db;
   const struct dt_pwstorage_t *pwstorage;
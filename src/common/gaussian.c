@@ -23,6 +23,9 @@
 #include <xmmintrin.h>
 #endif
 #include "common/gaussian.h"
+#ifdef DT_HAVE_AVX2_CODEPATH
+#include <immintrin.h>
+#endif
 #include "common/opencl.h"
 
 #define CLAMPF(a, mn, mx) ((a) < (mn) ? (mn) : ((a) > (mx) ? (mx) : (a)))
@@ -319,166 +322,235 @@ void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out)
 
 
 #if defined(__SSE__)
-static void dt_gaussian_blur_4c_sse(dt_gaussian_t *g, const float *const in, float *const out)
+typedef struct _gaussian_coeffs_t
 {
+  float a0, a1, a2, a3, b1, b2, coefp, coefn;
+} _gaussian_coeffs_t;
 
-  const int width = g->width;
-  const int height = g->height;
-  const int ch = 4;
-
-  assert(g->channels == 4);
+// the recursive filter forth and back along a line of 4 channel pixels, which are step floats apart.
+// clamps the input to min/max.
+static inline void _gaussian_line_sse(const _gaussian_coeffs_t *c, const __m128 Labmin, const __m128 Labmax,
+                                      const float *const in, float *const out, const int length,
+                                      const size_t step)
+{
+  __m128 xp = _mm_setzero_ps();
+  __m128 yb = _mm_setzero_ps();
+  __m128 yp = _mm_setzero_ps();
+  __m128 xc = _mm_setzero_ps();
+  __m128 yc = _mm_setzero_ps();
+  __m128 xn = _mm_setzero_ps();
+  __m128 xa = _mm_setzero_ps();
+  __m128 yn = _mm_setzero_ps();
+  __m128 ya = _mm_setzero_ps();
+
+  // forward filter
+  xp = MMCLAMPPS(_mm_load_ps(in), Labmin, Labmax);
+  yb = _mm_mul_ps(_mm_set_ps1(c->coefp), xp);
+  yp = yb;
+
+  for(int j = 0; j < length; j++)
+  {
+    size_t offset = j * step;
 
-  float a0, a1, a2, a3, b1, b2, coefp, coefn;
+    xc = MMCLAMPPS(_mm_load_ps(in + offset), Labmin, Labmax);
 
-  compute_gauss_params(g->sigma, g->order, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
+    yc = _mm_add_ps(
+        _mm_mul_ps(xc, _mm_set_ps1(c->a0)),
+        _mm_sub_ps(_mm_mul_ps(xp, _mm_set_ps1(c->a1)),
+                   _mm_add_ps(_mm_mul_ps(yp, _mm_set_ps1(c->b1)), _mm_mul_ps(yb, _mm_set_ps1(c->b2)))));
 
-  const __m128 Labmax = _mm_set_ps(g->max[3], g->max[2], g->max[1], g->max[0]);
-  const __m128 Labmin = _mm_set_ps(g->min[3], g->min[2], g->min[1], g->min[0]);
+    _mm_store_ps(out + offset, yc);
 
-  float *temp = g->buf;
+    xp = xc;
+    yb = yp;
+    yp = yc;
+  }
 
+  // backward filter
+  xn = MMCLAMPPS(_mm_load_ps(in + (length - 1) * step), Labmin, Labmax);
+  xa = xn;
+  yn = _mm_mul_ps(_mm_set_ps1(c->coefn), xn);
+  ya = yn;
 
-// vertical blur column by column
-#ifdef _OPENMP
-#pragma omp parallel for default(none) shared(temp, a0, a1, a2, a3, b1, b2, coefp, coefn) schedule(static)
-#endif
-  for(int i = 0; i < width; i++)
+  for(int j = length - 1; j > -1; j--)
   {
-    __m128 xp = _mm_setzero_ps();
-    __m128 yb = _mm_setzero_ps();
-    __m128 yp = _mm_setzero_ps();
-    __m128 xc = _mm_setzero_ps();
-    __m128 yc = _mm_setzero_ps();
-    __m128 xn = _mm_setzero_ps();
-    __m128 xa = _mm_setzero_ps();
-    __m128 yn = _mm_setzero_ps();
-    __m128 ya = _mm_setzero_ps();
+    size_t offset = j * step;
 
-    // forward filter
-    xp = MMCLAMPPS(_mm_load_ps(in + i * ch), Labmin, Labmax);
-    yb = _mm_mul_ps(_mm_set_ps1(coefp), xp);
-    yp = yb;
+    xc = MMCLAMPPS(_mm_load_ps(in + offset), Labmin, Labmax);
 
+    yc = _mm_add_ps(
+        _mm_mul_ps(xn, _mm_set_ps1(c->a2)),
+        _mm_sub_ps(_mm_mul_ps(xa, _mm_set_ps1(c->a3)),
+                   _mm_add_ps(_mm_mul_ps(yn, _mm_set_ps1(c->b1)), _mm_mul_ps(ya, _mm_set_ps1(c->b2)))));
 
-    for(int j = 0; j < height; j++)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      xc = MMCLAMPPS(_mm_load_ps(in + offset), Labmin, Labmax);
-
+    xa = xn;
+    xn = xc;
+    ya = yn;
+    yn = yc;
 
-      yc = _mm_add_ps(
-          _mm_mul_ps(xc, _mm_set_ps1(a0)),
-          _mm_sub_ps(_mm_mul_ps(xp, _mm_set_ps1(a1)),
-                     _mm_add_ps(_mm_mul_ps(yp, _mm_set_ps1(b1)), _mm_mul_ps(yb, _mm_set_ps1(b2)))));
+    _mm_store_ps(out + offset, _mm_add_ps(_mm_load_ps(out + offset), yc));
+  }
+}
 
-      _mm_store_ps(temp + offset, yc);
+static void dt_gaussian_blur_4c_sse(dt_gaussian_t *g, const float *const in, float *const out)
+{
 
-      xp = xc;
-      yb = yp;
-      yp = yc;
-    }
+  const int width = g->width;
+  const int height = g->height;
+  const int ch = 4;
 
-    // backward filter
-    xn = MMCLAMPPS(_mm_load_ps(in + ((size_t)(height - 1) * width + i) * ch), Labmin, Labmax);
-    xa = xn;
-    yn = _mm_mul_ps(_mm_set_ps1(coefn), xn);
-    ya = yn;
+  assert(g->channels == 4);
 
-    for(int j = height - 1; j > -1; j--)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
+  _gaussian_coeffs_t c;
 
-      xc = MMCLAMPPS(_mm_load_ps(in + offset), Labmin, Labmax);
+  compute_gauss_params(g->sigma, g->order, &c.a0, &c.a1, &c.a2, &c.a3, &c.b1, &c.b2, &c.coefp, &c.coefn);
 
-      yc = _mm_add_ps(
-          _mm_mul_ps(xn, _mm_set_ps1(a2)),
-          _mm_sub_ps(_mm_mul_ps(xa, _mm_set_ps1(a3)),
-                     _mm_add_ps(_mm_mul_ps(yn, _mm_set_ps1(b1)), _mm_mul_ps(ya, _mm_set_ps1(b2)))));
+  const __m128 Labmax = _mm_set_ps(g->max[3], g->max[2], g->max[1], g->max[0]);
+  const __m128 Labmin = _mm_set_ps(g->min[3], g->min[2], g->min[1], g->min[0]);
 
+  float *temp = g->buf;
 
-      xa = xn;
-      xn = xc;
-      ya = yn;
-      yn = yc;
 
-      _mm_store_ps(temp + offset, _mm_add_ps(_mm_load_ps(temp + offset), yc));
-    }
-  }
+// vertical blur column by column
+#ifdef _OPENMP
+#pragma omp parallel for default(none) shared(temp, c) schedule(static)
+#endif
+  for(int i = 0; i < width; i++)
+    _gaussian_line_sse(&c, Labmin, Labmax, in + (size_t)i * ch, temp + (size_t)i * ch, height,
+                       (size_t)width * ch);
 
 // horizontal blur line by line
 #ifdef _OPENMP
-#pragma omp parallel for default(none) shared(temp, a0, a1, a2, a3, b1, b2, coefp, coefn) schedule(static)
+#pragma omp parallel for default(none) shared(temp, c) schedule(static)
 #endif
   for(size_t j = 0; j < height; j++)
-  {
-    __m128 xp = _mm_setzero_ps();
-    __m128 yb = _mm_setzero_ps();
-    __m128 yp = _mm_setzero_ps();
-    __m128 xc = _mm_setzero_ps();
-    __m128 yc = _mm_setzero_ps();
-    __m128 xn = _mm_setzero_ps();
-    __m128 xa = _mm_setzero_ps();
-    __m128 yn = _mm_setzero_ps();
-    __m128 ya = _mm_setzero_ps();
-
-    // forward filter
-    xp = MMCLAMPPS(_mm_load_ps(temp + j * width * ch), Labmin, Labmax);
-    yb = _mm_mul_ps(_mm_set_ps1(coefp), xp);
-    yp = yb;
-
+    _gaussian_line_sse(&c, Labmin, Labmax, temp + j * width * ch, out + j * width * ch, width, ch);
+}
 
-    for(int i = 0; i < width; i++)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
+#ifdef DT_HAVE_AVX2_CODEPATH
+// two lines at once, a 4 channel pixel of each in one half of the registers. the pixels of the second
+// line start at in2/out2. same operations per channel as _gaussian_line_sse(), so the results are the same.
+__attribute__((target("avx2"))) static inline void
+_gaussian_line2_avx2(const _gaussian_coeffs_t *c, const __m256 Labmin, const __m256 Labmax, const float *const in,
+                     const float *const in2, float *const out, float *const out2, const int length,
+                     const size_t step)
+{
+#define LOAD2(p, p2, o) _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps((p) + (o))), _mm_load_ps((p2) + (o)), 1)
+#define STORE2(p, p2, o, v)                                                                                    \
+  {                                                                                                          \
+    _mm_store_ps((p) + (o), _mm256_castps256_ps128(v));                                                      \
+    _mm_store_ps((p2) + (o), _mm256_extractf128_ps(v, 1));                                                   \
+  }
+#define MMCLAMPPS256(a, mn, mx) (_mm256_min_ps((mx), _mm256_max_ps((a), (mn))))
 
-      xc = MMCLAMPPS(_mm_load_ps(temp + offset), Labmin, Labmax);
+  const __m256 a0 = _mm256_set1_ps(c->a0), a1 = _mm256_set1_ps(c->a1);
+  const __m256 a2 = _mm256_set1_ps(c->a2), a3 = _mm256_set1_ps(c->a3);
+  const __m256 b1 = _mm256_set1_ps(c->b1), b2 = _mm256_set1_ps(c->b2);
 
-      yc = _mm_add_ps(
-          _mm_mul_ps(xc, _mm_set_ps1(a0)),
-          _mm_sub_ps(_mm_mul_ps(xp, _mm_set_ps1(a1)),
-                     _mm_add_ps(_mm_mul_ps(yp, _mm_set_ps1(b1)), _mm_mul_ps(yb, _mm_set_ps1(b2)))));
+  // forward filter
+  __m256 xp = MMCLAMPPS256(LOAD2(in, in2, 0), Labmin, Labmax);
+  __m256 yb = _mm256_mul_ps(_mm256_set1_ps(c->coefp), xp);
+  __m256 yp = yb;
 
-      _mm_store_ps(out + offset, yc);
+  for(int j = 0; j < length; j++)
+  {
+    const size_t offset = j * step;
+    const __m256 xc = MMCLAMPPS256(LOAD2(in, in2, offset), Labmin, Labmax);
+    const __m256 yc = _mm256_add_ps(
+        _mm256_mul_ps(xc, a0),
+        _mm256_sub_ps(_mm256_mul_ps(xp, a1), _mm256_add_ps(_mm256_mul_ps(yp, b1), _mm256_mul_ps(yb, b2))));
+    STORE2(out, out2, offset, yc);
+    xp = xc;
+    yb = yp;
+    yp = yc;
+  }
 
-      xp = xc;
-      yb = yp;
-      yp = yc;
-    }
+  // backward filter
+  __m256 xn = MMCLAMPPS256(LOAD2(in, in2, (length - 1) * step), Labmin, Labmax);
+  __m256 xa = xn;
+  __m256 yn = _mm256_mul_ps(_mm256_set1_ps(c->coefn), xn);
+  __m256 ya = yn;
 
-    // backward filter
-    xn = MMCLAMPPS(_mm_load_ps(temp + ((size_t)(j + 1) * width - 1) * ch), Labmin, Labmax);
+  for(int j = length - 1; j > -1; j--)
+  {
+    const size_t offset = j * step;
+    const __m256 xc = MMCLAMPPS256(LOAD2(in, in2, offset), Labmin, Labmax);
+    const __m256 yc = _mm256_add_ps(
+        _mm256_mul_ps(xn, a2),
+        _mm256_sub_ps(_mm256_mul_ps(xa, a3), _mm256_add_ps(_mm256_mul_ps(yn, b1), _mm256_mul_ps(ya, b2))));
     xa = xn;
-    yn = _mm_mul_ps(_mm_set_ps1(coefn), xn);
+    xn = xc;
     ya = yn;
+    yn = yc;
+    const __m256 sum = _mm256_add_ps(LOAD2(out, out2, offset), yc);
+    STORE2(out, out2, offset, sum);
+  }
 
+#undef LOAD2
+#undef STORE2
+#undef MMCLAMPPS256
+}
 
-    for(int i = width - 1; i > -1; i--)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
+__attribute__((target("avx2"))) static void dt_gaussian_blur_4c_avx2(dt_gaussian_t *g, const float *const in,
+                                                                     float *const out)
+{
+  const int width = g->width;
+  const int height = g->height;
+  const int ch = 4;
+
+  assert(g->channels == 4);
 
-      xc = MMCLAMPPS(_mm_load_ps(temp + offset), Labmin, Labmax);
+  _gaussian_coeffs_t c;
 
-      yc = _mm_add_ps(
-          _mm_mul_ps(xn, _mm_set_ps1(a2)),
-          _mm_sub_ps(_mm_mul_ps(xa, _mm_set_ps1(a3)),
-                     _mm_add_ps(_mm_mul_ps(yn, _mm_set_ps1(b1)), _mm_mul_ps(ya, _mm_set_ps1(b2)))));
+  compute_gauss_params(g->sigma, g->order, &c.a0, &c.a1, &c.a2, &c.a3, &c.b1, &c.b2, &c.coefp, &c.coefn);
 
+  const __m128 Labmax = _mm_set_ps(g->max[3], g->max[2], g->max[1], g->max[0]);
+  const __m128 Labmin = _mm_set_ps(g->min[3], g->min[2], g->min[1], g->min[0]);
+  const __m256 Labmax2 = _mm256_insertf128_ps(_mm256_castps128_ps256(Labmax), Labmax, 1);
+  const __m256 Labmin2 = _mm256_insertf128_ps(_mm256_castps128_ps256(Labmin), Labmin, 1);
 
-      xa = xn;
-      xn = xc;
-      ya = yn;
-      yn = yc;
+  float *temp = g->buf;
 
-      _mm_store_ps(out + offset, _mm_add_ps(_mm_load_ps(out + offset), yc));
-    }
+// vertical blur, two neighbouring columns at a time
+#ifdef _OPENMP
+#pragma omp parallel for default(none) shared(temp, c) schedule(static)
+#endif
+  for(int i = 0; i < width / 2; i++)
+  {
+    const size_t x = (size_t)2 * i * ch;
+    _gaussian_line2_avx2(&c, Labmin2, Labmax2, in + x, in + x + ch, temp + x, temp + x + ch, height,
+                         (size_t)width * ch);
+  }
+  if(width & 1)
+    _gaussian_line_sse(&c, Labmin, Labmax, in + (size_t)(width - 1) * ch, temp + (size_t)(width - 1) * ch,
+                       height, (size_t)width * ch);
+
+// horizontal blur, two lines at a time
+#ifdef _OPENMP
+#pragma omp parallel for default(none) shared(temp, c) schedule(static)
+#endif
+  for(int j = 0; j < height / 2; j++)
+  {
+    const size_t y = (size_t)2 * j * width * ch;
+    _gaussian_line2_avx2(&c, Labmin2, Labmax2, temp + y, temp + y + (size_t)width * ch, out + y,
+                         out + y + (size_t)width * ch, width, ch);
+  }
+  if(height & 1)
+  {
+    const size_t y = (size_t)(height - 1) * width * ch;
+    _gaussian_line_sse(&c, Labmin, Labmax, temp + y, out + y, width, ch);
   }
 }
 #endif
+#endif
 
 void dt_gaussian_blur_4c(dt_gaussian_t *g, const float *const in, float *const out)
 {
   if(darktable.codepath.OPENMP_SIMD) return dt_gaussian_blur(g, in, out);
+#ifdef DT_HAVE_AVX2_CODEPATH
+  else if(darktable.codepath.AVX2)
+    return dt_gaussian_blur_4c_avx2(g, in, out);
+#endif
 #if defined(__SSE__)
   else if(darktable.codepath.SSE2)
     return dt_gaussian_blur_4c_sse(g, in, out);
@@ -619,6 +619,8 @@ void dt_image_remove(const int32_t imgid)
   sqlite3_finalize(stmt);
   // also clear all thumbnails in mipmap_cache.
   dt_mipmap_cache_remove(darktable.mipmap_cache, imgid);
+  // and the decoded raw
+  dt_raw_pool_remove(&darktable.mipmap_cache->raw_pool, imgid);
 
   dt_tag_update_used_tags();
 }
@@ -194,6 +194,11 @@ static int _default_storage_dimension(struct dt_imageio_module_storage_t *self,
 {
   return 0;
 }
+/** Default implementation of flags, used if storage module does not implement flags() */
+static int _default_storage_flags(struct dt_imageio_module_storage_t *self)
+{
+  return 0;
+}
 /** a NOP for when a default should do nothing */
 static void _default_storage_nop(struct dt_imageio_module_storage_t *self)
 {
@@ -243,6 +248,8 @@ static int dt_imageio_load_module_storage(dt_imageio_module_storage_t *module, c
     module->initialize_store = NULL;
   if(!g_module_symbol(module->module, "finalize_store", (gpointer) & (module->finalize_store)))
     module->finalize_store = NULL;
+  if(!g_module_symbol(module->module, "flags", (gpointer) & (module->flags)))
+    module->flags = _default_storage_flags;
   if(!g_module_symbol(module->module, "set_params", (gpointer) & (module->set_params))) goto error;
 
   if(!g_module_symbol(module->module, "supported", (gpointer) & (module->supported)))
@@ -36,9 +36,17 @@
 typedef enum dt_imageio_format_flags_t
 {
   FORMAT_FLAGS_SUPPORT_XMP = 1,
-  FORMAT_FLAGS_NO_TMPFILE = 2
+  FORMAT_FLAGS_NO_TMPFILE = 2,
+  FORMAT_FLAGS_PARALLEL_WRITE = 4 // write_image() keeps no state between images, every export thread may use
+                                  // its own copy of the params
 } dt_imageio_format_flags_t;
 
+/** Flag for the storage modules */
+typedef enum dt_imageio_storage_flags_t
+{
+  STORAGE_FLAGS_PARALLEL_STORE = 1 // store() may be called from several threads at the same time
+} dt_imageio_storage_flags_t;
+
 /**
  * defines the plugin structure for image import and export.
  *
@@ -175,6 +183,8 @@ typedef struct dt_imageio_module_storage_t
                const int num, const int total, const gboolean high_quality, const gboolean upscale);
   /* called once at the end (after exporting all images), if implemented. */
   void (*finalize_store)(struct dt_imageio_module_storage_t *self, dt_imageio_module_data_t *data);
+  /* dt_imageio_storage_flags_t of this storage */
+  int (*flags)(struct dt_imageio_module_storage_t *self);
 
   void *(*legacy_params)(struct dt_imageio_module_storage_t *self, const void *const old_params,
                          const size_t old_params_size, const int old_version, const int new_version,
@@ -36,15 +36,57 @@ extern "C" {
 #include <stdint.h>
 }
 
+// threads taken by the raw files being decoded right now. they share our thread budget (--threads), so
+// that import and thumbnail generation decoding several images at once don't start cores * cores threads.
+static int used_threads = 0;
+// the share of the decode running in this thread, 0 outside of decodes
+static thread_local int decode_threads = 0;
+
 // define this function, it is only declared in rawspeed:
 int rawspeed_get_number_of_processor_cores()
 {
+  return decode_threads > 0 ? decode_threads : MAX(1, darktable.num_openmp_threads);
+}
+
+// takes a share of the thread budget for the decode in this thread, for rawspeed as well as our own
+// parallel loops, and gives it back on every way out. a decode never gets more than the caller could use
+// itself, nor more than the others left over, but always at least one thread.
+class dt_rawspeed_decode_share_t
+{
+public:
+  dt_rawspeed_decode_share_t()
+  {
 #ifdef _OPENMP
-  return omp_get_num_procs();
+    threads = omp_get_max_threads();
 #else
-  return 1;
+    threads = darktable.num_openmp_threads;
 #endif
-}
+    int used;
+    do
+    {
+      used = __sync_fetch_and_add(&used_threads, 0);
+      share = MAX(1, MIN(threads, darktable.num_openmp_threads - used));
+    } while(!__sync_bool_compare_and_swap(&used_threads, used, used + share));
+    outer_share = decode_threads;
+    decode_threads = share;
+#ifdef _OPENMP
+    omp_set_num_threads(share);
+#endif
+  }
+  ~dt_rawspeed_decode_share_t()
+  {
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+    __sync_sub_and_fetch(&used_threads, share);
+    decode_threads = outer_share;
+  }
+
+private:
+  int threads = 1;
+  int share = 1;
+  int outer_share = 0;
+};
 
 using namespace rawspeed;
 
@@ -114,6 +156,8 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filena
 {
   if(!img->exif_inited) (void)dt_exif_read(img, filename);
 
+  const dt_rawspeed_decode_share_t share;
+
   char filen[PATH_MAX] = { 0 };
   snprintf(filen, sizeof(filen), "%s", filename);
   FileReader f(filen);
@@ -319,23 +363,13 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filena
 
     /*
      * since we do not want to crop black borders at this stage,
-     * and we do not want to rotate image, we can just use memcpy,
-     * as it is faster than dt_imageio_flip_buffers, but only if
-     * buffer sizes are equal,
-     * (from Klaus: r->pitch may differ from DT pitch (line to line spacing))
-     * else fallback to generic dt_imageio_flip_buffers()
+     * and we do not want to rotate image, this is a plain copy of
+     * all rows. dt_imageio_flip_buffers() does that in parallel,
+     * which beats a single memcpy on large images, and takes care
+     * of r->pitch differing from our pitch (line to line spacing).
      */
-    const size_t bufSize_mipmap = (size_t)img->width * img->height * r->getBpp();
-    const size_t bufSize_rawspeed = (size_t)r->pitch * dimUncropped.y;
-    if(bufSize_mipmap == bufSize_rawspeed)
-    {
-      memcpy(buf, r->getDataUncropped(0, 0), bufSize_mipmap);
-    }
-    else
-    {
-      dt_imageio_flip_buffers((char *)buf, (char *)r->getDataUncropped(0, 0), r->getBpp(), dimUncropped.x,
-                              dimUncropped.y, dimUncropped.x, dimUncropped.y, r->pitch, ORIENTATION_NONE);
-    }
+    dt_imageio_flip_buffers((char *)buf, (char *)r->getDataUncropped(0, 0), r->getBpp(), dimUncropped.x,
+                            dimUncropped.y, dimUncropped.x, dimUncropped.y, r->pitch, ORIENTATION_NONE);
   }
   catch(const std::exception &exc)
   {
@@ -23,9 +23,13 @@
 #include <assert.h>
 #include <glib.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <math.h>
 #include <stddef.h>
 #include <stdint.h>
+#ifdef DT_HAVE_AVX2_CODEPATH
+#include <immintrin.h>
+#endif
 
 /** Border extrapolation modes */
 enum border_mode
@@ -1350,6 +1354,162 @@ static int prepare_resampling_plan(const struct dt_interpolation *itor, int in,
   return 0;
 }
 
+/* --------------------------------------------------------------------------
+ * Resampling plan cache
+ * ------------------------------------------------------------------------*/
+
+/* The plans only depend on the interpolator and the geometry, and the same
+ * geometries come back all the time: every redraw of the darkroom at the same
+ * zoom, every thumbnail of the same size, every export of a batch. So plans are
+ * kept in a small cache shared by all threads instead of being rebuilt on each
+ * call. Plans are read only once built, users just hold a reference. */
+
+#define RESAMPLING_PLAN_CACHE_SIZE 16
+
+typedef struct resampling_plan_t
+{
+  enum dt_interpolation_type itor;
+  int in, in_x0, out, out_x0;
+  float scale;
+  int *length; // start of the allocation
+  float *kernel;
+  int *index;
+  int *meta;
+  int users;
+  int cached;
+  uint32_t age;
+} resampling_plan_t;
+
+static GMutex plan_cache_lock;
+static resampling_plan_t *plan_cache[RESAMPLING_PLAN_CACHE_SIZE];
+static uint32_t plan_cache_clock = 0;
+
+static inline int resampling_plan_matches(const resampling_plan_t *plan, const struct dt_interpolation *itor,
+                                          const int in, const int in_x0, const int out, const int out_x0,
+                                          const float scale)
+{
+  return plan && plan->itor == itor->id && plan->in == in && plan->in_x0 == in_x0 && plan->out == out
+         && plan->out_x0 == out_x0 && plan->scale == scale;
+}
+
+static resampling_plan_t *resampling_plan_cache_lookup(const struct dt_interpolation *itor, const int in,
+                                                       const int in_x0, const int out, const int out_x0,
+                                                       const float scale)
+{
+  for(int k = 0; k < RESAMPLING_PLAN_CACHE_SIZE; k++)
+  {
+    resampling_plan_t *plan = plan_cache[k];
+    if(resampling_plan_matches(plan, itor, in, in_x0, out, out_x0, scale))
+    {
+      plan->users++;
+      plan->age = ++plan_cache_clock;
+      return plan;
+    }
+  }
+  return NULL;
+}
+
+static void free_resampling_plan(resampling_plan_t *plan)
+{
+  dt_free_align(plan->length);
+  free(plan);
+}
+
+/** Returns a (possibly shared) plan as built by prepare_resampling_plan(), with
+ * meta information, and fills in its arrays. Must be given back with
+ * release_resampling_plan(), which is a no-op for NULL.
+ * @return the plan, NULL for failure */
+static resampling_plan_t *get_resampling_plan(const struct dt_interpolation *itor, int in, const int in_x0,
+                                              int out, const int out_x0, float scale, int **plength,
+                                              float **pkernel, int **pindex, int **pmeta)
+{
+  g_mutex_lock(&plan_cache_lock);
+  resampling_plan_t *plan = resampling_plan_cache_lookup(itor, in, in_x0, out, out_x0, scale);
+  g_mutex_unlock(&plan_cache_lock);
+
+  if(!plan)
+  {
+    // build outside of the lock, other threads might want other plans meanwhile
+    plan = (resampling_plan_t *)calloc(1, sizeof(resampling_plan_t));
+    if(!plan) return NULL;
+    if(prepare_resampling_plan(itor, in, in_x0, out, out_x0, scale, &plan->length, &plan->kernel, &plan->index,
+                               &plan->meta))
+    {
+      free(plan);
+      return NULL;
+    }
+    plan->itor = itor->id;
+    plan->in = in;
+    plan->in_x0 = in_x0;
+    plan->out = out;
+    plan->out_x0 = out_x0;
+    plan->scale = scale;
+    plan->users = 1;
+
+    g_mutex_lock(&plan_cache_lock);
+    resampling_plan_t *other = resampling_plan_cache_lookup(itor, in, in_x0, out, out_x0, scale);
+    if(other)
+    {
+      // somebody else was faster
+      free_resampling_plan(plan);
+      plan = other;
+    }
+    else
+    {
+      // take a free slot or evict the least recently used plan nobody holds
+      int slot = -1;
+      for(int k = 0; k < RESAMPLING_PLAN_CACHE_SIZE; k++)
+      {
+        if(!plan_cache[k])
+        {
+          slot = k;
+          break;
+        }
+        if(plan_cache[k]->users == 0 && (slot < 0 || plan_cache[k]->age < plan_cache[slot]->age)) slot = k;
+      }
+      if(slot >= 0)
+      {
+        if(plan_cache[slot]) free_resampling_plan(plan_cache[slot]);
+        plan_cache[slot] = plan;
+        plan->cached = 1;
+        plan->age = ++plan_cache_clock;
+      }
+    }
+    g_mutex_unlock(&plan_cache_lock);
+  }
+
+  *plength = plan->length;
+  *pkernel = plan->kernel;
+  *pindex = plan->index;
+  if(pmeta)
+  {
+    *pmeta = plan->meta;
+  }
+  return plan;
+}
+
+static void release_resampling_plan(resampling_plan_t *plan)
+{
+  if(!plan) return;
+  g_mutex_lock(&plan_cache_lock);
+  plan->users--;
+  // plans which didn't fit into the cache go away with their last user
+  const int drop = !plan->cached && plan->users == 0;
+  g_mutex_unlock(&plan_cache_lock);
+  if(drop) free_resampling_plan(plan);
+}
+
+void dt_interpolation_cleanup(void)
+{
+  g_mutex_lock(&plan_cache_lock);
+  for(int k = 0; k < RESAMPLING_PLAN_CACHE_SIZE; k++)
+  {
+    if(plan_cache[k]) free_resampling_plan(plan_cache[k]);
+    plan_cache[k] = NULL;
+  }
+  g_mutex_unlock(&plan_cache_lock);
+}
+
 static void dt_interpolation_resample_plain(const struct dt_interpolation *itor, float *out,
                                             const dt_iop_roi_t *const roi_out, const int32_t out_stride,
                                             const float *const in, const dt_iop_roi_t *const roi_in,
@@ -1362,8 +1522,8 @@ static void dt_interpolation_resample_plain(const struct dt_interpolation *itor,
   int *vlength = NULL;
   float *vkernel = NULL;
   int *vmeta = NULL;
-
-  int r;
+  resampling_plan_t *hplan = NULL;
+  resampling_plan_t *vplan = NULL;
 
   debug_info("resampling %p (%dx%d@%dx%d scale %f) -> %p (%dx%d@%dx%d scale %f)\n", in, roi_in->width,
              roi_in->height, roi_in->x, roi_in->y, roi_in->scale, out, roi_out->width, roi_out->height,
@@ -1400,16 +1560,16 @@ static void dt_interpolation_resample_plain(const struct dt_interpolation *itor,
 #endif
 
   // Prepare resampling plans once and for all
-  r = prepare_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale,
+  hplan = get_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale,
                               &hlength, &hkernel, &hindex, NULL);
-  if(r)
+  if(!hplan)
   {
     goto exit;
   }
 
-  r = prepare_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale,
+  vplan = get_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale,
                               &vlength, &vkernel, &vindex, &vmeta);
-  if(r)
+  if(!vplan)
   {
     goto exit;
   }
@@ -1500,11 +1660,9 @@ static void dt_interpolation_resample_plain(const struct dt_interpolation *itor,
 #endif
 
 exit:
-  /* Free the resampling plans. It's nasty to optimize allocs like that, but
-   * it simplifies the code :-D. The length array is in fact the only memory
-   * allocated. */
-  dt_free_align(hlength);
-  dt_free_align(vlength);
+  // Hand the resampling plans back to the cache
+  release_resampling_plan(hplan);
+  release_resampling_plan(vplan);
 }
 
 #if defined(__SSE2__)
@@ -1520,8 +1678,8 @@ static void dt_interpolation_resample_sse(const struct dt_interpolation *itor, f
   int *vlength = NULL;
   float *vkernel = NULL;
   int *vmeta = NULL;
-
-  int r;
+  resampling_plan_t *hplan = NULL;
+  resampling_plan_t *vplan = NULL;
 
   debug_info("resampling %p (%dx%d@%dx%d scale %f) -> %p (%dx%d@%dx%d scale %f)\n", in, roi_in->width,
              roi_in->height, roi_in->x, roi_in->y, roi_in->scale, out, roi_out->width, roi_out->height,
@@ -1558,16 +1716,16 @@ static void dt_interpolation_resample_sse(const struct dt_interpolation *itor, f
 #endif
 
   // Prepare resampling plans once and for all
-  r = prepare_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale,
+  hplan = get_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale,
                               &hlength, &hkernel, &hindex, NULL);
-  if(r)
+  if(!hplan)
   {
     goto exit;
   }
 
-  r = prepare_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale,
+  vplan = get_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale,
                               &vlength, &vkernel, &vindex, &vmeta);
-  if(r)
+  if(!vplan)
   {
     goto exit;
   }
@@ -1662,11 +1820,231 @@ static void dt_interpolation_resample_sse(const struct dt_interpolation *itor, f
 #endif
 
 exit:
-  /* Free the resampling plans. It's nasty to optimize allocs like that, but
-   * it simplifies the code :-D. The length array is in fact the only memory
-   * allocated. */
-  dt_free_align(hlength);
-  dt_free_align(vlength);
+  // Hand the resampling plans back to the cache
+  release_resampling_plan(hplan);
+  release_resampling_plan(vplan);
+}
+#endif
+
+#ifdef DT_HAVE_AVX2_CODEPATH
+/* The AVX2 version does the two passes separately instead of recomputing the
+ * horizontal sums of each input line for every output line it contributes to.
+ * Every thread takes a band of output lines, resamples the input lines the band
+ * needs horizontally into its own buffer, and then sums those up vertically in
+ * blocks of columns. The operations per pixel are the same as in the SSE
+ * version, in the same order, so the results are identical. */
+
+// output lines per band, at most
+#define RESAMPLING_BAND 32
+// pixels per column block of the vertical pass, two per register
+#define RESAMPLING_BLOCK 16
+
+// two pixels with their own taps, one in each half of the register
+__attribute__((target("avx2"))) static inline __m256 resample_load2(const float *const a, const float *const b)
+{
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps(a)), _mm_load_ps(b), 1);
+}
+
+__attribute__((target("avx2"))) static void resample_line_h_avx2(const float *const in, float *const out,
+                                                                 const int width, const int *const hlength,
+                                                                 const float *const hkernel,
+                                                                 const int *const hindex, const int *const hmeta)
+{
+  int ox = 0;
+  for(; ox + 1 < width; ox += 2)
+  {
+    const int l0 = hlength[ox], l1 = hlength[ox + 1];
+    const float *k0 = hkernel + hmeta[3 * ox + 1], *k1 = hkernel + hmeta[3 * ox + 4];
+    const int *i0 = hindex + hmeta[3 * ox + 2], *i1 = hindex + hmeta[3 * ox + 5];
+    if(l0 == l1)
+    {
+      __m256 vhs = _mm256_setzero_ps();
+      for(int ix = 0; ix < l0; ix++)
+      {
+        const __m256 vhtap
+            = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set_ps1(k0[ix])), _mm_set_ps1(k1[ix]), 1);
+        const __m256 pixels = resample_load2(in + (size_t)4 * i0[ix], in + (size_t)4 * i1[ix]);
+        vhs = _mm256_add_ps(vhs, _mm256_mul_ps(pixels, vhtap));
+      }
+      _mm256_storeu_ps(out + (size_t)4 * ox, vhs);
+    }
+    else
+    {
+      // only happens close to the borders
+      __m128 vhs0 = _mm_setzero_ps(), vhs1 = _mm_setzero_ps();
+      for(int ix = 0; ix < l0; ix++)
+        vhs0 = _mm_add_ps(vhs0, _mm_mul_ps(_mm_load_ps(in + (size_t)4 * i0[ix]), _mm_set_ps1(k0[ix])));
+      for(int ix = 0; ix < l1; ix++)
+        vhs1 = _mm_add_ps(vhs1, _mm_mul_ps(_mm_load_ps(in + (size_t)4 * i1[ix]), _mm_set_ps1(k1[ix])));
+      _mm_storeu_ps(out + (size_t)4 * ox, vhs0);
+      _mm_storeu_ps(out + (size_t)4 * ox + 4, vhs1);
+    }
+  }
+  if(ox < width)
+  {
+    const int l0 = hlength[ox];
+    const float *k0 = hkernel + hmeta[3 * ox + 1];
+    const int *i0 = hindex + hmeta[3 * ox + 2];
+    __m128 vhs = _mm_setzero_ps();
+    for(int ix = 0; ix < l0; ix++)
+      vhs = _mm_add_ps(vhs, _mm_mul_ps(_mm_load_ps(in + (size_t)4 * i0[ix]), _mm_set_ps1(k0[ix])));
+    _mm_storeu_ps(out + (size_t)4 * ox, vhs);
+  }
+}
+
+__attribute__((target("avx2"))) static void resample_line_v_avx2(const float *const buf, float *const out,
+                                                                 const int width, const int vl,
+                                                                 const float *const vkernel,
+                                                                 const int *const vindex, const int first)
+{
+  const size_t line = (size_t)4 * width;
+  int ox = 0;
+  for(; ox + RESAMPLING_BLOCK <= width; ox += RESAMPLING_BLOCK)
+  {
+    __m256 vs[RESAMPLING_BLOCK / 2];
+    for(int b = 0; b < RESAMPLING_BLOCK / 2; b++) vs[b] = _mm256_setzero_ps();
+    for(int iy = 0; iy < vl; iy++)
+    {
+      const float *i = buf + line * (vindex[iy] - first) + (size_t)4 * ox;
+      const __m256 vvtap = _mm256_set1_ps(vkernel[iy]);
+      for(int b = 0; b < RESAMPLING_BLOCK / 2; b++)
+        vs[b] = _mm256_add_ps(vs[b], _mm256_mul_ps(_mm256_loadu_ps(i + 8 * b), vvtap));
+    }
+    for(int b = 0; b < RESAMPLING_BLOCK / 2; b++) _mm256_storeu_ps(out + (size_t)4 * ox + 8 * b, vs[b]);
+  }
+  for(; ox < width; ox++)
+  {
+    __m128 vs = _mm_setzero_ps();
+    for(int iy = 0; iy < vl; iy++)
+    {
+      const float *i = buf + line * (vindex[iy] - first) + (size_t)4 * ox;
+      vs = _mm_add_ps(vs, _mm_mul_ps(_mm_loadu_ps(i), _mm_set_ps1(vkernel[iy])));
+    }
+    _mm_storeu_ps(out + (size_t)4 * ox, vs);
+  }
+}
+
+// range of input lines needed by output lines [oy0, oy1)
+static inline void resample_band_lines(const int *const vlength, const int *const vindex, const int *const vmeta,
+                                       const int oy0, const int oy1, int *first, int *last)
+{
+  *first = INT_MAX;
+  *last = INT_MIN;
+  for(int oy = oy0; oy < oy1; oy++)
+  {
+    const int *vi = vindex + vmeta[3 * oy + 2];
+    for(int iy = 0; iy < vlength[oy]; iy++)
+    {
+      *first = MIN(*first, vi[iy]);
+      *last = MAX(*last, vi[iy]);
+    }
+  }
+}
+
+__attribute__((target("avx2"))) static void
+dt_interpolation_resample_avx2(const struct dt_interpolation *itor, float *out, const dt_iop_roi_t *const roi_out,
+                               const int32_t out_stride, const float *const in, const dt_iop_roi_t *const roi_in,
+                               const int32_t in_stride)
+{
+  // nothing to win for the 1:1 copy
+  if(roi_out->scale == 1.f)
+    return dt_interpolation_resample_sse(itor, out, roi_out, out_stride, in, roi_in, in_stride);
+
+  int *hindex = NULL;
+  int *hlength = NULL;
+  float *hkernel = NULL;
+  int *hmeta = NULL;
+  int *vindex = NULL;
+  int *vlength = NULL;
+  float *vkernel = NULL;
+  int *vmeta = NULL;
+  resampling_plan_t *hplan = NULL;
+  resampling_plan_t *vplan = NULL;
+  float *bufs = NULL;
+
+  debug_info("resampling %p (%dx%d@%dx%d scale %f) -> %p (%dx%d@%dx%d scale %f)\n", in, roi_in->width,
+             roi_in->height, roi_in->x, roi_in->y, roi_in->scale, out, roi_out->width, roi_out->height,
+             roi_out->x, roi_out->y, roi_out->scale);
+
+#if DEBUG_RESAMPLING_TIMING
+  int64_t ts_plan = getts();
+#endif
+
+  hplan = get_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale,
+                              &hlength, &hkernel, &hindex, &hmeta);
+  if(!hplan)
+  {
+    goto exit;
+  }
+
+  vplan = get_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale,
+                              &vlength, &vkernel, &vindex, &vmeta);
+  if(!vplan)
+  {
+    goto exit;
+  }
+
+#if DEBUG_RESAMPLING_TIMING
+  ts_plan = getts() - ts_plan;
+  int64_t ts_resampling = getts();
+#endif
+
+  // smaller bands when there are only a few output lines, so all threads get some
+  const int nthreads = dt_get_num_threads();
+  const int band = CLAMP(roi_out->height / (4 * nthreads), 4, RESAMPLING_BAND);
+  const int nbands = (roi_out->height + band - 1) / band;
+
+  int maxlines = 0;
+  for(int b = 0; b < nbands; b++)
+  {
+    int first, last;
+    resample_band_lines(vlength, vindex, vmeta, b * band, MIN(roi_out->height, (b + 1) * band), &first, &last);
+    maxlines = MAX(maxlines, last - first + 1);
+  }
+
+  const size_t bufsize = (size_t)4 * roi_out->width * maxlines;
+  bufs = dt_alloc_align(64, sizeof(float) * bufsize * nthreads);
+  if(!bufs)
+  {
+    // the sse version gets along without the buffers
+    release_resampling_plan(hplan);
+    release_resampling_plan(vplan);
+    return dt_interpolation_resample_sse(itor, out, roi_out, out_stride, in, roi_in, in_stride);
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) schedule(dynamic)                                                      \
+    shared(out, bufs, hindex, hlength, hkernel, hmeta, vindex, vlength, vkernel, vmeta)
+#endif
+  for(int b = 0; b < nbands; b++)
+  {
+    const int oy0 = b * band, oy1 = MIN(roi_out->height, (b + 1) * band);
+    float *const buf = bufs + bufsize * dt_get_thread_num();
+
+    int first, last;
+    resample_band_lines(vlength, vindex, vmeta, oy0, oy1, &first, &last);
+
+    // horizontal pass over all input lines of the band
+    for(int iy = first; iy <= last; iy++)
+      resample_line_h_avx2((const float *)((const char *)in + (size_t)in_stride * iy),
+                           buf + (size_t)4 * roi_out->width * (iy - first), roi_out->width, hlength, hkernel,
+                           hindex, hmeta);
+
+    // vertical pass
+    for(int oy = oy0; oy < oy1; oy++)
+      resample_line_v_avx2(buf, (float *)((char *)out + (size_t)oy * out_stride), roi_out->width, vlength[oy],
+                           vkernel + vmeta[3 * oy + 1], vindex + vmeta[3 * oy + 2], first);
+  }
+
+#if DEBUG_RESAMPLING_TIMING
+  ts_resampling = getts() - ts_resampling;
+  fprintf(stderr, "resampling %p plan:%" PRId64 "us resampling:%" PRId64 "us\n", in, ts_plan, ts_resampling);
+#endif
+
+exit:
+  dt_free_align(bufs);
+  release_resampling_plan(hplan);
+  release_resampling_plan(vplan);
 }
 #endif
 
@@ -1680,6 +2058,10 @@ void dt_interpolation_resample(const struct dt_interpolation *itor, float *out,
 {
   if(darktable.codepath.OPENMP_SIMD)
     return dt_interpolation_resample_plain(itor, out, roi_out, out_stride, in, roi_in, in_stride);
+#ifdef DT_HAVE_AVX2_CODEPATH
+  else if(darktable.codepath.AVX2)
+    return dt_interpolation_resample_avx2(itor, out, roi_out, out_stride, in, roi_in, in_stride);
+#endif
 #if defined(__SSE2__)
   else if(darktable.codepath.SSE2)
     return dt_interpolation_resample_sse(itor, out, roi_out, out_stride, in, roi_in, in_stride);
@@ -1752,8 +2134,9 @@ int dt_interpolation_resample_cl(const struct dt_interpolation *itor, int devid,
   int *vlength = NULL;
   float *vkernel = NULL;
   int *vmeta = NULL;
+  resampling_plan_t *hplan = NULL;
+  resampling_plan_t *vplan = NULL;
 
-  int r;
   cl_int err = -999;
 
   cl_mem dev_hindex = NULL;
@@ -1797,16 +2180,16 @@ int dt_interpolation_resample_cl(const struct dt_interpolation *itor, int devid,
 #endif
 
   // Prepare resampling plans once and for all
-  r = prepare_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale,
+  hplan = get_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale,
                               &hlength, &hkernel, &hindex, &hmeta);
-  if(r)
+  if(!hplan)
   {
     goto error;
   }
 
-  r = prepare_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale,
+  vplan = get_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale,
                               &vlength, &vkernel, &vindex, &vmeta);
-  if(r)
+  if(!vplan)
   {
     goto error;
   }
@@ -1922,8 +2305,8 @@ int dt_interpolation_resample_cl(const struct dt_interpolation *itor, int devid,
   dt_opencl_release_mem_object(dev_vlength);
   dt_opencl_release_mem_object(dev_vkernel);
   dt_opencl_release_mem_object(dev_vmeta);
-  dt_free_align(hlength);
-  dt_free_align(vlength);
+  release_resampling_plan(hplan);
+  release_resampling_plan(vplan);
   return CL_SUCCESS;
 
 error:
@@ -1935,8 +2318,8 @@ error:
   dt_opencl_release_mem_object(dev_vlength);
   dt_opencl_release_mem_object(dev_vkernel);
   dt_opencl_release_mem_object(dev_vmeta);
-  dt_free_align(hlength);
-  dt_free_align(vlength);
+  release_resampling_plan(hplan);
+  release_resampling_plan(vplan);
   dt_print(DT_DEBUG_OPENCL, "[opencl_resampling] couldn't enqueue kernel! %d\n", err);
   return err;
 }
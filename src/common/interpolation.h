@@ -142,6 +142,9 @@ void dt_interpolation_resample_roi(const struct dt_interpolation *itor, float *o
                                    const float *const in, const dt_iop_roi_t *const roi_in,
                                    const int32_t in_stride);
 
+/** Frees the resampling plans kept between calls of the resampling functions. */
+void dt_interpolation_cleanup(void);
+
 #ifdef HAVE_OPENCL
 typedef struct dt_interpolation_cl_global_t
 {
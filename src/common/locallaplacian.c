@@ -28,6 +28,46 @@
 #if defined(__SSE2__)
 #include <xmmintrin.h>
 #endif
+#ifdef DT_HAVE_AVX2_CODEPATH
+#include <immintrin.h>
+#endif
+
+// the pyramids are built one gamma at a time, and the laplacian coefficients of each are added to the
+// output pyramid right away, so only the gaussian pyramids of the padded input and of one gamma are kept.
+// the finest level of these is never stored either: its rows are padded (and the curve applied) on the
+// fly while reducing to the next level. the output pyramid only covers the part of each level that ends
+// up in the unpadded image, its finest level lives in the brightness channel of the output buffer.
+
+#define max_levels 30
+#define num_gamma 6
+
+typedef enum ll_simd_t
+{
+  LL_SCALAR = 0,
+  LL_SSE2 = 1,
+  LL_AVX2 = 2
+} ll_simd_t;
+
+// the part of a pyramid level that is stored
+typedef struct ll_roi_t
+{
+  int x0, y0, w, h;
+} ll_roi_t;
+
+// parameters of the curve for one gamma
+typedef struct ll_curve_t
+{
+  float g, sigma, shadows, highlights, clarity;
+} ll_curve_t;
+
+// source of the rows of the finest level: the brightness of the input image, padded by max_supp on all
+// four sides, optionally with a curve applied.
+typedef struct ll_pad_t
+{
+  const float *input;
+  int wd, ht, max_supp;
+  const ll_curve_t *curve;
+} ll_pad_t;
 
 // downsample width/height to given level
 static inline int dl(int size, const int level)
@@ -37,25 +77,15 @@ static inline int dl(int size, const int level)
   return size;
 }
 
-// needs a boundary of 1 or 2px around i,j or else it will crash.
-// (translates to a 1px boundary around the corresponding pixel in the coarse buffer)
-// more precisely, 1<=i<wd-1 for even wd and
-//                 1<=i<wd-2 for odd wd (j likewise with ht)
-static inline float ll_expand_gaussian(
+// expand the coarse buffer at fine pixel i,j. ind is the index of coarse pixel i/2,j/2 and cw the
+// row stride of the coarse buffer.
+static inline float ll_expand_gaussian_ind(
     const float *const coarse,
+    const int ind,
+    const int cw,
     const int i,
-    const int j,
-    const int wd,
-    const int ht)
+    const int j)
 {
-  assert(i > 0);
-  assert(i < wd-1);
-  assert(j > 0);
-  assert(j < ht-1);
-  assert(j/2 + 1 < (ht-1)/2+1);
-  assert(i/2 + 1 < (wd-1)/2+1);
-  const int cw = (wd-1)/2+1;
-  const int ind = (j/2)*cw+i/2;
   // case 0:     case 1:     case 2:     case 3:
   //  x . x . x   x . x . x   x . x . x   x . x . x
   //  . . . . .   . . . . .   . .[.]. .   .[.]. . .
@@ -81,211 +111,49 @@ static inline float ll_expand_gaussian(
   }
 }
 
-// helper to fill in one pixel boundary by copying it
-static inline void ll_fill_boundary1(
-    float *const input,
+// needs a boundary of 1 or 2px around i,j or else it will crash.
+// (translates to a 1px boundary around the corresponding pixel in the coarse buffer)
+// more precisely, 1<=i<wd-1 for even wd and
+//                 1<=i<wd-2 for odd wd (j likewise with ht)
+static inline float ll_expand_gaussian(
+    const float *const coarse,
+    const int i,
+    const int j,
     const int wd,
     const int ht)
 {
-  for(int j=1;j<ht-1;j++) input[j*wd] = input[j*wd+1];
-  for(int j=1;j<ht-1;j++) input[j*wd+wd-1] = input[j*wd+wd-2];
-  memcpy(input,    input+wd, sizeof(float)*wd);
-  memcpy(input+wd*(ht-1), input+wd*(ht-2), sizeof(float)*wd);
+  assert(i > 0);
+  assert(i < wd-1);
+  assert(j > 0);
+  assert(j < ht-1);
+  assert(j/2 + 1 < (ht-1)/2+1);
+  assert(i/2 + 1 < (wd-1)/2+1);
+  const int cw = (wd-1)/2+1;
+  return ll_expand_gaussian_ind(coarse, (j/2)*cw+i/2, cw, i, j);
 }
 
-// helper to fill in two pixels boundary by copying it
-static inline void ll_fill_boundary2(
+// same for a coarse buffer that only holds roi of its level
+static inline float ll_expand_gaussian_roi(
+    const float *const coarse,
+    const ll_roi_t *const roi,
+    const int i,
+    const int j)
+{
+  return ll_expand_gaussian_ind(coarse, (j/2-roi->y0)*roi->w + i/2-roi->x0, roi->w, i, j);
+}
+
+// helper to fill in one pixel boundary by copying it
+static inline void ll_fill_boundary1(
     float *const input,
     const int wd,
     const int ht)
 {
   for(int j=1;j<ht-1;j++) input[j*wd] = input[j*wd+1];
-  if(wd & 1) for(int j=1;j<ht-1;j++) input[j*wd+wd-1] = input[j*wd+wd-2];
-  else       for(int j=1;j<ht-1;j++) input[j*wd+wd-1] = input[j*wd+wd-2] = input[j*wd+wd-3];
-  memcpy(input, input+wd, sizeof(float)*wd);
-  if(!(ht & 1)) memcpy(input+wd*(ht-2), input+wd*(ht-3), sizeof(float)*wd);
+  for(int j=1;j<ht-1;j++) input[j*wd+wd-1] = input[j*wd+wd-2];
+  memcpy(input,    input+wd, sizeof(float)*wd);
   memcpy(input+wd*(ht-1), input+wd*(ht-2), sizeof(float)*wd);
 }
 
-static inline void gauss_expand(
-    const float *const input, // coarse input
-    float *const fine,        // upsampled, blurry output
-    const int wd,             // fine res
-    const int ht)
-{
-#ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(static) collapse(2)
-#endif
-  for(int j=1;j<((ht-1)&~1);j++)  // even ht: two px boundary. odd ht: one px.
-    for(int i=1;i<((wd-1)&~1);i++)
-      fine[j*wd+i] = ll_expand_gaussian(input, i, j, wd, ht);
-  ll_fill_boundary2(fine, wd, ht);
-}
-
-#if defined(__SSE2__)
-static inline void gauss_reduce_sse2(
-    const float *const input, // fine input buffer
-    float *const coarse,      // coarse scale, blurred input buf
-    const int wd,             // fine res
-    const int ht)
-{
-  // blur, store only coarse res
-  const int cw = (wd-1)/2+1, ch = (ht-1)/2+1;
-
-  // this version is inspired by opencv's pyrDown_ :
-  // - allocate 5 rows of ring buffer (aligned)
-  // - for coarse res y
-  //   - fill 5 coarse-res row buffers with 1 4 6 4 1 weights (reuse some from last time)
-  //   - do vertical convolution via sse and write to coarse output buf
-
-  const int stride = ((cw+8)&~7); // assure sse alignment of rows
-  float *ringbuf = dt_alloc_align(16, sizeof(*ringbuf)*stride*5);
-  float *rows[5] = {0};
-  int rowj = 0; // we initialised this many rows so far
-
-  for(int j=1;j<ch-1;j++)
-  {
-    // horizontal pass, convolve with 1 4 6 4 1 kernel and decimate
-    for(;rowj<=2*j+2;rowj++)
-    {
-      float *const row = ringbuf + (rowj % 5)*stride;
-      const float *const in = input + rowj*wd;
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static) default(none)
-#endif
-      for(int i=1;i<cw-1;i++)
-        row[i] = 6*in[2*i] + 4*(in[2*i-1]+in[2*i+1]) + in[2*i-2] + in[2*i+2];
-    }
-
-    // init row pointers
-    for(int k=0;k<5;k++)
-      rows[k] = ringbuf + ((2*j-2+k)%5)*stride;
-
-    // vertical pass, convolve and decimate using SIMD:
-    // note that we're ignoring the (1..cw-1) buffer limit, we'll pull in
-    // garbage and fix it later by border filling.
-    float *const out = coarse + j*cw;
-    const float *const row0 = rows[0], *const row1 = rows[1],
-                *const row2 = rows[2], *const row3 = rows[3], *const row4 = rows[4];
-    const __m128 four = _mm_set1_ps(4.f), scale = _mm_set1_ps(1.f/256.f);
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static) default(none)
-#endif
-    for(int i=0;i<=cw-8;i+=8)
-    {
-      __m128 r0, r1, r2, r3, r4, t0, t1;
-      r0 = _mm_load_ps(row0 + i);
-      r1 = _mm_load_ps(row1 + i);
-      r2 = _mm_load_ps(row2 + i);
-      r3 = _mm_load_ps(row3 + i);
-      r4 = _mm_load_ps(row4 + i);
-      r0 = _mm_add_ps(r0, r4);
-      r1 = _mm_add_ps(_mm_add_ps(r1, r3), r2);
-      r0 = _mm_add_ps(r0, _mm_add_ps(r2, r2));
-      t0 = _mm_add_ps(r0, _mm_mul_ps(r1, four));
-
-      r0 = _mm_load_ps(row0 + i + 4);
-      r1 = _mm_load_ps(row1 + i + 4);
-      r2 = _mm_load_ps(row2 + i + 4);
-      r3 = _mm_load_ps(row3 + i + 4);
-      r4 = _mm_load_ps(row4 + i + 4);
-      r0 = _mm_add_ps(r0, r4);
-      r1 = _mm_add_ps(_mm_add_ps(r1, r3), r2);
-      r0 = _mm_add_ps(r0, _mm_add_ps(r2, r2));
-      t1 = _mm_add_ps(r0, _mm_mul_ps(r1, four));
-
-      t0 = _mm_mul_ps(t0, scale);
-      t1 = _mm_mul_ps(t1, scale);
-
-      _mm_storeu_ps(out + i, t0);
-      _mm_storeu_ps(out + i + 4, t1);
-    }
-    // process the rest
-    for(int i=cw&~7;i<cw-1;i++)
-      out[i] = (6*row2[i] + 4*(row1[i] + row3[i]) + row0[i] + row4[i])*(1.0f/256.0f);
-  }
-  dt_free_align(ringbuf);
-  ll_fill_boundary1(coarse, cw, ch);
-}
-#endif
-
-static inline void gauss_reduce(
-    const float *const input, // fine input buffer
-    float *const coarse,      // coarse scale, blurred input buf
-    const int wd,             // fine res
-    const int ht)
-{
-  // blur, store only coarse res
-  const int cw = (wd-1)/2+1, ch = (ht-1)/2+1;
-
-  // this is the scalar (non-simd) code:
-  const float a = 0.4f;
-  const float w[5] = {1./4.-a/2., 1./4., a, 1./4., 1./4.-a/2.};
-  memset(coarse, 0, sizeof(float)*cw*ch);
-  // direct 5x5 stencil only on required pixels:
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static) default(none) collapse(2)
-#endif
-  for(int j=1;j<ch-1;j++) for(int i=1;i<cw-1;i++)
-    for(int jj=-2;jj<=2;jj++) for(int ii=-2;ii<=2;ii++)
-      coarse[j*cw+i] += input[(2*j+jj)*wd+2*i+ii] * w[ii+2] * w[jj+2];
-  ll_fill_boundary1(coarse, cw, ch);
-}
-
-// allocate output buffer with monochrome brightness channel from input, padded
-// up by max_supp on all four sides, dimensions written to wd2 ht2
-static inline float *ll_pad_input(
-    const float *const input,
-    const int wd,
-    const int ht,
-    const int max_supp,
-    int *wd2,
-    int *ht2)
-{
-  const int stride = 4;
-  *wd2 = 2*max_supp + wd;
-  *ht2 = 2*max_supp + ht;
-  float *const out = dt_alloc_align(16, *wd2**ht2*sizeof(*out));
-
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic) default(none) shared(wd2, ht2)
-#endif
-  for(int j=0;j<ht;j++)
-  {
-    for(int i=0;i<max_supp;i++)
-      out[(j+max_supp)**wd2+i] = input[stride*wd*j]* 0.01f; // L -> [0,1]
-    for(int i=0;i<wd;i++)
-      out[(j+max_supp)**wd2+i+max_supp] = input[stride*(wd*j+i)] * 0.01f; // L -> [0,1]
-    for(int i=wd+max_supp;i<*wd2;i++)
-      out[(j+max_supp)**wd2+i] = input[stride*(j*wd+wd-1)] * 0.01f; // L -> [0,1]
-  }
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic) default(none) shared(wd2, ht2)
-#endif
-  for(int j=0;j<max_supp;j++)
-    memcpy(out + *wd2*j, out+max_supp**wd2, sizeof(float)**wd2);
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic) default(none) shared(wd2, ht2)
-#endif
-  for(int j=max_supp+ht;j<*ht2;j++)
-    memcpy(out + *wd2*j, out + *wd2*(max_supp+ht-1), sizeof(float)**wd2);
-
-  return out;
-}
-
-static inline float ll_laplacian(
-    const float *const coarse,   // coarse res gaussian
-    const float *const fine,     // fine res gaussian
-    const int i,                 // fine index
-    const int j,
-    const int wd,                // fine width
-    const int ht)                // fine height
-{
-  const float c = ll_expand_gaussian(coarse,
-      CLAMPS(i, 1, ((wd-1)&~1)-1), CLAMPS(j, 1, ((ht-1)&~1)-1), wd, ht);
-  return fine[j*wd+i] - c;
-}
-
 static inline float curve_scalar(
     const float x,
     const float g,
@@ -327,8 +195,6 @@ static inline __m128 curve_vec4(
     const __m128 highlights,
     const __m128 clarity)
 {
-  // TODO: pull these non-data depedent constants out of the loop to see
-  // whether the compiler fail to do so
   const __m128 const0 = _mm_set_ps1(0x3f800000u);
   const __m128 const1 = _mm_set_ps1(0x402DF854u); // for e^x
   const __m128 sign_mask = _mm_set1_ps(-0.f); // -0.f = 1 << 31
@@ -368,96 +234,391 @@ static inline __m128 curve_vec4(
   const __m128 k0 = _mm_add_ps(const0, _mm_mul_ps(arg, _mm_sub_ps(const1, const0)));
   const __m128 k = _mm_max_ps(k0, _mm_setzero_ps());
   const __m128i ki = _mm_cvtps_epi32(k);
-  const __m128 gauss = _mm_load_ps((float*)&ki);
+  const __m128 gauss = _mm_castsi128_ps(ki);
   const __m128 vcon = _mm_mul_ps(clarity, _mm_mul_ps(c, gauss));
   return _mm_add_ps(val, vcon);
 }
+#endif
 
-// sse (4-wide)
-void apply_curve_sse2(
-    float *const out,
-    const float *const in,
-    const uint32_t w,
-    const uint32_t h,
-    const uint32_t padding,
-    const float g,
-    const float sigma,
-    const float shadows,
-    const float highlights,
-    const float clarity)
+#ifdef DT_HAVE_AVX2_CODEPATH
+// 8-wide version of curve_vec4(), same operations so the results are the same.
+__attribute__((target("avx2"))) static inline __m256 curve_vec8(
+    const __m256 x,
+    const __m256 g,
+    const __m256 sigma,
+    const __m256 shadows,
+    const __m256 highlights,
+    const __m256 clarity)
 {
-  // TODO: do all this in avx2 8-wide (should be straight forward):
-#ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(dynamic)
+  const __m256 const0 = _mm256_set1_ps(0x3f800000u);
+  const __m256 const1 = _mm256_set1_ps(0x402DF854u); // for e^x
+  const __m256 sign_mask = _mm256_set1_ps(-0.f); // -0.f = 1 << 31
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  const __m256 twothirds = _mm256_set1_ps(2.0f/3.0f);
+  const __m256 twosig = _mm256_mul_ps(two, sigma);
+  const __m256 sigma2 = _mm256_mul_ps(sigma, sigma);
+  const __m256 s22 = _mm256_mul_ps(twothirds, sigma2);
+
+  const __m256 c = _mm256_sub_ps(x, g);
+  const __m256 select = _mm256_cmp_ps(c, zero, _CMP_LT_OS);
+  const __m256 shadhi = _mm256_or_ps(_mm256_andnot_ps(select, shadows), _mm256_and_ps(select, highlights));
+  const __m256 ssigma = _mm256_xor_ps(sigma, _mm256_and_ps(select, sign_mask));
+  const __m256 vlin
+      = _mm256_add_ps(g, _mm256_add_ps(ssigma, _mm256_mul_ps(shadhi, _mm256_sub_ps(c, ssigma))));
+
+  const __m256 t = _mm256_min_ps(one, _mm256_max_ps(zero, _mm256_div_ps(c, _mm256_mul_ps(two, ssigma))));
+  const __m256 t2 = _mm256_mul_ps(t, t);
+  const __m256 mt = _mm256_sub_ps(one, t);
+
+  const __m256 vmid = _mm256_add_ps(g,
+      _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(ssigma, two), _mm256_mul_ps(mt, t)),
+        _mm256_mul_ps(t2, _mm256_add_ps(ssigma, _mm256_mul_ps(ssigma, shadhi)))));
+
+  const __m256 linselect = _mm256_cmp_ps(_mm256_andnot_ps(sign_mask, c), twosig, _CMP_GT_OS);
+  const __m256 val = _mm256_or_ps(_mm256_and_ps(linselect, vlin), _mm256_andnot_ps(linselect, vmid));
+
+  const __m256 arg = _mm256_xor_ps(sign_mask, _mm256_div_ps(_mm256_mul_ps(c, c), s22));
+  const __m256 k0 = _mm256_add_ps(const0, _mm256_mul_ps(arg, _mm256_sub_ps(const1, const0)));
+  const __m256 k = _mm256_max_ps(k0, zero);
+  const __m256 gauss = _mm256_castsi256_ps(_mm256_cvtps_epi32(k));
+  const __m256 vcon = _mm256_mul_ps(clarity, _mm256_mul_ps(c, gauss));
+  return _mm256_add_ps(val, vcon);
+}
+
+__attribute__((target("avx2"))) static void ll_apply_curve_avx2(
+    float *const row,
+    const int n,
+    const ll_curve_t *const cv)
+{
+  const __m256 g8 = _mm256_set1_ps(cv->g);
+  const __m256 sig8 = _mm256_set1_ps(cv->sigma);
+  const __m256 shd8 = _mm256_set1_ps(cv->shadows);
+  const __m256 hil8 = _mm256_set1_ps(cv->highlights);
+  const __m256 clr8 = _mm256_set1_ps(cv->clarity);
+  for(int i=0;i<n;i+=8)
+    _mm256_store_ps(row + i, curve_vec8(_mm256_load_ps(row + i), g8, sig8, shd8, hil8, clr8));
+}
 #endif
-  for(uint32_t j=padding;j<h-padding;j++)
+
+// applies the curve to a row in place. the row is aligned and n a multiple of 8.
+static inline void ll_apply_curve(
+    float *const row,
+    const int n,
+    const ll_curve_t *const cv,
+    const ll_simd_t simd)
+{
+#ifdef DT_HAVE_AVX2_CODEPATH
+  if(simd == LL_AVX2)
   {
-    const float *in2  = in  + j*w + padding;
-    float *out2 = out + j*w + padding;
-    // find 4-byte aligned block in the middle:
-    const float *const beg = (float *)((size_t)(out2+3)&(size_t)0x10ul);
-    const float *const end = (float *)((size_t)(out2+w-padding)&(size_t)0x10ul);
-    const float *const fin = out2+w-padding;
-    const __m128 g4 = _mm_set1_ps(g);
-    const __m128 sig4 = _mm_set1_ps(sigma);
-    const __m128 shd4 = _mm_set1_ps(shadows);
-    const __m128 hil4 = _mm_set1_ps(highlights);
-    const __m128 clr4 = _mm_set1_ps(clarity);
-    for(;out2<beg;out2++,in2++)
-      *out2 = curve_scalar(*in2, g, sigma, shadows, highlights, clarity);
-    for(;out2<end;out2+=4,in2+=4)
-      _mm_stream_ps(out2, curve_vec4(_mm_load_ps(in2), g4, sig4, shd4, hil4, clr4));
-    for(;out2<fin;out2++,in2++)
-      *out2 = curve_scalar(*in2, g, sigma, shadows, highlights, clarity);
-    out2 = out + j*w;
-    for(int i=0;i<padding;i++)   out2[i] = out2[padding];
-    for(int i=w-padding;i<w;i++) out2[i] = out2[w-padding-1];
+    ll_apply_curve_avx2(row, n, cv);
+    return;
   }
-#ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(dynamic)
 #endif
-  for(int j=0;j<padding;j++) memcpy(out + w*j, out+padding*w, sizeof(float)*w);
-#ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(dynamic)
+#if defined(__SSE2__)
+  if(simd == LL_SSE2)
+  {
+    const __m128 g4 = _mm_set1_ps(cv->g);
+    const __m128 sig4 = _mm_set1_ps(cv->sigma);
+    const __m128 shd4 = _mm_set1_ps(cv->shadows);
+    const __m128 hil4 = _mm_set1_ps(cv->highlights);
+    const __m128 clr4 = _mm_set1_ps(cv->clarity);
+    for(int i=0;i<n;i+=4)
+      _mm_store_ps(row + i, curve_vec4(_mm_load_ps(row + i), g4, sig4, shd4, hil4, clr4));
+    return;
+  }
 #endif
-  for(int j=h-padding;j<h;j++) memcpy(out + w*j, out+w*(h-padding-1), sizeof(float)*w);
+  for(int i=0;i<n;i++)
+    row[i] = curve_scalar(row[i], cv->g, cv->sigma, cv->shadows, cv->highlights, cv->clarity);
+}
+
+// writes row j of the padded brightness to row, which is n >= wd+2*max_supp long.
+static inline void ll_pad_row(
+    const ll_pad_t *const pad,
+    const int j,
+    float *const row,
+    const int n)
+{
+  const float *const in = pad->input + (size_t)4*pad->wd*CLAMPS(j-pad->max_supp, 0, pad->ht-1);
+  const float left = in[0] * 0.01f, right = in[4*(pad->wd-1)] * 0.01f; // L -> [0,1]
+  for(int i=0;i<pad->max_supp;i++) row[i] = left;
+  for(int i=0;i<pad->wd;i++) row[pad->max_supp+i] = in[4*i] * 0.01f;
+  for(int i=pad->max_supp+pad->wd;i<n;i++) row[i] = right;
 }
+
+// vertical pass of the reduction for one coarse row, from the horizontally reduced fine rows 2j-2..2j+2.
+// note that we're ignoring the (1..cw-1) buffer limit, we'll pull in garbage and fix it later by
+// border filling.
+static inline void ll_reduce_row_sse2(
+    const float *const row0,
+    const float *const row1,
+    const float *const row2,
+    const float *const row3,
+    const float *const row4,
+    float *const out,
+    const int cw)
+{
+#if defined(__SSE2__)
+  const __m128 four = _mm_set1_ps(4.f), scale = _mm_set1_ps(1.f/256.f);
+  for(int i=0;i<=cw-8;i+=8)
+  {
+    __m128 r0, r1, r2, r3, r4, t0, t1;
+    r0 = _mm_load_ps(row0 + i);
+    r1 = _mm_load_ps(row1 + i);
+    r2 = _mm_load_ps(row2 + i);
+    r3 = _mm_load_ps(row3 + i);
+    r4 = _mm_load_ps(row4 + i);
+    r0 = _mm_add_ps(r0, r4);
+    r1 = _mm_add_ps(_mm_add_ps(r1, r3), r2);
+    r0 = _mm_add_ps(r0, _mm_add_ps(r2, r2));
+    t0 = _mm_add_ps(r0, _mm_mul_ps(r1, four));
+
+    r0 = _mm_load_ps(row0 + i + 4);
+    r1 = _mm_load_ps(row1 + i + 4);
+    r2 = _mm_load_ps(row2 + i + 4);
+    r3 = _mm_load_ps(row3 + i + 4);
+    r4 = _mm_load_ps(row4 + i + 4);
+    r0 = _mm_add_ps(r0, r4);
+    r1 = _mm_add_ps(_mm_add_ps(r1, r3), r2);
+    r0 = _mm_add_ps(r0, _mm_add_ps(r2, r2));
+    t1 = _mm_add_ps(r0, _mm_mul_ps(r1, four));
+
+    t0 = _mm_mul_ps(t0, scale);
+    t1 = _mm_mul_ps(t1, scale);
+
+    _mm_storeu_ps(out + i, t0);
+    _mm_storeu_ps(out + i + 4, t1);
+  }
 #endif
+  // process the rest
+  for(int i=cw&~7;i<cw-1;i++)
+    out[i] = (6*row2[i] + 4*(row1[i] + row3[i]) + row0[i] + row4[i])*(1.0f/256.0f);
+}
 
-// scalar version
-void apply_curve(
+#ifdef DT_HAVE_AVX2_CODEPATH
+__attribute__((target("avx2"))) static void ll_reduce_row_avx2(
+    const float *const row0,
+    const float *const row1,
+    const float *const row2,
+    const float *const row3,
+    const float *const row4,
     float *const out,
-    const float *const in,
-    const uint32_t w,
-    const uint32_t h,
-    const uint32_t padding,
-    const float g,
-    const float sigma,
-    const float shadows,
-    const float highlights,
-    const float clarity)
+    const int cw)
 {
+  const __m256 four = _mm256_set1_ps(4.f), scale = _mm256_set1_ps(1.f/256.f);
+  for(int i=0;i<=cw-8;i+=8)
+  {
+    __m256 r0 = _mm256_load_ps(row0 + i);
+    __m256 r1 = _mm256_load_ps(row1 + i);
+    const __m256 r2 = _mm256_load_ps(row2 + i);
+    const __m256 r3 = _mm256_load_ps(row3 + i);
+    const __m256 r4 = _mm256_load_ps(row4 + i);
+    r0 = _mm256_add_ps(r0, r4);
+    r1 = _mm256_add_ps(_mm256_add_ps(r1, r3), r2);
+    r0 = _mm256_add_ps(r0, _mm256_add_ps(r2, r2));
+    const __m256 t = _mm256_add_ps(r0, _mm256_mul_ps(r1, four));
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(t, scale));
+  }
+  for(int i=cw&~7;i<cw-1;i++)
+    out[i] = (6*row2[i] + 4*(row1[i] + row3[i]) + row0[i] + row4[i])*(1.0f/256.0f);
+}
+#endif
+
+// blur with a 5x5 kernel and decimate. the fine rows are taken from input, or if that is NULL made from
+// the padded input image by pad. this is inspired by opencv's pyrDown_: the coarse rows are split into
+// bands, and every thread keeps a ring buffer of 5 horizontally reduced fine rows for its band, which it
+// convolves vertically.
+static void gauss_reduce(
+    const float *const input, // fine input buffer or NULL
+    const ll_pad_t *const pad,// padded finest level, if input is NULL
+    float *const coarse,      // coarse scale, blurred input buf
+    const int wd,             // fine res
+    const int ht,
+    const ll_simd_t simd)
+{
+  // blur, store only coarse res
+  const int cw = (wd-1)/2+1, ch = (ht-1)/2+1;
+  // the simd version uses 1 4 6 4 1 weights, this is the kernel for the scalar code:
+  const float a = 0.4f;
+  const float w[5] = {1./4.-a/2., 1./4., a, 1./4., 1./4.-a/2.};
+
+  const int stride = ((cw+8)&~7); // assure simd alignment of rows
+  const int fstride = input ? 0 : ((wd+8)&~7);
+  const size_t scratch_size = (size_t)5*stride + fstride;
+  const int nthreads = dt_get_num_threads();
+  // the rows on band borders are reduced twice, so don't make the bands too small
+  const int band = MAX(32, (ch-2 + 4*nthreads-1)/(4*nthreads));
+  const int num_bands = (ch-2 + band-1)/band;
+  float *const scratch = dt_alloc_align(64, sizeof(float)*scratch_size*nthreads);
+  // the vertical pass reads the unused ends of the rows, keep them finite
+  memset(scratch, 0, sizeof(float)*scratch_size*nthreads);
+
 #ifdef _OPENMP
 #pragma omp parallel for default(none) schedule(dynamic)
 #endif
-  for(uint32_t j=padding;j<h-padding;j++)
+  for(int b=0;b<num_bands;b++)
   {
-    const float *in2  = in  + j*w + padding;
-    float *out2 = out + j*w + padding;
-    for(uint32_t i=padding;i<w-padding;i++)
-      (*out2++) = curve_scalar(*(in2++), g, sigma, shadows, highlights, clarity);
-    out2 = out + j*w;
-    for(int i=0;i<padding;i++)   out2[i] = out2[padding];
-    for(int i=w-padding;i<w;i++) out2[i] = out2[w-padding-1];
+    float *const ringbuf = scratch + scratch_size*dt_get_thread_num();
+    float *const padrow = ringbuf + (size_t)5*stride;
+    const int j0 = 1 + b*band, j1 = MIN(ch-1, j0+band);
+    int rowj = 2*j0-2; // we initialised rows up to this one so far
+
+    for(int j=j0;j<j1;j++)
+    {
+      // horizontal pass, convolve with 1 4 6 4 1 kernel and decimate
+      for(;rowj<=2*j+2;rowj++)
+      {
+        float *const row = ringbuf + (rowj % 5)*stride;
+        const float *in = input + (size_t)rowj*wd;
+        if(!input)
+        {
+          ll_pad_row(pad, rowj, padrow, fstride);
+          if(pad->curve) ll_apply_curve(padrow, fstride, pad->curve, simd);
+          in = padrow;
+        }
+        if(simd == LL_SCALAR)
+          for(int i=1;i<cw-1;i++)
+            row[i] = w[0]*in[2*i-2] + w[1]*in[2*i-1] + w[2]*in[2*i] + w[3]*in[2*i+1] + w[4]*in[2*i+2];
+        else
+          for(int i=1;i<cw-1;i++)
+            row[i] = 6*in[2*i] + 4*(in[2*i-1]+in[2*i+1]) + in[2*i-2] + in[2*i+2];
+      }
+
+      const float *const row0 = ringbuf + ((2*j-2)%5)*stride, *const row1 = ringbuf + ((2*j-1)%5)*stride,
+                  *const row2 = ringbuf + ((2*j)%5)*stride, *const row3 = ringbuf + ((2*j+1)%5)*stride,
+                  *const row4 = ringbuf + ((2*j+2)%5)*stride;
+      float *const out = coarse + (size_t)j*cw;
+#ifdef DT_HAVE_AVX2_CODEPATH
+      if(simd == LL_AVX2)
+        ll_reduce_row_avx2(row0, row1, row2, row3, row4, out, cw);
+      else
+#endif
+      if(simd == LL_SSE2)
+        ll_reduce_row_sse2(row0, row1, row2, row3, row4, out, cw);
+      else
+        for(int i=1;i<cw-1;i++)
+          out[i] = w[0]*row0[i] + w[1]*row1[i] + w[2]*row2[i] + w[3]*row3[i] + w[4]*row4[i];
+    }
   }
+  dt_free_align(scratch);
+  ll_fill_boundary1(coarse, cw, ch);
+}
+
+// the gamma to interpolate from for brightness v, and the weight of the next one
+static inline int ll_gamma_lo(
+    const float *const gamma,
+    const float v,
+    float *const a)
+{
+  int hi = 1;
+  for(;hi<num_gamma-1 && gamma[hi] <= v;hi++);
+  const int lo = hi-1;
+  *a = CLAMPS((v - gamma[lo])/(gamma[hi]-gamma[lo]), 0.0f, 1.0f);
+  return lo;
+}
+
+// the parts of each level which end up in the unpadded output: the image itself on the finest level,
+// on the coarser ones what the expansion of the finer roi reads. the coarsest level is kept whole.
+static void ll_get_rois(
+    ll_roi_t *const roi,
+    const int wd,
+    const int ht,
+    const int num_levels)
+{
+  const int max_supp = 1<<(num_levels-1);
+  const int w = wd + 2*max_supp, h = ht + 2*max_supp;
+  roi[0] = (ll_roi_t){ max_supp, max_supp, wd, ht };
+  for(int l=0;l<num_levels-2;l++)
+  {
+    const int pw = dl(w,l), ph = dl(h,l);
+    const int x0 = CLAMPS(roi[l].x0, 1, ((pw-1)&~1)-1)/2 - 1;
+    const int x1 = CLAMPS(roi[l].x0+roi[l].w-1, 1, ((pw-1)&~1)-1)/2 + 1;
+    const int y0 = CLAMPS(roi[l].y0, 1, ((ph-1)&~1)-1)/2 - 1;
+    const int y1 = CLAMPS(roi[l].y0+roi[l].h-1, 1, ((ph-1)&~1)-1)/2 + 1;
+    roi[l+1].x0 = MAX(0, x0);
+    roi[l+1].y0 = MAX(0, y0);
+    roi[l+1].w = MIN(dl(w,l+1)-1, x1) - roi[l+1].x0 + 1;
+    roi[l+1].h = MIN(dl(h,l+1)-1, y1) - roi[l+1].y0 + 1;
+  }
+  roi[num_levels-1] = (ll_roi_t){ 0, 0, dl(w,num_levels-1), dl(h,num_levels-1) };
+}
+
+// adds the laplacian coefficients of gamma k, weighted by how close the padded input is to that gamma,
+// to the output coefficients of level l >= 1. the first gamma of a pixel initialises it.
+static void ll_add_laplacian(
+    float *const lap,           // output coefficients of roi
+    const ll_roi_t *const roi,
+    const float *const padded,  // gaussian pyramid of the padded input, this level
+    const float *const fine,    // gaussian pyramid of gamma k, this level
+    const float *const coarse,  // and the next one
+    const int pw,               // dimensions of this level
+    const int ph,
+    const float *const gamma,
+    const int k)
+{
 #ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(dynamic)
+#pragma omp parallel for default(none) schedule(static)
 #endif
-  for(int j=0;j<padding;j++) memcpy(out + w*j, out+padding*w, sizeof(float)*w);
+  for(int j=roi->y0;j<roi->y0+roi->h;j++)
+  {
+    float *const out = lap + (size_t)(j-roi->y0)*roi->w;
+    for(int i=roi->x0;i<roi->x0+roi->w;i++)
+    {
+      float a;
+      const int lo = ll_gamma_lo(gamma, padded[(size_t)j*pw+i], &a);
+      if(lo != k && lo+1 != k) continue;
+      const float c = ll_expand_gaussian(coarse,
+          CLAMPS(i, 1, ((pw-1)&~1)-1), CLAMPS(j, 1, ((ph-1)&~1)-1), pw, ph);
+      const float l = fine[(size_t)j*pw+i] - c;
+      if(lo == k) out[i-roi->x0] = l * (1.0f-a);
+      else        out[i-roi->x0] += l * a;
+    }
+  }
+}
+
+// same for the finest level, the coefficients are kept in the L channel of out. the input brightness
+// and the curve are evaluated again instead of storing the finest levels.
+static void ll_add_laplacian0(
+    float *const out,
+    const float *const input,
+    const int wd,
+    const int ht,
+    const int max_supp,
+    const float *const coarse,  // level 1 of the gaussian pyramid of gamma k
+    const float *const gamma,
+    const int k,
+    const ll_curve_t *const cv,
+    const ll_simd_t simd)
+{
+  const int pw = wd + 2*max_supp, ph = ht + 2*max_supp;
+  const int stride = (wd+7)&~7;
+  const int nthreads = dt_get_num_threads();
+  float *const scratch = dt_alloc_align(64, sizeof(float)*stride*nthreads);
 #ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(dynamic)
+#pragma omp parallel for default(none) schedule(static)
 #endif
-  for(int j=h-padding;j<h;j++) memcpy(out + w*j, out+w*(h-padding-1), sizeof(float)*w);
+  for(int j=0;j<ht;j++)
+  {
+    float *const row = scratch + (size_t)stride*dt_get_thread_num();
+    const float *const in = input + (size_t)4*wd*j;
+    float *const o = out + (size_t)4*wd*j;
+    for(int i=0;i<wd;i++) row[i] = in[4*i] * 0.01f; // L -> [0,1]
+    for(int i=wd;i<stride;i++) row[i] = row[wd-1];
+    ll_apply_curve(row, stride, cv, simd);
+    for(int i=0;i<wd;i++)
+    {
+      float a;
+      const int lo = ll_gamma_lo(gamma, in[4*i] * 0.01f, &a);
+      if(lo != k && lo+1 != k) continue;
+      const float c = ll_expand_gaussian(coarse,
+          CLAMPS(i+max_supp, 1, ((pw-1)&~1)-1), CLAMPS(j+max_supp, 1, ((ph-1)&~1)-1), pw, ph);
+      const float l = row[i] - c;
+      if(lo == k) o[4*i] = l * (1.0f-a);
+      else        o[4*i] += l * a;
+    }
+  }
+  dt_free_align(scratch);
 }
 
 void local_laplacian_internal(
@@ -471,151 +632,140 @@ void local_laplacian_internal(
     const float clarity,        // user param: increase clarity/local contrast
     const int use_sse2)         // flag whether to use SSE version
 {
-#define max_levels 30
-#define num_gamma 6
   // don't divide by 2 more often than we can:
   const int num_levels = MIN(max_levels, 31-__builtin_clz(MIN(wd,ht)));
+  if(num_levels < 2)
+  { // nothing to do for tiny images
+    memcpy(out, input, sizeof(float)*4*wd*ht);
+    return;
+  }
   const int max_supp = 1<<(num_levels-1);
-  int w, h;
-  float *padded[max_levels] = {0};
-  padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h);
-
-  // allocate pyramid pointers for padded input
-  for(int l=1;l<num_levels;l++)
-    padded[l] = dt_alloc_align(16, sizeof(float)*dl(w,l)*dl(h,l));
+  const int w = wd + 2*max_supp, h = ht + 2*max_supp;
 
-  // allocate pyramid pointers for output
-  float *output[max_levels] = {0};
-  for(int l=0;l<num_levels;l++)
-    output[l] = dt_alloc_align(16, sizeof(float)*dl(w,l)*dl(h,l));
-
-  // create gauss pyramid of padded input, write coarse directly to output
+  ll_simd_t simd = LL_SCALAR;
 #if defined(__SSE2__)
-  if(use_sse2)
-  {
-    for(int l=1;l<num_levels-1;l++)
-      gauss_reduce_sse2(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
-    gauss_reduce_sse2(padded[num_levels-2], output[num_levels-1], dl(w,num_levels-2), dl(h,num_levels-2));
-  }
-  else
+  if(use_sse2) simd = LL_SSE2;
 #endif
-  {
-    for(int l=1;l<num_levels-1;l++)
-      gauss_reduce(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
-    gauss_reduce(padded[num_levels-2], output[num_levels-1], dl(w,num_levels-2), dl(h,num_levels-2));
-  }
+#ifdef DT_HAVE_AVX2_CODEPATH
+  if(use_sse2 && darktable.codepath.AVX2) simd = LL_AVX2;
+#endif
+
+  ll_pad_t pad = { input, wd, ht, max_supp, NULL };
+
+  // create gauss pyramid of padded input. the coarsest level is the coarsest one of the output, too.
+  float *padded[max_levels] = {0};
+  for(int l=1;l<num_levels;l++)
+    padded[l] = dt_alloc_align(64, sizeof(float)*dl(w,l)*dl(h,l));
+  gauss_reduce(NULL, &pad, padded[1], w, h, simd);
+  for(int l=2;l<num_levels;l++)
+    gauss_reduce(padded[l-1], NULL, padded[l], dl(w,l-1), dl(h,l-1), simd);
+
+  // output coefficients of the levels in between, the finest one is accumulated in out directly
+  ll_roi_t roi[max_levels];
+  ll_get_rois(roi, wd, ht, num_levels);
+  float *output[max_levels] = {0};
+  for(int l=1;l<num_levels-1;l++)
+    output[l] = dt_alloc_align(64, sizeof(float)*roi[l].w*roi[l].h);
+  output[num_levels-1] = padded[num_levels-1];
 
   // evenly sample brightness [0,1]:
   float gamma[num_gamma] = {0.0f};
   for(int k=0;k<num_gamma;k++) gamma[k] = (k+.5f)/(float)num_gamma;
   // for(int k=0;k<num_gamma;k++) gamma[k] = k/(num_gamma-1.0f);
 
-  // allocate memory for intermediate laplacian pyramids
-  float *buf[num_gamma][max_levels] = {{0}};
-  for(int k=0;k<num_gamma;k++) for(int l=0;l<num_levels;l++)
-    buf[k][l] = dt_alloc_align(16, sizeof(float)*dl(w,l)*dl(h,l));
+  // gaussian pyramid of the current gamma, without the finest level
+  float *buf[max_levels] = {0};
+  for(int l=1;l<num_levels;l++)
+    buf[l] = dt_alloc_align(64, sizeof(float)*dl(w,l)*dl(h,l));
 
   // the paper says remapping only level 3 not 0 does the trick, too
   // (but i really like the additional octave of sharpness we get,
   // willing to pay the cost).
   for(int k=0;k<num_gamma;k++)
-  { // process images
-#if defined(__SSE2__)
-    if(use_sse2)
-      apply_curve_sse2(buf[k][0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity);
-    else // brackets in next line needed for silly gcc warning:
-#endif
-    {apply_curve(buf[k][0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity);}
+  {
+    const ll_curve_t curve = { gamma[k], sigma, shadows, highlights, clarity };
+    pad.curve = &curve;
+    gauss_reduce(NULL, &pad, buf[1], w, h, simd);
+    for(int l=2;l<num_levels;l++)
+      gauss_reduce(buf[l-1], NULL, buf[l], dl(w,l-1), dl(h,l-1), simd);
 
-    // create gaussian pyramids
-    for(int l=1;l<num_levels;l++)
-#if defined(__SSE2__)
-      if(use_sse2)
-        gauss_reduce_sse2(buf[k][l-1], buf[k][l], dl(w,l-1), dl(h,l-1));
-      else
-#endif
-        gauss_reduce(buf[k][l-1], buf[k][l], dl(w,l-1), dl(h,l-1));
+    ll_add_laplacian0(out, input, wd, ht, max_supp, buf[1], gamma, k, &curve, simd);
+    for(int l=1;l<num_levels-1;l++)
+      ll_add_laplacian(output[l], roi + l, padded[l], buf[l], buf[l+1], dl(w,l), dl(h,l), gamma, k);
   }
 
   // assemble output pyramid coarse to fine
-  for(int l=num_levels-2;l >= 0; l--)
+  for(int l=num_levels-2;l>0;l--)
   {
     const int pw = dl(w,l), ph = dl(h,l);
-
-    gauss_expand(output[l+1], output[l], pw, ph);
-    // go through all coefficients in the upsampled gauss buffer:
+    const float *const coarse = output[l+1];
+    const ll_roi_t *const croi = roi + l + 1;
+    float *const lap = output[l];
+    const ll_roi_t *const r = roi + l;
 #ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(static) collapse(2) shared(w,h,buf,output,l,gamma,padded)
+#pragma omp parallel for default(none) schedule(static)
 #endif
-    for(int j=0;j<ph;j++) for(int i=0;i<pw;i++)
-    {
-      const float v = padded[l][j*pw+i];
-      int hi = 1;
-      for(;hi<num_gamma-1 && gamma[hi] <= v;hi++);
-      int lo = hi-1;
-      const float a = CLAMPS((v - gamma[lo])/(gamma[hi]-gamma[lo]), 0.0f, 1.0f);
-      const float l0 = ll_laplacian(buf[lo][l+1], buf[lo][l], i, j, pw, ph);
-      const float l1 = ll_laplacian(buf[hi][l+1], buf[hi][l], i, j, pw, ph);
-      output[l][j*pw+i] += l0 * (1.0f-a) + l1 * a;
-      // we could do this to save on memory (no need for finest buf[][]).
-      // unfortunately it results in a quite noticable loss of sharpness, i think
-      // the extra level is worth it.
-      // else if(l == 0) // use finest scale from input to not amplify noise (and use less memory)
-      //   output[l][j*pw+i] += ll_laplacian(padded[l+1], padded[l], i, j, pw, ph);
-    }
+    for(int j=r->y0;j<r->y0+r->h;j++)
+      for(int i=r->x0;i<r->x0+r->w;i++)
+        lap[(size_t)(j-r->y0)*r->w+i-r->x0] += ll_expand_gaussian_roi(coarse, croi,
+            CLAMPS(i, 1, ((pw-1)&~1)-1), CLAMPS(j, 1, ((ph-1)&~1)-1));
   }
 #ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(dynamic) collapse(2) shared(w,output,buf)
+#pragma omp parallel for default(none) schedule(static) shared(output, roi)
 #endif
   for(int j=0;j<ht;j++) for(int i=0;i<wd;i++)
   {
-    out[4*(j*wd+i)+0] = 100.0f * output[0][(j+max_supp)*w+max_supp+i]; // [0,1] -> L
-    out[4*(j*wd+i)+1] = input[4*(j*wd+i)+1]; // copy original colour channels
-    out[4*(j*wd+i)+2] = input[4*(j*wd+i)+2];
+    const size_t k = (size_t)4*(j*wd+i);
+    const float c = ll_expand_gaussian_roi(output[1], roi + 1,
+        CLAMPS(i+max_supp, 1, ((w-1)&~1)-1), CLAMPS(j+max_supp, 1, ((h-1)&~1)-1));
+    out[k+0] = 100.0f * (c + out[k+0]); // [0,1] -> L
+    out[k+1] = input[k+1]; // copy original colour channels
+    out[k+2] = input[k+2];
   }
   // free all buffers!
-  for(int l=0;l<max_levels;l++)
+  for(int l=1;l<num_levels;l++)
   {
     dt_free_align(padded[l]);
-    dt_free_align(output[l]);
-    for(int k = 0; k < num_gamma; k++) dt_free_align(buf[k][l]);
+    dt_free_align(buf[l]);
+    if(l < num_levels-1) dt_free_align(output[l]);
   }
-#undef num_levels
-#undef num_gamma
 }
 
 
 size_t local_laplacian_memory_use(const int width,     // width of input image
                                   const int height)    // height of input image
 {
-#define max_levels 30
-#define num_gamma 6
   const int num_levels = MIN(max_levels, 31-__builtin_clz(MIN(width,height)));
+  if(num_levels < 2) return 0;
   const int max_supp = 1<<(num_levels-1);
   const int paddwd = width  + 2*max_supp;
   const int paddht = height + 2*max_supp;
 
+  ll_roi_t roi[max_levels];
+  ll_get_rois(roi, width, height, num_levels);
+
   size_t memory_use = 0;
 
-  for(int l=0;l<num_levels;l++)
-    memory_use += (size_t)(2 + num_gamma) * dl(paddwd, l) * dl(paddht, l) * sizeof(float);
+  // gaussian pyramids of the padded input and of one gamma, except for the finest level
+  for(int l=1;l<num_levels;l++)
+    memory_use += (size_t)2 * dl(paddwd, l) * dl(paddht, l) * sizeof(float);
+  // output coefficients
+  for(int l=1;l<num_levels-1;l++)
+    memory_use += (size_t)roi[l].w * roi[l].h * sizeof(float);
+  // per thread rows of the reduction
+  memory_use += (size_t)dt_get_num_threads() * (5 * ((dl(paddwd, 1)+8)&~7) + ((paddwd+8)&~7)) * sizeof(float);
 
   return memory_use;
-#undef num_levels
-#undef num_gamma
 }
 
 size_t local_laplacian_singlebuffer_size(const int width,     // width of input image
                                          const int height)    // height of input image
 {
-#define max_levels 30
-#define num_gamma 6
   const int num_levels = MIN(max_levels, 31-__builtin_clz(MIN(width,height)));
+  if(num_levels < 2) return 0;
   const int max_supp = 1<<(num_levels-1);
   const int paddwd = width  + 2*max_supp;
   const int paddht = height + 2*max_supp;
 
-  return (size_t)dl(paddwd, 0) * dl(paddht, 0) * sizeof(float);
-#undef num_levels
-#undef num_gamma
+  return (size_t)dl(paddwd, 1) * dl(paddht, 1) * sizeof(float);
 }
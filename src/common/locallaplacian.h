@@ -19,7 +19,7 @@
 
 void local_laplacian_internal(
     const float *const input,   // input buffer in some Labx or yuvx format
-    float *const out,           // output buffer with colour
+    float *const out,           // output buffer with colour, must not be the input
     const int wd,               // width and
     const int ht,               // height of the input buffer
     const float sigma,          // user param: separate shadows/midtones/highlights
@@ -20,14 +20,17 @@
 #include "common/darktable.h"
 #include "common/debug.h"
 #include "common/exif.h"
+#include "common/file_location.h"
 #include "common/grealpath.h"
 #include "common/image_cache.h"
 #include "common/imageio.h"
 #include "common/imageio_jpeg.h"
 #include "common/imageio_module.h"
+#include "common/mipmap_pack.h"
 #include "control/conf.h"
 #include "control/jobs.h"
 #include "develop/imageop_math.h"
+#include "develop/pixelpipe_cache.h"
 
 #include <assert.h>
 #include <errno.h>
@@ -44,6 +47,7 @@
 #endif
 
 #if !defined(_WIN32)
+#include <sys/mman.h>
 #include <sys/statvfs.h>
 #else 
 //statvfs does not exist in Windows, providing implementation
@@ -58,7 +62,9 @@ typedef enum dt_mipmap_buffer_dsc_flags
 {
   DT_MIPMAP_BUFFER_DSC_FLAG_NONE = 0,
   DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE = 1 << 0,
-  DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE = 1 << 1
+  DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE = 1 << 1,
+  // full buffer of a successfully decoded image, its dt_image_t is stored behind the pixels
+  DT_MIPMAP_BUFFER_DSC_FLAG_DECODED = 1 << 2
 } dt_mipmap_buffer_dsc_flags;
 
 // the embedded Exif data to tag thumbnails as sRGB or AdobeRGB
@@ -240,6 +246,99 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, float *isca
                     dt_colorspaces_color_profile_type_t *color_space, const uint32_t imgid,
                     const dt_mipmap_size_t size);
 
+// full buffers may be mapped instead of allocated from the heap. anonymous mappings can use transparent huge
+// pages, mappings of unlinked files let the kernel write the buffers back to disk under memory pressure,
+// instead of swapping or killing us. small buffers and the fallback for files are anonymous mappings, so
+// everything but heap memory is unmapped again.
+static void *_full_buffer_alloc(const dt_mipmap_cache_t *cache, const size_t size)
+{
+#if !defined(_WIN32)
+  if(cache->full_backing != DT_MIPMAP_BACKING_HEAP)
+  {
+    void *mem = MAP_FAILED;
+    if(cache->full_backing == DT_MIPMAP_BACKING_FILE && size >= (1 << 20))
+    {
+      char cachedir[PATH_MAX] = { 0 };
+      dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+      gchar *filename = g_build_filename(cachedir, "full-XXXXXX", NULL);
+      const int fd = g_mkstemp(filename);
+      if(fd >= 0)
+      {
+        g_unlink(filename);
+        // reserve the blocks, running out of disk space later on would end in SIGBUS
+#if defined(__APPLE__)
+        const int err = ftruncate(fd, size);
+#else
+        const int err = posix_fallocate(fd, 0, size);
+#endif
+        if(!err) mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+      }
+      else
+        dt_print(DT_DEBUG_CACHE, "[mipmap_cache] can't create `%s': %s\n", filename, g_strerror(errno));
+      g_free(filename);
+    }
+    if(mem == MAP_FAILED)
+    {
+      mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+      if(mem != MAP_FAILED && cache->full_backing == DT_MIPMAP_BACKING_HUGE_PAGES)
+        madvise(mem, size, MADV_HUGEPAGE);
+#endif
+    }
+    return mem == MAP_FAILED ? NULL : mem;
+  }
+#endif
+  return dt_alloc_align(64, size);
+}
+
+static void _full_buffer_free(const dt_mipmap_cache_t *cache, void *mem, const size_t size)
+{
+  if(mem == (void *)dt_mipmap_cache_static_dead_image) return;
+#if !defined(_WIN32)
+  if(cache->full_backing != DT_MIPMAP_BACKING_HEAP)
+  {
+    munmap(mem, size);
+    return;
+  }
+#endif
+  dt_free_align(mem);
+}
+
+// hands full buffers evicted from the raw pool back to the allocator they came from
+static void _raw_pool_free(void *data, const size_t size, void *user_data)
+{
+  _full_buffer_free((const dt_mipmap_cache_t *)user_data, data, size);
+}
+
+// the image as its loader left it, stored behind the pixels of decoded full buffers
+static inline dt_image_t *_full_buffer_image(struct dt_mipmap_buffer_dsc *dsc)
+{
+  return (dt_image_t *)((uint8_t *)dsc + dsc->size - sizeof(dt_image_t));
+}
+
+// restores what the loader found out about the image, for a full buffer which wasn't decoded again
+static void _full_buffer_restore_image(dt_image_t *img, const dt_image_t *decoded)
+{
+  const int32_t format = DT_IMAGE_LDR | DT_IMAGE_RAW | DT_IMAGE_HDR | DT_IMAGE_4BAYER;
+  img->width = decoded->width;
+  img->height = decoded->height;
+  img->crop_x = decoded->crop_x;
+  img->crop_y = decoded->crop_y;
+  img->crop_width = decoded->crop_width;
+  img->crop_height = decoded->crop_height;
+  img->flags = (img->flags & ~format) | (decoded->flags & format);
+  img->loader = decoded->loader;
+  img->buf_dsc = decoded->buf_dsc;
+  memcpy(img->d65_color_matrix, decoded->d65_color_matrix, sizeof(img->d65_color_matrix));
+  img->raw_black_level = decoded->raw_black_level;
+  memcpy(img->raw_black_level_separate, decoded->raw_black_level_separate, sizeof(img->raw_black_level_separate));
+  img->raw_white_point = decoded->raw_white_point;
+  img->fuji_rotation_pos = decoded->fuji_rotation_pos;
+  img->pixel_aspect_ratio = decoded->pixel_aspect_ratio;
+  memcpy(img->wb_coeffs, decoded->wb_coeffs, sizeof(img->wb_coeffs));
+}
+
 // callback for the imageio core to allocate memory.
 // only needed for _F and _FULL buffers, as they change size
 // with the input image. will allocate img->width*img->height*img->bpp bytes.
@@ -247,6 +346,7 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf, const dt_image_t *img)
 {
   assert(buf->size == DT_MIPMAP_FULL);
 
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
   dt_cache_entry_t *entry = buf->cache_entry;
   struct dt_mipmap_buffer_dsc *dsc = (struct dt_mipmap_buffer_dsc *)entry->data;
 
@@ -254,17 +354,18 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf, const dt_image_t *img)
   const int ht = img->height;
 
   const size_t bpp = dt_iop_buffer_dsc_to_bpp(&img->buf_dsc);
-  const size_t buffer_size = (size_t)wd * ht * bpp + sizeof(*dsc);
+  // room for the image behind the pixels, for the raw pool
+  const size_t buffer_size = (size_t)wd * ht * bpp + sizeof(*dsc) + sizeof(dt_image_t);
 
   // buf might have been alloc'ed before,
   // so only check size and re-alloc if necessary:
   if(!buf->buf || ((void *)dsc == (void *)dt_mipmap_cache_static_dead_image) || (entry->data_size < buffer_size))
   {
-    if((void *)dsc != (void *)dt_mipmap_cache_static_dead_image) dt_free_align(entry->data);
+    _full_buffer_free(cache, entry->data, entry->data_size);
 
     entry->data_size = 0;
 
-    entry->data = dt_alloc_align(64, buffer_size);
+    entry->data = _full_buffer_alloc(cache, buffer_size);
 
     if(!entry->data)
     {
@@ -279,6 +380,9 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf, const dt_image_t *img)
 
     // set buffer size only if we're making it larger.
     dsc = (struct dt_mipmap_buffer_dsc *)entry->data;
+
+    // we hold the write lock, as the alloc callback asks for it
+    dt_cache_update_cost(&cache->mip_full.cache, entry, entry->data_size);
   }
 
   dsc->size = buffer_size;
@@ -325,7 +429,10 @@ void dt_mipmap_cache_allocate_dynamic(void *data, dt_cache_entry_t *entry)
       entry->data_size = sizeof(*dsc) + sizeof(float) * 4 * 64;
     }
 
-    entry->data = dt_alloc_align(16, entry->data_size);
+    if(mip == DT_MIPMAP_FULL)
+      entry->data = _full_buffer_alloc(cache, entry->data_size);
+    else
+      entry->data = dt_alloc_align(16, entry->data_size);
 
     // fprintf(stderr, "[mipmap cache] alloc dynamic for key %u %p\n", key, *buf);
     if(!(entry->data))
@@ -359,7 +466,22 @@ void dt_mipmap_cache_allocate_dynamic(void *data, dt_cache_entry_t *entry)
   int loaded_from_disk = 0;
   if(mip < DT_MIPMAP_F)
   {
-    if(cache->cachedir[0] && dt_conf_get_bool("cache_disk_backend"))
+    if(cache->pack[mip] && dt_conf_get_bool("cache_disk_backend"))
+    {
+      // no decoding, just a copy out of the mapped pack file
+      uint32_t width, height;
+      int color_space;
+      if(!dt_mipmap_pack_read(cache->pack[mip], get_imgid(entry->key), entry->data + sizeof(*dsc),
+                              cache->max_width[mip], cache->max_height[mip], &width, &height, &color_space))
+      {
+        dsc->width = width;
+        dsc->height = height;
+        dsc->iscale = 1.0f;
+        dsc->color_space = color_space;
+        loaded_from_disk = 1;
+      }
+    }
+    else if(cache->cachedir[0] && dt_conf_get_bool("cache_disk_backend"))
     {
       // try and load from disk, if successful set flag
       char filename[PATH_MAX] = {0};
@@ -407,9 +529,10 @@ read_error:
     dsc->flags = DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
   else dsc->flags = 0;
 
-  // cost is just flat one for the buffer, as the buffers might have different sizes,
-  // to make sure quota is meaningful.
-  if(mip >= DT_MIPMAP_F) entry->cost = 1;
+  // full buffers are accounted in bytes, and updated once the image is loaded (see dt_mipmap_cache_alloc()).
+  // cost is just flat one for the mipf buffers, which all have the same size.
+  if(mip == DT_MIPMAP_FULL) entry->cost = entry->data_size;
+  else if(mip == DT_MIPMAP_F) entry->cost = 1;
   else entry->cost = cache->buffer_size[mip];
 }
 
@@ -426,6 +549,38 @@ static void dt_mipmap_cache_unlink_ondisk_thumbnail(void *data, uint32_t imgid,
     snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", cache->cachedir, mip, imgid);
     g_unlink(filename);
   }
+  if(mip < DT_MIPMAP_F && cache->pack[mip]) dt_mipmap_pack_remove(cache->pack[mip], imgid);
+}
+
+// whether the disk backend has a thumbnail of this size for imgid
+static gboolean _ondisk_thumbnail_exists(const dt_mipmap_cache_t *cache, const uint32_t imgid,
+                                         const dt_mipmap_size_t mip)
+{
+  if(mip < DT_MIPMAP_F && cache->pack[mip]) return dt_mipmap_pack_contains(cache->pack[mip], imgid);
+  char filename[PATH_MAX] = { 0 };
+  snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", cache->cachedir, mip, imgid);
+  return g_file_test(filename, G_FILE_TEST_EXISTS);
+}
+
+// check the disk isn't full before writing to it
+static gboolean _disk_has_space(const char *filename)
+{
+  struct statvfs vfsbuf;
+  if (!statvfs(filename, &vfsbuf))
+  {
+    int64_t free_mb = ((vfsbuf.f_frsize * vfsbuf.f_bavail) >> 20);
+    if (free_mb < 100)
+    {
+      fprintf(stderr, "Aborting image write as only %" PRId64 " MB free to write %s\n", free_mb, filename);
+      return FALSE;
+    }
+  }
+  else
+  {
+    fprintf(stderr, "Aborting image write since couldn't determine free space available to write %s\n", filename);
+    return FALSE;
+  }
+  return TRUE;
 }
 
 void dt_mipmap_cache_deallocate_dynamic(void *data, dt_cache_entry_t *entry)
@@ -442,6 +597,14 @@ void dt_mipmap_cache_deallocate_dynamic(void *data, dt_cache_entry_t *entry)
       {
         dt_mipmap_cache_unlink_ondisk_thumbnail(data, get_imgid(entry->key), mip);
       }
+      else if(cache->pack[mip] && dt_conf_get_bool("cache_disk_backend"))
+      {
+        // raw pixels, appended to the pack. like the jpegs, existing thumbnails are not rewritten
+        const uint32_t imgid = get_imgid(entry->key);
+        if(!dt_mipmap_pack_contains(cache->pack[mip], imgid) && _disk_has_space(cache->cachedir))
+          dt_mipmap_pack_write(cache->pack[mip], imgid, entry->data + sizeof(*dsc), dsc->width, dsc->height,
+                               dsc->color_space);
+      }
       else if(cache->cachedir[0] && dt_conf_get_bool("cache_disk_backend"))
       {
         // serialize to disk
@@ -456,21 +619,7 @@ void dt_mipmap_cache_deallocate_dynamic(void *data, dt_cache_entry_t *entry)
           if (!g_file_test(filename, G_FILE_TEST_EXISTS) && (f = g_fopen(filename, "wb")))
           {
             // first check the disk isn't full
-            struct statvfs vfsbuf;
-            if (!statvfs(filename, &vfsbuf))
-            {
-              int64_t free_mb = ((vfsbuf.f_frsize * vfsbuf.f_bavail) >> 20);
-              if (free_mb < 100)
-              {
-                fprintf(stderr, "Aborting image write as only %" PRId64 " MB free to write %s\n", free_mb, filename);
-                goto write_error;
-              }
-            }
-            else
-            {
-              fprintf(stderr, "Aborting image write since couldn't determine free space available to write %s\n", filename);
-              goto write_error;
-            }
+            if(!_disk_has_space(filename)) goto write_error;
 
             const int cache_quality = dt_conf_get_int("database_cache_quality");
             const uint8_t *exif = NULL;
@@ -496,7 +645,18 @@ write_error:
       }
     }
   }
-  dt_free_align(entry->data);
+  if(mip == DT_MIPMAP_FULL)
+  {
+    // decoded images wait in the raw pool, in case they are needed again
+    const struct dt_mipmap_buffer_dsc *dsc = (struct dt_mipmap_buffer_dsc *)entry->data;
+    if(entry->data != (void *)dt_mipmap_cache_static_dead_image && (dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_DECODED)
+       && !(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE)
+       && !dt_raw_pool_put(&cache->raw_pool, get_imgid(entry->key), entry->data, entry->data_size))
+      return;
+    _full_buffer_free(cache, entry->data, entry->data_size);
+  }
+  else
+    dt_free_align(entry->data);
 }
 
 static uint32_t nearest_power_of_two(const uint32_t value)
@@ -509,6 +669,20 @@ static uint32_t nearest_power_of_two(const uint32_t value)
 void dt_mipmap_cache_init(dt_mipmap_cache_t *cache)
 {
   dt_mipmap_cache_get_filename(cache->cachedir, sizeof(cache->cachedir));
+
+  // the pack files are opened once, switching the format needs a restart
+  for(int k = 0; k < DT_MIPMAP_F; k++) cache->pack[k] = NULL;
+  gchar *format = dt_conf_get_string("cache_disk_backend_format");
+  if(cache->cachedir[0] && dt_conf_get_bool("cache_disk_backend") && !g_strcmp0(format, "raw pack files"))
+  {
+    for(int k = 0; k < DT_MIPMAP_F; k++)
+    {
+      char filename[PATH_MAX] = { 0 };
+      snprintf(filename, sizeof(filename), "%s.d/%d", cache->cachedir, k);
+      cache->pack[k] = dt_mipmap_pack_open(filename);
+    }
+  }
+  g_free(format);
   // make sure static memory is initialized
   struct dt_mipmap_buffer_dsc *dsc = (struct dt_mipmap_buffer_dsc *)dt_mipmap_cache_static_dead_image;
   dead_image_f((dt_mipmap_buffer_t *)(dsc + 1));
@@ -570,11 +744,22 @@ void dt_mipmap_cache_init(dt_mipmap_cache_t *cache)
       = MAX(2, parallel); // even with one thread you want two buffers. one for dr one for thumbs.
   int32_t max_mem_bufs = nearest_power_of_two(full_entries);
 
-  // for this buffer, because it can be very busy during import
-  dt_cache_init(&cache->mip_full.cache, 0, max_mem_bufs);
+  // full buffers are accounted in bytes, their size depends on the image
+  gchar *backing = dt_conf_get_string("cache_full_backing");
+  cache->full_backing = DT_MIPMAP_BACKING_HEAP;
+#if !defined(_WIN32)
+  if(!g_strcmp0(backing, "huge pages"))
+    cache->full_backing = DT_MIPMAP_BACKING_HUGE_PAGES;
+  else if(!g_strcmp0(backing, "temporary files"))
+    cache->full_backing = DT_MIPMAP_BACKING_FILE;
+#endif
+  g_free(backing);
+  const size_t full_mem = MAX(dt_conf_get_int64("cache_full_memory"), (int64_t)256 << 20);
+  dt_cache_init(&cache->mip_full.cache, 0, full_mem);
   dt_cache_set_allocate_callback(&cache->mip_full.cache, dt_mipmap_cache_allocate_dynamic, cache);
   dt_cache_set_cleanup_callback(&cache->mip_full.cache, dt_mipmap_cache_deallocate_dynamic, cache);
   cache->buffer_size[DT_MIPMAP_FULL] = 0;
+  dt_raw_pool_init(&cache->raw_pool, MAX(dt_conf_get_int64("cache_raw_pool_memory"), 0), _raw_pool_free, cache);
 
   // same for mipf:
   dt_cache_init(&cache->mip_f.cache, 0, max_mem_bufs);
@@ -588,8 +773,17 @@ void dt_mipmap_cache_init(dt_mipmap_cache_t *cache)
 void dt_mipmap_cache_cleanup(dt_mipmap_cache_t *cache)
 {
   dt_cache_cleanup(&cache->mip_thumbs.cache);
+  // nothing goes to the pool anymore
+  dt_raw_pool_set_quota(&cache->raw_pool, 0);
   dt_cache_cleanup(&cache->mip_full.cache);
+  dt_raw_pool_cleanup(&cache->raw_pool);
   dt_cache_cleanup(&cache->mip_f.cache);
+  // after the caches, which write their thumbnails on cleanup
+  for(int k = 0; k < DT_MIPMAP_F; k++)
+  {
+    dt_mipmap_pack_close(cache->pack[k]);
+    cache->pack[k] = NULL;
+  }
 }
 
 void dt_mipmap_cache_print(dt_mipmap_cache_t *cache)
@@ -601,9 +795,10 @@ void dt_mipmap_cache_print(dt_mipmap_cache_t *cache)
   printf("[mipmap_cache] float fill %d/%d slots (%.2f%%)\n",
          (uint32_t)cache->mip_f.cache.cost, (uint32_t)cache->mip_f.cache.cost_quota,
          100.0f * (float)cache->mip_f.cache.cost / (float)cache->mip_f.cache.cost_quota);
-  printf("[mipmap_cache] full  fill %d/%d slots (%.2f%%)\n",
-         (uint32_t)cache->mip_full.cache.cost, (uint32_t)cache->mip_full.cache.cost_quota,
+  printf("[mipmap_cache] full  fill %.2f/%.2f MB (%.2f%%)\n",
+         cache->mip_full.cache.cost / (1024.0 * 1024.0), cache->mip_full.cache.cost_quota / (1024.0 * 1024.0),
          100.0f * (float)cache->mip_full.cache.cost / (float)cache->mip_full.cache.cost_quota);
+  dt_raw_pool_print(&cache->raw_pool);
 
   uint64_t sum = 0;
   uint64_t sum_fetches = 0;
@@ -706,6 +901,10 @@ void dt_mipmap_cache_get_with_caller(
     // and opposite: prefetch without locking
     if(mip > DT_MIPMAP_FULL || (int)mip < DT_MIPMAP_0)
       return; // remove the (int) once we no longer have to support gcc < 4.8 :/
+    // full images in the raw pool are moved back without decoding, nothing to do in the background
+    if(mip == DT_MIPMAP_FULL
+       && (dt_cache_contains(&cache->mip_full.cache, key) || dt_raw_pool_contains(&cache->raw_pool, imgid)))
+      return;
     dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_FG, dt_image_load_job_create(imgid, mip));
   }
   else if(flags == DT_MIPMAP_PREFETCH_DISK)
@@ -714,10 +913,8 @@ void dt_mipmap_cache_get_with_caller(
     if(!cache->cachedir[0]) return;
     if(mip > DT_MIPMAP_FULL || (int)mip < DT_MIPMAP_0)
       return; // remove the (int) once we no longer have to support gcc < 4.8 :/
-    char filename[PATH_MAX] = {0};
-    snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", cache->cachedir, mip, key);
     // don't attempt to load if disk cache doesn't exist
-    if(!g_file_test(filename, G_FILE_TEST_EXISTS)) return;
+    if(!_ondisk_thumbnail_exists(cache, imgid, mip)) return;
     dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_FG, dt_image_load_job_create(imgid, mip));
   }
   else if(flags == DT_MIPMAP_BLOCKING)
@@ -760,8 +957,45 @@ void dt_mipmap_cache_get_with_caller(
         buf->width = buf->height = 0;
         buf->iscale = 0.0f;
         buf->color_space = DT_COLORSPACE_NONE; // TODO: does the full buffer need to know this?
-        dt_imageio_retval_t ret = dt_imageio_open(&buffered_image, filename, buf); // TODO: color_space?
-        // might have been reallocated:
+        dt_imageio_retval_t ret = DT_IMAGEIO_FILE_CORRUPTED;
+
+        // decoded before and evicted since? then the raw pool may still have it.
+        size_t pooled_size = 0;
+        void *pooled = dt_raw_pool_take(&cache->raw_pool, imgid, &pooled_size);
+        if(pooled)
+        {
+          ASAN_UNPOISON_MEMORY_REGION(pooled, pooled_size);
+          struct dt_mipmap_buffer_dsc *pdsc = (struct dt_mipmap_buffer_dsc *)pooled;
+          const dt_image_t *decoded = _full_buffer_image(pdsc);
+          // the file might have been replaced, or the id reused
+          if(decoded->film_id == buffered_image.film_id && !strcmp(decoded->filename, buffered_image.filename))
+          {
+            _full_buffer_free(cache, entry->data, entry->data_size);
+            entry->data = pooled;
+            entry->data_size = pooled_size;
+            dt_cache_update_cost(&cache->mip_full.cache, entry, entry->data_size);
+            _full_buffer_restore_image(&buffered_image, decoded);
+            ret = DT_IMAGEIO_OK;
+            dt_print(DT_DEBUG_CACHE, "[mipmap_cache] image %u taken from the raw pool\n", imgid);
+          }
+          else
+            _full_buffer_free(cache, pooled, pooled_size);
+        }
+
+        if(ret != DT_IMAGEIO_OK)
+        {
+          ret = dt_imageio_open(&buffered_image, filename, buf); // TODO: color_space?
+          // might have been reallocated:
+          ASAN_UNPOISON_MEMORY_REGION(entry->data, dt_mipmap_buffer_dsc_size);
+          dsc = (struct dt_mipmap_buffer_dsc *)buf->cache_entry->data;
+          if(ret == DT_IMAGEIO_OK && (void *)dsc != (void *)dt_mipmap_cache_static_dead_image
+             && dsc->size >= sizeof(*dsc) + sizeof(dt_image_t))
+          {
+            // keep what the loader found out with the pixels
+            memcpy(_full_buffer_image(dsc), &buffered_image, sizeof(dt_image_t));
+            dsc->flags |= DT_MIPMAP_BUFFER_DSC_FLAG_DECODED;
+          }
+        }
         ASAN_UNPOISON_MEMORY_REGION(entry->data, dt_mipmap_buffer_dsc_size);
         dsc = (struct dt_mipmap_buffer_dsc *)buf->cache_entry->data;
         if(ret != DT_IMAGEIO_OK)
@@ -897,13 +1131,8 @@ void dt_mipmap_cache_get_with_caller(
     __sync_fetch_and_add(&(_get_cache(cache, mip)->stats_misses), 1);
     // in case we don't even have a disk cache for our requested thumbnail,
     // prefetch at least mip0, in case we have that in the disk caches:
-    if(cache->cachedir[0])
-    {
-      char filename[PATH_MAX] = {0};
-      snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", cache->cachedir, mip, key);
-      if(g_file_test(filename, G_FILE_TEST_EXISTS))
-        dt_mipmap_cache_get(cache, 0, imgid, DT_MIPMAP_0, DT_MIPMAP_PREFETCH_DISK, 0);
-    }
+    if(cache->cachedir[0] && _ondisk_thumbnail_exists(cache, imgid, mip))
+      dt_mipmap_cache_get(cache, 0, imgid, DT_MIPMAP_0, DT_MIPMAP_PREFETCH_DISK, 0);
     // nothing found :(
     buf->buf = NULL;
     buf->imgid = 0;
@@ -980,6 +1209,9 @@ void dt_mipmap_cache_remove(dt_mipmap_cache_t *cache, const uint32_t imgid)
       dt_mipmap_cache_unlink_ondisk_thumbnail((&_get_cache(cache, k)->cache)->cleanup_data, imgid, k);
     }
   }
+
+  // and the processed preview, it was made with the old history
+  dt_dev_pixelpipe_cache_disk_remove(imgid);
 }
 
 void dt_mimap_cache_evict(dt_mipmap_cache_t *cache, const uint32_t imgid)
@@ -1261,6 +1493,11 @@ void dt_mipmap_cache_copy_thumbnails(const dt_mipmap_cache_t *cache, const uint3
   {
     for(dt_mipmap_size_t mip = DT_MIPMAP_0; mip < DT_MIPMAP_F; mip++)
     {
+      if(cache->pack[mip])
+      {
+        dt_mipmap_pack_copy(cache->pack[mip], dst_imgid, src_imgid);
+        continue;
+      }
       // try and load from disk, if successful set flag
       char srcpath[PATH_MAX] = {0};
       char dstpath[PATH_MAX] = {0};
@@ -21,6 +21,7 @@
 #include "common/cache.h"
 #include "common/colorspaces.h"
 #include "common/image.h"
+#include "common/raw_pool.h"
 
 // sizes stored in the mipmap cache, set to fixed values in mipmap_cache.c
 typedef enum dt_mipmap_size_t
@@ -85,6 +86,14 @@ typedef struct dt_mipmap_cache_one_t
   long int stats_standin;    // texture used as stand-in
 } dt_mipmap_cache_one_t;
 
+// memory behind DT_MIPMAP_FULL buffers (cache_full_backing)
+typedef enum dt_mipmap_backing_t
+{
+  DT_MIPMAP_BACKING_HEAP = 0,       // plain allocations
+  DT_MIPMAP_BACKING_HUGE_PAGES = 1, // anonymous mappings, asking for transparent huge pages
+  DT_MIPMAP_BACKING_FILE = 2        // mappings of unlinked files in the cache directory
+} dt_mipmap_backing_t;
+
 typedef struct dt_mipmap_cache_t
 {
   // real width and height are stored per element
@@ -99,6 +108,11 @@ typedef struct dt_mipmap_cache_t
   dt_mipmap_cache_one_t mip_f;
   dt_mipmap_cache_one_t mip_full;
   char cachedir[PATH_MAX]; // cached sha1sum filename for faster access
+  // pack files of the thumbnail mips, if cache_disk_backend_format asks for them. NULL otherwise
+  struct dt_mipmap_pack_t *pack[DT_MIPMAP_F];
+  dt_mipmap_backing_t full_backing;
+  // decoded full buffers evicted from mip_full, with their own quota (cache_raw_pool_memory)
+  dt_raw_pool_t raw_pool;
 } dt_mipmap_cache_t;
 
 // dynamic memory allocation interface for imageio backend: a write locked
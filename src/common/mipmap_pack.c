@@ -0,0 +1,416 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2017 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/mipmap_pack.h"
+#include "common/darktable.h"
+#include "common/dtpthread.h"
+
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DT_MIPMAP_PACK_MAGIC "dtmippak"
+#define DT_MIPMAP_PACK_VERSION 1
+#define DT_MIPMAP_PACK_RECORD_MAGIC 0x6d697070u
+// records start at multiples of this, so the pixels are nicely aligned in the mapping
+#define DT_MIPMAP_PACK_ALIGN 64
+// only compact if that much space could be won, and more than is used
+#define DT_MIPMAP_PACK_COMPACT_MIN ((size_t)64 << 20)
+#define DT_MIPMAP_PACK_REMOVED G_MAXUINT64
+
+// at the beginning of both the pack and the index file
+typedef struct dt_mipmap_pack_header_t
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved[5];
+} dt_mipmap_pack_header_t;
+
+// in front of every thumbnail in the pack file
+typedef struct dt_mipmap_pack_record_t
+{
+  uint32_t magic;
+  uint32_t imgid;
+  uint32_t width, height;
+  int32_t color_space;
+  uint32_t size; // bytes of pixel data following this record
+  uint32_t reserved[10];
+} dt_mipmap_pack_record_t;
+
+// one entry of the index file
+typedef struct dt_mipmap_pack_index_t
+{
+  uint32_t imgid;
+  uint32_t reserved;
+  uint64_t offset; // of the record in the pack, DT_MIPMAP_PACK_REMOVED if deleted
+} dt_mipmap_pack_index_t;
+
+struct dt_mipmap_pack_t
+{
+  char *pack_filename, *index_filename;
+
+  dt_pthread_mutex_t write_mutex; // serializes appending to the files
+  FILE *pack, *index;
+
+  dt_pthread_mutex_t mutex; // protects the rest
+  GHashTable *offsets;      // imgid -> offset of the record in the pack
+  GMappedFile *map;         // (possibly shorter) read-only view of the pack
+  size_t live_bytes, dead_bytes;
+};
+
+static inline size_t _record_size(const size_t size)
+{
+  const size_t bytes = sizeof(dt_mipmap_pack_record_t) + size;
+  return (bytes + DT_MIPMAP_PACK_ALIGN - 1) & ~(size_t)(DT_MIPMAP_PACK_ALIGN - 1);
+}
+
+static void _header_init(dt_mipmap_pack_header_t *header)
+{
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, DT_MIPMAP_PACK_MAGIC, sizeof(header->magic));
+  header->version = DT_MIPMAP_PACK_VERSION;
+}
+
+static gboolean _header_valid(const dt_mipmap_pack_header_t *header)
+{
+  return !memcmp(header->magic, DT_MIPMAP_PACK_MAGIC, sizeof(header->magic))
+         && header->version == DT_MIPMAP_PACK_VERSION;
+}
+
+// the record at offset, if it is complete and belongs to imgid. called with the mutex held
+static const dt_mipmap_pack_record_t *_get_record(GMappedFile *map, const uint64_t offset, const uint32_t imgid)
+{
+  if(!map) return NULL;
+  const size_t length = g_mapped_file_get_length(map);
+  if(offset + sizeof(dt_mipmap_pack_record_t) > length) return NULL;
+  const dt_mipmap_pack_record_t *record
+      = (const dt_mipmap_pack_record_t *)(g_mapped_file_get_contents(map) + offset);
+  if(record->magic != DT_MIPMAP_PACK_RECORD_MAGIC || record->imgid != imgid
+     || record->size != (size_t)record->width * record->height * 4
+     || offset + sizeof(dt_mipmap_pack_record_t) + record->size > length)
+    return NULL;
+  return record;
+}
+
+// map the whole pack again, it might have grown. called with the mutex held
+static void _remap(dt_mipmap_pack_t *pack)
+{
+  GMappedFile *map = g_mapped_file_new(pack->pack_filename, FALSE, NULL);
+  if(!map) return;
+  if(pack->map) g_mapped_file_unref(pack->map);
+  pack->map = map;
+}
+
+// (re)create empty files
+static int _create(dt_mipmap_pack_t *pack)
+{
+  dt_mipmap_pack_header_t header;
+  _header_init(&header);
+  int err = 0;
+  FILE *f = g_fopen(pack->pack_filename, "wb");
+  if(!f || fwrite(&header, sizeof(header), 1, f) != 1) err = 1;
+  if(f) fclose(f);
+  f = g_fopen(pack->index_filename, "wb");
+  if(!f || fwrite(&header, sizeof(header), 1, f) != 1) err = 1;
+  if(f) fclose(f);
+  return err;
+}
+
+// read the index file and check its entries against the pack
+static int _load_index(dt_mipmap_pack_t *pack)
+{
+  gchar *contents = NULL;
+  gsize length = 0;
+  if(!g_file_get_contents(pack->index_filename, &contents, &length, NULL)) return 1;
+  if(length < sizeof(dt_mipmap_pack_header_t) || !_header_valid((dt_mipmap_pack_header_t *)contents))
+  {
+    g_free(contents);
+    return 1;
+  }
+
+  const dt_mipmap_pack_index_t *entries
+      = (const dt_mipmap_pack_index_t *)(contents + sizeof(dt_mipmap_pack_header_t));
+  // a partially written entry at the end is simply ignored
+  const size_t cnt = (length - sizeof(dt_mipmap_pack_header_t)) / sizeof(dt_mipmap_pack_index_t);
+  for(size_t k = 0; k < cnt; k++)
+  {
+    if(entries[k].offset == DT_MIPMAP_PACK_REMOVED)
+      g_hash_table_remove(pack->offsets, GUINT_TO_POINTER(entries[k].imgid));
+    else
+      g_hash_table_insert(pack->offsets, GUINT_TO_POINTER(entries[k].imgid),
+                          (gpointer)(guintptr)entries[k].offset);
+  }
+  g_free(contents);
+
+  // drop whatever isn't backed by a complete record, and sum up what is
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, pack->offsets);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+  {
+    const dt_mipmap_pack_record_t *record = _get_record(pack->map, (guintptr)value, GPOINTER_TO_UINT(key));
+    if(record)
+      pack->live_bytes += _record_size(record->size);
+    else
+      g_hash_table_iter_remove(&iter);
+  }
+  const size_t length_pack = g_mapped_file_get_length(pack->map) - sizeof(dt_mipmap_pack_header_t);
+  pack->dead_bytes = length_pack > pack->live_bytes ? length_pack - pack->live_bytes : 0;
+  return 0;
+}
+
+// write all live records into fresh files and swap them in. called before the files are opened for appending
+static void _compact(dt_mipmap_pack_t *pack)
+{
+  gchar *pack_tmp = g_strdup_printf("%s.tmp", pack->pack_filename);
+  gchar *index_tmp = g_strdup_printf("%s.tmp", pack->index_filename);
+  FILE *fp = g_fopen(pack_tmp, "wb");
+  FILE *fi = g_fopen(index_tmp, "wb");
+  int err = !fp || !fi;
+
+  dt_mipmap_pack_header_t header;
+  _header_init(&header);
+  if(!err) err = fwrite(&header, sizeof(header), 1, fp) != 1 || fwrite(&header, sizeof(header), 1, fi) != 1;
+
+  GHashTable *offsets = g_hash_table_new(NULL, NULL);
+  uint64_t offset = sizeof(dt_mipmap_pack_header_t);
+  const uint8_t zeros[DT_MIPMAP_PACK_ALIGN] = { 0 };
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, pack->offsets);
+  while(!err && g_hash_table_iter_next(&iter, &key, &value))
+  {
+    const dt_mipmap_pack_record_t *record = _get_record(pack->map, (guintptr)value, GPOINTER_TO_UINT(key));
+    if(!record) continue;
+    const size_t bytes = sizeof(dt_mipmap_pack_record_t) + record->size;
+    const size_t padding = _record_size(record->size) - bytes;
+    const dt_mipmap_pack_index_t entry = { .imgid = record->imgid, .offset = offset };
+    err = fwrite(record, bytes, 1, fp) != 1 || (padding && fwrite(zeros, padding, 1, fp) != 1)
+          || fwrite(&entry, sizeof(entry), 1, fi) != 1;
+    g_hash_table_insert(offsets, key, (gpointer)(guintptr)offset);
+    offset += bytes + padding;
+  }
+
+  if(fp && fclose(fp)) err = 1;
+  if(fi && fclose(fi)) err = 1;
+
+  if(!err && !g_rename(pack_tmp, pack->pack_filename) && !g_rename(index_tmp, pack->index_filename))
+  {
+    dt_print(DT_DEBUG_CACHE, "[mipmap_pack] compacted `%s' from %zu to %zu bytes\n", pack->pack_filename,
+             pack->live_bytes + pack->dead_bytes, pack->live_bytes);
+    g_hash_table_destroy(pack->offsets);
+    pack->offsets = offsets;
+    pack->dead_bytes = 0;
+    _remap(pack);
+  }
+  else
+  {
+    // the old files are still fine, keep using them
+    g_hash_table_destroy(offsets);
+    g_unlink(pack_tmp);
+    g_unlink(index_tmp);
+  }
+  g_free(pack_tmp);
+  g_free(index_tmp);
+}
+
+dt_mipmap_pack_t *dt_mipmap_pack_open(const char *basename)
+{
+  dt_mipmap_pack_t *pack = (dt_mipmap_pack_t *)calloc(1, sizeof(dt_mipmap_pack_t));
+  pack->pack_filename = g_strdup_printf("%s.pack", basename);
+  pack->index_filename = g_strdup_printf("%s.idx", basename);
+  pack->offsets = g_hash_table_new(NULL, NULL);
+  dt_pthread_mutex_init(&pack->mutex, NULL);
+  dt_pthread_mutex_init(&pack->write_mutex, NULL);
+
+  gchar *dirname = g_path_get_dirname(pack->pack_filename);
+  g_mkdir_with_parents(dirname, 0750);
+  g_free(dirname);
+
+  _remap(pack);
+  if(!pack->map || g_mapped_file_get_length(pack->map) < sizeof(dt_mipmap_pack_header_t)
+     || !_header_valid((dt_mipmap_pack_header_t *)g_mapped_file_get_contents(pack->map)) || _load_index(pack))
+  {
+    // missing or broken, start from scratch
+    g_hash_table_remove_all(pack->offsets);
+    pack->live_bytes = pack->dead_bytes = 0;
+    if(_create(pack)) goto error;
+    _remap(pack);
+  }
+  else if(pack->dead_bytes > DT_MIPMAP_PACK_COMPACT_MIN && pack->dead_bytes > pack->live_bytes)
+    _compact(pack);
+
+  pack->pack = g_fopen(pack->pack_filename, "ab");
+  pack->index = g_fopen(pack->index_filename, "ab");
+  if(!pack->map || !pack->pack || !pack->index) goto error;
+
+  dt_print(DT_DEBUG_CACHE, "[mipmap_pack] opened `%s' with %u thumbnails\n", pack->pack_filename,
+           g_hash_table_size(pack->offsets));
+  return pack;
+
+error:
+  fprintf(stderr, "[mipmap_pack] can't open `%s'\n", pack->pack_filename);
+  dt_mipmap_pack_close(pack);
+  return NULL;
+}
+
+void dt_mipmap_pack_close(dt_mipmap_pack_t *pack)
+{
+  if(!pack) return;
+  if(pack->pack) fclose(pack->pack);
+  if(pack->index) fclose(pack->index);
+  if(pack->map) g_mapped_file_unref(pack->map);
+  g_hash_table_destroy(pack->offsets);
+  dt_pthread_mutex_destroy(&pack->mutex);
+  dt_pthread_mutex_destroy(&pack->write_mutex);
+  g_free(pack->pack_filename);
+  g_free(pack->index_filename);
+  free(pack);
+}
+
+int dt_mipmap_pack_read(dt_mipmap_pack_t *pack, const uint32_t imgid, uint8_t *buf, const uint32_t max_width,
+                        const uint32_t max_height, uint32_t *width, uint32_t *height, int *color_space)
+{
+  dt_pthread_mutex_lock(&pack->mutex);
+  gpointer value;
+  if(!g_hash_table_lookup_extended(pack->offsets, GUINT_TO_POINTER(imgid), NULL, &value))
+  {
+    dt_pthread_mutex_unlock(&pack->mutex);
+    return 1;
+  }
+  const uint64_t offset = (guintptr)value;
+  const dt_mipmap_pack_record_t *record = _get_record(pack->map, offset, imgid);
+  if(!record)
+  {
+    // appended after we last mapped the pack
+    _remap(pack);
+    record = _get_record(pack->map, offset, imgid);
+  }
+  // keep the mapping alive while copying, the pack might get remapped in the meantime
+  GMappedFile *map = record ? g_mapped_file_ref(pack->map) : NULL;
+  dt_pthread_mutex_unlock(&pack->mutex);
+
+  if(!record) return 1;
+  int err = 1;
+  if(record->width <= max_width && record->height <= max_height)
+  {
+    memcpy(buf, record + 1, record->size);
+    *width = record->width;
+    *height = record->height;
+    *color_space = record->color_space;
+    err = 0;
+  }
+  g_mapped_file_unref(map);
+  return err;
+}
+
+// append an index entry and flush it. called with the write_mutex held
+static int _append_index(dt_mipmap_pack_t *pack, const uint32_t imgid, const uint64_t offset)
+{
+  const dt_mipmap_pack_index_t entry = { .imgid = imgid, .offset = offset };
+  return fwrite(&entry, sizeof(entry), 1, pack->index) != 1 || fflush(pack->index);
+}
+
+int dt_mipmap_pack_write(dt_mipmap_pack_t *pack, const uint32_t imgid, const uint8_t *buf, const uint32_t width,
+                         const uint32_t height, const int color_space)
+{
+  const dt_mipmap_pack_record_t record = { .magic = DT_MIPMAP_PACK_RECORD_MAGIC,
+                                           .imgid = imgid,
+                                           .width = width,
+                                           .height = height,
+                                           .color_space = color_space,
+                                           .size = width * height * 4 };
+  const size_t padding = _record_size(record.size) - sizeof(record) - record.size;
+  const uint8_t zeros[DT_MIPMAP_PACK_ALIGN] = { 0 };
+
+  dt_pthread_mutex_lock(&pack->write_mutex);
+  // append mode, the position is always the end of the file
+  fseek(pack->pack, 0, SEEK_END);
+  const long pos = ftell(pack->pack);
+  // a failed write before might have left half a record, start the next one aligned again
+  const size_t skip = pos < 0 ? 0 : (DT_MIPMAP_PACK_ALIGN - (size_t)pos % DT_MIPMAP_PACK_ALIGN) % DT_MIPMAP_PACK_ALIGN;
+  const uint64_t offset = pos + skip;
+  int err = pos < 0 || (skip && fwrite(zeros, skip, 1, pack->pack) != 1)
+            || fwrite(&record, sizeof(record), 1, pack->pack) != 1
+            || fwrite(buf, record.size, 1, pack->pack) != 1
+            || (padding && fwrite(zeros, padding, 1, pack->pack) != 1) || fflush(pack->pack);
+  // only reference the record once it is completely on disk
+  if(!err) err = _append_index(pack, imgid, offset);
+  if(!err)
+  {
+    dt_pthread_mutex_lock(&pack->mutex);
+    gpointer value;
+    if(g_hash_table_lookup_extended(pack->offsets, GUINT_TO_POINTER(imgid), NULL, &value))
+      pack->dead_bytes += _record_size(record.size); // the size of the old one is close enough
+    else
+      pack->live_bytes += _record_size(record.size);
+    g_hash_table_insert(pack->offsets, GUINT_TO_POINTER(imgid), (gpointer)(guintptr)offset);
+    dt_pthread_mutex_unlock(&pack->mutex);
+  }
+  else
+    fprintf(stderr, "[mipmap_pack] failed to write thumbnail for image %u to `%s'\n", imgid, pack->pack_filename);
+  dt_pthread_mutex_unlock(&pack->write_mutex);
+  return err;
+}
+
+gboolean dt_mipmap_pack_contains(dt_mipmap_pack_t *pack, const uint32_t imgid)
+{
+  dt_pthread_mutex_lock(&pack->mutex);
+  const gboolean res = g_hash_table_contains(pack->offsets, GUINT_TO_POINTER(imgid));
+  dt_pthread_mutex_unlock(&pack->mutex);
+  return res;
+}
+
+void dt_mipmap_pack_remove(dt_mipmap_pack_t *pack, const uint32_t imgid)
+{
+  dt_pthread_mutex_lock(&pack->write_mutex);
+  dt_pthread_mutex_lock(&pack->mutex);
+  const gboolean found = g_hash_table_remove(pack->offsets, GUINT_TO_POINTER(imgid));
+  dt_pthread_mutex_unlock(&pack->mutex);
+  // the hole is accounted for when opening the pack the next time
+  if(found) _append_index(pack, imgid, DT_MIPMAP_PACK_REMOVED);
+  dt_pthread_mutex_unlock(&pack->write_mutex);
+}
+
+void dt_mipmap_pack_copy(dt_mipmap_pack_t *pack, const uint32_t dst_imgid, const uint32_t src_imgid)
+{
+  dt_pthread_mutex_lock(&pack->mutex);
+  gpointer value;
+  const dt_mipmap_pack_record_t *record = NULL;
+  if(g_hash_table_lookup_extended(pack->offsets, GUINT_TO_POINTER(src_imgid), NULL, &value))
+  {
+    record = _get_record(pack->map, (guintptr)value, src_imgid);
+    if(!record)
+    {
+      _remap(pack);
+      record = _get_record(pack->map, (guintptr)value, src_imgid);
+    }
+  }
+  GMappedFile *map = record ? g_mapped_file_ref(pack->map) : NULL;
+  dt_pthread_mutex_unlock(&pack->mutex);
+
+  if(!record) return;
+  dt_mipmap_pack_write(pack, dst_imgid, (const uint8_t *)(record + 1), record->width, record->height,
+                       record->color_space);
+  g_mapped_file_unref(map);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
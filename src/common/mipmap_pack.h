@@ -0,0 +1,52 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2017 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+#include <inttypes.h>
+
+/**
+ * disk backend for the thumbnail mip levels, an alternative to one jpeg file per image.
+ *
+ * all thumbnails of one mip level live in an append-only pack file, as raw 8-bit pixels in the
+ * layout of the mipmap cache, so loading one is a single memcpy out of a memory mapping. a
+ * second append-only file maps image ids to offsets in the pack, the last entry for an id wins.
+ * replaced and removed thumbnails leave holes which are compacted away when opening the pack.
+ */
+typedef struct dt_mipmap_pack_t dt_mipmap_pack_t;
+
+/** open or create the pack with the given basename (<basename>.pack and <basename>.idx). */
+dt_mipmap_pack_t *dt_mipmap_pack_open(const char *basename);
+void dt_mipmap_pack_close(dt_mipmap_pack_t *pack);
+
+/** copy the thumbnail of imgid into buf (4 bytes per pixel). fails if it doesn't fit into
+ * max_width x max_height. returns 0 on success. */
+int dt_mipmap_pack_read(dt_mipmap_pack_t *pack, const uint32_t imgid, uint8_t *buf, const uint32_t max_width,
+                        const uint32_t max_height, uint32_t *width, uint32_t *height, int *color_space);
+/** append the thumbnail of imgid, replacing any previous one. returns 0 on success. */
+int dt_mipmap_pack_write(dt_mipmap_pack_t *pack, const uint32_t imgid, const uint8_t *buf, const uint32_t width,
+                         const uint32_t height, const int color_space);
+gboolean dt_mipmap_pack_contains(dt_mipmap_pack_t *pack, const uint32_t imgid);
+void dt_mipmap_pack_remove(dt_mipmap_pack_t *pack, const uint32_t imgid);
+/** duplicate the thumbnail of src_imgid for dst_imgid, if there is one. */
+void dt_mipmap_pack_copy(dt_mipmap_pack_t *pack, const uint32_t dst_imgid, const uint32_t src_imgid);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,180 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2017 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/raw_pool.h"
+#include "common/darktable.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void dt_raw_pool_init(dt_raw_pool_t *pool, const size_t quota, dt_raw_pool_free_t free_buffer, void *free_data)
+{
+  memset(pool, 0, sizeof(*pool));
+  dt_pthread_mutex_init(&pool->lock, NULL);
+  pool->quota = quota;
+  pool->free_buffer = free_buffer;
+  pool->free_data = free_data;
+}
+
+static void _buffer_free(dt_raw_pool_t *pool, dt_raw_pool_buffer_t *b)
+{
+  pool->free_buffer(b->data, b->size, pool->free_data);
+  free(b);
+}
+
+// the free callbacks may unmap memory, so they're called after the lock has been dropped
+static void _free_list(dt_raw_pool_t *pool, GList *list)
+{
+  for(GList *iter = list; iter; iter = g_list_next(iter)) _buffer_free(pool, (dt_raw_pool_buffer_t *)iter->data);
+  g_list_free(list);
+}
+
+void dt_raw_pool_cleanup(dt_raw_pool_t *pool)
+{
+  _free_list(pool, pool->buffers);
+  pool->buffers = NULL;
+  pool->cost = 0;
+  dt_pthread_mutex_destroy(&pool->lock);
+}
+
+void dt_raw_pool_print(dt_raw_pool_t *pool)
+{
+  dt_pthread_mutex_lock(&pool->lock);
+  const guint num = g_list_length(pool->buffers);
+  const size_t cost = pool->cost;
+  dt_pthread_mutex_unlock(&pool->lock);
+  printf("[raw_pool] %u images, %.2f/%.2f MB, hit rate so far: %.3f (%ld of %ld), %ld evicted\n", num,
+         cost / (1024.0 * 1024.0), pool->quota / (1024.0 * 1024.0),
+         pool->hits + pool->misses ? pool->hits / (float)(pool->hits + pool->misses) : 0.0f, pool->hits,
+         pool->hits + pool->misses, pool->evictions);
+}
+
+static GList *_find(dt_raw_pool_t *pool, const uint32_t imgid)
+{
+  for(GList *iter = pool->buffers; iter; iter = g_list_next(iter))
+    if(((dt_raw_pool_buffer_t *)iter->data)->imgid == imgid) return iter;
+  return NULL;
+}
+
+// unlinks the oldest buffers until size more bytes fit, and returns them. called with the lock held.
+static GList *_evict(dt_raw_pool_t *pool, const size_t size)
+{
+  GList *evicted = NULL;
+  GList *iter = g_list_last(pool->buffers);
+  while(iter && pool->cost + size > pool->quota)
+  {
+    GList *prev = g_list_previous(iter);
+    dt_raw_pool_buffer_t *b = (dt_raw_pool_buffer_t *)iter->data;
+    pool->buffers = g_list_delete_link(pool->buffers, iter);
+    pool->cost -= b->size;
+    pool->evictions++;
+    evicted = g_list_prepend(evicted, b);
+    iter = prev;
+  }
+  return evicted;
+}
+
+int dt_raw_pool_put(dt_raw_pool_t *pool, const uint32_t imgid, void *data, const size_t size)
+{
+  dt_raw_pool_buffer_t *b = (dt_raw_pool_buffer_t *)malloc(sizeof(dt_raw_pool_buffer_t));
+  if(!b) return 1;
+  b->imgid = imgid;
+  b->data = data;
+  b->size = size;
+
+  dt_pthread_mutex_lock(&pool->lock);
+  if(size > pool->quota)
+  {
+    dt_pthread_mutex_unlock(&pool->lock);
+    free(b);
+    return 1;
+  }
+
+  GList *evicted = NULL;
+  GList *old = _find(pool, imgid);
+  if(old)
+  {
+    pool->cost -= ((dt_raw_pool_buffer_t *)old->data)->size;
+    evicted = g_list_prepend(evicted, old->data);
+    pool->buffers = g_list_delete_link(pool->buffers, old);
+  }
+  evicted = g_list_concat(evicted, _evict(pool, size));
+  pool->buffers = g_list_prepend(pool->buffers, b);
+  pool->cost += size;
+  dt_pthread_mutex_unlock(&pool->lock);
+
+  _free_list(pool, evicted);
+  dt_print(DT_DEBUG_CACHE, "[raw_pool] keeping image %u, %.2f MB\n", imgid, size / (1024.0 * 1024.0));
+  return 0;
+}
+
+void *dt_raw_pool_take(dt_raw_pool_t *pool, const uint32_t imgid, size_t *size)
+{
+  void *data = NULL;
+  dt_pthread_mutex_lock(&pool->lock);
+  GList *iter = _find(pool, imgid);
+  if(iter)
+  {
+    dt_raw_pool_buffer_t *b = (dt_raw_pool_buffer_t *)iter->data;
+    data = b->data;
+    *size = b->size;
+    pool->cost -= b->size;
+    pool->buffers = g_list_delete_link(pool->buffers, iter);
+    free(b);
+    pool->hits++;
+  }
+  else
+    pool->misses++;
+  dt_pthread_mutex_unlock(&pool->lock);
+  return data;
+}
+
+int dt_raw_pool_contains(dt_raw_pool_t *pool, const uint32_t imgid)
+{
+  dt_pthread_mutex_lock(&pool->lock);
+  const int found = _find(pool, imgid) != NULL;
+  dt_pthread_mutex_unlock(&pool->lock);
+  return found;
+}
+
+void dt_raw_pool_remove(dt_raw_pool_t *pool, const uint32_t imgid)
+{
+  dt_pthread_mutex_lock(&pool->lock);
+  GList *iter = _find(pool, imgid);
+  dt_raw_pool_buffer_t *b = iter ? (dt_raw_pool_buffer_t *)iter->data : NULL;
+  if(b)
+  {
+    pool->cost -= b->size;
+    pool->buffers = g_list_delete_link(pool->buffers, iter);
+  }
+  dt_pthread_mutex_unlock(&pool->lock);
+  if(b) _buffer_free(pool, b);
+}
+
+void dt_raw_pool_set_quota(dt_raw_pool_t *pool, const size_t quota)
+{
+  dt_pthread_mutex_lock(&pool->lock);
+  pool->quota = quota;
+  GList *evicted = _evict(pool, 0);
+  dt_pthread_mutex_unlock(&pool->lock);
+  _free_list(pool, evicted);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
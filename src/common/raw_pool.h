@@ -0,0 +1,76 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2017 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/dtpthread.h"
+
+#include <glib.h>
+#include <inttypes.h>
+#include <stddef.h>
+
+/**
+ * pool of decoded full size images which nobody uses right now, with its own quota in bytes
+ * (cache_raw_pool_memory). the full mipmap cache hands its buffers over when it evicts them,
+ * and takes them back instead of decoding the image again.
+ *
+ * buffers are moved in and out, never shared: while an image is in use its buffer is counted
+ * by the locks of the mipmap cache entry, the pool only ever holds unreferenced ones. that way
+ * the quota can always be met by freeing the oldest buffers.
+ */
+
+// frees a buffer the pool owns, supplied by whoever allocated it
+typedef void((*dt_raw_pool_free_t)(void *data, const size_t size, void *user_data));
+
+typedef struct dt_raw_pool_buffer_t
+{
+  uint32_t imgid;
+  void *data;
+  size_t size;
+} dt_raw_pool_buffer_t;
+
+typedef struct dt_raw_pool_t
+{
+  dt_pthread_mutex_t lock; // protects the rest
+  GList *buffers;          // most recently added first
+  size_t cost;             // bytes held
+  size_t quota;            // bytes we may hold, 0 switches the pool off
+  dt_raw_pool_free_t free_buffer;
+  void *free_data;
+  long int hits, misses, evictions;
+} dt_raw_pool_t;
+
+void dt_raw_pool_init(dt_raw_pool_t *pool, const size_t quota, dt_raw_pool_free_t free_buffer, void *free_data);
+void dt_raw_pool_cleanup(dt_raw_pool_t *pool);
+void dt_raw_pool_print(dt_raw_pool_t *pool);
+
+/** takes ownership of data, evicting older buffers if needed. returns non zero if the buffer doesn't fit, the
+ * caller keeps it then. a buffer already held for the image is replaced. */
+int dt_raw_pool_put(dt_raw_pool_t *pool, const uint32_t imgid, void *data, const size_t size);
+/** removes the buffer of the image from the pool and hands it to the caller, or returns NULL. */
+void *dt_raw_pool_take(dt_raw_pool_t *pool, const uint32_t imgid, size_t *size);
+/** non zero if the pool holds a buffer for the image. */
+int dt_raw_pool_contains(dt_raw_pool_t *pool, const uint32_t imgid);
+/** frees the buffer of the image, if there is one. */
+void dt_raw_pool_remove(dt_raw_pool_t *pool, const uint32_t imgid);
+/** changes the quota, and evicts what is now too much. */
+void dt_raw_pool_set_quota(dt_raw_pool_t *pool, const size_t quota);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -320,6 +320,26 @@ gchar *dt_util_foo_to_utf8(const char *string)
   return tag;
 }
 
+void dt_util_json_append_string(GString *str, const char *value)
+{
+  if(!value)
+  {
+    g_string_append(str, "null");
+    return;
+  }
+  g_string_append_c(str, '"');
+  for(const char *c = value; *c; c++)
+  {
+    if(*c == '"' || *c == '\\')
+      g_string_append_printf(str, "\\%c", *c);
+    else if((unsigned char)*c < 0x20)
+      g_string_append_printf(str, "\\u%04x", (unsigned char)*c);
+    else
+      g_string_append_c(str, *c);
+  }
+  g_string_append_c(str, '"');
+}
+
 // get easter sunday (in the western world)
 static void easter(int Y, int* month, int *day)
 {
@@ -41,6 +41,8 @@ off_t dt_util_get_file_size(const char *filename);
 gboolean dt_util_is_dir_empty(const char *dirname);
 /** returns a valid UTF-8 string for the given char array. has to be freed with g_free(). */
 gchar *dt_util_foo_to_utf8(const char *string);
+/** append value as a quoted and escaped json string to str, or null if value is NULL */
+void dt_util_json_append_string(GString *str, const char *value);
 
 typedef enum dt_logo_season_t
 {
@@ -165,10 +165,20 @@ typedef struct dt_control_t
   pthread_cond_t cond;
   int32_t num_threads;
   pthread_t *thread, kick_on_workers_thread;
-  dt_job_t **job;
 
-  GList *queues[DT_JOB_QUEUE_MAX];
-  size_t queue_length[DT_JOB_QUEUE_MAX];
+  // per worker job deques, see control/jobs.c
+  struct dt_control_worker_queue_t *worker_queues;
+  uint32_t next_worker;
+  // the DT_JOB_QUEUE_SYSTEM_FG stack shared by all workers and its queued and running jobs, for deduping.
+  // protected by queue_mutex, fg_length is the size of the stack for peeking without it.
+  struct dt_control_deque_t *fg_queue;
+  GHashTable *fg_jobs;
+  int fg_length;
+
+  // queue wait and run time per kind of job
+  dt_pthread_mutex_t stats_mutex;
+  GHashTable *job_stats;
+  long int stats_steals;
 
   dt_pthread_mutex_t res_mutex;
   dt_job_t *job_res[DT_CTL_WORKER_RESERVED];
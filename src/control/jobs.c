@@ -25,6 +25,7 @@
 
 #define DT_CONTROL_FG_PRIORITY 4
 #define DT_CONTROL_MAX_JOBS 30
+#define DT_CONTROL_DEQUE_MIN_SIZE 16
 
 /* the queue can have scheduled jobs but all
     the workers are sleeping, so this kicks the workers
@@ -55,9 +56,30 @@ typedef struct _dt_job_t
 
   dt_progress_t *progress;
 
+  const char *type;   // the format of the description, shared by all jobs of one kind
+  double queued_time; // for the statistics
+
   char description[DT_CONTROL_DESCRIPTION_LEN];
 } _dt_job_t;
 
+/* a growable ring buffer of jobs, the front is jobs[first] */
+typedef struct dt_control_deque_t
+{
+  _dt_job_t **jobs;
+  size_t first, length, size;
+} dt_control_deque_t;
+
+/* every worker owns one deque per queue class. they are only locked for a few instructions, so
+   adding jobs and picking the next one doesn't serialize all threads on a global lock. workers
+   which run dry steal from the others. DT_JOB_QUEUE_SYSTEM_FG is the exception: its jobs go to the
+   one stack in dt_control_t, so the most recently requested thumbnail is always next, whichever
+   worker is free, and the size limit drops the globally oldest one. */
+typedef struct dt_control_worker_queue_t
+{
+  dt_pthread_mutex_t mutex;
+  dt_control_deque_t deque[DT_JOB_QUEUE_MAX];
+} dt_control_worker_queue_t;
+
 /** check if two jobs are to be considered equal. a simple memcmp won't work since the mutexes probably won't
    match
     we don't want to compare result, priority or state since these will change during the course of
@@ -74,6 +96,82 @@ static inline int dt_control_job_equal(_dt_job_t *j1, _dt_job_t *j2)
           && (g_strcmp0(j1->description, j2->description) == 0));
 }
 
+/** hash and equality for the table of queued and running DT_JOB_QUEUE_SYSTEM_FG jobs. jobs only match if they
+    use the same kind of params, so the hash can be taken over those. */
+static guint dt_control_job_hash(gconstpointer key)
+{
+  const _dt_job_t *job = (const _dt_job_t *)key;
+  guint hash = g_direct_hash(job->execute) ^ g_direct_hash(job->state_changed_cb) ^ job->queue;
+  if(job->params_size != 0)
+  {
+    const unsigned char *params = (const unsigned char *)job->params;
+    for(size_t k = 0; k < job->params_size; k++) hash = (hash << 5) + hash + params[k];
+    return hash;
+  }
+  return hash ^ g_str_hash(job->description);
+}
+
+static gboolean dt_control_job_hash_equal(gconstpointer a, gconstpointer b)
+{
+  _dt_job_t *j1 = (_dt_job_t *)a, *j2 = (_dt_job_t *)b;
+  return j1->params_size == j2->params_size && dt_control_job_equal(j1, j2);
+}
+
+static void dt_control_deque_grow(dt_control_deque_t *d)
+{
+  const size_t size = MAX(DT_CONTROL_DEQUE_MIN_SIZE, 2 * d->size);
+  _dt_job_t **jobs = (_dt_job_t **)malloc(size * sizeof(_dt_job_t *));
+  for(size_t k = 0; k < d->length; k++) jobs[k] = d->jobs[(d->first + k) % d->size];
+  free(d->jobs);
+  d->jobs = jobs;
+  d->first = 0;
+  d->size = size;
+}
+
+static void dt_control_deque_push_front(dt_control_deque_t *d, _dt_job_t *job)
+{
+  if(d->length == d->size) dt_control_deque_grow(d);
+  d->first = (d->first + d->size - 1) % d->size;
+  d->jobs[d->first] = job;
+  d->length++;
+}
+
+static void dt_control_deque_push_back(dt_control_deque_t *d, _dt_job_t *job)
+{
+  if(d->length == d->size) dt_control_deque_grow(d);
+  d->jobs[(d->first + d->length) % d->size] = job;
+  d->length++;
+}
+
+static _dt_job_t *dt_control_deque_pop_front(dt_control_deque_t *d)
+{
+  if(!d->length) return NULL;
+  _dt_job_t *job = d->jobs[d->first];
+  d->first = (d->first + 1) % d->size;
+  d->length--;
+  return job;
+}
+
+static _dt_job_t *dt_control_deque_pop_back(dt_control_deque_t *d)
+{
+  if(!d->length) return NULL;
+  d->length--;
+  return d->jobs[(d->first + d->length) % d->size];
+}
+
+static gboolean dt_control_deque_remove(dt_control_deque_t *d, _dt_job_t *job)
+{
+  for(size_t k = 0; k < d->length; k++)
+  {
+    if(d->jobs[(d->first + k) % d->size] != job) continue;
+    // close the gap
+    for(; k + 1 < d->length; k++) d->jobs[(d->first + k) % d->size] = d->jobs[(d->first + k + 1) % d->size];
+    d->length--;
+    return TRUE;
+  }
+  return FALSE;
+}
+
 static void dt_control_job_set_state(_dt_job_t *job, dt_job_state_t state)
 {
   if(!job) return;
@@ -133,6 +231,7 @@ dt_job_t *dt_control_job_create(dt_job_execute_callback execute, const char *msg
 
   job->execute = execute;
   job->state = DT_JOB_STATE_INITIALIZED;
+  job->type = msg;
 
   dt_pthread_mutex_init(&job->state_mutex, NULL);
   dt_pthread_mutex_init(&job->wait_mutex, NULL);
@@ -190,6 +289,33 @@ void dt_control_job_wait(_dt_job_t *job)
   }
 }
 
+/* run the job and account how long it waited in its queue and how long it took */
+static void dt_control_job_execute_timed(_dt_job_t *job)
+{
+  dt_control_t *control = darktable.control;
+  const double start = dt_get_wtime();
+  job->result = job->execute(job);
+  const double end = dt_get_wtime();
+  if(!control->job_stats) return; // not initialized yet
+
+  dt_pthread_mutex_lock(&control->stats_mutex);
+  dt_job_stats_t *stats = (dt_job_stats_t *)g_hash_table_lookup(control->job_stats, job->type);
+  if(!stats)
+  {
+    stats = (dt_job_stats_t *)calloc(1, sizeof(dt_job_stats_t));
+    stats->type = job->type;
+    g_hash_table_insert(control->job_stats, (gpointer)job->type, stats);
+  }
+  const double wait = job->queued_time > 0.0 ? start - job->queued_time : 0.0;
+  stats->queue = job->queue;
+  stats->count++;
+  stats->wait += wait;
+  stats->max_wait = MAX(stats->max_wait, wait);
+  stats->run += end - start;
+  stats->max_run = MAX(stats->max_run, end - start);
+  dt_pthread_mutex_unlock(&control->stats_mutex);
+}
+
 static int32_t dt_control_run_job_res(dt_control_t *control, int32_t res)
 {
   if(((unsigned int)res) >= DT_CTL_WORKER_RESERVED) return -1;
@@ -216,7 +342,7 @@ static int32_t dt_control_run_job_res(dt_control_t *control, int32_t res)
     dt_control_job_set_state(job, DT_JOB_STATE_RUNNING);
 
     /* execute job */
-    job->result = job->execute(job);
+    dt_control_job_execute_timed(job);
 
     dt_control_job_set_state(job, DT_JOB_STATE_FINISHED);
     dt_print(DT_DEBUG_CONTROL, "[run_job-] %02d %f ", res, dt_get_wtime());
@@ -228,7 +354,12 @@ static int32_t dt_control_run_job_res(dt_control_t *control, int32_t res)
   return 0;
 }
 
-static _dt_job_t *dt_control_schedule_job(dt_control_t *control)
+static __thread int worker_id = -1;
+
+/* pick the next job out of the deques of one worker, called with its mutex held. the shared foreground
+   stack competes with them if fg is set, then queue_mutex has to be held, too. */
+static _dt_job_t *dt_control_worker_pick_job(dt_control_t *control, dt_control_worker_queue_t *wq,
+                                             const gboolean fg)
 {
   /*
    * job scheduling works like this:
@@ -240,55 +371,82 @@ static _dt_job_t *dt_control_schedule_job(dt_control_t *control)
    *   * system background
    * - the jobs that didn't get picked this round get their priority incremented
    */
-
-  dt_pthread_mutex_lock(&control->queue_mutex);
-
-  // find the job
-  _dt_job_t *job = NULL;
-  int winner_queue = DT_JOB_QUEUE_MAX;
-  int max_priority = -1;
-  for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
+  gboolean skip_export = control->export_scheduled;
+  while(TRUE)
   {
-    if(control->queues[i] == NULL) continue;
-    if(control->export_scheduled && i == DT_JOB_QUEUE_USER_EXPORT) continue;
-    _dt_job_t *_job = (_dt_job_t *)control->queues[i]->data;
-    if(_job->priority > max_priority)
+    _dt_job_t *job = NULL;
+    int winner_queue = DT_JOB_QUEUE_MAX;
+    int max_priority = -1;
+    for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
     {
-      max_priority = _job->priority;
-      job = _job;
-      winner_queue = i;
+      const dt_control_deque_t *d
+          = i == DT_JOB_QUEUE_SYSTEM_FG ? (fg ? control->fg_queue : NULL) : &wq->deque[i];
+      if(!d || d->length == 0) continue;
+      if(skip_export && i == DT_JOB_QUEUE_USER_EXPORT) continue;
+      _dt_job_t *_job = d->jobs[d->first];
+      if(_job->priority > max_priority)
+      {
+        max_priority = _job->priority;
+        job = _job;
+        winner_queue = i;
+      }
     }
-  }
 
-  if(!job)
-  {
-    dt_pthread_mutex_unlock(&control->queue_mutex);
-    return NULL;
-  }
+    if(!job) return NULL;
 
-  // the order of the queues in control->queues matches our priority, and we only update job when the priority
-  // is strictly bigger
-  // invariant -> job is the one we are looking for
+    // only one export may be scheduled at a time, over all workers
+    if(winner_queue == DT_JOB_QUEUE_USER_EXPORT
+       && !__sync_bool_compare_and_swap(&control->export_scheduled, FALSE, TRUE))
+    {
+      skip_export = TRUE;
+      continue;
+    }
 
-  // remove the to be scheduled job from its queue
-  GList **queue = &control->queues[winner_queue];
-  *queue = g_list_delete_link(*queue, *queue);
-  control->queue_length[winner_queue]--;
-  if(winner_queue == DT_JOB_QUEUE_USER_EXPORT) control->export_scheduled = TRUE;
+    // the order of the deques matches our priority, and we only update job when the priority
+    // is strictly bigger
+    // invariant -> job is the one we are looking for
+    if(winner_queue == DT_JOB_QUEUE_SYSTEM_FG)
+    {
+      dt_control_deque_pop_front(control->fg_queue);
+      __sync_fetch_and_sub(&control->fg_length, 1);
+    }
+    else
+      dt_control_deque_pop_front(&wq->deque[winner_queue]);
 
-  // and place it in scheduled job array (for job deduping)
-  control->job[dt_control_get_threadid()] = job;
+    // increment the priorities of the others
+    for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
+    {
+      dt_control_deque_t *d = i == DT_JOB_QUEUE_SYSTEM_FG ? (fg ? control->fg_queue : NULL) : &wq->deque[i];
+      if(i == winner_queue || !d || d->length == 0) continue;
+      d->jobs[d->first]->priority++;
+    }
 
-  // increment the priorities of the others
-  for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
-  {
-    if(i == winner_queue || control->queues[i] == NULL) continue;
-    ((_dt_job_t *)control->queues[i]->data)->priority++;
+    return job;
   }
+}
 
-  dt_pthread_mutex_unlock(&control->queue_mutex);
-
-  return job;
+static _dt_job_t *dt_control_schedule_job(dt_control_t *control)
+{
+  // our own jobs first, then steal from the others. the foreground stack is weighed against our own
+  // jobs by priority before we go stealing.
+  for(int k = 0; k < control->num_threads; k++)
+  {
+    const int w = (worker_id + k) % control->num_threads;
+    dt_control_worker_queue_t *wq = control->worker_queues + w;
+    // don't touch the global lock when there is nothing on the stack anyways
+    const gboolean fg = __sync_fetch_and_add(&control->fg_length, 0) > 0;
+    if(fg) dt_pthread_mutex_lock(&control->queue_mutex);
+    dt_pthread_mutex_lock(&wq->mutex);
+    _dt_job_t *job = dt_control_worker_pick_job(control, wq, fg);
+    dt_pthread_mutex_unlock(&wq->mutex);
+    if(fg) dt_pthread_mutex_unlock(&control->queue_mutex);
+    if(job)
+    {
+      if(k > 0 && job->queue != DT_JOB_QUEUE_SYSTEM_FG) __sync_fetch_and_add(&control->stats_steals, 1);
+      return job;
+    }
+  }
+  return NULL;
 }
 
 static void dt_control_job_execute(_dt_job_t *job)
@@ -301,7 +459,7 @@ static void dt_control_job_execute(_dt_job_t *job)
   dt_control_job_set_state(job, DT_JOB_STATE_RUNNING);
 
   /* execute job */
-  job->result = job->execute(job);
+  dt_control_job_execute_timed(job);
 
   dt_control_job_set_state(job, DT_JOB_STATE_FINISHED);
 
@@ -324,11 +482,15 @@ static int32_t dt_control_run_job(dt_control_t *control)
 
   dt_pthread_mutex_unlock(&job->wait_mutex);
 
-  // remove the job from scheduled job array (for job deduping)
-  dt_pthread_mutex_lock(&control->queue_mutex);
-  control->job[dt_control_get_threadid()] = NULL;
-  if(job->queue == DT_JOB_QUEUE_USER_EXPORT) control->export_scheduled = FALSE;
-  dt_pthread_mutex_unlock(&control->queue_mutex);
+  // remove the job from the scheduled jobs (for job deduping)
+  if(job->queue == DT_JOB_QUEUE_SYSTEM_FG)
+  {
+    dt_pthread_mutex_lock(&control->queue_mutex);
+    g_hash_table_remove(control->fg_jobs, job);
+    dt_pthread_mutex_unlock(&control->queue_mutex);
+  }
+  if(job->queue == DT_JOB_QUEUE_USER_EXPORT)
+    __sync_bool_compare_and_swap(&control->export_scheduled, TRUE, FALSE);
 
   // and free it
   dt_control_job_dispose(job);
@@ -358,6 +520,7 @@ int32_t dt_control_add_job_res(dt_control_t *control, _dt_job_t *job, int32_t re
   dt_control_job_print(job);
   dt_print(DT_DEBUG_CONTROL, "\n");
 
+  job->queued_time = dt_get_wtime();
   dt_control_job_set_state(job, DT_JOB_STATE_QUEUED);
   control->job_res[res] = job;
   control->new_res[res] = 1;
@@ -371,6 +534,18 @@ int32_t dt_control_add_job_res(dt_control_t *control, _dt_job_t *job, int32_t re
   return 0;
 }
 
+/* drop the oldest foreground job. called with queue_mutex held */
+static _dt_job_t *dt_control_drop_fg_job(dt_control_t *control)
+{
+  _dt_job_t *job = dt_control_deque_pop_back(control->fg_queue);
+  if(job)
+  {
+    __sync_fetch_and_sub(&control->fg_length, 1);
+    g_hash_table_remove(control->fg_jobs, job);
+  }
+  return job;
+}
+
 int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t *job)
 {
   if(((unsigned int)queue_id) >= DT_JOB_QUEUE_MAX || !job)
@@ -383,6 +558,7 @@ int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t
   {
     // whatever we are adding here won't be scheduled as the system isn't running. execute it synchronous instead.
     dt_pthread_mutex_lock(&job->wait_mutex); // is that even needed?
+    job->queued_time = dt_get_wtime();
     dt_control_job_execute(job);
     dt_pthread_mutex_unlock(&job->wait_mutex);
 
@@ -394,12 +570,15 @@ int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t
 
   _dt_job_t *job_for_disposal = NULL;
 
-  dt_pthread_mutex_lock(&control->queue_mutex);
+  // jobs added by a worker stay with it, the rest is spread over all workers. foreground jobs go to the
+  // shared stack.
+  const int w = queue_id == DT_JOB_QUEUE_SYSTEM_FG
+                    ? -1
+                    : worker_id >= 0
+                          ? worker_id
+                          : (int)(__sync_fetch_and_add(&control->next_worker, 1) % control->num_threads);
 
-  GList **queue = &control->queues[queue_id];
-  size_t length = control->queue_length[queue_id];
-
-  dt_print(DT_DEBUG_CONTROL, "[add_job] %zu | ", length);
+  dt_print(DT_DEBUG_CONTROL, "[add_job] %d | ", w);
   dt_control_job_print(job);
   dt_print(DT_DEBUG_CONTROL, "\n");
 
@@ -408,11 +587,17 @@ int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t
     // this is a stack with limited size and bubble up and all that stuff
     job->priority = DT_CONTROL_FG_PRIORITY;
 
-    // check if we have already scheduled the job
-    for(int k = 0; k < control->num_threads; k++)
+    dt_pthread_mutex_lock(&control->queue_mutex);
+
+    // check if we have already scheduled or queued the job
+    _dt_job_t *other_job = (_dt_job_t *)g_hash_table_lookup(control->fg_jobs, job);
+    if(other_job)
     {
-      _dt_job_t *other_job = (_dt_job_t *)control->job[k];
-      if(dt_control_job_equal(job, other_job))
+      // still on the stack or already picked by a worker?
+      const gboolean queued = dt_control_deque_remove(control->fg_queue, other_job);
+      if(queued) __sync_fetch_and_sub(&control->fg_length, 1);
+
+      if(!queued)
       {
         dt_print(DT_DEBUG_CONTROL, "[add_job] found job already in scheduled: ");
         dt_control_job_print(other_job);
@@ -425,43 +610,37 @@ int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t
 
         return 0; // there can't be any further copy
       }
-    }
 
-    // if the job is already in the queue -> move it to the top
-    for(GList *iter = *queue; iter; iter = g_list_next(iter))
-    {
-      _dt_job_t *other_job = (_dt_job_t *)iter->data;
-      if(dt_control_job_equal(job, other_job))
-      {
-        dt_print(DT_DEBUG_CONTROL, "[add_job] found job already in queue: ");
-        dt_control_job_print(other_job);
-        dt_print(DT_DEBUG_CONTROL, "\n");
-
-        *queue = g_list_delete_link(*queue, iter);
-        length--;
+      // the job is already in the queue -> move it to the top
+      dt_print(DT_DEBUG_CONTROL, "[add_job] found job already in queue: ");
+      dt_control_job_print(other_job);
+      dt_print(DT_DEBUG_CONTROL, "\n");
 
-        job_for_disposal = job;
-
-        job = other_job;
-        break; // there can't be any further copy in the list
-      }
+      job_for_disposal = job;
+      job = other_job;
+    }
+    else
+    {
+      job->queued_time = dt_get_wtime();
+      dt_control_job_set_state(job, DT_JOB_STATE_QUEUED);
+      g_hash_table_add(control->fg_jobs, job);
     }
 
-    // now we can add the new job to the list
-    *queue = g_list_prepend(*queue, job);
-    length++;
+    // now we can add the job to the stack
+    dt_control_deque_push_front(control->fg_queue, job);
 
     // and take care of the maximal queue size
-    if(length > DT_CONTROL_MAX_JOBS)
+    if(__sync_add_and_fetch(&control->fg_length, 1) > DT_CONTROL_MAX_JOBS)
     {
-      GList *last = g_list_last(*queue);
-      dt_control_job_set_state((_dt_job_t *)last->data, DT_JOB_STATE_DISCARDED);
-      dt_control_job_dispose((_dt_job_t *)last->data);
-      *queue = g_list_delete_link(*queue, last);
-      length--;
+      _dt_job_t *last = dt_control_drop_fg_job(control);
+      if(last)
+      {
+        dt_control_job_set_state(last, DT_JOB_STATE_DISCARDED);
+        dt_control_job_dispose(last);
+      }
     }
 
-    control->queue_length[queue_id] = length;
+    dt_pthread_mutex_unlock(&control->queue_mutex);
   }
   else
   {
@@ -472,11 +651,14 @@ int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t
       job->priority = 0;
     else
       job->priority = DT_CONTROL_FG_PRIORITY;
-    *queue = g_list_append(*queue, job);
-    control->queue_length[queue_id]++;
+    // the job has to be queued before any worker can see it
+    job->queued_time = dt_get_wtime();
+    dt_control_job_set_state(job, DT_JOB_STATE_QUEUED);
+    dt_control_worker_queue_t *wq = control->worker_queues + w;
+    dt_pthread_mutex_lock(&wq->mutex);
+    dt_control_deque_push_back(&wq->deque[queue_id], job);
+    dt_pthread_mutex_unlock(&wq->mutex);
   }
-  dt_control_job_set_state(job, DT_JOB_STATE_QUEUED);
-  dt_pthread_mutex_unlock(&control->queue_mutex);
 
   // notify workers
   dt_pthread_mutex_lock(&control->cond_mutex);
@@ -557,6 +739,7 @@ static void *dt_control_work(void *ptr)
   worker_thread_parameters_t *params = (worker_thread_parameters_t *)ptr;
   dt_control_t *control = params->self;
   threadid = params->threadid;
+  worker_id = params->threadid;
   char name[16] = {0};
   snprintf(name, sizeof(name), "worker %d", threadid);
   dt_pthread_setname(name);
@@ -611,7 +794,16 @@ void dt_control_jobs_init(dt_control_t *control)
   // start threads
   control->num_threads = CLAMP(dt_conf_get_int("worker_threads"), 1, 8);
   control->thread = (pthread_t *)calloc(control->num_threads, sizeof(pthread_t));
-  control->job = (dt_job_t **)calloc(control->num_threads, sizeof(dt_job_t *));
+  control->worker_queues
+      = (dt_control_worker_queue_t *)calloc(control->num_threads, sizeof(dt_control_worker_queue_t));
+  for(int k = 0; k < control->num_threads; k++) dt_pthread_mutex_init(&control->worker_queues[k].mutex, NULL);
+  control->fg_queue = (dt_control_deque_t *)calloc(1, sizeof(dt_control_deque_t));
+  control->fg_jobs = g_hash_table_new(dt_control_job_hash, dt_control_job_hash_equal);
+  control->fg_length = 0;
+  control->next_worker = 0;
+  dt_pthread_mutex_init(&control->stats_mutex, NULL);
+  control->job_stats = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free);
+  control->stats_steals = 0;
   dt_pthread_mutex_lock(&control->run_mutex);
   control->running = 1;
   dt_pthread_mutex_unlock(&control->run_mutex);
@@ -641,10 +833,69 @@ void dt_control_jobs_init(dt_control_t *control)
 
 void dt_control_jobs_cleanup(dt_control_t *control)
 {
-  free(control->job);
+  if(darktable.unmuted & (DT_DEBUG_CONTROL | DT_DEBUG_PERF)) dt_control_jobs_print_stats(control);
+
+  // jobs still waiting in the deques are dropped on the floor, just like before
+  for(int k = 0; k < control->num_threads; k++)
+  {
+    for(int i = 0; i < DT_JOB_QUEUE_MAX; i++) free(control->worker_queues[k].deque[i].jobs);
+    dt_pthread_mutex_destroy(&control->worker_queues[k].mutex);
+  }
+  free(control->worker_queues);
+  control->worker_queues = NULL;
+  free(control->fg_queue->jobs);
+  free(control->fg_queue);
+  control->fg_queue = NULL;
+  g_hash_table_destroy(control->fg_jobs);
+  control->fg_jobs = NULL;
+  dt_pthread_mutex_lock(&control->stats_mutex);
+  g_hash_table_destroy(control->job_stats);
+  control->job_stats = NULL;
+  dt_pthread_mutex_unlock(&control->stats_mutex);
+  dt_pthread_mutex_destroy(&control->stats_mutex);
   free(control->thread);
 }
 
+static gint dt_control_job_stats_compare(gconstpointer a, gconstpointer b)
+{
+  const dt_job_stats_t *s1 = (const dt_job_stats_t *)a, *s2 = (const dt_job_stats_t *)b;
+  const double t1 = s1->wait + s1->run, t2 = s2->wait + s2->run;
+  return t1 < t2 ? 1 : (t1 > t2 ? -1 : 0);
+}
+
+GList *dt_control_jobs_get_stats(dt_control_t *control)
+{
+  GList *list = NULL;
+  dt_pthread_mutex_lock(&control->stats_mutex);
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init(&iter, control->job_stats);
+  while(g_hash_table_iter_next(&iter, NULL, &value))
+  {
+    dt_job_stats_t *stats = (dt_job_stats_t *)malloc(sizeof(dt_job_stats_t));
+    memcpy(stats, value, sizeof(dt_job_stats_t));
+    list = g_list_prepend(list, stats);
+  }
+  dt_pthread_mutex_unlock(&control->stats_mutex);
+  return g_list_sort(list, dt_control_job_stats_compare);
+}
+
+void dt_control_jobs_print_stats(dt_control_t *control)
+{
+  GList *list = dt_control_jobs_get_stats(control);
+  fprintf(stderr, "[control] job statistics, %ld jobs stolen between workers:\n", control->stats_steals);
+  fprintf(stderr, "  %-40s %5s %8s %12s %12s %12s %12s\n", "job", "queue", "count", "avg wait [s]", "max wait [s]",
+          "avg run [s]", "max run [s]");
+  for(GList *iter = list; iter; iter = g_list_next(iter))
+  {
+    const dt_job_stats_t *stats = (const dt_job_stats_t *)iter->data;
+    fprintf(stderr, "  %-40.40s %5d %8" PRIu64 " %12.4f %12.4f %12.4f %12.4f\n", stats->type, stats->queue,
+            stats->count, stats->wait / stats->count, stats->max_wait, stats->run / stats->count,
+            stats->max_run);
+  }
+  g_list_free_full(list, free);
+}
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -86,6 +86,22 @@ struct dt_control_t;
 void dt_control_jobs_init(struct dt_control_t *control);
 void dt_control_jobs_cleanup(struct dt_control_t *control);
 
+/** how long the jobs of one kind (same description format) waited in their queue and ran */
+typedef struct dt_job_stats_t
+{
+  const char *type; // the format passed to dt_control_job_create()
+  dt_job_queue_t queue;
+  uint64_t count;
+  double wait, max_wait; // in seconds, from being queued to running
+  double run, max_run;   // in seconds
+} dt_job_stats_t;
+
+/** get a copy of the statistics of all kinds of jobs that ran so far, most expensive first.
+  * free with g_list_free_full(list, free) */
+GList *dt_control_jobs_get_stats(struct dt_control_t *control);
+/** print them to stderr. done on shutdown with -d control or -d perf */
+void dt_control_jobs_print_stats(struct dt_control_t *control);
+
 int dt_control_add_job(struct dt_control_t *control, dt_job_queue_t queue_id, dt_job_t *job);
 int32_t dt_control_add_job_res(struct dt_control_t *s, dt_job_t *job, int32_t res);
 
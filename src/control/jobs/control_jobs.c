@@ -33,6 +33,7 @@
 #include "common/tags.h"
 #include "control/conf.h"
 #include "develop/imageop_math.h"
+#include "develop/tiling.h"
 
 #include "gui/gtk.h"
 
@@ -67,6 +68,35 @@ typedef struct dt_control_export_t
   gboolean style_append;
 } dt_control_export_t;
 
+// upper bound for the number of images exported in parallel
+#define DT_CONTROL_EXPORT_MAX_PARALLEL 16
+// rough number of full size float buffers one export pipe keeps around:
+// the input, two cache lines and scratch space of the modules
+#define DT_CONTROL_EXPORT_BUFFERS_PER_IMAGE 5
+
+// state shared between the threads of one export job
+typedef struct dt_control_export_queue_t
+{
+  dt_job_t *job;
+  const dt_control_export_t *settings;
+  dt_imageio_module_format_t *mformat;
+  dt_imageio_module_storage_t *mstorage;
+  dt_imageio_module_data_t *sdata;
+  guint tagid, etagid;
+  int omp_threads; // openmp threads per image
+
+  dt_pthread_mutex_t mutex; // protects the rest
+  GList *images;
+  guint num, total;
+  double fraction;
+} dt_control_export_queue_t;
+
+typedef struct dt_control_export_worker_t
+{
+  dt_control_export_queue_t *queue;
+  dt_imageio_module_data_t *fdata; // one per thread
+} dt_control_export_worker_t;
+
 typedef struct dt_control_image_enumerator_t
 {
   GList *index;
@@ -1160,9 +1190,108 @@ static int32_t dt_control_local_copy_images_job_run(dt_job_t *job)
   return 0;
 }
 
+static void dt_control_export_images(dt_control_export_queue_t *q, dt_imageio_module_data_t *fdata)
+{
+  while(dt_control_job_get_state(q->job) != DT_JOB_STATE_CANCELLED)
+  {
+    dt_pthread_mutex_lock(&q->mutex);
+    if(!q->images)
+    {
+      dt_pthread_mutex_unlock(&q->mutex);
+      break;
+    }
+    const int imgid = GPOINTER_TO_INT(q->images->data);
+    q->images = g_list_delete_link(q->images, q->images);
+    const guint num = ++q->num;
+
+    // remove 'changed' tag from image
+    dt_tag_detach(q->tagid, imgid);
+    // make sure the 'exported' tag is set on the image
+    dt_tag_attach(q->etagid, imgid);
+    dt_pthread_mutex_unlock(&q->mutex);
+
+    // check if image still exists:
+    char imgfilename[PATH_MAX] = { 0 };
+    const dt_image_t *image = dt_image_cache_get(darktable.image_cache, (int32_t)imgid, 'r');
+    if(image)
+    {
+      gboolean from_cache = TRUE;
+      dt_image_full_path(image->id, imgfilename, sizeof(imgfilename), &from_cache);
+      if(!g_file_test(imgfilename, G_FILE_TEST_IS_REGULAR))
+      {
+        dt_control_log(_("image `%s' is currently unavailable"), image->filename);
+        fprintf(stderr, "image `%s' is currently unavailable\n", imgfilename);
+        // dt_image_remove(imgid);
+        dt_image_cache_read_release(darktable.image_cache, image);
+      }
+      else
+      {
+        dt_image_cache_read_release(darktable.image_cache, image);
+        if(q->mstorage->store(q->mstorage, q->sdata, imgid, q->mformat, fdata, num, q->total,
+                              q->settings->high_quality, q->settings->upscale) != 0)
+          dt_control_job_cancel(q->job);
+      }
+    }
+
+    dt_pthread_mutex_lock(&q->mutex);
+    q->fraction += 1.0 / q->total;
+    if(q->fraction > 1.0) q->fraction = 1.0;
+    dt_control_job_set_progress(q->job, q->fraction);
+    dt_pthread_mutex_unlock(&q->mutex);
+  }
+}
+
+static void *dt_control_export_worker(void *ptr)
+{
+  dt_control_export_worker_t *worker = (dt_control_export_worker_t *)ptr;
+#ifdef _OPENMP
+  omp_set_num_threads(worker->queue->omp_threads);
+#endif
+  dt_pthread_setname("export");
+  dt_control_export_images(worker->queue, worker->fdata);
+  return NULL;
+}
+
+// how many images to export at the same time: as many as the user allows (export_parallel_images, 0 means
+// automatic), as long as one pipe per image fits into host_memory_limit. storage and format both have to
+// allow it, formats like pdf collect all images in one document.
+static int dt_control_export_get_parallel(dt_imageio_module_storage_t *mstorage,
+                                          dt_imageio_module_format_t *mformat, dt_imageio_module_data_t *fdata,
+                                          GList *images)
+{
+  const int conf = dt_conf_get_int("export_parallel_images");
+  if(conf == 1 || !(mstorage->flags(mstorage) & STORAGE_FLAGS_PARALLEL_STORE)
+     || !(mformat->flags(fdata) & FORMAT_FLAGS_PARALLEL_WRITE))
+    return 1;
+
+  int parallel = MIN(conf > 1 ? conf : DT_CONTROL_EXPORT_MAX_PARALLEL, darktable.num_openmp_threads);
+  parallel = MIN(parallel, (int)g_list_length(images));
+  if(parallel <= 1) return 1;
+
+  // every pipe has to hold the largest image in full resolution
+  size_t width = 0, height = 0;
+  for(GList *iter = images; iter; iter = g_list_next(iter))
+  {
+    const dt_image_t *image = dt_image_cache_get(darktable.image_cache, GPOINTER_TO_INT(iter->data), 'r');
+    if(!image) continue;
+    if((size_t)image->width * image->height > width * height)
+    {
+      width = image->width;
+      height = image->height;
+    }
+    dt_image_cache_read_release(darktable.image_cache, image);
+  }
+
+  while(parallel > 1
+        && !dt_tiling_piece_fits_host_memory(width, height, 4 * sizeof(float),
+                                             parallel * DT_CONTROL_EXPORT_BUFFERS_PER_IMAGE, 0))
+    parallel--;
+
+  return parallel;
+}
+
 static int32_t dt_control_export_job_run(dt_job_t *job)
 {
-  int imgid = -1;
   dt_control_image_enumerator_t *params = (dt_control_image_enumerator_t *)dt_control_job_get_params(job);
   dt_control_export_t *settings = (dt_control_export_t *)params->data;
   GList *t = params->index;
@@ -1210,61 +1339,74 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
   // update the message. initialize_store() might have changed the number of images
   dt_control_job_set_progress_message(job, message);
 
-  double fraction = 0;
-
   // set up the fdata struct
   fdata->max_width = (settings->max_width != 0 && w != 0) ? MIN(w, settings->max_width) : MAX(w, settings->max_width);
   fdata->max_height = (settings->max_height != 0 && h != 0) ? MIN(h, settings->max_height) : MAX(h, settings->max_height);
   g_strlcpy(fdata->style, settings->style, sizeof(fdata->style));
   fdata->style_append = settings->style_append;
-  guint num = 0;
+
+  dt_control_export_queue_t queue = { 0 };
+  queue.job = job;
+  queue.settings = settings;
+  queue.mformat = mformat;
+  queue.mstorage = mstorage;
+  queue.sdata = sdata;
+  queue.images = t;
+  queue.total = total;
   // Invariant: the tagid for 'darktable|changed' will not change while this function runs. Is this a
   // sensible assumption?
-  guint tagid = 0, etagid = 0;
-  dt_tag_new("darktable|changed", &tagid);
-  dt_tag_new("darktable|exported", &etagid);
-
-  while(t && dt_control_job_get_state(job) != DT_JOB_STATE_CANCELLED)
+  dt_tag_new("darktable|changed", &queue.tagid);
+  dt_tag_new("darktable|exported", &queue.etagid);
+  dt_pthread_mutex_init(&queue.mutex, NULL);
+
+  // each image gets its own pipe in its own thread, with a share of the openmp threads
+  const int parallel = dt_control_export_get_parallel(mstorage, mformat, fdata, t);
+  queue.omp_threads = MAX(1, darktable.num_openmp_threads / parallel);
+  dt_print(DT_DEBUG_PERF, "[export] exporting %d images in parallel, %d threads each\n", parallel,
+           queue.omp_threads);
+
+  pthread_t *threads = NULL;
+  dt_control_export_worker_t *workers = NULL;
+  int num_workers = 0;
+  if(parallel > 1)
   {
-    if(!t)
-      imgid = 0;
-    else
+    threads = (pthread_t *)calloc(parallel - 1, sizeof(pthread_t));
+    workers = (dt_control_export_worker_t *)calloc(parallel - 1, sizeof(dt_control_export_worker_t));
+    for(int k = 0; k < parallel - 1; k++)
     {
-      imgid = GPOINTER_TO_INT(t->data);
-      t = g_list_delete_link(t, t);
-      num = total - g_list_length(t);
-    }
-
-    // remove 'changed' tag from image
-    dt_tag_detach(tagid, imgid);
-    // make sure the 'exported' tag is set on the image
-    dt_tag_attach(etagid, imgid);
-    // check if image still exists:
-    char imgfilename[PATH_MAX] = { 0 };
-    const dt_image_t *image = dt_image_cache_get(darktable.image_cache, (int32_t)imgid, 'r');
-    if(image)
-    {
-      gboolean from_cache = TRUE;
-      dt_image_full_path(image->id, imgfilename, sizeof(imgfilename), &from_cache);
-      if(!g_file_test(imgfilename, G_FILE_TEST_IS_REGULAR))
-      {
-        dt_control_log(_("image `%s' is currently unavailable"), image->filename);
-        fprintf(stderr, "image `%s' is currently unavailable\n", imgfilename);
-        // dt_image_remove(imgid);
-        dt_image_cache_read_release(darktable.image_cache, image);
-      }
-      else
+      // same settings as ours, but private state
+      workers[k].queue = &queue;
+      workers[k].fdata = mformat->get_params(mformat);
+      memcpy(workers[k].fdata, fdata, mformat->params_size(mformat));
+      if(dt_pthread_create(&threads[k], dt_control_export_worker, &workers[k]))
       {
-        dt_image_cache_read_release(darktable.image_cache, image);
-        if(mstorage->store(mstorage, sdata, imgid, mformat, fdata, num, total, settings->high_quality, settings->upscale) != 0)
-          dt_control_job_cancel(job);
+        // we still make progress with the threads we got
+        mformat->free_params(mformat, workers[k].fdata);
+        break;
       }
+      num_workers++;
     }
+  }
 
-    fraction += 1.0 / total;
-    if(fraction > 1.0) fraction = 1.0;
-    dt_control_job_set_progress(job, fraction);
+#ifdef _OPENMP
+  const int omp_threads = omp_get_max_threads();
+  omp_set_num_threads(queue.omp_threads);
+#endif
+  dt_control_export_images(&queue, fdata);
+#ifdef _OPENMP
+  omp_set_num_threads(omp_threads);
+#endif
+
+  for(int k = 0; k < num_workers; k++)
+  {
+    pthread_join(threads[k], NULL);
+    mformat->free_params(mformat, workers[k].fdata);
   }
+  free(threads);
+  free(workers);
+
+  g_list_free(queue.images);
+  dt_pthread_mutex_destroy(&queue.mutex);
   params->index = NULL;
 
   if(mstorage->finalize_store) mstorage->finalize_store(mstorage, sdata);
@@ -2791,6 +2791,26 @@ _blend_row_func *dt_develop_choose_blend_func(const unsigned int blend_mode)
   return blend;
 }
 
+/* set up the mask of one row, see dt_develop_blend_process() */
+static inline void _blend_init_mask_row(const _blend_buffer_desc_t *bd, const dt_develop_blend_params_t *const d,
+                                        const int uniform, const int drawn, const int invert, const float fill,
+                                        const float opacity, const float *a, const float *b, float *mask)
+{
+  const size_t width = bd->stride / bd->ch;
+  if(uniform)
+  {
+    for(size_t i = 0; i < width; i++) mask[i] = opacity;
+    return;
+  }
+
+  if(!drawn)
+    for(size_t i = 0; i < width; i++) mask[i] = fill;
+  else if(invert)
+    for(size_t i = 0; i < width; i++) mask[i] = 1.0f - mask[i];
+
+  _blend_make_mask(bd, d->blendif, d->blendif_parameters, d->mask_mode, d->mask_combine, opacity, a, b, mask);
+}
+
 void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
                               const void *const ivoid, void *const ovoid, const struct dt_iop_roi_t *const roi_in,
                               const struct dt_iop_roi_t *const roi_out)
@@ -2862,17 +2882,25 @@ void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelp
 
   float *const mask = _mask;
 
-  if(mask_mode == DEVELOP_MASK_ENABLED)
-  {
-    /* blend uniformly (no drawn or parametric mask) */
+  /* check if mask should be suppressed temporarily (i.e. just set to global
+   * opacity value) */
+  const int suppress = self->suppress_mask && self->dev->gui_attached && (self == self->dev->gui_module)
+                       && (piece->pipe == self->dev->pipe) && (mask_mode & DEVELOP_MASK_BOTH);
 
-    const size_t buffsize = (size_t)roi_out->width * roi_out->height;
-#ifdef _OPENMP
-#pragma omp parallel for default(none)
-#endif
-    for(size_t i = 0; i < buffsize; i++) mask[i] = opacity;
-  }
-  else
+  const int maskblur = fabs(d->radius) <= 0.1f ? 0 : 1;
+
+  /* how each row of the mask is set up before blending:
+   * uniform: blend uniformly (no drawn or parametric mask), mask is opacity
+   * drawn:   a drawn mask has been rendered into the mask buffer
+   * fill:    initial mask value if there is no drawn mask
+   * if the mask needs no blurring, building the mask and blending happen in one pass over the rows,
+   * while they are still in cache. otherwise the mask is finished completely first. */
+  const int uniform = (mask_mode == DEVELOP_MASK_ENABLED) || suppress;
+  int drawn = 0;
+  int invert = 0;
+  float fill = 1.0f;
+
+  if(!uniform)
   {
     /* we blend with a drawn and/or parametric mask */
 
@@ -2882,99 +2910,67 @@ void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelp
     if(form && (!(self->flags() & IOP_FLAGS_NO_MASKS)) && (d->mask_mode & DEVELOP_MASK_MASK))
     {
       dt_masks_group_render_roi(self, piece, form, roi_out, mask);
-
-      if(d->mask_combine & DEVELOP_COMBINE_MASKS_POS)
-      {
-        // if we have a mask and this flag is set -> invert the mask
-        const size_t buffsize = (size_t)roi_out->width * roi_out->height;
-#ifdef _OPENMP
-#pragma omp parallel for default(none)
-#endif
-        for(size_t i = 0; i < buffsize; i++) mask[i] = 1.0f - mask[i];
-      }
+      drawn = 1;
+      // if we have a mask and this flag is set -> invert the mask
+      invert = (d->mask_combine & DEVELOP_COMBINE_MASKS_POS) ? 1 : 0;
     }
     else if((!(self->flags() & IOP_FLAGS_NO_MASKS)) && (d->mask_mode & DEVELOP_MASK_MASK))
     {
       // no form defined but drawn mask active
       // we fill the buffer with 1.0f or 0.0f depending on mask_combine
-      const float fill = (d->mask_combine & DEVELOP_COMBINE_MASKS_POS) ? 0.0f : 1.0f;
-      const size_t buffsize = (size_t)roi_out->width * roi_out->height;
-#ifdef _OPENMP
-#pragma omp parallel for default(none)
-#endif
-      for(size_t i = 0; i < buffsize; i++) mask[i] = fill;
+      fill = (d->mask_combine & DEVELOP_COMBINE_MASKS_POS) ? 0.0f : 1.0f;
     }
     else
     {
       // we fill the buffer with 1.0f or 0.0f depending on mask_combine
-      const float fill = (d->mask_combine & DEVELOP_COMBINE_INCL) ? 0.0f : 1.0f;
-      const size_t buffsize = (size_t)roi_out->width * roi_out->height;
-#ifdef _OPENMP
-#pragma omp parallel for default(none)
-#endif
-      for(size_t i = 0; i < buffsize; i++) mask[i] = fill;
+      fill = (d->mask_combine & DEVELOP_COMBINE_INCL) ? 0.0f : 1.0f;
     }
+  }
 
+  const int fused = uniform || !maskblur;
+
+  if(!fused)
+  {
 #ifdef _OPENMP
-#pragma omp parallel for default(none)
+#pragma omp parallel for default(none) shared(drawn, invert, fill)
 #endif
     for(size_t y = 0; y < roi_out->height; y++)
     {
-
       size_t iindex = ((size_t)(y + yoffs) * iwidth + xoffs) * ch;
       size_t oindex = (size_t)y * roi_out->width * ch;
       _blend_buffer_desc_t bd = { .cst = cst, .stride = (size_t)roi_out->width * ch, .ch = ch, .bch = bch };
       float *in = (float *)ivoid + iindex;
       float *out = (float *)ovoid + oindex;
       float *m = (float *)mask + y * roi_out->width;
-      _blend_make_mask(&bd, d->blendif, d->blendif_parameters, d->mask_mode, d->mask_combine, opacity, in,
-                       out, m);
+      _blend_init_mask_row(&bd, d, uniform, drawn, invert, fill, opacity, in, out, m);
     }
 
-    const int maskblur = fabs(d->radius) <= 0.1f ? 0 : 1;
     const int gaussian = d->radius > 0.0f ? 1 : 0;
     const float radius = fabs(d->radius);
 
-    if(maskblur)
+    if(gaussian)
     {
-      if(gaussian)
-      {
-        const float sigma = radius * roi_out->scale / piece->iscale;
+      const float sigma = radius * roi_out->scale / piece->iscale;
 
-        const float mmax[] = { 1.0f };
-        const float mmin[] = { 0.0f };
+      const float mmax[] = { 1.0f };
+      const float mmin[] = { 0.0f };
 
-        dt_gaussian_t *g = dt_gaussian_init(roi_out->width, roi_out->height, 1, mmax, mmin, sigma, 0);
-        if(g)
-        {
-          dt_gaussian_blur(g, mask, mask);
-          dt_gaussian_free(g);
-        }
-      }
-      else
+      dt_gaussian_t *g = dt_gaussian_init(roi_out->width, roi_out->height, 1, mmax, mmin, sigma, 0);
+      if(g)
       {
-        // potential further blend algorithm (bilateral grid?)
+        dt_gaussian_blur(g, mask, mask);
+        dt_gaussian_free(g);
       }
     }
-
-    /* check if mask should be suppressed temporarily (i.e. just set to global
-     * opacity value) */
-    if(self->suppress_mask && self->dev->gui_attached && (self == self->dev->gui_module)
-       && (piece->pipe == self->dev->pipe) && (mask_mode & DEVELOP_MASK_BOTH))
+    else
     {
-#ifdef _OPENMP
-#pragma omp parallel for default(none)
-#endif
-      for(size_t k = 0; k < (size_t)roi_out->height * roi_out->width; k++)
-      {
-        mask[k] = opacity;
-      }
+      // potential further blend algorithm (bilateral grid?)
     }
   }
 
 /* now apply blending with per-pixel opacity value as defined in mask */
 #ifdef _OPENMP
-#pragma omp parallel for default(none)
+#pragma omp parallel for default(none) shared(drawn, invert, fill)
 #endif
   for(size_t y = 0; y < roi_out->height; y++)
   {
@@ -2985,6 +2981,8 @@ void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelp
     float *out = (float *)ovoid + oindex;
     float *m = (float *)mask + y * roi_out->width;
 
+    if(fused) _blend_init_mask_row(&bd, d, uniform, drawn, invert, fill, opacity, in, out, m);
+
     if(request_mask_display & DT_DEV_PIXELPIPE_DISPLAY_ANY)
       display_channel(&bd, in, out, m, request_mask_display);
     else
@@ -243,6 +243,7 @@ void dt_dev_process_preview_job(dt_develop_t *dev)
     dt_dev_pixelpipe_cleanup_nodes(dev->preview_pipe);
     dt_dev_pixelpipe_create_nodes(dev->preview_pipe, dev);
     dt_dev_pixelpipe_flush_caches(dev->preview_pipe);
+    dev->preview_pipe->load_from_disk = 1;
     dev->preview_loading = 0;
   }
 
@@ -1712,10 +1713,25 @@ int dt_dev_distort_backtransform(dt_develop_t *dev, float *points, size_t points
   return dt_dev_distort_backtransform_plus(dev, dev->preview_pipe, 0, 99999, points, points_count);
 }
 
+// the module being edited may hide some others (operation_tags_filter()). the distort functions below look
+// that up once per call and pass it to _dev_distort_applies() for every module.
+static inline int _dev_distort_filter(const dt_develop_t *dev)
+{
+  return dev->gui_module ? dev->gui_module->operation_tags_filter() : 0;
+}
+
+static inline int _dev_distort_applies(dt_iop_module_t *module, const dt_dev_pixelpipe_iop_t *piece,
+                                       const int pmin, const int pmax, const int filter)
+{
+  return piece->enabled && module->priority <= pmax && module->priority >= pmin
+         && !(filter & module->operation_tags());
+}
+
 int dt_dev_distort_transform_plus(dt_develop_t *dev, dt_dev_pixelpipe_t *pipe, int pmin, int pmax,
                                   float *points, size_t points_count)
 {
   dt_pthread_mutex_lock(&dev->history_mutex);
+  const int filter = _dev_distort_filter(dev);
   GList *modules = g_list_first(dev->iop);
   GList *pieces = g_list_first(pipe->nodes);
   while(modules)
@@ -1727,8 +1743,7 @@ int dt_dev_distort_transform_plus(dt_develop_t *dev, dt_dev_pixelpipe_t *pipe, i
     }
     dt_iop_module_t *module = (dt_iop_module_t *)(modules->data);
     dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)(pieces->data);
-    if(piece->enabled && module->priority <= pmax && module->priority >= pmin &&
-      !(dev->gui_module && dev->gui_module->operation_tags_filter() & module->operation_tags()))
+    if(_dev_distort_applies(module, piece, pmin, pmax, filter))
     {
       module->distort_transform(module, piece, points, points_count);
     }
@@ -1743,6 +1758,7 @@ int dt_dev_distort_backtransform_plus(dt_develop_t *dev, dt_dev_pixelpipe_t *pip
                                       float *points, size_t points_count)
 {
   dt_pthread_mutex_lock(&dev->history_mutex);
+  const int filter = _dev_distort_filter(dev);
   GList *modules = g_list_last(dev->iop);
   GList *pieces = g_list_last(pipe->nodes);
   while(modules)
@@ -1754,8 +1770,7 @@ int dt_dev_distort_backtransform_plus(dt_develop_t *dev, dt_dev_pixelpipe_t *pip
     }
     dt_iop_module_t *module = (dt_iop_module_t *)(modules->data);
     dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)(pieces->data);
-    if(piece->enabled && module->priority <= pmax && module->priority >= pmin &&
-      !(dev->gui_module && dev->gui_module->operation_tags_filter() & module->operation_tags()))
+    if(_dev_distort_applies(module, piece, pmin, pmax, filter))
     {
       module->distort_backtransform(module, piece, points, points_count);
     }
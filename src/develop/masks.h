@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include "common/cache.h"
 #include "common/opencl.h"
 #include "develop/pixelpipe.h"
 #include "dtgtk/button.h"
@@ -244,6 +245,28 @@ int dt_masks_group_render(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece
 int dt_masks_group_render_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
                               const dt_iop_roi_t *roi, float *buffer);
 
+/**
+ * rasterized masks of dt_masks_get_mask_roi(), shared by all pipes. the key covers the form with all
+ * its points (and those of all forms of a group), the distortions applied before the module, the pipe
+ * input and the roi, so a mask is only rendered again if one of these changed. the total size is bounded
+ * by masks_cache_memory.
+ */
+typedef struct dt_masks_cache_t
+{
+  dt_cache_t cache;
+  // largest single mask we accept, so one full resolution mask can't flush everything else
+  size_t max_line_size;
+
+  // long int to give 32-bits on old archs, so __sync* calls will work.
+  long int stats_requests;
+  long int stats_hits;
+} dt_masks_cache_t;
+
+void dt_masks_cache_init(dt_masks_cache_t *cache);
+void dt_masks_cache_cleanup(dt_masks_cache_t *cache);
+/** print out fill state and hit rate (debug). */
+void dt_masks_cache_print(dt_masks_cache_t *cache);
+
 // returns current masks version
 int dt_masks_version(void);
 
@@ -313,6 +336,10 @@ void dt_masks_form_move(dt_masks_form_t *grp, int formid, int up);
 int dt_masks_form_duplicate(dt_develop_t *dev, int formid);
 
 /** utils functions */
+/** transform points and border (may be NULL) with all distorting modules up to prio_max, in one go so that
+ * every module only sets up its transformation once */
+int dt_masks_distort_points_border(dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe, int prio_max,
+                                   float *points, int points_count, float *border, int border_count);
 int dt_masks_point_in_form_exact(float x, float y, float *points, int points_start, int points_count);
 int dt_masks_point_in_form_near(float x, float y, float *points, int points_start, int points_count, float distance, int *near);
 
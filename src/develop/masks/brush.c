@@ -847,16 +847,14 @@ static int _brush_get_points_border(dt_develop_t *dev, dt_masks_form_t *form, in
   start2 = dt_get_wtime();
 
   // and we transform them with all distorted modules
-  if(dt_dev_distort_transform_plus(dev, pipe, 0, prio_max, *points, *points_count))
+  if(dt_masks_distort_points_border(dev, pipe, prio_max, *points, *points_count, border ? *border : NULL,
+                                    border ? *border_count : 0))
   {
-    if(!border || dt_dev_distort_transform_plus(dev, pipe, 0, prio_max, *border, *border_count))
-    {
-      if(darktable.unmuted & DT_DEBUG_PERF)
-        dt_print(DT_DEBUG_MASKS, "[masks %s] brush_points transform took %0.04f sec\n", form->name,
-                 dt_get_wtime() - start2);
+    if(darktable.unmuted & DT_DEBUG_PERF)
+      dt_print(DT_DEBUG_MASKS, "[masks %s] brush_points transform took %0.04f sec\n", form->name,
+               dt_get_wtime() - start2);
 //       start2 = dt_get_wtime();
-      return 1;
-    }
+    return 1;
   }
 
   // if we failed, then free all and return
@@ -2629,9 +2627,10 @@ static int dt_brush_get_mask(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *pi
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
-static inline void _brush_falloff_roi(float *buffer, int *p0, int *p1, int bw, int bh, float hardness,
-                                      float density)
+/** we write a falloff segment respecting limits of buffer. only rows y0 <= y < y1 are touched, so that
+ * horizontal bands of the buffer can be drawn in parallel. */
+static inline void _brush_falloff_roi(float *buffer, const int *p0, const int *p1, int bw, int bh, float hardness,
+                                      float density, int y0, int y1)
 {
   // segment length (increase by 1 to avoid division-by-zero special case handling)
   const int l = sqrt((p1[0] - p0[0]) * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
@@ -2664,10 +2663,13 @@ static inline void _brush_falloff_roi(float *buffer, int *p0, int *p1, int bw, i
 
     float *buf = buffer + (size_t)y * bw + x;
 
-    *buf = fmaxf(*buf, op);
-    if(x + dx >= 0 && x + dx < bw)
-      buf[dpx] = fmaxf(buf[dpx], op); // this one is to avoid gaps due to int rounding
-    if(y + dy >= 0 && y + dy < bh)
+    if(y >= y0 && y < y1)
+    {
+      *buf = fmaxf(*buf, op);
+      if(x + dx >= 0 && x + dx < bw)
+        buf[dpx] = fmaxf(buf[dpx], op); // this one is to avoid gaps due to int rounding
+    }
+    if(y + dy >= y0 && y + dy < y1)
       buf[dpy] = fmaxf(buf[dpy], op); // this one is to avoid gaps due to int rounding
   }
 }
@@ -2764,20 +2766,37 @@ static int dt_brush_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
     return 1;
   }
 
-  // now we fill the falloff
-  int p0[2], p1[2];
-  for(int i = nb_corner * 3; i < border_count; i++)
+  // now we fill the falloff, in horizontal bands, one per thread. as segments are merged with max() the
+  // result doesn't depend on the order.
+  const int nb_bands = MIN(height, 4 * dt_get_num_threads());
+#ifdef _OPENMP
+#if !defined(__SUNOS__) && !defined(__NetBSD__)
+#pragma omp parallel for schedule(dynamic) default(none) shared(buffer, points, border, payload, border_count, nb_corner)
+#else
+#pragma omp parallel for schedule(dynamic) shared(buffer, points, border, payload, border_count, nb_corner)
+#endif
+#endif
+  for(int b = 0; b < nb_bands; b++)
   {
-    p0[0] = points[i * 2];
-    p0[1] = points[i * 2 + 1];
-    p1[0] = border[i * 2];
-    p1[1] = border[i * 2 + 1];
+    const int y0 = (int)((size_t)height * b / nb_bands);
+    const int y1 = (int)((size_t)height * (b + 1) / nb_bands);
+    int p0[2], p1[2];
+    for(int i = nb_corner * 3; i < border_count; i++)
+    {
+      p0[0] = points[i * 2];
+      p0[1] = points[i * 2 + 1];
+      p1[0] = border[i * 2];
+      p1[1] = border[i * 2 + 1];
 
-    if(MAX(p0[0], p1[0]) < 0 || MIN(p0[0], p1[0]) >= width || MAX(p0[1], p1[1]) < 0
-       || MIN(p0[1], p1[1]) >= height)
-      continue;
+      if(MAX(p0[0], p1[0]) < 0 || MIN(p0[0], p1[0]) >= width || MAX(p0[1], p1[1]) < 0
+         || MIN(p0[1], p1[1]) >= height)
+        continue;
 
-    _brush_falloff_roi(buffer, p0, p1, width, height, payload[i * 2], payload[i * 2 + 1]);
+      // the segment touches one row more in the direction it runs
+      if(MAX(p0[1], p1[1]) + 1 < y0 || MIN(p0[1], p1[1]) - 1 >= y1) continue;
+
+      _brush_falloff_roi(buffer, p0, p1, width, height, payload[i * 2], payload[i * 2 + 1], y0, y1);
+    }
   }
 
   free(points);
@@ -623,8 +623,8 @@ int dt_masks_get_mask(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt
   return 0;
 }
 
-int dt_masks_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
-                          const dt_iop_roi_t *roi, float *buffer)
+static int _masks_render_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
+                                  const dt_iop_roi_t *roi, float *buffer)
 {
   if(form->type & DT_MASKS_CIRCLE)
   {
@@ -653,6 +653,206 @@ int dt_masks_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece
   return 0;
 }
 
+// header in front of every mask in the cache, the pixels follow at DT_MASKS_CACHE_LINE_OFFSET bytes.
+typedef struct dt_masks_cache_line_t
+{
+  uint64_t hash;
+  size_t size;
+} dt_masks_cache_line_t;
+
+#define DT_MASKS_CACHE_LINE_OFFSET ((sizeof(dt_masks_cache_line_t) + 63) & ~(size_t)63)
+
+static inline uint64_t _masks_hash_bytes(uint64_t hash, const void *data, const size_t size)
+{
+  const char *str = (const char *)data;
+  for(size_t i = 0; i < size; i++) hash = ((hash << 5) + hash) ^ str[i];
+  return hash;
+}
+
+static size_t _masks_point_size(const dt_masks_type_t type)
+{
+  if(type & DT_MASKS_GROUP) return sizeof(dt_masks_point_group_t);
+  if(type & DT_MASKS_CIRCLE) return sizeof(dt_masks_point_circle_t);
+  if(type & DT_MASKS_PATH) return sizeof(dt_masks_point_path_t);
+  if(type & DT_MASKS_GRADIENT) return sizeof(dt_masks_point_gradient_t);
+  if(type & DT_MASKS_ELLIPSE) return sizeof(dt_masks_point_ellipse_t);
+  if(type & DT_MASKS_BRUSH) return sizeof(dt_masks_point_brush_t);
+  return 0;
+}
+
+// like dt_masks_group_get_hash_buffer(), but looks up the forms of a group in the develop of the pipe,
+// which isn't darktable.develop for exports and thumbnails.
+static uint64_t _masks_hash_form(dt_develop_t *dev, dt_masks_form_t *form, uint64_t hash)
+{
+  hash = _masks_hash_bytes(hash, &form->type, sizeof(form->type));
+  hash = _masks_hash_bytes(hash, &form->formid, sizeof(form->formid));
+  hash = _masks_hash_bytes(hash, &form->version, sizeof(form->version));
+  hash = _masks_hash_bytes(hash, form->source, sizeof(form->source));
+
+  const size_t point_size = _masks_point_size(form->type);
+  for(GList *points = form->points; points; points = g_list_next(points))
+  {
+    hash = _masks_hash_bytes(hash, points->data, point_size);
+    if(form->type & DT_MASKS_GROUP)
+    {
+      dt_masks_form_t *sel = dt_masks_get_from_id(dev, ((dt_masks_point_group_t *)points->data)->formid);
+      if(sel) hash = _masks_hash_form(dev, sel, hash);
+    }
+  }
+  return hash;
+}
+
+static uint64_t _masks_hash(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
+                            const dt_iop_roi_t *roi)
+{
+  const dt_dev_pixelpipe_t *pipe = piece->pipe;
+  uint64_t hash = _masks_hash_form(module->dev, form, 5381);
+  // the points are distorted by all modules before this one ..
+  const uint64_t distort = dt_dev_hash_distort_plus(module->dev, piece->pipe, 0, module->priority);
+  hash = _masks_hash_bytes(hash, &distort, sizeof(distort));
+  // .. and scaled to the pipe input.
+  hash = _masks_hash_bytes(hash, &pipe->image.id, sizeof(pipe->image.id));
+  hash = _masks_hash_bytes(hash, &pipe->iwidth, sizeof(pipe->iwidth));
+  hash = _masks_hash_bytes(hash, &pipe->iheight, sizeof(pipe->iheight));
+  hash = _masks_hash_bytes(hash, &pipe->iscale, sizeof(pipe->iscale));
+  hash = _masks_hash_bytes(hash, roi, sizeof(dt_iop_roi_t));
+  return hash;
+}
+
+static inline uint32_t _masks_cache_key(const uint64_t hash)
+{
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static void _masks_cache_allocate(void *data, dt_cache_entry_t *entry)
+{
+  // only the header for now, pixels are attached when the mask is stored
+  entry->data_size = DT_MASKS_CACHE_LINE_OFFSET;
+  entry->data = dt_alloc_align(64, entry->data_size);
+  if(!entry->data)
+  {
+    fprintf(stderr, "[masks] memory allocation failed!\n");
+    exit(1);
+  }
+  dt_masks_cache_line_t *line = (dt_masks_cache_line_t *)entry->data;
+  line->hash = -1;
+  line->size = 0;
+  entry->cost = entry->data_size;
+}
+
+static void _masks_cache_deallocate(void *data, dt_cache_entry_t *entry)
+{
+  dt_free_align(entry->data);
+}
+
+void dt_masks_cache_init(dt_masks_cache_t *cache)
+{
+  const int64_t cache_memory = dt_conf_get_int64("masks_cache_memory");
+  const size_t max_mem = MAX(cache_memory, 0);
+
+  dt_cache_init(&cache->cache, 0, max_mem);
+  dt_cache_set_allocate_callback(&cache->cache, _masks_cache_allocate, cache);
+  dt_cache_set_cleanup_callback(&cache->cache, _masks_cache_deallocate, cache);
+  cache->max_line_size = max_mem / 4;
+
+  cache->stats_requests = 0;
+  cache->stats_hits = 0;
+}
+
+void dt_masks_cache_cleanup(dt_masks_cache_t *cache)
+{
+  dt_cache_cleanup(&cache->cache);
+}
+
+void dt_masks_cache_print(dt_masks_cache_t *cache)
+{
+  if(!cache) return;
+  printf("[masks] cache fill %.2f/%.2f MB, hit rate so far: %.3f (%ld of %ld)\n",
+         cache->cache.cost / (1024.0 * 1024.0), cache->cache.cost_quota / (1024.0 * 1024.0),
+         cache->stats_requests ? cache->stats_hits / (float)cache->stats_requests : 0.0f, cache->stats_hits,
+         cache->stats_requests);
+}
+
+// copies the mask for hash to buffer. returns 0 on success.
+static int _masks_cache_get(dt_masks_cache_t *cache, const uint64_t hash, const size_t size, float *buffer)
+{
+  __sync_fetch_and_add(&cache->stats_requests, 1);
+
+  // don't wait for writers, we can still render the mask ourselves
+  dt_cache_entry_t *entry = dt_cache_testget(&cache->cache, _masks_cache_key(hash), 'r');
+  if(!entry) return 1;
+
+  int miss = 1;
+  const dt_masks_cache_line_t *line = (const dt_masks_cache_line_t *)entry->data;
+  // the key is only 32 bits, so make sure this really is our mask
+  if(line->hash == hash && line->size == size)
+  {
+    memcpy(buffer, (const char *)entry->data + DT_MASKS_CACHE_LINE_OFFSET, size);
+    __sync_fetch_and_add(&cache->stats_hits, 1);
+    miss = 0;
+  }
+  dt_cache_release(&cache->cache, entry);
+  return miss;
+}
+
+// only masks which rendered fine go in here, callers don't all look at what rendering returned and would
+// otherwise get a buffer which was never written.
+static void _masks_cache_put(dt_masks_cache_t *cache, const uint64_t hash, const size_t size,
+                             const float *buffer)
+{
+  // a new line always comes back write locked
+  dt_cache_entry_t *entry = dt_cache_get(&cache->cache, _masks_cache_key(hash), 'w');
+  dt_masks_cache_line_t *line = (dt_masks_cache_line_t *)entry->data;
+  if(line->hash == hash && line->size == size)
+  {
+    // some other pipe was faster
+    dt_cache_release(&cache->cache, entry);
+    return;
+  }
+
+  const size_t data_size = DT_MASKS_CACHE_LINE_OFFSET + size;
+  if(entry->data_size < data_size)
+  {
+    void *buf = dt_alloc_align(64, data_size);
+    if(!buf)
+    {
+      line->hash = -1;
+      line->size = 0;
+      dt_cache_release(&cache->cache, entry);
+      return;
+    }
+    dt_free_align(entry->data);
+    entry->data = buf;
+    entry->data_size = data_size;
+    dt_cache_update_cost(&cache->cache, entry, data_size);
+    line = (dt_masks_cache_line_t *)entry->data;
+  }
+
+  memcpy((char *)entry->data + DT_MASKS_CACHE_LINE_OFFSET, buffer, size);
+  line->size = size;
+  line->hash = hash;
+  dt_cache_release(&cache->cache, entry);
+}
+
+int dt_masks_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
+                          const dt_iop_roi_t *roi, float *buffer)
+{
+  dt_masks_cache_t *cache = darktable.masks_cache;
+  const size_t size = (size_t)roi->width * roi->height * sizeof(float);
+  if(!cache || size > cache->max_line_size) return _masks_render_mask_roi(module, piece, form, roi, buffer);
+
+  const uint64_t hash = _masks_hash(module, piece, form, roi);
+  if(!_masks_cache_get(cache, hash, size, buffer))
+  {
+    dt_print(DT_DEBUG_MASKS, "[masks] reusing mask of form %d\n", form->formid);
+    return 1;
+  }
+
+  const int ok = _masks_render_mask_roi(module, piece, form, roi, buffer);
+  if(ok) _masks_cache_put(cache, hash, size, buffer);
+  return ok;
+}
+
 int dt_masks_version(void)
 {
   return DEVELOP_MASKS_VERSION;
@@ -2284,6 +2484,28 @@ void dt_masks_cleanup_unused(dt_develop_t *dev)
   free(used);
 }
 
+int dt_masks_distort_points_border(dt_develop_t *dev, dt_dev_pixelpipe_t *pipe, int prio_max, float *points,
+                                   int points_count, float *border, int border_count)
+{
+  if(!border) return dt_dev_distort_transform_plus(dev, pipe, 0, prio_max, points, points_count);
+
+  float *all = malloc(sizeof(float) * 2 * (points_count + border_count));
+  if(!all)
+    return dt_dev_distort_transform_plus(dev, pipe, 0, prio_max, points, points_count)
+           && dt_dev_distort_transform_plus(dev, pipe, 0, prio_max, border, border_count);
+
+  memcpy(all, points, sizeof(float) * 2 * points_count);
+  memcpy(all + 2 * points_count, border, sizeof(float) * 2 * border_count);
+  const int ok = dt_dev_distort_transform_plus(dev, pipe, 0, prio_max, all, points_count + border_count);
+  if(ok)
+  {
+    memcpy(points, all, sizeof(float) * 2 * points_count);
+    memcpy(border, all + 2 * points_count, sizeof(float) * 2 * border_count);
+  }
+  free(all);
+  return ok;
+}
+
 int dt_masks_point_in_form_exact(float x, float y, float *points, int points_start, int points_count)
 {
   // we use ray casting algorith
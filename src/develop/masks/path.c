@@ -687,57 +687,55 @@ static int _path_get_points_border(dt_develop_t *dev, dt_masks_form_t *form, int
   }
 
   // and we transform them with all distorted modules
-  if(dt_dev_distort_transform_plus(dev, pipe, 0, prio_max, *points, *points_count))
+  if(dt_masks_distort_points_border(dev, pipe, prio_max, *points, *points_count, border ? *border : NULL,
+                                    border ? *border_count : 0))
   {
-    if(!border || dt_dev_distort_transform_plus(dev, pipe, 0, prio_max, *border, *border_count))
+    if(darktable.unmuted & DT_DEBUG_PERF)
+      dt_print(DT_DEBUG_MASKS, "[masks %s] path_points transform took %0.04f sec\n", form->name,
+               dt_get_wtime() - start2);
+    start2 = dt_get_wtime();
+
+    if(border)
     {
-      if(darktable.unmuted & DT_DEBUG_PERF)
-        dt_print(DT_DEBUG_MASKS, "[masks %s] path_points transform took %0.04f sec\n", form->name,
-                 dt_get_wtime() - start2);
-      start2 = dt_get_wtime();
+      // we don't want to copy the falloff points
+      for(int k = 0; k < nb; k++)
+        for(int i = 2; i < 6; i++) (*border)[k * 6 + i] = border_init[k * 6 + i];
 
-      if(border)
+      // now we want to write the skipping zones
+      for(int i = 0; i < inter_count; i++)
       {
-        // we don't want to copy the falloff points
-        for(int k = 0; k < nb; k++)
-          for(int i = 2; i < 6; i++) (*border)[k * 6 + i] = border_init[k * 6 + i];
-
-        // now we want to write the skipping zones
-        for(int i = 0; i < inter_count; i++)
+        int v = (dt_masks_dynbuf_buffer(intersections))[i * 2];
+        int w = (dt_masks_dynbuf_buffer(intersections))[ i * 2 + 1];
+        if(v <= w)
         {
-          int v = (dt_masks_dynbuf_buffer(intersections))[i * 2];
-          int w = (dt_masks_dynbuf_buffer(intersections))[ i * 2 + 1];
-          if(v <= w)
-          {
-            (*border)[v * 2] = NAN;
-            (*border)[v * 2 + 1] = w;
-          }
-          else
+          (*border)[v * 2] = NAN;
+          (*border)[v * 2 + 1] = w;
+        }
+        else
+        {
+          if(w > nb * 3)
           {
-            if(w > nb * 3)
-            {
-              if(isnan((*border)[nb * 6]) && isnan((*border)[nb * 6 + 1]))
-                (*border)[nb * 6 + 1] = w;
-              else if(isnan((*border)[nb * 6]))
-                (*border)[nb * 6 + 1] = MAX((*border)[nb * 6 + 1], w);
-              else
-                (*border)[nb * 6 + 1] = w;
-              (*border)[nb * 6] = NAN;
-            }
-            (*border)[v * 2] = NAN;
-            (*border)[v * 2 + 1] = NAN;
+            if(isnan((*border)[nb * 6]) && isnan((*border)[nb * 6 + 1]))
+              (*border)[nb * 6 + 1] = w;
+            else if(isnan((*border)[nb * 6]))
+              (*border)[nb * 6 + 1] = MAX((*border)[nb * 6 + 1], w);
+            else
+              (*border)[nb * 6 + 1] = w;
+            (*border)[nb * 6] = NAN;
           }
+          (*border)[v * 2] = NAN;
+          (*border)[v * 2 + 1] = NAN;
         }
       }
+    }
 
-      if(darktable.unmuted & DT_DEBUG_PERF)
-        dt_print(DT_DEBUG_MASKS, "[masks %s] path_points end took %0.04f sec\n", form->name,
-                 dt_get_wtime() - start2);
+    if(darktable.unmuted & DT_DEBUG_PERF)
+      dt_print(DT_DEBUG_MASKS, "[masks %s] path_points end took %0.04f sec\n", form->name,
+               dt_get_wtime() - start2);
 //       start2 = dt_get_wtime();
-      dt_masks_dynbuf_free(intersections);
-      free(border_init);
-      return 1;
-    }
+    dt_masks_dynbuf_free(intersections);
+    free(border_init);
+    return 1;
   }
 
   // if we failed, then free all and return
@@ -2451,8 +2449,9 @@ static int _path_crop_to_roi(float *path, const int point_count, float xmin, flo
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
-static void _path_falloff_roi(float *buffer, int *p0, int *p1, int bw, int bh)
+/** we write a falloff segment respecting limits of buffer. only rows y0 <= y < y1 are touched, so that
+ * horizontal bands of the buffer can be drawn in parallel. */
+static void _path_falloff_roi(float *buffer, const int *p0, const int *p1, int bw, int y0, int y1)
 {
   // segment length
   const int l = sqrt((p1[0] - p0[0]) * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
@@ -2471,14 +2470,138 @@ static void _path_falloff_roi(float *buffer, int *p0, int *p1, int bw, int bh)
     const int y = (int)((float)i * ly / (float)l) + p0[1];
     const float op = 1.0 - (float)i / (float)l;
     float *buf = buffer + (size_t)y * bw + x;
-    if(x >= 0 && x < bw && y >= 0 && y < bh) buf[0] = fmaxf(buf[0], op);
-    if(x + dx >= 0 && x + dx < bw && y >= 0 && y < bh)
+    if(x >= 0 && x < bw && y >= y0 && y < y1) buf[0] = fmaxf(buf[0], op);
+    if(x + dx >= 0 && x + dx < bw && y >= y0 && y < y1)
       buf[dx] = fmaxf(buf[dx], op); // this one is to avoid gap due to int rounding
-    if(x >= 0 && x < bw && y + dy >= 0 && y + dy < bh)
+    if(x >= 0 && x < bw && y + dy >= y0 && y + dy < y1)
       buf[dpy] = fmaxf(buf[dpy], op); // this one is to avoid gap due to int rounding
   }
 }
 
+static int _path_cmp_int(const void *a, const void *b)
+{
+  return *(const int *)a - *(const int *)b;
+}
+
+/** fills the inside of the path (cpoints from index first on). instead of flagging the crossings in the
+ * buffer and walking the whole bounding box serially, we collect the crossings of all edges per row first
+ * (an edge table) and then fill the spans between them, one row per thread. the result is the same as
+ * with the edge-flag fill: crossings outside of the clamped bounding box stay single pixels. */
+static int _path_fill_roi(float *buffer, const float *cpoints, const int first, const int points_count,
+                          const int width, const int height, const float xmin, const float xmax,
+                          const float ymin, const float ymax)
+{
+  int *offsets = calloc(height + 1, sizeof(int));
+  if(offsets == NULL) return 0;
+
+  // two passes over the edges: count the crossings per row, then store them
+  int *crossings = NULL;
+  for(int pass = 0; pass < 2; pass++)
+  {
+    float xlast = cpoints[(points_count - 1) * 2];
+    float ylast = cpoints[(points_count - 1) * 2 + 1];
+
+    for(int i = first; i < points_count; i++)
+    {
+      float xstart = xlast;
+      float ystart = ylast;
+
+      float xend = xlast = cpoints[i * 2];
+      float yend = ylast = cpoints[i * 2 + 1];
+
+      if(ystart > yend)
+      {
+        float tmp;
+        tmp = ystart, ystart = yend, yend = tmp;
+        tmp = xstart, xstart = xend, xend = tmp;
+      }
+
+      const float m = (xstart - xend) / (ystart - yend); // we don't need special handling of ystart==yend
+                                                         // as following loop will take care
+
+      for(int yy = (int)ceilf(ystart); (float)yy < yend; yy++)
+      {
+        const float xcross = xstart + m * (yy - ystart);
+
+        int xx = floorf(xcross);
+        if((float)xx + 0.5f <= xcross) xx++;
+
+        if(xx < 0 || xx >= width || yy < 0 || yy >= height)
+          continue; // sanity check just to be on the safe side
+
+        if(pass == 0)
+          offsets[yy + 1]++;
+        else
+          crossings[offsets[yy]++] = xx;
+      }
+    }
+
+    if(pass == 0)
+    {
+      for(int yy = 0; yy < height; yy++) offsets[yy + 1] += offsets[yy];
+      crossings = malloc(MAX(offsets[height], 1) * sizeof(int));
+      if(crossings == NULL)
+      {
+        free(offsets);
+        return 0;
+      }
+    }
+  }
+  // the second pass moved every offset to the start of the next row
+  for(int yy = height; yy > 0; yy--) offsets[yy] = offsets[yy - 1];
+  offsets[0] = 0;
+
+  // the part of the rows the edge-flag fill would have walked
+  const int x0 = fmaxf(xmin, 0);
+  const int x1 = floorf(fminf(xmax, width - 1));
+  const int y0 = fmaxf(ymin, 0);
+  const int y1 = floorf(fminf(ymax, height - 1));
+
+#ifdef _OPENMP
+#if !defined(__SUNOS__) && !defined(__NetBSD__)
+#pragma omp parallel for schedule(dynamic, 16) default(none) shared(buffer, crossings, offsets)
+#else
+#pragma omp parallel for schedule(dynamic, 16) shared(buffer, crossings, offsets)
+#endif
+#endif
+  for(int yy = 0; yy < height; yy++)
+  {
+    int *c = crossings + offsets[yy];
+    const int n = offsets[yy + 1] - offsets[yy];
+    if(n == 0) continue;
+    qsort(c, n, sizeof(int), _path_cmp_int);
+
+    float *row = buffer + (size_t)yy * width;
+    const int fill = (yy >= y0 && yy <= y1);
+    int state = 0, on = 0;
+    for(int k = 0; k < n;)
+    {
+      // a pixel crossed an even number of times is no crossing at all
+      const int xx = c[k];
+      int count = 0;
+      while(k < n && c[k] == xx) k++, count++;
+      if(!(count & 1)) continue;
+
+      if(!fill || xx < x0 || xx > x1)
+      {
+        row[xx] = 1.0f;
+        continue;
+      }
+      if(state)
+        for(int x = on; x <= xx; x++) row[x] = 1.0f;
+      else
+        on = xx;
+      state = !state;
+    }
+    if(state)
+      for(int x = on; x <= x1; x++) row[x] = 1.0f;
+  }
+
+  free(crossings);
+  free(offsets);
+  return 1;
+}
+
 static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
                                 const dt_iop_roi_t *roi, float *buffer)
 {
@@ -2673,69 +2796,13 @@ static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
     }
     else
     {
-      // all other cases
-
-      // edge-flag polygon fill: we write all the point around the path into the buffer
-      float xlast = cpoints[(points_count - 1) * 2];
-      float ylast = cpoints[(points_count - 1) * 2 + 1];
-
-      for(int i = nb_corner * 3; i < points_count; i++)
+      // all other cases: fill the inside of the path row by row
+      if(!_path_fill_roi(buffer, cpoints, nb_corner * 3, points_count, width, height, xmin, xmax, ymin, ymax))
       {
-        float xstart = xlast;
-        float ystart = ylast;
-
-        float xend = xlast = cpoints[i * 2];
-        float yend = ylast = cpoints[i * 2 + 1];
-
-        if(ystart > yend)
-        {
-          float tmp;
-          tmp = ystart, ystart = yend, yend = tmp;
-          tmp = xstart, xstart = xend, xend = tmp;
-        }
-
-        const float m = (xstart - xend) / (ystart - yend); // we don't need special handling of ystart==yend
-                                                           // as following loop will take care
-
-        for(int yy = (int)ceilf(ystart); (float)yy < yend;
-            yy++) // this would normally never touch the last roi line => see comment further above
-        {
-          const float xcross = xstart + m * (yy - ystart);
-
-          int xx = floorf(xcross);
-          if((float)xx + 0.5f <= xcross) xx++;
-
-          if(xx < 0 || xx >= width || yy < 0 || yy >= height)
-            continue; // sanity check just to be on the safe side
-
-          size_t index = (size_t)yy * width + xx;
-
-          buffer[index] = 1.0f - buffer[index];
-        }
-      }
-
-      if(darktable.unmuted & DT_DEBUG_PERF)
-        dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill draw path took %0.04f sec\n", form->name,
-                 dt_get_wtime() - start2);
-      start2 = dt_get_wtime();
-
-      // we fill the inside plain
-      // we don't need to deal with parts of shape outside of roi
-      xmin = fmaxf(xmin, 0);
-      xmax = fminf(xmax, width - 1);
-      ymin = fmaxf(ymin, 0);
-      ymax = fminf(ymax, height - 1);
-
-      for(int yy = ymin; yy <= ymax; yy++)
-      {
-        int state = 0;
-        for(int xx = xmin; xx <= xmax; xx++)
-        {
-          size_t index = (size_t)yy * width + xx;
-          float v = buffer[index];
-          if(v > 0.5f) state = !state;
-          if(state) buffer[index] = 1.0f;
-        }
+        free(cpoints);
+        free(points);
+        free(border);
+        return 0;
       }
 
       if(darktable.unmuted & DT_DEBUG_PERF)
@@ -2749,6 +2816,16 @@ static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
   // deal with feather if it does not lie outside of roi
   if(!path_encircles_roi)
   {
+    // collect the falloff segments first ..
+    int *segments = malloc(4 * sizeof(int) * MAX(border_count - (int)nb_corner * 3, 1));
+    if(segments == NULL)
+    {
+      free(points);
+      free(border);
+      return 0;
+    }
+    int nb_segments = 0;
+
     int p0[2], p1[2];
     float pf1[2];
     int last0[2] = { -100, -100 };
@@ -2781,10 +2858,14 @@ static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
         p1[1] = pf1[1] = border[next * 2 + 1];
       }
 
-      // and we draw the falloff
+      // and we remember the falloff
       if(last0[0] != p0[0] || last0[1] != p0[1] || last1[0] != p1[0] || last1[1] != p1[1])
       {
-        _path_falloff_roi(buffer, p0, p1, width, height);
+        int *seg = segments + 4 * nb_segments++;
+        seg[0] = p0[0];
+        seg[1] = p0[1];
+        seg[2] = p1[0];
+        seg[3] = p1[1];
         last0[0] = p0[0];
         last0[1] = p0[1];
         last1[0] = p1[0];
@@ -2792,6 +2873,30 @@ static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
       }
     }
 
+    // .. and draw them in horizontal bands, one per thread. as segments are merged with max() the
+    // result doesn't depend on the order.
+    const int nb_bands = MIN(height, 4 * dt_get_num_threads());
+#ifdef _OPENMP
+#if !defined(__SUNOS__) && !defined(__NetBSD__)
+#pragma omp parallel for schedule(dynamic) default(none) shared(buffer, segments, nb_segments)
+#else
+#pragma omp parallel for schedule(dynamic) shared(buffer, segments, nb_segments)
+#endif
+#endif
+    for(int b = 0; b < nb_bands; b++)
+    {
+      const int y0 = (int)((size_t)height * b / nb_bands);
+      const int y1 = (int)((size_t)height * (b + 1) / nb_bands);
+      for(int k = 0; k < nb_segments; k++)
+      {
+        const int *seg = segments + 4 * k;
+        // the segment touches one row more in the direction it runs
+        if(MAX(seg[1], seg[3]) + 1 < y0 || MIN(seg[1], seg[3]) - 1 >= y1) continue;
+        _path_falloff_roi(buffer, seg, seg + 2, width, y0, y1);
+      }
+    }
+    free(segments);
+
     if(darktable.unmuted & DT_DEBUG_PERF)
       dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill fill falloff took %0.04f sec\n", form->name,
                dt_get_wtime() - start2);
@@ -17,20 +17,20 @@
 */
 
 #include "develop/pixelpipe_cache.h"
+#include "common/colorspaces.h"
+#include "common/darktable.h"
+#include "common/mipmap_cache.h"
+#include "control/conf.h"
 #include "develop/format.h"
 #include "develop/pixelpipe_hb.h"
 #include "libs/lib.h"
+#include <float.h>
+#include <glib/gstdio.h>
 #include <stdlib.h>
 
 
-// TODO: make cache global (needs to be thread safe then)
-// plan:
-// - look at mipmap_cache.c, for the full buffer allocs
-// - do that, but for `large' and `regular' buffers (full + export/dr mode), so 2 caches
-//   (in fact, maybe 3, one for preview pipes?)
-// - have at most 3 read locks all the time per pipe, get them at create time
-//   ping, pong, and priority buffer (focused plugin)
-// - drop read by the time another is requested (with priority, drop that, or alternating ping and pong?)
+// the per-pipe cache below only lives as long as its pipe. the shared cache at the end of this file
+// keeps module outputs around across pipes (darkroom re-entry, repeated exports, thumbnail regeneration).
 
 int dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_cache_t *cache, int entries, size_t size)
 {
@@ -43,6 +43,9 @@ int dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_cache_t *cache, int entries, si
 #endif
   cache->hash = (uint64_t *)calloc(entries, sizeof(uint64_t));
   cache->used = (int32_t *)calloc(entries, sizeof(int32_t));
+  cache->cost = (float *)calloc(entries, sizeof(float));
+  cache->op = (char **)calloc(entries, sizeof(char *));
+  cache->stats = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
   for(int k = 0; k < entries; k++)
   {
     cache->size[k] = size;
@@ -75,6 +78,10 @@ void dt_dev_pixelpipe_cache_cleanup(dt_dev_pixelpipe_cache_t *cache)
   free(cache->hash);
   free(cache->used);
   free(cache->size);
+  free(cache->cost);
+  for(int k = 0; k < cache->entries; k++) g_free(cache->op[k]);
+  free(cache->op);
+  g_hash_table_destroy(cache->stats);
 }
 
 uint64_t dt_dev_pixelpipe_cache_hash(int imgid, const dt_iop_roi_t *roi, dt_dev_pixelpipe_t *pipe, int module)
@@ -132,6 +139,17 @@ int dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_cache_t *cache, const uint64_t h
   return dt_dev_pixelpipe_cache_get_weighted(cache, hash, size, data, dsc, 0);
 }
 
+static dt_dev_pixelpipe_cache_stats_t *_get_stats(dt_dev_pixelpipe_cache_t *cache, const char *op)
+{
+  dt_dev_pixelpipe_cache_stats_t *stats = g_hash_table_lookup(cache->stats, op);
+  if(!stats)
+  {
+    stats = g_malloc0(sizeof(dt_dev_pixelpipe_cache_stats_t));
+    g_hash_table_insert(cache->stats, g_strdup(op), stats);
+  }
+  return stats;
+}
+
 int dt_dev_pixelpipe_cache_get_weighted(dt_dev_pixelpipe_cache_t *cache, const uint64_t hash, const size_t size,
                                         void **data, dt_iop_buffer_dsc_t **dsc, int weight)
 {
@@ -157,6 +175,15 @@ int dt_dev_pixelpipe_cache_get_weighted(dt_dev_pixelpipe_cache_t *cache, const u
       sz = cache->size[k];
       cache->used[k] = weight; // this is the MRU entry
 
+      if(cache->op[k])
+      {
+        dt_dev_pixelpipe_cache_stats_t *stats = _get_stats(cache, cache->op[k]);
+        stats->queries++;
+        stats->hits++;
+        stats->bytes_saved += size;
+        stats->time_saved += cache->cost[k];
+      }
+
       ASAN_POISON_MEMORY_REGION(*data, sz);
       ASAN_UNPOISON_MEMORY_REGION(*data, size);
     }
@@ -164,7 +191,26 @@ int dt_dev_pixelpipe_cache_get_weighted(dt_dev_pixelpipe_cache_t *cache, const u
 
   if(!*data || sz < size)
   {
-    // kill LRU entry
+    // pick the line to kill: free lines first. otherwise the one which is cheapest to recompute per byte,
+    // discounted by its age. lines used during the last query (most likely the input of the module we're
+    // about to process) and lines weighted as important are not considered. if nothing is left, fall back
+    // to the least recently used one.
+    float min_value = FLT_MAX;
+    for(int k = 0; k < cache->entries; k++)
+    {
+      if(cache->hash[k] == (uint64_t)-1)
+      {
+        max = k;
+        break;
+      }
+      if(cache->used[k] <= 1) continue;
+      const float value = (cache->cost[k] + 1e-6f) / (MAX(cache->size[k], 1) * (float)cache->used[k]);
+      if(value < min_value)
+      {
+        min_value = value;
+        max = k;
+      }
+    }
     // printf("[pixelpipe_cache_get] hash not found, returning slot %d/%d age %d\n", max, cache->entries,
     // weight);
     if(cache->size[max] < size)
@@ -185,6 +231,9 @@ int dt_dev_pixelpipe_cache_get_weighted(dt_dev_pixelpipe_cache_t *cache, const u
 
     cache->hash[max] = hash;
     cache->used[max] = weight;
+    cache->cost[max] = 0.0f;
+    g_free(cache->op[max]);
+    cache->op[max] = NULL;
     cache->misses++;
     return 1;
   }
@@ -213,6 +262,26 @@ void dt_dev_pixelpipe_cache_reweight(dt_dev_pixelpipe_cache_t *cache, void *data
   }
 }
 
+void dt_dev_pixelpipe_cache_set_cost(dt_dev_pixelpipe_cache_t *cache, void *data, const char *op, const float cost)
+{
+  for(int k = 0; k < cache->entries; k++)
+  {
+    if(cache->data[k] == data)
+    {
+      cache->cost[k] = cost;
+      g_free(cache->op[k]);
+      cache->op[k] = g_strdup(op);
+      _get_stats(cache, op)->queries++;
+    }
+  }
+}
+
+const dt_dev_pixelpipe_cache_stats_t *dt_dev_pixelpipe_cache_get_stats(dt_dev_pixelpipe_cache_t *cache,
+                                                                       const char *op)
+{
+  return g_hash_table_lookup(cache->stats, op);
+}
+
 void dt_dev_pixelpipe_cache_invalidate(dt_dev_pixelpipe_cache_t *cache, void *data)
 {
   for(int k = 0; k < cache->entries; k++)
@@ -230,10 +299,452 @@ void dt_dev_pixelpipe_cache_print(dt_dev_pixelpipe_cache_t *cache)
   for(int k = 0; k < cache->entries; k++)
   {
     printf("pixelpipe cacheline %d ", k);
-    printf("used %d by %" PRIu64 "", cache->used[k], cache->hash[k]);
+    printf("used %d by %" PRIu64 " (%s, %.3f secs, %zu bytes)", cache->used[k], cache->hash[k],
+           cache->op[k] ? cache->op[k] : "-", cache->cost[k], cache->size[k]);
     printf("\n");
   }
   printf("cache hit rate so far: %.3f\n", (cache->queries - cache->misses) / (float)cache->queries);
+
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, cache->stats);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+  {
+    const dt_dev_pixelpipe_cache_stats_t *stats = (dt_dev_pixelpipe_cache_stats_t *)value;
+    printf("  %-20s hit rate %.3f (%" PRIu64 " of %" PRIu64 "), saved %.2f MB and %.3f secs\n",
+           (const char *)key, stats->queries ? stats->hits / (float)stats->queries : 0.0f, stats->hits,
+           stats->queries, stats->bytes_saved / (1024.0 * 1024.0), stats->time_saved);
+  }
+}
+
+// header in front of every line of the shared cache, the pixels follow at
+// DT_DEV_PIXELPIPE_CACHE_LINE_OFFSET bytes.
+typedef struct dt_dev_pixelpipe_cache_line_t
+{
+  uint64_t hash;
+  size_t size;
+  dt_iop_buffer_dsc_t dsc;
+  float cost;
+} dt_dev_pixelpipe_cache_line_t;
+
+// rough estimate of memcpy() throughput in bytes per second
+#define DT_DEV_PIXELPIPE_CACHE_COPY_RATE (2.0f * 1024.0f * 1024.0f * 1024.0f)
+
+#define DT_DEV_PIXELPIPE_CACHE_LINE_OFFSET ((sizeof(dt_dev_pixelpipe_cache_line_t) + 63) & ~(size_t)63)
+
+static inline uint32_t _shared_key(const uint64_t hash)
+{
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static void _shared_allocate(void *data, dt_cache_entry_t *entry)
+{
+  // only the header for now, pixels are attached in dt_dev_pixelpipe_cache_shared_put()
+  entry->data_size = DT_DEV_PIXELPIPE_CACHE_LINE_OFFSET;
+  entry->data = dt_alloc_align(64, entry->data_size);
+  if(!entry->data)
+  {
+    fprintf(stderr, "[pixelpipe_cache] memory allocation failed!\n");
+    exit(1);
+  }
+  dt_dev_pixelpipe_cache_line_t *line = (dt_dev_pixelpipe_cache_line_t *)entry->data;
+  line->hash = -1;
+  line->size = 0;
+  entry->cost = entry->data_size;
+}
+
+static void _shared_deallocate(void *data, dt_cache_entry_t *entry)
+{
+  dt_free_align(entry->data);
+}
+
+static void _shared_copy(void *dst, const void *src, size_t size)
+{
+  // big buffers are copied in 1MB chunks, spread over all threads
+  size_t chunk = (size_t)1 << 20;
+  size_t chunks = (size + chunk - 1) / chunk;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) default(none) shared(dst, src, size, chunk, chunks) if(chunks > 4)
+#endif
+  for(size_t k = 0; k < chunks; k++)
+  {
+    const size_t offset = k * chunk;
+    memcpy((char *)dst + offset, (const char *)src + offset, MIN(chunk, size - offset));
+  }
+}
+
+void dt_dev_pixelpipe_cache_shared_init(dt_dev_pixelpipe_cache_shared_t *cache)
+{
+  const int64_t cache_memory = dt_conf_get_int64("pixelpipe_cache_memory");
+  const size_t max_mem = MAX(cache_memory, 0);
+
+  dt_cache_init(&cache->cache, 0, max_mem);
+  dt_cache_set_allocate_callback(&cache->cache, _shared_allocate, cache);
+  dt_cache_set_cleanup_callback(&cache->cache, _shared_deallocate, cache);
+  cache->max_line_size = max_mem / 4;
+
+  dt_pthread_mutex_init(&cache->generations_lock, NULL);
+  cache->generations = g_hash_table_new(NULL, NULL);
+  cache->stats_requests = 0;
+  cache->stats_hits = 0;
+  cache->stats_stores = 0;
+}
+
+void dt_dev_pixelpipe_cache_shared_cleanup(dt_dev_pixelpipe_cache_shared_t *cache)
+{
+  dt_cache_cleanup(&cache->cache);
+  g_hash_table_destroy(cache->generations);
+  dt_pthread_mutex_destroy(&cache->generations_lock);
+}
+
+void dt_dev_pixelpipe_cache_shared_invalidate(dt_dev_pixelpipe_cache_shared_t *cache, const int imgid)
+{
+  if(!cache) return;
+  dt_pthread_mutex_lock(&cache->generations_lock);
+  const int generation = GPOINTER_TO_INT(g_hash_table_lookup(cache->generations, GINT_TO_POINTER(imgid)));
+  g_hash_table_insert(cache->generations, GINT_TO_POINTER(imgid), GINT_TO_POINTER(generation + 1));
+  dt_pthread_mutex_unlock(&cache->generations_lock);
+}
+
+static inline uint64_t _shared_hash_bytes(uint64_t h, const void *data, const size_t size)
+{
+  const char *str = (const char *)data;
+  for(size_t i = 0; i < size; i++) h = ((h << 5) + h) ^ str[i];
+  return h;
+}
+
+// the same flags demosaic_qual_flags() in iop/demosaic.c ends up with: full scale (1), markesteijn for
+// x-trans (2) and medium quality (4).
+static int _shared_demosaic_quality(const dt_dev_pixelpipe_t *pipe, const dt_iop_roi_t *roi)
+{
+  int quality = 0;
+  if(pipe->type == DT_DEV_PIXELPIPE_FULL)
+  {
+    int qual = 1;
+    gchar *conf = dt_conf_get_string("plugins/darkroom/demosaic/quality");
+    if(conf && !strcmp(conf, "always bilinear (fast)"))
+      qual = 0;
+    else if(conf && !strcmp(conf, "full (possibly slow)"))
+      qual = 2;
+    g_free(conf);
+    if(qual > 0) quality |= 1;
+    if(qual > 1) quality |= 2;
+    if(qual < 2 && roi->scale <= .99999f) quality |= 4;
+  }
+  else if(pipe->type == DT_DEV_PIXELPIPE_EXPORT)
+    quality = 1 | 2;
+  else if(pipe->type == DT_DEV_PIXELPIPE_THUMBNAIL)
+  {
+    static const char *const levels[] = { "small", "VGA", "720p", "1080p", "WQXGA", "4k", "5K" };
+    const int level = dt_mipmap_cache_get_matching_size(darktable.mipmap_cache, roi->width, roi->height);
+    gchar *min = dt_conf_get_string("plugins/lighttable/thumbnail_hq_min_level");
+    int hq = min && !strcmp(min, "always");
+    for(size_t k = 0; min && k < sizeof(levels) / sizeof(levels[0]); k++)
+      if(!strcmp(min, levels[k])) hq = level > (int)k;
+    g_free(min);
+    if(hq) quality = 1 | 2;
+  }
+  return quality;
+}
+
+// colorout picks its output profile from outside of the history, see its commit_params()
+static uint64_t _shared_hash_profiles(uint64_t h, const dt_dev_pixelpipe_t *pipe)
+{
+  const dt_colorspaces_t *profiles = darktable.color_profiles;
+  if(pipe->type == DT_DEV_PIXELPIPE_EXPORT)
+  {
+    const int32_t over_type = dt_conf_get_int("plugins/lighttable/export/icctype");
+    const int32_t over_intent = dt_conf_get_int("plugins/lighttable/export/iccintent");
+    const int32_t force_lcms2 = dt_conf_get_bool("plugins/lighttable/export/force_lcms2");
+    gchar *over_filename = dt_conf_get_string("plugins/lighttable/export/iccprofile");
+    h = _shared_hash_bytes(h, &over_type, sizeof(over_type));
+    h = _shared_hash_bytes(h, &over_intent, sizeof(over_intent));
+    h = _shared_hash_bytes(h, &force_lcms2, sizeof(force_lcms2));
+    if(over_filename) h = _shared_hash_bytes(h, over_filename, strlen(over_filename));
+    g_free(over_filename);
+  }
+  else if(profiles)
+  {
+    const int32_t display_type = pipe->type == DT_DEV_PIXELPIPE_THUMBNAIL ? dt_mipmap_cache_get_colorspace()
+                                                                          : profiles->display_type;
+    h = _shared_hash_bytes(h, &display_type, sizeof(display_type));
+    h = _shared_hash_bytes(h, &profiles->display_intent, sizeof(profiles->display_intent));
+    h = _shared_hash_bytes(h, profiles->display_filename, strlen(profiles->display_filename));
+    if(pipe->type == DT_DEV_PIXELPIPE_FULL)
+    {
+      // softproof and gamut check
+      h = _shared_hash_bytes(h, &profiles->mode, sizeof(profiles->mode));
+      h = _shared_hash_bytes(h, &profiles->softproof_type, sizeof(profiles->softproof_type));
+      h = _shared_hash_bytes(h, &profiles->softproof_intent, sizeof(profiles->softproof_intent));
+      h = _shared_hash_bytes(h, profiles->softproof_filename, strlen(profiles->softproof_filename));
+    }
+  }
+  return h;
+}
+
+// modules which branch on the pipe type in their commit_params() or process() for more than gui data:
+// hot pixel marks, dithering and the naive bilateral path are left out in some pipes.
+static int _shared_depends_on_type(const char *op)
+{
+  static const char *const ops[] = { "hotpixels", "dither", "bilateral" };
+  for(size_t k = 0; k < sizeof(ops) / sizeof(ops[0]); k++)
+    if(!strcmp(op, ops[k])) return 1;
+  return 0;
+}
+
+static uint64_t _shared_hash_pipe(const uint64_t hash, const dt_dev_pixelpipe_t *pipe, const dt_iop_roi_t *roi,
+                                  const int module)
+{
+  // the input might be any of the mip sizes
+  uint64_t h = hash;
+  h = _shared_hash_bytes(h, &pipe->iwidth, sizeof(pipe->iwidth));
+  h = _shared_hash_bytes(h, &pipe->iheight, sizeof(pipe->iheight));
+  h = _shared_hash_bytes(h, &pipe->iscale, sizeof(pipe->iscale));
+
+  // same modules as in dt_dev_pixelpipe_cache_hash(). commit_params() disables some of them per pipe type
+  // (finalscale, the over exposure indicators), and a few others render differently for reasons which are
+  // not part of their params.
+  GList *pieces = pipe->nodes;
+  for(int k = 0; k < module && pieces; k++, pieces = g_list_next(pieces))
+  {
+    const dt_dev_pixelpipe_iop_t *piece = (const dt_dev_pixelpipe_iop_t *)pieces->data;
+    const int32_t enabled = piece->enabled;
+    h = _shared_hash_bytes(h, &enabled, sizeof(enabled));
+    if(!enabled) continue;
+
+    const char *op = piece->module->op;
+    if(!strcmp(op, "demosaic"))
+    {
+      const int32_t quality = _shared_demosaic_quality(pipe, roi);
+      h = _shared_hash_bytes(h, &quality, sizeof(quality));
+    }
+    else if(!strcmp(op, "colorout"))
+      h = _shared_hash_profiles(h, pipe);
+    else if(_shared_depends_on_type(op))
+    {
+      const int32_t type = pipe->type;
+      h = _shared_hash_bytes(h, &type, sizeof(type));
+    }
+  }
+  return h;
+}
+
+uint64_t dt_dev_pixelpipe_cache_shared_hash(const uint64_t hash, const dt_dev_pixelpipe_t *pipe,
+                                            const dt_iop_roi_t *roi, const int module)
+{
+  uint64_t h = _shared_hash_pipe(hash, pipe, roi, module);
+
+  // lines of this image stored before the last dt_dev_pixelpipe_cache_shared_invalidate() must not be found
+  // any more, even if they were locked at that time. they just age out of the cache.
+  dt_dev_pixelpipe_cache_shared_t *cache = darktable.pixelpipe_cache;
+  if(cache)
+  {
+    dt_pthread_mutex_lock(&cache->generations_lock);
+    const int32_t generation
+        = GPOINTER_TO_INT(g_hash_table_lookup(cache->generations, GINT_TO_POINTER(pipe->image.id)));
+    dt_pthread_mutex_unlock(&cache->generations_lock);
+    h = _shared_hash_bytes(h, &generation, sizeof(generation));
+  }
+  return h;
+}
+
+int dt_dev_pixelpipe_cache_shared_available(dt_dev_pixelpipe_cache_shared_t *cache, const uint64_t hash)
+{
+  if(!cache || !cache->max_line_size) return 0;
+  return dt_cache_contains(&cache->cache, _shared_key(hash));
+}
+
+int dt_dev_pixelpipe_cache_shared_get(dt_dev_pixelpipe_cache_shared_t *cache, const uint64_t hash,
+                                      const size_t size, void *data, dt_iop_buffer_dsc_t *dsc, float *cost)
+{
+  if(!cache || !cache->max_line_size) return 1;
+  __sync_fetch_and_add(&cache->stats_requests, 1);
+
+  // don't wait for writers, we can still compute the buffer ourselves
+  dt_cache_entry_t *entry = dt_cache_testget(&cache->cache, _shared_key(hash), 'r');
+  if(!entry) return 1;
+  ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
+
+  int miss = 1;
+  const dt_dev_pixelpipe_cache_line_t *line = (const dt_dev_pixelpipe_cache_line_t *)entry->data;
+  // the key is only 32 bits, so make sure this really is our buffer
+  if(line->hash == hash && line->size == size)
+  {
+    _shared_copy(data, (const char *)entry->data + DT_DEV_PIXELPIPE_CACHE_LINE_OFFSET, size);
+    *dsc = line->dsc;
+    if(cost) *cost = line->cost;
+    __sync_fetch_and_add(&cache->stats_hits, 1);
+    miss = 0;
+  }
+  dt_cache_release(&cache->cache, entry);
+  return miss;
+}
+
+void dt_dev_pixelpipe_cache_shared_put(dt_dev_pixelpipe_cache_shared_t *cache, const uint64_t hash,
+                                       const size_t size, const void *data, const dt_iop_buffer_dsc_t *dsc,
+                                       const float cost)
+{
+  if(!cache || !size || size > cache->max_line_size) return;
+  // copying in and out again would be slower than just running the module
+  if(cost * DT_DEV_PIXELPIPE_CACHE_COPY_RATE < 2.0f * size) return;
+
+  // a new line always comes back write locked
+  dt_cache_entry_t *entry = dt_cache_get(&cache->cache, _shared_key(hash), 'w');
+  ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
+  dt_dev_pixelpipe_cache_line_t *line = (dt_dev_pixelpipe_cache_line_t *)entry->data;
+  if(line->hash == hash && line->size == size)
+  {
+    // some other pipe was faster
+    dt_cache_release(&cache->cache, entry);
+    return;
+  }
+
+  const size_t data_size = DT_DEV_PIXELPIPE_CACHE_LINE_OFFSET + size;
+  if(entry->data_size < data_size)
+  {
+    void *buf = dt_alloc_align(64, data_size);
+    if(!buf)
+    {
+      line->hash = -1;
+      line->size = 0;
+      dt_cache_release(&cache->cache, entry);
+      return;
+    }
+    dt_free_align(entry->data);
+    entry->data = buf;
+    entry->data_size = data_size;
+    dt_cache_update_cost(&cache->cache, entry, data_size);
+    line = (dt_dev_pixelpipe_cache_line_t *)entry->data;
+  }
+
+  _shared_copy((char *)entry->data + DT_DEV_PIXELPIPE_CACHE_LINE_OFFSET, data, size);
+  line->dsc = *dsc;
+  line->cost = cost;
+  line->size = size;
+  line->hash = hash;
+  __sync_fetch_and_add(&cache->stats_stores, 1);
+  dt_cache_release(&cache->cache, entry);
+}
+
+void dt_dev_pixelpipe_cache_shared_print(dt_dev_pixelpipe_cache_shared_t *cache)
+{
+  if(!cache) return;
+  printf("[pixelpipe_cache] shared fill %.2f/%.2f MB (%.2f%%)\n", cache->cache.cost / (1024.0 * 1024.0),
+         cache->cache.cost_quota / (1024.0 * 1024.0),
+         cache->cache.cost_quota ? 100.0f * (float)cache->cache.cost / (float)cache->cache.cost_quota : 0.0f);
+  printf("[pixelpipe_cache] shared hit rate so far: %.3f (%ld of %ld), %ld buffers stored\n",
+         cache->stats_requests ? cache->stats_hits / (float)cache->stats_requests : 0.0f, cache->stats_hits,
+         cache->stats_requests, cache->stats_stores);
+}
+
+// header of the files written by dt_dev_pixelpipe_cache_disk_write(), the pixels follow
+// at DT_DEV_PIXELPIPE_CACHE_LINE_OFFSET bytes, just like in memory.
+typedef struct dt_dev_pixelpipe_cache_file_t
+{
+  char magic[8];
+  uint64_t version; // module params of other releases may hash the same but process differently
+  uint64_t hash;
+  uint64_t size;
+  dt_iop_buffer_dsc_t dsc;
+} dt_dev_pixelpipe_cache_file_t;
+
+static const char _disk_magic[8] = "DTPVW01";
+
+static uint64_t _disk_version(void)
+{
+  uint64_t hash = 5381;
+  for(const char *c = darktable_package_version; *c; c++) hash = ((hash << 5) + hash) ^ *c;
+  hash = ((hash << 5) + hash) ^ sizeof(dt_iop_buffer_dsc_t);
+  return hash;
+}
+
+static gboolean _disk_filename(const int imgid, char *filename, size_t size)
+{
+  if(!darktable.mipmap_cache || !darktable.mipmap_cache->cachedir[0]) return FALSE;
+  snprintf(filename, size, "%s.d/preview/%d.dtp", darktable.mipmap_cache->cachedir, imgid);
+  return TRUE;
+}
+
+void *dt_dev_pixelpipe_cache_disk_read(const int imgid, const uint64_t hash, size_t *size,
+                                       dt_iop_buffer_dsc_t *dsc)
+{
+  if(!dt_conf_get_bool("cache_disk_backend_preview")) return NULL;
+  char filename[PATH_MAX] = { 0 };
+  if(!_disk_filename(imgid, filename, sizeof(filename))) return NULL;
+
+  FILE *f = g_fopen(filename, "rb");
+  if(!f) return NULL;
+
+  void *data = NULL;
+  dt_dev_pixelpipe_cache_file_t header;
+  if(fread(&header, sizeof(header), 1, f) == 1 && !memcmp(header.magic, _disk_magic, sizeof(_disk_magic))
+     && header.version == _disk_version() && header.hash == hash && header.size > 0
+     && !fseek(f, DT_DEV_PIXELPIPE_CACHE_LINE_OFFSET, SEEK_SET))
+  {
+    data = dt_alloc_align(64, header.size);
+    if(data && fread(data, 1, header.size, f) == header.size)
+    {
+      *size = header.size;
+      *dsc = header.dsc;
+    }
+    else
+    {
+      dt_free_align(data);
+      data = NULL;
+    }
+  }
+  fclose(f);
+
+  dt_print(DT_DEBUG_CACHE, "[pixelpipe_cache] preview of image %d %s on disk\n", imgid,
+           data ? "found" : "not found");
+  return data;
+}
+
+void dt_dev_pixelpipe_cache_disk_write(const int imgid, const uint64_t hash, const size_t size, const void *data,
+                                       const dt_iop_buffer_dsc_t *dsc)
+{
+  if(!size || !dt_conf_get_bool("cache_disk_backend_preview")) return;
+  char filename[PATH_MAX] = { 0 };
+  if(!_disk_filename(imgid, filename, sizeof(filename))) return;
+
+  gchar *dirname = g_path_get_dirname(filename);
+  const int mkd = g_mkdir_with_parents(dirname, 0750);
+  g_free(dirname);
+  if(mkd) return;
+
+  // write to a temporary file first, so readers never see half a preview
+  gchar *tmpname = g_strdup_printf("%s.tmp", filename);
+  FILE *f = g_fopen(tmpname, "wb");
+  if(!f)
+  {
+    g_free(tmpname);
+    return;
+  }
+
+  dt_dev_pixelpipe_cache_file_t header = { { 0 } };
+  memcpy(header.magic, _disk_magic, sizeof(_disk_magic));
+  header.version = _disk_version();
+  header.hash = hash;
+  header.size = size;
+  header.dsc = *dsc;
+  char pad[DT_DEV_PIXELPIPE_CACHE_LINE_OFFSET] = { 0 };
+  memcpy(pad, &header, sizeof(header));
+
+  int err = fwrite(pad, sizeof(pad), 1, f) != 1 || fwrite(data, 1, size, f) != size;
+  err |= fclose(f) != 0;
+  if(err || g_rename(tmpname, filename))
+  {
+    fprintf(stderr, "[pixelpipe_cache] failed to write preview of image %d to `%s'\n", imgid, filename);
+    g_unlink(tmpname);
+  }
+  g_free(tmpname);
+}
+
+void dt_dev_pixelpipe_cache_disk_remove(const int imgid)
+{
+  // always try, in case the option was switched off in between
+  char filename[PATH_MAX] = { 0 };
+  if(_disk_filename(imgid, filename, sizeof(filename))) g_unlink(filename);
 }
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
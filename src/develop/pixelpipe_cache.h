@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include "common/cache.h"
+
 #include <inttypes.h>
 
 struct dt_dev_pixelpipe_t;
@@ -28,8 +30,20 @@ struct dt_iop_roi_t;
  * implements a simple pixel cache suitable for caching float images
  * corresponding to history items and zoom/pan settings in the develop module.
  * it is optimized for very few entries (~5), so most operations are O(N).
+ * every line remembers how long it took to compute, and eviction prefers the lines
+ * which are cheapest to recompute per byte, so expensive early stages (demosaic,
+ * denoise) survive slider drags on modules late in the pipe.
  */
 
+/** per module usage statistics, see dt_dev_pixelpipe_cache_set_cost(). */
+typedef struct dt_dev_pixelpipe_cache_stats_t
+{
+  uint64_t queries;     // number of times the output of this module was requested
+  uint64_t hits;        // .. and served from the cache
+  uint64_t bytes_saved; // size of the buffers we didn't have to compute
+  double time_saved;    // time in seconds it took to compute these
+} dt_dev_pixelpipe_cache_stats_t;
+
 typedef struct dt_dev_pixelpipe_cache_t
 {
   int32_t entries;
@@ -38,12 +52,15 @@ typedef struct dt_dev_pixelpipe_cache_t
   struct dt_iop_buffer_dsc_t *dsc;
   uint64_t *hash;
   int32_t *used;
+  float *cost; // wall time in seconds it took to compute the line
+  char **op;   // module which produced the line, for the stats
 #ifdef HAVE_OPENCL
   void **gpu_mem;
 #endif
   // profiling:
   uint64_t queries;
   uint64_t misses;
+  GHashTable *stats; // module op -> dt_dev_pixelpipe_cache_stats_t
 } dt_dev_pixelpipe_cache_t;
 
 /** constructs a new cache with given cache line count (entries) and float buffer entry size in bytes.
@@ -75,12 +92,92 @@ void dt_dev_pixelpipe_cache_flush(dt_dev_pixelpipe_cache_t *cache);
 /** makes this buffer very important after it has been pulled from the cache. */
 void dt_dev_pixelpipe_cache_reweight(dt_dev_pixelpipe_cache_t *cache, void *data);
 
+/** records that the given cache line was computed by module op in cost seconds. */
+void dt_dev_pixelpipe_cache_set_cost(dt_dev_pixelpipe_cache_t *cache, void *data, const char *op, const float cost);
+
+/** returns the usage statistics of module op, or NULL if it didn't produce any cache line yet. */
+const dt_dev_pixelpipe_cache_stats_t *dt_dev_pixelpipe_cache_get_stats(dt_dev_pixelpipe_cache_t *cache,
+                                                                       const char *op);
+
 /** mark the given cache line pointer as invalid. */
 void dt_dev_pixelpipe_cache_invalidate(dt_dev_pixelpipe_cache_t *cache, void *data);
 
 /** print out cache lines/hashes (debug). */
 void dt_dev_pixelpipe_cache_print(dt_dev_pixelpipe_cache_t *cache);
 
+/**
+ * global store of intermediate module outputs, shared between all pixelpipes
+ * (darkroom, preview, thumbnail and export). it is built on top of dt_cache_t like
+ * the mipmap cache, so lines are read/write locked and the total size is bounded
+ * by a memory quota (pixelpipe_cache_memory). lines are keyed by
+ * dt_dev_pixelpipe_cache_shared_hash(), so pipes of any type find each other's buffers as long as
+ * nothing outside of the history makes the modules render differently.
+ * the per-pipe cache above still provides the working buffers. on a local miss a
+ * pipe looks into the shared cache and copies the buffer over, and after processing
+ * a module on the cpu it publishes a copy of the output.
+ */
+typedef struct dt_dev_pixelpipe_cache_shared_t
+{
+  dt_cache_t cache;
+  // largest single buffer we accept, so one line can't flush everything else
+  size_t max_line_size;
+  // imgid -> number of dt_dev_pixelpipe_cache_shared_invalidate() calls, part of every line's hash
+  GHashTable *generations;
+  dt_pthread_mutex_t generations_lock;
+
+  // a few stats on usage in this run.
+  // long int to give 32-bits on old archs, so __sync* calls will work.
+  long int stats_requests;
+  long int stats_hits;
+  long int stats_stores;
+} dt_dev_pixelpipe_cache_shared_t;
+
+void dt_dev_pixelpipe_cache_shared_init(dt_dev_pixelpipe_cache_shared_t *cache);
+void dt_dev_pixelpipe_cache_shared_cleanup(dt_dev_pixelpipe_cache_shared_t *cache);
+
+/** hides all lines of imgid, called whenever a pipe's own cache is obsoleted because of state outside of
+  * the history. other images keep theirs. */
+void dt_dev_pixelpipe_cache_shared_invalidate(dt_dev_pixelpipe_cache_shared_t *cache, const int imgid);
+
+/** extends a hash from dt_dev_pixelpipe_cache_hash(imgid, roi, pipe, module) by everything that differs
+  * between pipes processing the same history up to that module: the input buffer dimensions, the demosaic
+  * quality, the output, display and softproof profiles and which modules the pipe disabled. */
+uint64_t dt_dev_pixelpipe_cache_shared_hash(const uint64_t hash, const struct dt_dev_pixelpipe_t *pipe,
+                                            const struct dt_iop_roi_t *roi, const int module);
+
+/** 0: not contained. does not lock the cache line. */
+int dt_dev_pixelpipe_cache_shared_available(dt_dev_pixelpipe_cache_shared_t *cache, const uint64_t hash);
+
+/** copies the buffer for the given hash to data, its format to dsc and the time it took to compute to cost.
+  * returns 0 on success, non-zero if the buffer is not (or no longer) cached or has a different size. */
+int dt_dev_pixelpipe_cache_shared_get(dt_dev_pixelpipe_cache_shared_t *cache, const uint64_t hash,
+                                      const size_t size, void *data, struct dt_iop_buffer_dsc_t *dsc,
+                                      float *cost);
+
+/** stores a copy of the given buffer under hash, evicting old lines if the quota is exceeded.
+  * buffers which took less than cost seconds to compute than it takes to copy them are not stored. */
+void dt_dev_pixelpipe_cache_shared_put(dt_dev_pixelpipe_cache_shared_t *cache, const uint64_t hash,
+                                       const size_t size, const void *data,
+                                       const struct dt_iop_buffer_dsc_t *dsc, const float cost);
+
+/** print out fill state and hit rate (debug). */
+void dt_dev_pixelpipe_cache_shared_print(dt_dev_pixelpipe_cache_shared_t *cache);
+
+/**
+ * optional persistent store of the last preview pipe output per image (cache_disk_backend_preview),
+ * in <cachedir>.d/preview/<imgid>.dtp. the file remembers the hash it was written for, which covers the
+ * whole history, the profiles and the contents of the display profile, so a stale file is never used. it
+ * is removed together with the thumbnails in dt_mipmap_cache_remove(), which runs on every history write.
+ * it is only looked at in the first preview run after an image got loaded.
+ */
+/** returns the stored output of imgid if it was written for hash, or NULL. free with dt_free_align(). */
+void *dt_dev_pixelpipe_cache_disk_read(const int imgid, const uint64_t hash, size_t *size,
+                                       struct dt_iop_buffer_dsc_t *dsc);
+/** replaces the stored output of imgid. */
+void dt_dev_pixelpipe_cache_disk_write(const int imgid, const uint64_t hash, const size_t size, const void *data,
+                                       const struct dt_iop_buffer_dsc_t *dsc);
+void dt_dev_pixelpipe_cache_disk_remove(const int imgid);
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -28,6 +28,7 @@
 #include "develop/format.h"
 #include "develop/imageop_math.h"
 #include "develop/pixelpipe.h"
+#include "develop/pixelpipe_profile.h"
 #include "develop/tiling.h"
 #include "gui/gtk.h"
 #include "libs/colorpicker.h"
@@ -140,10 +141,17 @@ int dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe, size_t size, int32_t
   if(!dt_dev_pixelpipe_cache_init(&(pipe->cache), entries, pipe->backbuf_size)) return 0;
   pipe->cache_obsolete = 0;
   pipe->backbuf = NULL;
+  pipe->backbuf_disk_hash = 0;
+  pipe->load_from_disk = 0;
+  pipe->profile = NULL;
   pipe->processing = 0;
   pipe->shutdown = 0;
   pipe->opencl_error = 0;
   pipe->tiling = 0;
+  pipe->bands = dt_conf_get_bool("pixelpipe_bands");
+  pipe->tiled_backbuf = NULL;
+  pipe->bands_buf[0] = pipe->bands_buf[1] = NULL;
+  pipe->bands_buf_size = 0;
   pipe->mask_display = DT_DEV_PIXELPIPE_DISPLAY_NONE;
   pipe->input_timestamp = 0;
   pipe->levels = IMAGEIO_RGB | IMAGEIO_INT8;
@@ -171,6 +179,14 @@ void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
   dt_dev_pixelpipe_cleanup_nodes(pipe);
   // so now it's safe to clean up cache:
   dt_dev_pixelpipe_cache_cleanup(&(pipe->cache));
+  if(pipe->profile) g_array_free(pipe->profile, TRUE);
+  pipe->profile = NULL;
+  if(pipe->tiled_backbuf) dt_free_align(pipe->tiled_backbuf);
+  pipe->tiled_backbuf = NULL;
+  dt_free_align(pipe->bands_buf[0]);
+  dt_free_align(pipe->bands_buf[1]);
+  pipe->bands_buf[0] = pipe->bands_buf[1] = NULL;
+  pipe->bands_buf_size = 0;
   dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
   dt_pthread_mutex_destroy(&(pipe->backbuf_mutex));
   dt_pthread_mutex_destroy(&(pipe->busy_mutex));
@@ -231,6 +247,7 @@ void dt_dev_pixelpipe_create_nodes(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev)
       piece->hash = 0;
       piece->process_cl_ready = 0;
       piece->process_tiling_ready = 0;
+      piece->process_bands_ready = 0;
       dt_iop_init_pipe(piece->module, pipe, piece);
       pipe->nodes = g_list_append(pipe->nodes, piece);
     }
@@ -560,6 +577,192 @@ error:
 #endif
 
 
+// is this piece skipped in the pipe?
+static inline int _skip_piece(dt_develop_t *dev, dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece)
+{
+  return !piece->enabled
+         || (dev->gui_module && dev->gui_module->operation_tags_filter() & module->operation_tags());
+}
+
+// row bands are only used where intermediate buffers are not worth keeping, and everything runs on the cpu.
+static int _pipe_bands_ready(dt_dev_pixelpipe_t *pipe)
+{
+  if(!pipe->bands || !(pipe->type & (DT_DEV_PIXELPIPE_EXPORT | DT_DEV_PIXELPIPE_THUMBNAIL))
+     || (pipe->mask_display & DT_DEV_PIXELPIPE_DISPLAY_ANY))
+    return 0;
+#ifdef HAVE_OPENCL
+  if(dt_opencl_is_inited() && pipe->opencl_enabled && pipe->devid >= 0) return 0;
+#endif
+  return 1;
+}
+
+// can this piece run on row bands? it has to be point-wise, and nothing else may need its whole input or
+// output: no blending, histogram or color picker, and the same roi in and out.
+static int _piece_bands_ready(dt_develop_t *dev, dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece,
+                              const dt_iop_roi_t *roi)
+{
+  if(!(module->flags() & IOP_FLAGS_POINTWISE) || !piece->process_bands_ready) return 0;
+  if(piece->request_histogram & DT_REQUEST_ON) return 0;
+  if(module == dev->gui_module && module->request_color_pick != DT_REQUEST_COLORPICK_OFF) return 0;
+  const dt_develop_blend_params_t *const bp = (const dt_develop_blend_params_t *)piece->blendop_data;
+  if(bp && (bp->mask_mode & DEVELOP_MASK_ENABLED)) return 0;
+
+  dt_iop_roi_t roi_in = *roi;
+  module->modify_roi_in(module, piece, roi, &roi_in);
+  return !memcmp(&roi_in, roi, sizeof(dt_iop_roi_t));
+}
+
+// number of rows per band: about 256k per thread for each band buffer, pixels have at most 4 floats
+static inline int _pixelpipe_band_rows(const dt_iop_roi_t *roi)
+{
+  const size_t row_size = (size_t)4 * sizeof(float) * roi->width;
+  return CLAMPS((int)(((size_t)256 << 10) * dt_get_num_threads() / row_size), dt_get_num_threads(),
+                roi->height);
+}
+
+// makes sure the band buffers of the pipe hold at least size bytes. returns 0 if they could not be allocated.
+static int _pixelpipe_bands_alloc(dt_dev_pixelpipe_t *pipe, const size_t size)
+{
+  if(size <= pipe->bands_buf_size) return 1;
+  dt_free_align(pipe->bands_buf[0]);
+  dt_free_align(pipe->bands_buf[1]);
+  pipe->bands_buf[0] = dt_alloc_align(64, size);
+  pipe->bands_buf[1] = dt_alloc_align(64, size);
+  if(!pipe->bands_buf[0] || !pipe->bands_buf[1])
+  {
+    dt_free_align(pipe->bands_buf[0]);
+    dt_free_align(pipe->bands_buf[1]);
+    pipe->bands_buf[0] = pipe->bands_buf[1] = NULL;
+    pipe->bands_buf_size = 0;
+    return 0;
+  }
+  pipe->bands_buf_size = size;
+  return 1;
+}
+
+// collects the point-wise modules right before the one at pos+1 which can run together with it, starting
+// at *modules/*pieces (the module at pos). these are moved to the module before the first one, which provides
+// the input then. returns how many were collected, 0 also if there is no memory for the band buffers, so all
+// modules get processed one by one.
+static int _pixelpipe_bands_chain(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, const dt_iop_roi_t *roi,
+                                  GList **modules, GList **pieces, int *pos)
+{
+  int count = 0;
+  GList *const modules_start = *modules, *const pieces_start = *pieces;
+  const int pos_start = *pos;
+  GList *m = *modules, *p = *pieces;
+  for(int k = *pos; m; k--, m = g_list_previous(m), p = g_list_previous(p))
+  {
+    dt_iop_module_t *module = (dt_iop_module_t *)m->data;
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)p->data;
+    if(_skip_piece(dev, module, piece)) continue;
+    if(!_piece_bands_ready(dev, module, piece, roi)) break;
+
+    // no need to compute buffers again which are cached already
+    const uint64_t hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, roi, pipe, k);
+    if(dt_dev_pixelpipe_cache_available(&(pipe->cache), hash)
+       || dt_dev_pixelpipe_cache_shared_available(darktable.pixelpipe_cache,
+                                                  dt_dev_pixelpipe_cache_shared_hash(hash, pipe, roi, k)))
+      break;
+
+    count++;
+    *modules = g_list_previous(m);
+    *pieces = g_list_previous(p);
+    *pos = k - 1;
+  }
+
+  if(count
+     && !_pixelpipe_bands_alloc(pipe, (size_t)4 * sizeof(float) * roi->width * _pixelpipe_band_rows(roi)))
+  {
+    *modules = modules_start;
+    *pieces = pieces_start;
+    *pos = pos_start;
+    return 0;
+  }
+  return count;
+}
+
+// runs the last count point-wise modules before the one in modules, and that one, on bands of rows which
+// stay in the cpu caches. only the last module writes a full buffer, the others write to the two band
+// buffers of the pipe in turn, see _pixelpipe_bands_chain(). every module of the chain is recorded in the
+// profile with the time it took over all bands. called with busy_mutex locked, like process().
+static void _pixelpipe_process_bands(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, GList *modules, GList *pieces,
+                                     const int count, const void *const input,
+                                     const dt_iop_buffer_dsc_t *const input_format, void *const output,
+                                     const dt_iop_roi_t *const roi)
+{
+  const int n = count + 1;
+  dt_iop_module_t **chain_modules = g_malloc_n(n, sizeof(dt_iop_module_t *));
+  dt_dev_pixelpipe_iop_t **chain_pieces = g_malloc_n(n, sizeof(dt_dev_pixelpipe_iop_t *));
+  dt_iop_buffer_dsc_t *chain_dsc = g_malloc_n(n, sizeof(dt_iop_buffer_dsc_t));
+  double *chain_time = g_malloc0_n(n, sizeof(double));
+  for(int k = n - 1; k >= 0; modules = g_list_previous(modules), pieces = g_list_previous(pieces))
+  {
+    if(_skip_piece(dev, (dt_iop_module_t *)modules->data, (dt_dev_pixelpipe_iop_t *)pieces->data)) continue;
+    chain_modules[k] = (dt_iop_module_t *)modules->data;
+    chain_pieces[k] = (dt_dev_pixelpipe_iop_t *)pieces->data;
+    k--;
+  }
+
+  const int band = _pixelpipe_band_rows(roi);
+  void *const *const buf = pipe->bands_buf;
+
+  const double start = dt_get_wtime();
+  dt_iop_buffer_dsc_t dsc = *input_format;
+  for(int y = 0; y < roi->height && !pipe->shutdown; y += band)
+  {
+    dt_iop_roi_t roi_band = *roi;
+    roi_band.y += y;
+    roi_band.height = MIN(band, roi->height - y);
+
+    const void *in = (const char *)input + dt_iop_buffer_dsc_to_bpp(input_format) * roi->width * y;
+    for(int k = 0; k < n; k++)
+    {
+      dt_iop_module_t *module = chain_modules[k];
+      dt_dev_pixelpipe_iop_t *piece = chain_pieces[k];
+      // the formats are set up as for a whole buffer on the first band. modules may change pipe->dsc in
+      // process(), so it is reset for every band, like for tiles.
+      if(y == 0)
+      {
+        piece->dsc_out = piece->dsc_in = dsc;
+        module->output_format(module, pipe, piece, &piece->dsc_out);
+        chain_dsc[k] = pipe->dsc = piece->dsc_out;
+      }
+      else
+        pipe->dsc = chain_dsc[k];
+
+      void *out = k == n - 1 ? (char *)output + dt_iop_buffer_dsc_to_bpp(&chain_dsc[k]) * roi->width * y
+                             : buf[k & 1];
+      const double module_start = dt_get_wtime();
+      module->process(module, piece, in, out, &roi_band, &roi_band);
+      chain_time[k] += dt_get_wtime() - module_start;
+      if(y == 0) dsc = piece->dsc_out = pipe->dsc;
+      in = out;
+    }
+  }
+  pipe->dsc = chain_pieces[n - 1]->dsc_out;
+
+  // lay the modules out one after the other, as if they had run on the whole buffer
+  double module_start = start;
+  for(int k = 0; k < n; k++)
+  {
+    dt_dev_pixelpipe_profile_add_duration(pipe, chain_modules[k], module_start, chain_time[k],
+                                          DT_DEV_PIXELPIPE_PROFILE_CACHE_MISS, 0, 0,
+                                          dt_iop_buffer_dsc_to_bpp(&chain_dsc[k]) * roi->width * roi->height,
+                                          roi->width, roi->height);
+    module_start += chain_time[k];
+  }
+
+  dt_print(DT_DEBUG_DEV,
+           "[dev_pixelpipe] processed `%s' together with %d modules before it in bands of %d rows [%s]\n",
+           chain_modules[n - 1]->op, count, band, _pipe_type_to_str(pipe->type));
+
+  g_free(chain_modules);
+  g_free(chain_pieces);
+  g_free(chain_dsc);
+  g_free(chain_time);
+}
+
 // recursive helper for process:
 static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, void **output,
                                         void **cl_mem_output, dt_iop_buffer_dsc_t **out_format,
@@ -578,8 +781,7 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
     module = (dt_iop_module_t *)modules->data;
     piece = (dt_dev_pixelpipe_iop_t *)pieces->data;
     // skip this module?
-    if(!piece->enabled
-       || (dev->gui_module && dev->gui_module->operation_tags_filter() & module->operation_tags()))
+    if(_skip_piece(dev, module, piece))
       return dt_dev_pixelpipe_process_rec(pipe, dev, output, cl_mem_output, out_format, &roi_in,
                                           g_list_previous(modules), g_list_previous(pieces), pos - 1);
   }
@@ -605,6 +807,8 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
     (void)dt_dev_pixelpipe_cache_get(&(pipe->cache), hash, bufsize, output, out_format);
 
     dt_pthread_mutex_unlock(&pipe->busy_mutex);
+    dt_dev_pixelpipe_profile_add(pipe, module, dt_get_wtime(), DT_DEV_PIXELPIPE_PROFILE_CACHE_HIT, 0, 0, bufsize,
+                                 roi_out->width, roi_out->height);
     if(!modules) return 0;
     // go to post-collect directly:
     goto post_process_collect_info;
@@ -620,6 +824,40 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
   if(pipe == dev->preview_pipe && dev->preview_loading) return 1;
   if(dev->gui_leaving) return 1;
 
+  // 2b) maybe another pipe already computed this buffer for the same history.
+  // modules collecting histograms or picking colors need to see the data, so they are always processed.
+  const uint64_t shared_hash = dt_dev_pixelpipe_cache_shared_hash(hash, pipe, roi_out, pos);
+  if(modules && !(piece->request_histogram & DT_REQUEST_ON)
+     && !(module == dev->gui_module && module->request_color_pick != DT_REQUEST_COLORPICK_OFF)
+     && !(pipe->mask_display & DT_DEV_PIXELPIPE_DISPLAY_ANY)
+     && dt_dev_pixelpipe_cache_shared_available(darktable.pixelpipe_cache, shared_hash))
+  {
+    const double shared_start = dt_get_wtime();
+    dt_pthread_mutex_lock(&pipe->busy_mutex);
+    if(pipe->shutdown)
+    {
+      dt_pthread_mutex_unlock(&pipe->busy_mutex);
+      return 1;
+    }
+    (void)dt_dev_pixelpipe_cache_get(&(pipe->cache), hash, bufsize, output, out_format);
+    float shared_cost = 0.0f;
+    if(!dt_dev_pixelpipe_cache_shared_get(darktable.pixelpipe_cache, shared_hash, bufsize, *output, *out_format,
+                                          &shared_cost))
+    {
+      dt_print(DT_DEBUG_DEV, "[dev_pixelpipe] reusing shared buffer of `%s' [%s]\n", module_name,
+               _pipe_type_to_str(pipe->type));
+      // keep the line as expensive as it was for the pipe which computed it
+      dt_dev_pixelpipe_cache_set_cost(&(pipe->cache), *output, module->op, shared_cost);
+      dt_pthread_mutex_unlock(&pipe->busy_mutex);
+      dt_dev_pixelpipe_profile_add(pipe, module, shared_start, DT_DEV_PIXELPIPE_PROFILE_CACHE_SHARED, 0, 0,
+                                   bufsize, roi_out->width, roi_out->height);
+      goto post_process_collect_info;
+    }
+    // got evicted in between, compute it ourselves
+    dt_dev_pixelpipe_cache_invalidate(&(pipe->cache), *output);
+    dt_pthread_mutex_unlock(&pipe->busy_mutex);
+  }
+
 
   // 3) input -> output
   if(!modules)
@@ -675,8 +913,16 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
       // else found in cache.
     }
 
+    if(*output != pipe->input)
+    {
+      dt_times_t end;
+      dt_get_times(&end);
+      dt_dev_pixelpipe_cache_set_cost(&(pipe->cache), *output, "(input)", end.clock - start.clock);
+    }
     dt_show_times(&start, "[dev_pixelpipe]", "initing base buffer [%s]", _pipe_type_to_str(pipe->type));
     dt_pthread_mutex_unlock(&pipe->busy_mutex);
+    dt_dev_pixelpipe_profile_add(pipe, NULL, start.clock, DT_DEV_PIXELPIPE_PROFILE_CACHE_MISS, 0, 0,
+                                 *output != pipe->input ? bufsize : 0, roi_out->width, roi_out->height);
   }
   else
   {
@@ -690,6 +936,14 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
       return 1;
     }
     module->modify_roi_in(module, piece, roi_out, &roi_in);
+
+    // point-wise modules right before this one run together with it in row bands, without full buffers
+    // in between. the input is the one of the first of them then.
+    GList *input_modules = g_list_previous(modules), *input_pieces = g_list_previous(pieces);
+    int input_pos = pos - 1;
+    const int bands = (_pipe_bands_ready(pipe) && _piece_bands_ready(dev, module, piece, roi_out))
+                          ? _pixelpipe_bands_chain(pipe, dev, roi_out, &input_modules, &input_pieces, &input_pos)
+                          : 0;
     dt_pthread_mutex_unlock(&pipe->busy_mutex);
 
     // recurse to get actual data of input buffer
@@ -699,8 +953,8 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
 
     piece = (dt_dev_pixelpipe_iop_t *)pieces->data;
 
-    if(dt_dev_pixelpipe_process_rec(pipe, dev, &input, &cl_mem_input, &input_format, &roi_in,
-                                    g_list_previous(modules), g_list_previous(pieces), pos - 1))
+    if(dt_dev_pixelpipe_process_rec(pipe, dev, &input, &cl_mem_input, &input_format, &roi_in, input_modules,
+                                    input_pieces, input_pos))
       return 1;
 
     const size_t in_bpp = dt_iop_buffer_dsc_to_bpp(input_format);
@@ -1512,11 +1766,17 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
         return 1;
       }
 
-      /* process module on cpu. use tiling if needed and possible. */
-      if(piece->process_tiling_ready
-         && !dt_tiling_piece_fits_host_memory(MAX(roi_in.width, roi_out->width),
-                                              MAX(roi_in.height, roi_out->height), MAX(in_bpp, bpp),
-                                              tiling.factor, tiling.overhead))
+      /* process module on cpu. use row bands or tiling if needed and possible. */
+      if(bands)
+      {
+        _pixelpipe_process_bands(pipe, dev, modules, pieces, bands, input, input_format, *output, roi_out);
+        pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU);
+        pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_GPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
+      }
+      else if(piece->process_tiling_ready
+              && !dt_tiling_piece_fits_host_memory(MAX(roi_in.width, roi_out->width),
+                                                   MAX(roi_in.height, roi_out->height), MAX(in_bpp, bpp),
+                                                   tiling.factor, tiling.overhead))
       {
         module->process_tiling(module, piece, input, *output, &roi_in, roi_out, in_bpp);
         pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
@@ -1597,11 +1857,17 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
       return 1;
     }
 
-    /* process module on cpu. use tiling if needed and possible. */
-    if(piece->process_tiling_ready
-       && !dt_tiling_piece_fits_host_memory(MAX(roi_in.width, roi_out->width),
-                                            MAX(roi_in.height, roi_out->height), MAX(in_bpp, bpp),
-                                            tiling.factor, tiling.overhead))
+    /* process module on cpu. use row bands or tiling if needed and possible. */
+    if(bands)
+    {
+      _pixelpipe_process_bands(pipe, dev, modules, pieces, bands, input, input_format, *output, roi_out);
+      pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU);
+      pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_GPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
+    }
+    else if(piece->process_tiling_ready
+            && !dt_tiling_piece_fits_host_memory(MAX(roi_in.width, roi_out->width),
+                                                 MAX(roi_in.height, roi_out->height), MAX(in_bpp, bpp),
+                                                 tiling.factor, tiling.overhead))
     {
       module->process_tiling(module, piece, input, *output, &roi_in, roi_out, in_bpp);
       pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
@@ -1679,6 +1945,23 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
     // in case we get this buffer from the cache in the future, cache some stuff:
     **out_format = piece->dsc_out = pipe->dsc;
 
+    // remember what it cost us, so eviction can keep the expensive buffers.
+    dt_times_t end;
+    dt_get_times(&end);
+    const float cost = end.clock - start.clock;
+    dt_dev_pixelpipe_cache_set_cost(&(pipe->cache), *output, module->op, cost);
+    // a band chain has recorded all its modules already
+    if(!bands)
+      dt_dev_pixelpipe_profile_add(pipe, module, start.clock, DT_DEV_PIXELPIPE_PROFILE_CACHE_MISS,
+                                   (pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_ON_GPU) != 0,
+                                   (pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_WITH_TILING) != 0, bufsize,
+                                   roi_out->width, roi_out->height);
+
+    // and let other pipes have it, too. buffers which only live on the gpu are not shared.
+    if(*cl_mem_output == NULL && !(pipe->mask_display & DT_DEV_PIXELPIPE_DISPLAY_ANY))
+      dt_dev_pixelpipe_cache_shared_put(darktable.pixelpipe_cache, shared_hash, bufsize, *output, *out_format,
+                                        cost);
+
     dt_pthread_mutex_unlock(&pipe->busy_mutex);
     if(module == darktable.develop->gui_module)
     {
@@ -2151,6 +2434,198 @@ int dt_dev_pixelpipe_process_no_gamma(dt_dev_pixelpipe_t *pipe, dt_develop_t *de
   return ret;
 }
 
+// walks the rois back from roi through all modules, like process_rec() does. gives the size of the largest
+// buffer any of them works on and the overlap they and their mask blur need around a tile all together, in
+// pixels of roi. returns 0 if one of the modules can't be processed in tiles, or needs the whole image for its
+// histogram.
+static int _pixelpipe_tiling_requirements(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, const dt_iop_roi_t *roi,
+                                          size_t *max_bytes, int *overlap)
+{
+  dt_iop_roi_t roi_out = *roi;
+  float total_overlap = 0.0f;
+  // 4 floats per pixel after demosaic, raw data before
+  size_t bpp = 4 * sizeof(float);
+  *max_bytes = (size_t)roi->width * roi->height * bpp;
+
+  GList *modules = g_list_last(dev->iop);
+  GList *pieces = g_list_last(pipe->nodes);
+  for(; modules && pieces; modules = g_list_previous(modules), pieces = g_list_previous(pieces))
+  {
+    dt_iop_module_t *module = (dt_iop_module_t *)modules->data;
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)pieces->data;
+    if(_skip_piece(dev, module, piece)) continue;
+
+    // point-wise modules don't care about tiles, even if they don't tile by themselves. gamma converts every
+    // pixel on its own, too, but writes packed 8-bit pixels its dsc doesn't tell about, so it can't be
+    // flagged point-wise for row bands.
+    const int tiling_ready = (module->flags() & IOP_FLAGS_ALLOW_TILING) && piece->process_tiling_ready;
+    const int pointwise = ((module->flags() & IOP_FLAGS_POINTWISE) && piece->process_bands_ready)
+                          || !strcmp(module->op, "gamma");
+    if(!(tiling_ready || pointwise) || (piece->request_histogram & DT_REQUEST_ON))
+    {
+      dt_print(DT_DEBUG_DEV, "[pixelpipe_process_tiled] module `%s' can't be processed in tiles\n", module->op);
+      return 0;
+    }
+
+    dt_iop_roi_t roi_in = roi_out;
+    module->modify_roi_in(module, piece, &roi_out, &roi_in);
+
+    dt_develop_tiling_t tiling = { 0 };
+    module->tiling_callback(module, piece, &roi_in, &roi_out, &tiling);
+    // the overlap is in pixels of the module's input
+    total_overlap += tiling.overlap * roi->scale / roi_in.scale;
+
+    // a blurred blend mask reaches as far as its gaussian, see dt_develop_blend_process(). the blur is done
+    // on the module's output.
+    const dt_develop_blend_params_t *const bp = (const dt_develop_blend_params_t *)piece->blendop_data;
+    if(bp && (bp->mask_mode & DEVELOP_MASK_ENABLED) && bp->radius > 0.1f)
+    {
+      const float sigma = bp->radius * roi_out.scale / piece->iscale;
+      total_overlap += ceilf(4 * sigma) * roi->scale / roi_out.scale;
+    }
+
+    if(!strcmp(module->op, "demosaic")) bpp = pipe->image.buf_dsc.channels * sizeof(float);
+    *max_bytes = MAX(*max_bytes, (size_t)roi_in.width * roi_in.height * bpp);
+    roi_out = roi_in;
+  }
+
+  *overlap = ceilf(total_overlap);
+  return 1;
+}
+
+// gamma writes packed 8-bit rgba, while the dsc of the pipe output still tells 4 floats
+static int _pixelpipe_gamma_enabled(const dt_dev_pixelpipe_t *pipe)
+{
+  for(const GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    const dt_dev_pixelpipe_iop_t *piece = (const dt_dev_pixelpipe_iop_t *)nodes->data;
+    if(!strcmp(piece->module->op, "gamma")) return piece->enabled;
+  }
+  return 0;
+}
+
+#ifdef _DEBUG
+// runs the pipe once more without tiles and reports how far the stitched 8-bit output is off
+static void _pixelpipe_check_tiled(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, const int width,
+                                   const int height, const float scale, const uint8_t *const tiled)
+{
+  if(dt_dev_pixelpipe_process(pipe, dev, 0, 0, width, height, scale)) return;
+  int max_diff = 0;
+  size_t count = 0;
+  dt_pthread_mutex_lock(&pipe->backbuf_mutex);
+  const uint8_t *const untiled = pipe->backbuf;
+  for(size_t k = 0; untiled && k < (size_t)4 * width * height; k++)
+  {
+    const int diff = abs((int)tiled[k] - (int)untiled[k]);
+    max_diff = MAX(max_diff, diff);
+    if(diff > 1) count++;
+  }
+  dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
+  if(count)
+    fprintf(stderr, "[pixelpipe_process_tiled] tiled output differs from the untiled one: %zu values off by "
+                    "more than 1, at most %d\n", count, max_diff);
+}
+#endif
+
+int dt_dev_pixelpipe_process_tiled(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int width, int height,
+                                   float scale, int no_gamma)
+{
+  // a module has its input, output and some temporary memory at the same time
+  const float factor = 3.0f;
+
+  const dt_iop_roi_t roi = (dt_iop_roi_t){ 0, 0, width, height, scale };
+  size_t max_bytes = 0;
+  int overlap = 0;
+  if(!dt_conf_get_bool("pixelpipe_export_tiling")
+     || !_pixelpipe_tiling_requirements(pipe, dev, &roi, &max_bytes, &overlap)
+     || dt_tiling_piece_fits_host_memory(max_bytes, 1, 1, factor, 0))
+    goto untiled;
+
+  // shrink the tiles by the ratio of the largest buffer to what fits, the good part of a tile has to be
+  // larger than the overlap on both sides.
+  const float available = dt_conf_get_int("host_memory_limit") * 1024.0f * 1024.0f / factor;
+  const float shrink = sqrtf(fminf(available / max_bytes, 1.0f));
+  const int tile_wd = (int)(width * shrink) - 2 * overlap;
+  const int tile_ht = (int)(height * shrink) - 2 * overlap;
+  if(tile_wd < MAX(overlap, 64) || tile_ht < MAX(overlap, 64))
+  {
+    dt_print(DT_DEBUG_DEV, "[pixelpipe_process_tiled] overlap of %d pixels is too large for tiling\n", overlap);
+    goto untiled;
+  }
+  const int tiles_x = (width + tile_wd - 1) / tile_wd;
+  const int tiles_y = (height + tile_ht - 1) / tile_ht;
+  if(tiles_x * tiles_y > dt_conf_get_int("maximum_number_tiles"))
+  {
+    dt_print(DT_DEBUG_DEV, "[pixelpipe_process_tiled] too many tiles: %d x %d\n", tiles_x, tiles_y);
+    goto untiled;
+  }
+
+  dt_print(DT_DEBUG_DEV, "[pixelpipe_process_tiled] processing %d x %d in %d x %d tiles of %d x %d with "
+                         "overlap %d [%s]\n",
+           width, height, tiles_x, tiles_y, tile_wd, tile_ht, overlap, _pipe_type_to_str(pipe->type));
+
+  uint8_t *out = NULL;
+  size_t out_bpp = 0;
+  dt_iop_buffer_dsc_t out_dsc = { 0 };
+  const int gamma = !no_gamma && _pixelpipe_gamma_enabled(pipe);
+  for(int ty = 0; ty < tiles_y; ty++)
+    for(int tx = 0; tx < tiles_x; tx++)
+    {
+      // the good part of the tile, and the part which is processed around it
+      const int gx = tx * tile_wd, gy = ty * tile_ht;
+      const int gw = MIN(tile_wd, width - gx), gh = MIN(tile_ht, height - gy);
+      const int x = MAX(gx - overlap, 0), y = MAX(gy - overlap, 0);
+      const int wd = MIN(gx + gw + overlap, width) - x, ht = MIN(gy + gh + overlap, height) - y;
+
+      const int err = no_gamma ? dt_dev_pixelpipe_process_no_gamma(pipe, dev, x, y, wd, ht, scale)
+                               : dt_dev_pixelpipe_process(pipe, dev, x, y, wd, ht, scale);
+      if(err)
+      {
+        if(out) dt_free_align(out);
+        return 1;
+      }
+
+      if(!out)
+      {
+        out_dsc = pipe->backbuf_dsc;
+        out_bpp = gamma ? 4 * sizeof(uint8_t) : dt_iop_buffer_dsc_to_bpp(&out_dsc);
+        out = dt_alloc_align(64, (size_t)width * height * out_bpp);
+        if(!out)
+        {
+          dt_print(DT_DEBUG_DEV, "[pixelpipe_process_tiled] could not alloc output buffer\n");
+          return 1;
+        }
+      }
+
+      const uint8_t *const tile = pipe->backbuf;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) shared(out, out_bpp, width) schedule(static)
+#endif
+      for(int j = 0; j < gh; j++)
+        memcpy(out + ((size_t)(gy + j) * width + gx) * out_bpp,
+               tile + ((size_t)(gy - y + j) * wd + (gx - x)) * out_bpp, (size_t)gw * out_bpp);
+    }
+
+#ifdef _DEBUG
+  if(gamma) _pixelpipe_check_tiled(pipe, dev, width, height, scale, out);
+#endif
+
+  dt_pthread_mutex_lock(&pipe->backbuf_mutex);
+  if(pipe->tiled_backbuf) dt_free_align(pipe->tiled_backbuf);
+  pipe->tiled_backbuf = out;
+  pipe->backbuf_hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, &roi, pipe, 0);
+  pipe->backbuf_dsc = out_dsc;
+  pipe->backbuf = out;
+  pipe->backbuf_width = width;
+  pipe->backbuf_height = height;
+  dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
+  return 0;
+
+untiled:
+  return no_gamma ? dt_dev_pixelpipe_process_no_gamma(pipe, dev, 0, 0, width, height, scale)
+                  : dt_dev_pixelpipe_process(pipe, dev, 0, 0, width, height, scale);
+}
+
 void dt_dev_pixelpipe_disable_after(dt_dev_pixelpipe_t *pipe, const char *op)
 {
   GList *nodes = g_list_last(pipe->nodes);
@@ -2226,6 +2701,76 @@ static int dt_dev_pixelpipe_process_rec_and_backcopy(dt_dev_pixelpipe_t *pipe, d
 }
 
 
+// the disk cache outlives the session, so unlike the shared cache it also has to know the contents of the
+// system display profile, which might have changed in between. invalidations of the shared cache don't
+// survive a restart, so they are left out.
+static uint64_t _dev_pixelpipe_disk_hash(const dt_dev_pixelpipe_t *pipe, const uint64_t hash,
+                                         const dt_iop_roi_t *roi, const int pos)
+{
+  uint64_t h = _shared_hash_pipe(hash, pipe, roi, pos);
+  if(darktable.color_profiles->display_type == DT_COLORSPACE_DISPLAY)
+  {
+    pthread_rwlock_rdlock(&darktable.color_profiles->xprofile_lock);
+    const char *str = (const char *)darktable.color_profiles->xprofile_data;
+    for(int i = 0; str && i < darktable.color_profiles->xprofile_size; i++) h = ((h << 5) + h) ^ str[i];
+    pthread_rwlock_unlock(&darktable.color_profiles->xprofile_lock);
+  }
+  return h;
+}
+
+// the disk cache only has the final output, so modules which need to see their data (histograms, color
+// pickers, waveform) have to be processed.
+static int _dev_pixelpipe_needs_module_data(const dt_dev_pixelpipe_t *pipe, const dt_develop_t *dev)
+{
+  if(dev->histogram_type == DT_DEV_HISTOGRAM_WAVEFORM) return 1;
+  if(dev->gui_module && dev->gui_module->request_color_pick != DT_REQUEST_COLORPICK_OFF) return 1;
+  for(const GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    const dt_dev_pixelpipe_iop_t *piece = (const dt_dev_pixelpipe_iop_t *)nodes->data;
+    if(piece->enabled && (piece->request_histogram & DT_REQUEST_ON)) return 1;
+  }
+  return 0;
+}
+
+// on darkroom entry the output for this very history might still be on disk from last time.
+// if so, put it into the cache line of the last module, processing will then stop right there.
+static void _dev_pixelpipe_load_from_disk(dt_dev_pixelpipe_t *pipe, const dt_iop_roi_t *roi, const int pos)
+{
+  const uint64_t hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, roi, pipe, pos);
+  if(dt_dev_pixelpipe_cache_available(&(pipe->cache), hash)) return;
+
+  size_t size = 0;
+  dt_iop_buffer_dsc_t dsc;
+  void *data = dt_dev_pixelpipe_cache_disk_read(pipe->image.id, _dev_pixelpipe_disk_hash(pipe, hash, roi, pos),
+                                                &size, &dsc);
+  if(!data) return;
+
+  if(size == (size_t)roi->width * roi->height * dt_iop_buffer_dsc_to_bpp(&dsc))
+  {
+    dt_pthread_mutex_lock(&pipe->busy_mutex);
+    void *line = NULL;
+    dt_iop_buffer_dsc_t *line_dsc = NULL;
+    (void)dt_dev_pixelpipe_cache_get(&(pipe->cache), hash, size, &line, &line_dsc);
+    memcpy(line, data, size);
+    *line_dsc = dsc;
+    dt_pthread_mutex_unlock(&pipe->busy_mutex);
+  }
+  dt_free_align(data);
+}
+
+void dt_dev_pixelpipe_store_backbuf(dt_dev_pixelpipe_t *pipe)
+{
+  if(pipe->type != DT_DEV_PIXELPIPE_PREVIEW || !dt_conf_get_bool("cache_disk_backend_preview")) return;
+
+  dt_pthread_mutex_lock(&pipe->backbuf_mutex);
+  if(pipe->backbuf && pipe->backbuf_disk_hash)
+    dt_dev_pixelpipe_cache_disk_write(pipe->image.id, pipe->backbuf_disk_hash,
+                                      (size_t)pipe->backbuf_width * pipe->backbuf_height
+                                          * dt_iop_buffer_dsc_to_bpp(&pipe->backbuf_dsc),
+                                      pipe->backbuf, &pipe->backbuf_dsc);
+  dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
+}
+
 int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x, int y, int width, int height,
                              float scale)
 {
@@ -2247,7 +2792,11 @@ int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x,
 
   dt_iop_roi_t roi = (dt_iop_roi_t){ x, y, width, height, scale };
   // printf("pixelpipe homebrew process start\n");
-  if(darktable.unmuted & DT_DEBUG_DEV) dt_dev_pixelpipe_cache_print(&pipe->cache);
+  if(darktable.unmuted & DT_DEBUG_DEV)
+  {
+    dt_dev_pixelpipe_cache_print(&pipe->cache);
+    dt_dev_pixelpipe_cache_shared_print(darktable.pixelpipe_cache);
+  }
 
   //  go through list of modules from the end:
   guint pos = g_list_length(dev->iop);
@@ -2257,8 +2806,15 @@ int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x,
 // re-entry point: in case of late opencl errors we start all over again with opencl-support disabled
 restart:
 
+  // a rerun records every module again, so drop what the failed run left
+  dt_dev_pixelpipe_profile_begin(pipe);
+
   // check if we should obsolete caches
-  if(pipe->cache_obsolete) dt_dev_pixelpipe_cache_flush(&(pipe->cache));
+  if(pipe->cache_obsolete)
+  {
+    dt_dev_pixelpipe_cache_flush(&(pipe->cache));
+    dt_dev_pixelpipe_cache_shared_invalidate(darktable.pixelpipe_cache, pipe->image.id);
+  }
   pipe->cache_obsolete = 0;
 
   // mask display off as a starting point
@@ -2270,6 +2826,15 @@ restart:
   dt_iop_buffer_dsc_t _out_format = { 0 };
   dt_iop_buffer_dsc_t *out_format = &_out_format;
 
+  // only the first run after loading the image, later ones have their buffers in memory anyways
+  if(pipe->load_from_disk)
+  {
+    if(pipe->type == DT_DEV_PIXELPIPE_PREVIEW && dev->gui_attached
+       && dt_conf_get_bool("cache_disk_backend_preview") && !_dev_pixelpipe_needs_module_data(pipe, dev))
+      _dev_pixelpipe_load_from_disk(pipe, &roi, pos);
+    pipe->load_from_disk = 0;
+  }
+
   // run pixelpipe recursively and get error status
   int err = dt_dev_pixelpipe_process_rec_and_backcopy(pipe, dev, &buf, &cl_mem_out, &out_format, &roi, modules,
                                                       pieces, pos);
@@ -2321,6 +2886,7 @@ restart:
   // ... and in case of other errors ...
   if(err)
   {
+    dt_dev_pixelpipe_profile_end(pipe, _pipe_type_to_str(pipe->type), 1);
     pipe->processing = 0;
     return 1;
   }
@@ -2328,11 +2894,16 @@ restart:
   // terminate
   dt_pthread_mutex_lock(&pipe->backbuf_mutex);
   pipe->backbuf_hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, &roi, pipe, 0);
+  pipe->backbuf_disk_hash = _dev_pixelpipe_disk_hash(
+      pipe, dt_dev_pixelpipe_cache_hash(pipe->image.id, &roi, pipe, pos), &roi, pos);
+  pipe->backbuf_dsc = *out_format;
   pipe->backbuf = buf;
   pipe->backbuf_width = width;
   pipe->backbuf_height = height;
   dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
 
+  dt_dev_pixelpipe_profile_end(pipe, _pipe_type_to_str(pipe->type), 0);
+
   // printf("pixelpipe homebrew process end\n");
   pipe->processing = 0;
   return 0;
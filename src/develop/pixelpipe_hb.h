@@ -55,6 +55,7 @@ typedef struct dt_dev_pixelpipe_iop_t
       buf_out;                // theoretical full buffer regions of interest, as passed through modify_roi_out
   int process_cl_ready;       // set this to 0 in commit_params to temporarily disable the use of process_cl
   int process_tiling_ready;   // set this to 0 in commit_params to temporarily disable tiling
+  int process_bands_ready;    // set this to 0 in commit_params if the module is not point-wise for these params
 
   // the following are used  internally for caching:
   dt_iop_buffer_dsc_t dsc_in, dsc_out;
@@ -104,7 +105,15 @@ typedef struct dt_dev_pixelpipe_t
   size_t backbuf_size;
   int backbuf_width, backbuf_height;
   uint64_t backbuf_hash;
+  // hash of the backbuf including pipe type and input size, and its format, for the disk cache
+  uint64_t backbuf_disk_hash;
+  // set when a new image got loaded, the next run may take its output from the disk cache
+  int load_from_disk;
+  dt_iop_buffer_dsc_t backbuf_dsc;
   dt_pthread_mutex_t backbuf_mutex, busy_mutex;
+  // records of the current run, if profiling (see pixelpipe_profile.h)
+  GArray *profile;
+  double profile_start;
   // working?
   int processing;
   // shutting down?
@@ -115,6 +124,13 @@ typedef struct dt_dev_pixelpipe_t
   int opencl_error;
   // running in a tiling context?
   int tiling;
+  // run point-wise modules together in row bands? (see IOP_FLAGS_POINTWISE)
+  int bands;
+  // the two band sized buffers used in between the modules of a band chain, kept between runs
+  void *bands_buf[2];
+  size_t bands_buf_size;
+  // output of dt_dev_pixelpipe_process_tiled(), stitched together from the tiles. owned by the pipe.
+  void *tiled_backbuf;
   // should this pixelpipe display a mask in the end?
   int mask_display;
   // input data based on this timestamp:
@@ -173,10 +189,18 @@ void dt_dev_pixelpipe_synch_top(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *d
 // process region of interest of pixels. returns 1 if pipe was altered during processing.
 int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y, int width,
                              int height, float scale);
+// writes the current output of a preview pipe to the disk cache, see dt_dev_pixelpipe_cache_disk_write().
+void dt_dev_pixelpipe_store_backbuf(dt_dev_pixelpipe_t *pipe);
 // convenience method that does not gamma-compress the image.
 int dt_dev_pixelpipe_process_no_gamma(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y,
                                       int width, int height, float scale);
 
+// processes the full image like dt_dev_pixelpipe_process(_no_gamma), but runs the whole pipe tile by tile if
+// its buffers wouldn't fit into host_memory_limit otherwise (pixelpipe_export_tiling). the result is in
+// pipe->backbuf either way.
+int dt_dev_pixelpipe_process_tiled(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int width, int height,
+                                   float scale, int no_gamma);
+
 // disable given op and all that comes after it in the pipe:
 void dt_dev_pixelpipe_disable_after(dt_dev_pixelpipe_t *pipe, const char *op);
 // disable given op and all that comes before it in the pipe:
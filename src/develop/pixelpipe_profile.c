@@ -0,0 +1,227 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2017 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "develop/pixelpipe_profile.h"
+#include "common/darktable.h"
+#include "common/file_location.h"
+#include "common/utility.h"
+#include "control/conf.h"
+#include "develop/imageop.h"
+#include "develop/pixelpipe_hb.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+// small per thread ids for the trace viewer, pthread_t is opaque
+static int _next_thread_id = 0;
+static __thread int _thread_id = 0;
+
+static int _get_thread_id(void)
+{
+  if(!_thread_id) _thread_id = __sync_add_and_fetch(&_next_thread_id, 1);
+  return _thread_id;
+}
+
+static const char *_cache_to_str(const dt_dev_pixelpipe_profile_cache_t cache)
+{
+  switch(cache)
+  {
+    case DT_DEV_PIXELPIPE_PROFILE_CACHE_HIT:
+      return "hit";
+    case DT_DEV_PIXELPIPE_PROFILE_CACHE_SHARED:
+      return "shared";
+    default:
+      return "miss";
+  }
+}
+
+void dt_dev_pixelpipe_profile_init(dt_dev_pixelpipe_profile_t *profile)
+{
+  memset(profile, 0, sizeof(*profile));
+  dt_pthread_mutex_init(&profile->mutex, NULL);
+
+  gchar *format = dt_conf_get_string("pixelpipe_profile");
+  if(!g_strcmp0(format, "json"))
+    profile->format = DT_DEV_PIXELPIPE_PROFILE_JSON;
+  else if(!g_strcmp0(format, "chrome trace"))
+    profile->format = DT_DEV_PIXELPIPE_PROFILE_CHROME_TRACE;
+  g_free(format);
+  if(profile->format == DT_DEV_PIXELPIPE_PROFILE_OFF) return;
+
+  gchar *filename = dt_conf_get_string("pixelpipe_profile_file");
+  if(!filename || !*filename)
+  {
+    g_free(filename);
+    char cachedir[PATH_MAX] = { 0 };
+    dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+    filename = g_strdup_printf("%s/pixelpipe-profile.json", cachedir);
+  }
+
+  profile->f = g_fopen(filename, "w");
+  if(!profile->f)
+  {
+    fprintf(stderr, "[pixelpipe_profile] can't open `%s' for writing, profiling disabled\n", filename);
+    profile->format = DT_DEV_PIXELPIPE_PROFILE_OFF;
+  }
+  else
+  {
+    dt_print(DT_DEBUG_PERF, "[pixelpipe_profile] writing to `%s'\n", filename);
+    if(profile->format == DT_DEV_PIXELPIPE_PROFILE_CHROME_TRACE) fputs("[\n", profile->f);
+  }
+  g_free(filename);
+  profile->start = dt_get_wtime();
+}
+
+void dt_dev_pixelpipe_profile_cleanup(dt_dev_pixelpipe_profile_t *profile)
+{
+  if(profile->f)
+  {
+    if(profile->format == DT_DEV_PIXELPIPE_PROFILE_CHROME_TRACE) fputs("\n]\n", profile->f);
+    fclose(profile->f);
+    profile->f = NULL;
+  }
+  dt_pthread_mutex_destroy(&profile->mutex);
+}
+
+void dt_dev_pixelpipe_profile_begin(dt_dev_pixelpipe_t *pipe)
+{
+  const dt_dev_pixelpipe_profile_t *profile = darktable.pixelpipe_profile;
+  if(!profile || profile->format == DT_DEV_PIXELPIPE_PROFILE_OFF) return;
+
+  if(!pipe->profile) pipe->profile = g_array_new(FALSE, FALSE, sizeof(dt_dev_pixelpipe_profile_record_t));
+  g_array_set_size(pipe->profile, 0);
+  pipe->profile_start = dt_get_wtime();
+}
+
+void dt_dev_pixelpipe_profile_add(dt_dev_pixelpipe_t *pipe, const dt_iop_module_t *module, const double start,
+                                  const dt_dev_pixelpipe_profile_cache_t cache, const int gpu, const int tiling,
+                                  const size_t bytes, const int width, const int height)
+{
+  if(!pipe->profile) return;
+  dt_dev_pixelpipe_profile_add_duration(pipe, module, start, dt_get_wtime() - start, cache, gpu, tiling, bytes,
+                                        width, height);
+}
+
+void dt_dev_pixelpipe_profile_add_duration(dt_dev_pixelpipe_t *pipe, const dt_iop_module_t *module,
+                                           const double start, const double duration,
+                                           const dt_dev_pixelpipe_profile_cache_t cache, const int gpu,
+                                           const int tiling, const size_t bytes, const int width,
+                                           const int height)
+{
+  if(!pipe->profile) return;
+
+  dt_dev_pixelpipe_profile_record_t r;
+  g_strlcpy(r.op, module ? module->op : "(input)", sizeof(r.op));
+  g_strlcpy(r.multi_name, module ? module->multi_name : "", sizeof(r.multi_name));
+  r.start = start - darktable.pixelpipe_profile->start;
+  r.duration = duration;
+  r.cache = cache;
+  r.gpu = gpu;
+  r.tiling = tiling;
+  r.bytes = bytes;
+  r.width = width;
+  r.height = height;
+  g_array_append_val(pipe->profile, r);
+}
+
+static void _write_json(GString *str, const dt_dev_pixelpipe_t *pipe, const char *type, const double start,
+                        const double duration, const int err)
+{
+  g_string_append_printf(str, "{\"pipe\": \"%s\", \"imgid\": %d, \"start\": %.6f, \"seconds\": %.6f, "
+                              "\"status\": \"%s\", \"width\": %d, \"height\": %d, \"modules\": [",
+                         type, pipe->image.id, start, duration, err ? "aborted" : "ok", pipe->backbuf_width,
+                         pipe->backbuf_height);
+  for(guint k = 0; k < pipe->profile->len; k++)
+  {
+    const dt_dev_pixelpipe_profile_record_t *r
+        = &g_array_index(pipe->profile, dt_dev_pixelpipe_profile_record_t, k);
+    g_string_append(str, k ? ", {\"op\": " : "{\"op\": ");
+    dt_util_json_append_string(str, r->op);
+    g_string_append(str, ", \"name\": ");
+    dt_util_json_append_string(str, r->multi_name);
+    g_string_append_printf(str, ", \"start\": %.6f, \"seconds\": %.6f, \"device\": \"%s\", \"tiling\": %s, "
+                                "\"cache\": \"%s\", \"bytes\": %zu, \"width\": %d, \"height\": %d}",
+                           r->start, r->duration, r->gpu ? "gpu" : "cpu", r->tiling ? "true" : "false",
+                           _cache_to_str(r->cache), r->bytes, r->width, r->height);
+  }
+  g_string_append(str, "]}\n");
+}
+
+static void _write_trace_event(GString *str, const gboolean first, const char *name, const char *type,
+                               const int tid, const double start, const double duration)
+{
+  g_string_append(str, first ? "{\"name\": " : ",\n{\"name\": ");
+  dt_util_json_append_string(str, name);
+  g_string_append_printf(str, ", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.0f, "
+                              "\"dur\": %.0f, \"args\": {",
+                         type, tid, start * 1e6, duration * 1e6);
+}
+
+static void _write_chrome_trace(GString *str, const dt_dev_pixelpipe_t *pipe, const char *type,
+                                const double start, const double duration, const int err)
+{
+  const int tid = _get_thread_id();
+  gchar *name = g_strdup_printf("%s pipe", type);
+  _write_trace_event(str, TRUE, name, type, tid, start, duration);
+  g_free(name);
+  g_string_append_printf(str, "\"imgid\": %d, \"status\": \"%s\"}}", pipe->image.id, err ? "aborted" : "ok");
+
+  for(guint k = 0; k < pipe->profile->len; k++)
+  {
+    const dt_dev_pixelpipe_profile_record_t *r
+        = &g_array_index(pipe->profile, dt_dev_pixelpipe_profile_record_t, k);
+    gchar *label = *r->multi_name ? g_strdup_printf("%s %s", r->op, r->multi_name) : g_strdup(r->op);
+    _write_trace_event(str, FALSE, label, type, tid, r->start, r->duration);
+    g_free(label);
+    g_string_append_printf(str, "\"device\": \"%s\", \"tiling\": %s, \"cache\": \"%s\", \"bytes\": %zu, "
+                                "\"width\": %d, \"height\": %d}}",
+                           r->gpu ? "gpu" : "cpu", r->tiling ? "true" : "false", _cache_to_str(r->cache),
+                           r->bytes, r->width, r->height);
+  }
+}
+
+void dt_dev_pixelpipe_profile_end(dt_dev_pixelpipe_t *pipe, const char *type, const int err)
+{
+  dt_dev_pixelpipe_profile_t *profile = darktable.pixelpipe_profile;
+  if(!pipe->profile || !profile || !profile->f) return;
+
+  const double start = pipe->profile_start - profile->start;
+  const double duration = dt_get_wtime() - pipe->profile_start;
+
+  // format outside of the lock, so concurrent pipes only serialize on the write itself
+  GString *str = g_string_new(NULL);
+  if(profile->format == DT_DEV_PIXELPIPE_PROFILE_JSON)
+    _write_json(str, pipe, type, start, duration, err);
+  else
+    _write_chrome_trace(str, pipe, type, start, duration, err);
+
+  dt_pthread_mutex_lock(&profile->mutex);
+  // trace events of consecutive runs are separated by a comma
+  if(profile->format == DT_DEV_PIXELPIPE_PROFILE_CHROME_TRACE && profile->runs) fputs(",\n", profile->f);
+  profile->runs++;
+  fputs(str->str, profile->f);
+  fflush(profile->f);
+  dt_pthread_mutex_unlock(&profile->mutex);
+  g_string_free(str, TRUE);
+
+  g_array_set_size(pipe->profile, 0);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
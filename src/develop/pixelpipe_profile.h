@@ -0,0 +1,96 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2017 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/dtpthread.h"
+
+#include <glib.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+struct dt_dev_pixelpipe_t;
+struct dt_iop_module_t;
+
+/**
+ * per module timings of every pixelpipe run, written to a file while darktable is running
+ * (pixelpipe_profile). unlike -d perf this is independent of debug output and doesn't need
+ * a special build, so it can be switched on for a whole batch of exports.
+ *
+ * every pipe collects the records of its current run without any locking, and hands them to
+ * the writer when the run is done. in "json" mode the file holds one object per run and line,
+ * in "chrome trace" mode it is a trace event array as read by chrome://tracing and similar.
+ */
+
+typedef enum dt_dev_pixelpipe_profile_format_t
+{
+  DT_DEV_PIXELPIPE_PROFILE_OFF = 0,
+  DT_DEV_PIXELPIPE_PROFILE_JSON = 1,
+  DT_DEV_PIXELPIPE_PROFILE_CHROME_TRACE = 2
+} dt_dev_pixelpipe_profile_format_t;
+
+typedef enum dt_dev_pixelpipe_profile_cache_t
+{
+  DT_DEV_PIXELPIPE_PROFILE_CACHE_MISS = 0,   // computed
+  DT_DEV_PIXELPIPE_PROFILE_CACHE_HIT = 1,    // found in the cache of the pipe
+  DT_DEV_PIXELPIPE_PROFILE_CACHE_SHARED = 2, // copied from the cache shared between pipes
+} dt_dev_pixelpipe_profile_cache_t;
+
+/** what happened to one module during one run. */
+typedef struct dt_dev_pixelpipe_profile_record_t
+{
+  char op[20];
+  char multi_name[128];
+  double start, duration; // seconds since the profile was opened
+  dt_dev_pixelpipe_profile_cache_t cache;
+  int gpu, tiling;
+  size_t bytes; // size of the output buffer
+  int width, height;
+} dt_dev_pixelpipe_profile_record_t;
+
+typedef struct dt_dev_pixelpipe_profile_t
+{
+  dt_dev_pixelpipe_profile_format_t format;
+  double start;
+  dt_pthread_mutex_t mutex; // protects the rest
+  FILE *f;
+  int runs;
+} dt_dev_pixelpipe_profile_t;
+
+void dt_dev_pixelpipe_profile_init(dt_dev_pixelpipe_profile_t *profile);
+void dt_dev_pixelpipe_profile_cleanup(dt_dev_pixelpipe_profile_t *profile);
+
+/** starts a new run of pipe, a no-op if profiling is off. */
+void dt_dev_pixelpipe_profile_begin(struct dt_dev_pixelpipe_t *pipe);
+/** records one module (NULL for the input buffer), started at start (as returned by dt_get_wtime()). */
+void dt_dev_pixelpipe_profile_add(struct dt_dev_pixelpipe_t *pipe, const struct dt_iop_module_t *module,
+                                  const double start, const dt_dev_pixelpipe_profile_cache_t cache,
+                                  const int gpu, const int tiling, const size_t bytes, const int width,
+                                  const int height);
+/** same, for a module which took duration seconds, not necessarily all up to now. */
+void dt_dev_pixelpipe_profile_add_duration(struct dt_dev_pixelpipe_t *pipe, const struct dt_iop_module_t *module,
+                                           const double start, const double duration,
+                                           const dt_dev_pixelpipe_profile_cache_t cache, const int gpu,
+                                           const int tiling, const size_t bytes, const int width,
+                                           const int height);
+/** writes the run out. type is the pipe type for display. */
+void dt_dev_pixelpipe_profile_end(struct dt_dev_pixelpipe_t *pipe, const char *type, const int err);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
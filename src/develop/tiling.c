@@ -579,14 +579,200 @@ static int _fit_output_to_input_roi(struct dt_iop_module_t *self, struct dt_dev_
 }
 
 
+/* one tile as passed to process(), and where its input comes from and its good part goes to */
+typedef struct _tile_t
+{
+  dt_iop_roi_t iroi, oroi; // full roi of the tile
+  size_t ioffs;            // offset of the tile into ivoid
+  size_t ooffs;            // offset of the good part into ovoid
+  size_t good_offs;        // offset of the good part into the output tile buffer
+  int good_wd, good_ht;    // dimensions of the good part
+} _tile_t;
+
+/* rows to copy between a tile buffer and the full image buffer */
+typedef struct _tile_copy_t
+{
+  char *dst;
+  const char *src;
+  size_t dst_pitch, src_pitch, row_size, rows;
+} _tile_copy_t;
+
+/* what the helper thread copies while process() runs on the current tile */
+typedef struct _tile_copy_job_t
+{
+  _tile_copy_t copy[2];
+  int count;
+} _tile_copy_job_t;
+
+static inline _tile_copy_t _tile_copy_in(const _tile_t *const tile, const void *const ivoid, void *const input,
+                                         const size_t ipitch, const int in_bpp)
+{
+  const size_t row_size = (size_t)tile->iroi.width * in_bpp;
+  return (_tile_copy_t){ (char *)input, (const char *)ivoid + tile->ioffs, row_size, ipitch, row_size,
+                         tile->iroi.height };
+}
+
+static inline _tile_copy_t _tile_copy_out(const _tile_t *const tile, const void *const output, void *const ovoid,
+                                          const size_t opitch, const int out_bpp)
+{
+  return (_tile_copy_t){ (char *)ovoid + tile->ooffs, (const char *)output + tile->good_offs, opitch,
+                         (size_t)tile->oroi.width * out_bpp, (size_t)tile->good_wd * out_bpp, tile->good_ht };
+}
+
+static void _tile_copy(const _tile_copy_t *const c)
+{
+#ifdef _OPENMP
+#pragma omp parallel for default(none) schedule(static)
+#endif
+  for(size_t j = 0; j < c->rows; j++) memcpy(c->dst + j * c->dst_pitch, c->src + j * c->src_pitch, c->row_size);
+}
+
+/* single threaded on purpose, all other threads are busy in process() */
+static void *_tile_copy_thread(void *arg)
+{
+  const _tile_copy_job_t *const job = (const _tile_copy_job_t *)arg;
+  for(int k = 0; k < job->count; k++)
+  {
+    const _tile_copy_t *const c = job->copy + k;
+    for(size_t j = 0; j < c->rows; j++) memcpy(c->dst + j * c->dst_pitch, c->src + j * c->src_pitch, c->row_size);
+  }
+  return NULL;
+}
+
+/* runs process() on all tiles. if spare bytes of memory allow for a second pair of tile buffers, the next
+   tile is copied in and the previous one copied out by a helper thread while process() works on the current
+   one, so the module's threads don't wait for the copies between tiles. returns 1 if the tile buffers could
+   not be allocated, nothing has been processed then. */
+static int _process_tiles(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                          const void *const ivoid, void *const ovoid, const int in_bpp, const int out_bpp,
+                          const size_t ipitch, const size_t opitch, const _tile_t *const tiles,
+                          const int num_tiles, const float spare, const char *label)
+{
+  size_t in_size = 0, out_size = 0;
+  for(int t = 0; t < num_tiles; t++)
+  {
+    in_size = MAX(in_size, (size_t)tiles[t].iroi.width * tiles[t].iroi.height * in_bpp);
+    out_size = MAX(out_size, (size_t)tiles[t].oroi.width * tiles[t].oroi.height * out_bpp);
+  }
+
+  /* reserve input and output buffers for tiles */
+  void *input[2] = { NULL, NULL };
+  void *output[2] = { NULL, NULL };
+  input[0] = dt_alloc_align(64, in_size);
+  output[0] = dt_alloc_align(64, out_size);
+  if(input[0] == NULL || output[0] == NULL)
+  {
+    dt_print(DT_DEBUG_DEV, "[%s] could not alloc tile buffers for module '%s'\n", label, self->op);
+    if(input[0] != NULL) dt_free_align(input[0]);
+    if(output[0] != NULL) dt_free_align(output[0]);
+    return 1;
+  }
+
+  int buffers = 1;
+  if(num_tiles > 1 && spare >= (float)(in_size + out_size))
+  {
+    input[1] = dt_alloc_align(64, in_size);
+    output[1] = dt_alloc_align(64, out_size);
+    if(input[1] != NULL && output[1] != NULL)
+    {
+      buffers = 2;
+      dt_print(DT_DEBUG_DEV, "[%s] double buffering tiles for module '%s'\n", label, self->op);
+    }
+  }
+
+  /* store processed_maximum to be re-used and aggregated */
+  float processed_maximum_saved[4];
+  float processed_maximum_new[4] = { 1.0f };
+  for(int k = 0; k < 4; k++) processed_maximum_saved[k] = piece->pipe->dsc.processed_maximum[k];
+
+  piece->pipe->tiling = 1;
+
+  /* prepare input buffer of the first tile */
+  const _tile_copy_t first = _tile_copy_in(tiles, ivoid, input[0], ipitch, in_bpp);
+  _tile_copy(&first);
+
+  /* iterate over tiles */
+  for(int t = 0; t < num_tiles; t++)
+  {
+    const _tile_t *const tile = tiles + t;
+    const int b = t % buffers;
+
+    dt_print(DT_DEBUG_DEV, "[%s] tile %d of %d with %d x %d at origin [%d, %d]\n", label, t + 1, num_tiles,
+             tile->iroi.width, tile->iroi.height, tile->iroi.x, tile->iroi.y);
+
+    /* with two pairs of buffers the next tile is copied in and the previous one out in the background */
+    _tile_copy_job_t job = { .count = 0 };
+    pthread_t thread;
+    int threaded = 0;
+    if(buffers == 2)
+    {
+      if(t + 1 < num_tiles) job.copy[job.count++] = _tile_copy_in(tile + 1, ivoid, input[!b], ipitch, in_bpp);
+      if(t > 0) job.copy[job.count++] = _tile_copy_out(tile - 1, output[!b], ovoid, opitch, out_bpp);
+      threaded = !dt_pthread_create(&thread, _tile_copy_thread, &job);
+    }
+
+    /* take original processed_maximum as starting point */
+    for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
+
+    /* call process() of module */
+    self->process(self, piece, input[b], output[b], &tile->iroi, &tile->oroi);
+
+    /* aggregate resulting processed_maximum */
+    /* TODO: check if there really can be differences between tiles and take
+             appropriate action (calculate minimum, maximum, average, ...?) */
+    for(int k = 0; k < 4; k++)
+    {
+      if(t > 0 && fabs(processed_maximum_new[k] - piece->pipe->dsc.processed_maximum[k]) > 1.0e-6f)
+        dt_print(DT_DEBUG_DEV, "[%s] processed_maximum[%d] differs between tiles in module '%s'\n", label, k,
+                 self->op);
+      processed_maximum_new[k] = piece->pipe->dsc.processed_maximum[k];
+    }
+
+    if(threaded)
+      pthread_join(thread, NULL);
+    else
+      for(int k = 0; k < job.count; k++) _tile_copy(job.copy + k);
+
+    if(buffers == 1)
+    {
+      /* copy "good" part of tile to output buffer, and prepare the next one */
+      const _tile_copy_t out = _tile_copy_out(tile, output[0], ovoid, opitch, out_bpp);
+      _tile_copy(&out);
+      if(t + 1 < num_tiles)
+      {
+        const _tile_copy_t in = _tile_copy_in(tile + 1, ivoid, input[0], ipitch, in_bpp);
+        _tile_copy(&in);
+      }
+    }
+  }
+
+  /* the last tile is still to be copied back when double buffering */
+  if(buffers == 2)
+  {
+    const _tile_copy_t last
+        = _tile_copy_out(tiles + num_tiles - 1, output[(num_tiles - 1) % 2], ovoid, opitch, out_bpp);
+    _tile_copy(&last);
+  }
+
+  /* copy back final processed_maximum */
+  for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_new[k];
+
+  for(int b = 0; b < 2; b++)
+  {
+    if(input[b] != NULL) dt_free_align(input[b]);
+    if(output[b] != NULL) dt_free_align(output[b]);
+  }
+  return 0;
+}
+
+
 /* simple tiling algorithm for roi_in == roi_out, i.e. for pixel to pixel modules/operations */
 static void _default_process_tiling_ptp(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
                                         const void *const ivoid, void *const ovoid,
                                         const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
                                         const int in_bpp)
 {
-  void *input = NULL;
-  void *output = NULL;
+  _tile_t *tiles = NULL;
   dt_iop_buffer_dsc_t dsc;
   self->output_format(self, piece->pipe, piece, &dsc);
   const int out_bpp = dt_iop_buffer_dsc_to_bpp(&dsc);
@@ -700,111 +886,45 @@ static void _default_process_tiling_ptp(struct dt_iop_module_t *self, struct dt_
            "[default_process_tiling_ptp] (%d x %d) tiles with max dimensions %d x %d and overlap %d\n",
            tiles_x, tiles_y, width, height, overlap);
 
-  /* reserve input and output buffers for tiles */
-  input = dt_alloc_align(64, (size_t)width * height * in_bpp);
-  if(input == NULL)
-  {
-    dt_print(DT_DEBUG_DEV, "[default_process_tiling_ptp] could not alloc input buffer for module '%s'\n",
-             self->op);
-    goto error;
-  }
-  output = dt_alloc_align(64, (size_t)width * height * out_bpp);
-  if(output == NULL)
-  {
-    dt_print(DT_DEBUG_DEV, "[default_process_tiling_ptp] could not alloc output buffer for module '%s'\n",
-             self->op);
-    goto error;
-  }
-
-  /* store processed_maximum to be re-used and aggregated */
-  float processed_maximum_saved[4];
-  float processed_maximum_new[4] = { 1.0f };
-  for(int k = 0; k < 4; k++) processed_maximum_saved[k] = piece->pipe->dsc.processed_maximum[k];
-
-
-  /* iterate over tiles */
+  /* collect the tiles */
+  tiles = g_malloc_n((size_t)tiles_x * tiles_y, sizeof(_tile_t));
+  int num_tiles = 0;
   for(size_t tx = 0; tx < tiles_x; tx++)
     for(size_t ty = 0; ty < tiles_y; ty++)
     {
-      piece->pipe->tiling = 1;
-
       size_t wd = tx * tile_wd + width > roi_in->width ? roi_in->width - tx * tile_wd : width;
       size_t ht = ty * tile_ht + height > roi_in->height ? roi_in->height - ty * tile_ht : height;
 
       /* no need to process end-tiles that are smaller than the total overlap area */
       if((wd <= 2 * overlap && tx > 0) || (ht <= 2 * overlap && ty > 0)) continue;
 
-      /* origin and region of effective part of tile, which we want to store later */
-      size_t origin[] = { 0, 0, 0 };
-      size_t region[] = { wd, ht, 1 };
-
-      /* roi_in and roi_out for process_cl on subbuffer */
-      dt_iop_roi_t iroi = { roi_in->x + tx * tile_wd, roi_in->y + ty * tile_ht, wd, ht, roi_in->scale };
-      dt_iop_roi_t oroi = { roi_out->x + tx * tile_wd, roi_out->y + ty * tile_ht, wd, ht, roi_out->scale };
-
-      /* offsets of tile into ivoid and ovoid */
-      size_t ioffs = (ty * tile_ht) * ipitch + (tx * tile_wd) * in_bpp;
-      size_t ooffs = (ty * tile_ht) * opitch + (tx * tile_wd) * out_bpp;
-
-
-      dt_print(DT_DEBUG_DEV, "[default_process_tiling_ptp] tile (%zu, %zu) with %zu x %zu at origin [%zu, %zu]\n",
-               tx, ty, wd, ht, tx * tile_wd, ty * tile_ht);
+      _tile_t *tile = tiles + num_tiles++;
 
-/* prepare input tile buffer */
-#ifdef _OPENMP
-#pragma omp parallel for default(none) shared(input, width, ioffs, wd, ht) schedule(static)
-#endif
-      for(size_t j = 0; j < ht; j++)
-        memcpy((char *)input + j * wd * in_bpp, (char *)ivoid + ioffs + j * ipitch, (size_t)wd * in_bpp);
-
-      /* take original processed_maximum as starting point */
-      for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
+      /* roi_in and roi_out for process on subbuffer */
+      tile->iroi = (dt_iop_roi_t){ roi_in->x + tx * tile_wd, roi_in->y + ty * tile_ht, wd, ht, roi_in->scale };
+      tile->oroi = (dt_iop_roi_t){ roi_out->x + tx * tile_wd, roi_out->y + ty * tile_ht, wd, ht, roi_out->scale };
 
-      /* call process() of module */
-      self->process(self, piece, input, output, &iroi, &oroi);
-
-      /* aggregate resulting processed_maximum */
-      /* TODO: check if there really can be differences between tiles and take
-               appropriate action (calculate minimum, maximum, average, ...?) */
-      for(int k = 0; k < 4; k++)
-      {
-        if(tx + ty > 0 && fabs(processed_maximum_new[k] - piece->pipe->dsc.processed_maximum[k]) > 1.0e-6f)
-          dt_print(
-              DT_DEBUG_DEV,
-              "[default_process_tiling_ptp] processed_maximum[%d] differs between tiles in module '%s'\n", k,
-              self->op);
-        processed_maximum_new[k] = piece->pipe->dsc.processed_maximum[k];
-      }
+      /* offset of tile into ivoid */
+      tile->ioffs = (ty * tile_ht) * ipitch + (tx * tile_wd) * in_bpp;
 
       /* correct origin and region of tile for overlap.
          make sure that we only copy back the "good" part. */
-      if(tx > 0)
-      {
-        origin[0] += overlap;
-        region[0] -= overlap;
-        ooffs += overlap * out_bpp;
-      }
-      if(ty > 0)
-      {
-        origin[1] += overlap;
-        region[1] -= overlap;
-        ooffs += overlap * opitch;
-      }
-
-/* copy "good" part of tile to output buffer */
-#ifdef _OPENMP
-#pragma omp parallel for default(none) shared(ooffs, output, width, origin, region, wd) schedule(static)
-#endif
-      for(size_t j = 0; j < region[1]; j++)
-        memcpy((char *)ovoid + ooffs + j * opitch,
-               (char *)output + ((j + origin[1]) * wd + origin[0]) * out_bpp, (size_t)region[0] * out_bpp);
+      const size_t origin_x = tx > 0 ? overlap : 0;
+      const size_t origin_y = ty > 0 ? overlap : 0;
+      tile->ooffs = (ty * tile_ht + origin_y) * opitch + (tx * tile_wd + origin_x) * out_bpp;
+      tile->good_offs = (origin_y * wd + origin_x) * out_bpp;
+      tile->good_wd = wd - origin_x;
+      tile->good_ht = ht - origin_y;
     }
 
-  /* copy back final processed_maximum */
-  for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_new[k];
+  /* memory left for a second pair of tile buffers */
+  const float spare = available - (float)width * height * max_bpp * factor;
 
-  if(input != NULL) dt_free_align(input);
-  if(output != NULL) dt_free_align(output);
+  if(_process_tiles(self, piece, ivoid, ovoid, in_bpp, out_bpp, ipitch, opitch, tiles, num_tiles, spare,
+                    "default_process_tiling_ptp"))
+    goto error;
+
+  g_free(tiles);
   piece->pipe->tiling = 0;
   return;
 
@@ -813,8 +933,7 @@ error:
 // fall through
 
 fallback:
-  if(input != NULL) dt_free_align(input);
-  if(output != NULL) dt_free_align(output);
+  g_free(tiles);
   piece->pipe->tiling = 0;
   dt_print(DT_DEBUG_DEV, "[default_process_tiling_ptp] fall back to standard processing for module '%s'\n",
            self->op);
@@ -831,8 +950,7 @@ static void _default_process_tiling_roi(struct dt_iop_module_t *self, struct dt_
                                         const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
                                         const int in_bpp)
 {
-  void *input = NULL;
-  void *output = NULL;
+  _tile_t *tiles = NULL;
 
   //_print_roi(roi_in, "module roi_in");
   //_print_roi(roi_out, "module roi_out");
@@ -975,17 +1093,13 @@ static void _default_process_tiling_roi(struct dt_iop_module_t *self, struct dt_
            tiles_x, tiles_y, width, height);
 
 
-  /* store processed_maximum to be re-used and aggregated */
-  float processed_maximum_saved[4];
-  float processed_maximum_new[4] = { 1.0f };
-  for(int k = 0; k < 4; k++) processed_maximum_saved[k] = piece->pipe->dsc.processed_maximum[k];
-
-  /* iterate over tiles */
+  /* collect the tiles. all of them are fitted before processing starts, so a failure doesn't leave the
+     output half done */
+  tiles = g_malloc_n((size_t)tiles_x * tiles_y, sizeof(_tile_t));
+  int num_tiles = 0;
   for(size_t tx = 0; tx < tiles_x; tx++)
     for(size_t ty = 0; ty < tiles_y; ty++)
     {
-      piece->pipe->tiling = 1;
-
       /* the output dimensions of the good part of this specific tile */
       size_t wd = (tx + 1) * tile_wd > roi_out->width ? roi_out->width - tx * tile_wd : tile_wd;
       size_t ht = (ty + 1) * tile_ht > roi_out->height ? roi_out->height - ty * tile_ht : tile_ht;
@@ -1068,78 +1182,26 @@ static void _default_process_tiling_roi(struct dt_iop_module_t *self, struct dt_
       //_print_roi(&iroi_full, "tile iroi_full final");
       //_print_roi(&oroi_full, "tile oroi_full final");
 
-      /* offsets of tile into ivoid and ovoid */
-      size_t ioffs = ((size_t)iroi_full.y - roi_in->y) * ipitch + ((size_t)iroi_full.x - roi_in->x) * in_bpp;
-      size_t ooffs = ((size_t)oroi_good.y - roi_out->y) * opitch
-                     + ((size_t)oroi_good.x - roi_out->x) * out_bpp;
-
-      dt_print(DT_DEBUG_DEV, "[default_process_tiling_roi] tile (%zu, %zu) with %d x %d at origin [%d, %d]\n",
-               tx, ty, iroi_full.width, iroi_full.height, iroi_full.x, iroi_full.y);
-
-
-      /* prepare input tile buffer */
-      input = dt_alloc_align(64, (size_t)iroi_full.width * iroi_full.height * in_bpp);
-      if(input == NULL)
-      {
-        dt_print(DT_DEBUG_DEV, "[default_process_tiling_roi] could not alloc input buffer for module '%s'\n",
-                 self->op);
-        goto error;
-      }
-      output = dt_alloc_align(64, (size_t)oroi_full.width * oroi_full.height * out_bpp);
-      if(output == NULL)
-      {
-        dt_print(DT_DEBUG_DEV, "[default_process_tiling_roi] could not alloc output buffer for module '%s'\n",
-                 self->op);
-        goto error;
-      }
-
-#ifdef _OPENMP
-#pragma omp parallel for default(none) shared(input, ioffs, iroi_full) schedule(static)
-#endif
-      for(size_t j = 0; j < iroi_full.height; j++)
-        memcpy((char *)input + j * iroi_full.width * in_bpp, (char *)ivoid + ioffs + j * ipitch,
-               (size_t)iroi_full.width * in_bpp);
-
-      /* take original processed_maximum as starting point */
-      for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
-
-      /* call process() of module */
-      self->process(self, piece, input, output, &iroi_full, &oroi_full);
-
-      /* aggregate resulting processed_maximum */
-      /* TODO: check if there really can be differences between tiles and take
-               appropriate action (calculate minimum, maximum, average, ...?) */
-      for(int k = 0; k < 4; k++)
-      {
-        if(tx + ty > 0 && fabs(processed_maximum_new[k] - piece->pipe->dsc.processed_maximum[k]) > 1.0e-6f)
-          dt_print(
-              DT_DEBUG_DEV,
-              "[default_process_tiling_roi] processed_maximum[%d] differs between tiles in module '%s'\n", k,
-              self->op);
-        processed_maximum_new[k] = piece->pipe->dsc.processed_maximum[k];
-      }
-
-      /* copy "good" part of tile to output buffer */
-      const int origin_x = oroi_good.x - oroi_full.x;
-      const int origin_y = oroi_good.y - oroi_full.y;
-#ifdef _OPENMP
-#pragma omp parallel for default(none) shared(ooffs, output, oroi_good, oroi_full) schedule(static)
-#endif
-      for(size_t j = 0; j < oroi_good.height; j++)
-        memcpy((char *)ovoid + ooffs + j * opitch,
-               (char *)output + ((j + origin_y) * oroi_full.width + origin_x) * out_bpp,
-               (size_t)oroi_good.width * out_bpp);
-
-      dt_free_align(input);
-      dt_free_align(output);
-      input = output = NULL;
+      /* offsets of tile into ivoid and ovoid, and of the "good" part into the tile */
+      _tile_t *tile = tiles + num_tiles++;
+      tile->iroi = iroi_full;
+      tile->oroi = oroi_full;
+      tile->ioffs = ((size_t)iroi_full.y - roi_in->y) * ipitch + ((size_t)iroi_full.x - roi_in->x) * in_bpp;
+      tile->ooffs = ((size_t)oroi_good.y - roi_out->y) * opitch + ((size_t)oroi_good.x - roi_out->x) * out_bpp;
+      tile->good_offs = ((size_t)(oroi_good.y - oroi_full.y) * oroi_full.width + (oroi_good.x - oroi_full.x))
+                        * out_bpp;
+      tile->good_wd = oroi_good.width;
+      tile->good_ht = oroi_good.height;
     }
 
-  /* copy back final processed_maximum */
-  for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_new[k];
+  /* memory left for a second pair of tile buffers */
+  const float spare = available - (float)width * height * max_bpp * factor;
+
+  if(_process_tiles(self, piece, ivoid, ovoid, in_bpp, out_bpp, ipitch, opitch, tiles, num_tiles, spare,
+                    "default_process_tiling_roi"))
+    goto error;
 
-  if(input != NULL) dt_free_align(input);
-  if(output != NULL) dt_free_align(output);
+  g_free(tiles);
   piece->pipe->tiling = 0;
   return;
 
@@ -1148,8 +1210,7 @@ error:
 // fall through
 
 fallback:
-  if(input != NULL) dt_free_align(input);
-  if(output != NULL) dt_free_align(output);
+  g_free(tiles);
   piece->pipe->tiling = 0;
   dt_print(DT_DEBUG_DEV, "[default_process_tiling_roi] fall back to standard processing for module '%s'\n",
            self->op);
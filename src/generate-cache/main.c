@@ -18,6 +18,7 @@
 */
 
 #include <glib.h>    // for g_mkdir_with_parents, _
+#include <glib/gstdio.h> // for g_stat, g_unlink
 #include <gtk/gtk.h> // for gtk_init_check
 #include <libintl.h> // for bind_textdomain_codeset, etc
 #include <limits.h>  // for PATH_MAX
@@ -32,7 +33,9 @@
 #include "common/darktable.h"    // for darktable, darktable_t, dt_cleanup, etc
 #include "common/database.h"     // for dt_database_get
 #include "common/debug.h"        // for DT_DEBUG_SQLITE3_PREPARE_V2
+#include "common/image.h"        // for dt_image_full_path
 #include "common/mipmap_cache.h" // for dt_mipmap_size_t, etc
+#include "common/mipmap_pack.h"  // for dt_mipmap_pack_contains
 #include "config.h"              // for GETTEXT_PACKAGE, etc
 #include "control/conf.h"        // for dt_conf_get_bool
 
@@ -40,7 +43,142 @@
 #include "win/main_wrapper.h"
 #endif
 
-static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mipmap_size_t max_mip, const int32_t min_imgid, const int32_t max_imgid)
+// write the checkpoint at most this often (in seconds)
+#define CHECKPOINT_INTERVAL 5.0
+
+// shared between the worker threads
+typedef struct generate_cache_t
+{
+  dt_mipmap_size_t min_mip, max_mip;
+  int omp_threads;
+  GHashTable *existing[DT_MIPMAP_F]; // imgids of the jpeg thumbnails already on disc
+
+  dt_pthread_mutex_t mutex; // protects the rest
+  GArray *imgids;           // what's left to do, ascending
+  uint8_t *done;            // per entry of imgids
+  size_t next, watermark;   // next to hand out, all before watermark are done
+  size_t counter;
+  size_t bytes_in, bytes_out;
+  char checkpoint[PATH_MAX];
+  double last_checkpoint;
+} generate_cache_t;
+
+static gboolean _thumbnail_exists(generate_cache_t *g, const int32_t imgid, const dt_mipmap_size_t mip)
+{
+  if(darktable.mipmap_cache->pack[mip]) return dt_mipmap_pack_contains(darktable.mipmap_cache->pack[mip], imgid);
+  return g_hash_table_contains(g->existing[mip], GINT_TO_POINTER(imgid));
+}
+
+// one directory listing per mip instead of one access() per thumbnail
+static GHashTable *_scan_existing(const dt_mipmap_size_t mip)
+{
+  GHashTable *existing = g_hash_table_new(NULL, NULL);
+  char dirname[PATH_MAX] = { 0 };
+  snprintf(dirname, sizeof(dirname), "%s.d/%d", darktable.mipmap_cache->cachedir, mip);
+  GDir *dir = g_dir_open(dirname, 0, NULL);
+  if(!dir) return existing;
+  const gchar *name;
+  while((name = g_dir_read_name(dir)))
+  {
+    if(!g_str_has_suffix(name, ".jpg")) continue;
+    const int imgid = atoi(name);
+    if(imgid > 0) g_hash_table_add(existing, GINT_TO_POINTER(imgid));
+  }
+  g_dir_close(dir);
+  return existing;
+}
+
+// the last imgid up to which everything was done, if the previous run had the same mip range
+static int32_t _read_checkpoint(generate_cache_t *g)
+{
+  int32_t imgid = 0;
+  int min_mip = -1, max_mip = -1;
+  FILE *f = g_fopen(g->checkpoint, "rb");
+  if(!f) return 0;
+  if(fscanf(f, "%d %d %d", &min_mip, &max_mip, &imgid) != 3 || min_mip != g->min_mip || max_mip != g->max_mip)
+    imgid = 0;
+  fclose(f);
+  return imgid;
+}
+
+// called with the mutex held
+static void _write_checkpoint(generate_cache_t *g)
+{
+  if(g->watermark == 0) return;
+  // write and rename, a run killed in between doesn't leave a truncated file behind
+  gchar *tmp = g_strdup_printf("%s.tmp", g->checkpoint);
+  FILE *f = g_fopen(tmp, "wb");
+  if(f)
+  {
+    fprintf(f, "%d %d %d\n", g->min_mip, g->max_mip, g_array_index(g->imgids, int32_t, g->watermark - 1));
+    if(!fclose(f)) g_rename(tmp, g->checkpoint);
+  }
+  g_free(tmp);
+  g->last_checkpoint = dt_get_wtime();
+}
+
+static size_t _file_size(const int32_t imgid)
+{
+  char filename[PATH_MAX] = { 0 };
+  gboolean from_cache = FALSE;
+  dt_image_full_path(imgid, filename, sizeof(filename), &from_cache);
+  GStatBuf statbuf;
+  return g_stat(filename, &statbuf) ? 0 : statbuf.st_size;
+}
+
+static void *_generate_thread(void *data)
+{
+  generate_cache_t *g = (generate_cache_t *)data;
+#ifdef _OPENMP
+  omp_set_num_threads(g->omp_threads);
+#endif
+  while(TRUE)
+  {
+    dt_pthread_mutex_lock(&g->mutex);
+    if(g->next >= g->imgids->len)
+    {
+      dt_pthread_mutex_unlock(&g->mutex);
+      break;
+    }
+    const size_t index = g->next++;
+    dt_pthread_mutex_unlock(&g->mutex);
+    const int32_t imgid = g_array_index(g->imgids, int32_t, index);
+
+    size_t bytes_out = 0, bytes_in = 0;
+    for(int k = g->max_mip; k >= (int)g->min_mip && k >= 0; k--)
+    {
+      // if the thumbnail is already on disc - do nothing
+      if(_thumbnail_exists(g, imgid, k)) continue;
+
+      // else, generate thumbnail and store in mipmap cache.
+      dt_mipmap_buffer_t buf;
+      dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
+      bytes_out += (size_t)buf.width * buf.height * 4;
+      dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+      // the largest one has to read the image, the rest is downsampled from it
+      if(!bytes_in) bytes_in = _file_size(imgid);
+    }
+
+    // and immediately write thumbs to disc and remove from mipmap cache.
+    dt_mimap_cache_evict(darktable.mipmap_cache, imgid);
+
+    dt_pthread_mutex_lock(&g->mutex);
+    g->done[index] = 1;
+    while(g->watermark < g->imgids->len && g->done[g->watermark]) g->watermark++;
+    g->counter++;
+    g->bytes_in += bytes_in;
+    g->bytes_out += bytes_out;
+    fprintf(stderr, "image %zu/%u (%.02f%%) (id:%d)\n", g->counter, g->imgids->len,
+            100.0 * g->counter / (float)g->imgids->len, imgid);
+    if(dt_get_wtime() - g->last_checkpoint > CHECKPOINT_INTERVAL) _write_checkpoint(g);
+    dt_pthread_mutex_unlock(&g->mutex);
+  }
+  return NULL;
+}
+
+static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mipmap_size_t max_mip,
+                                    int32_t min_imgid, const int32_t max_imgid, int threads,
+                                    const gboolean resume)
 {
   fprintf(stderr, _("creating cache directories\n"));
   for(dt_mipmap_size_t k = min_mip; k <= max_mip; k++)
@@ -56,64 +194,84 @@ static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mip
     }
   }
 
-  // some progress counter
-  sqlite3_stmt *stmt;
-  size_t image_count = 0, counter = 0;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT COUNT(*) FROM main.images WHERE id >= ?1 AND id <= ?2", -1, &stmt, 0);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, min_imgid);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, max_imgid);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    image_count = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
-  }
-  else
-  {
-    return 1;
-  }
+  generate_cache_t g = { 0 };
+  g.min_mip = min_mip;
+  g.max_mip = max_mip;
+  snprintf(g.checkpoint, sizeof(g.checkpoint), "%s.d/generate-cache.checkpoint", darktable.mipmap_cache->cachedir);
 
-  if(!image_count)
+  if(resume)
   {
-    fprintf(stderr, _("warning: no images are matching the requested image id range\n"));
-    if(min_imgid > max_imgid)
+    const int32_t last = _read_checkpoint(&g);
+    if(last >= min_imgid)
     {
-      fprintf(stderr, _("warning: did you want to swap these boundaries?\n"));
+      fprintf(stderr, _("resuming after image id %d\n"), last);
+      min_imgid = last + 1;
     }
   }
 
-  // go through all images:
+  for(dt_mipmap_size_t k = min_mip; k <= max_mip; k++) g.existing[k] = _scan_existing(k);
+
+  // collect all images which miss at least one thumbnail
+  sqlite3_stmt *stmt;
+  size_t image_count = 0, skipped = 0;
+  g.imgids = g_array_new(FALSE, FALSE, sizeof(int32_t));
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT id FROM main.images WHERE id >= ?1 AND id <= ?2", -1, &stmt, 0);
+                              "SELECT id FROM main.images WHERE id >= ?1 AND id <= ?2 ORDER BY id", -1, &stmt, 0);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, min_imgid);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, max_imgid);
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
     const int32_t imgid = sqlite3_column_int(stmt, 0);
+    image_count++;
+    gboolean complete = TRUE;
+    for(dt_mipmap_size_t k = min_mip; k <= max_mip && complete; k++) complete = _thumbnail_exists(&g, imgid, k);
+    if(complete)
+      skipped++;
+    else
+      g_array_append_val(g.imgids, imgid);
+  }
+  sqlite3_finalize(stmt);
 
-    counter++;
-    fprintf(stderr, "image %zu/%zu (%.02f%%) (id:%d)\n", counter, image_count, 100.0 * counter / (float)image_count, imgid);
-
-    for(int k = max_mip; k >= min_mip && k >= 0; k--)
+  if(!image_count)
+  {
+    fprintf(stderr, _("warning: no images are matching the requested image id range\n"));
+    if(min_imgid > max_imgid)
     {
-      char filename[PATH_MAX] = { 0 };
-      snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", darktable.mipmap_cache->cachedir, k, imgid);
-
-      // if the thumbnail is already on disc - do nothing
-      if(!access(filename, R_OK)) continue;
-
-      // else, generate thumbnail and store in mipmap cache.
-      dt_mipmap_buffer_t buf;
-      dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
-      dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+      fprintf(stderr, _("warning: did you want to swap these boundaries?\n"));
     }
-
-    // and immediately write thumbs to disc and remove from mipmap cache.
-    dt_mimap_cache_evict(darktable.mipmap_cache, imgid);
   }
-
-  sqlite3_finalize(stmt);
-  fprintf(stderr, "done\n");
+  if(skipped) fprintf(stderr, _("skipping %zu images which already have all thumbnails\n"), skipped);
+
+  // every thread runs its own pipe, and gets a share of the cores for it
+  threads = CLAMP(threads, 1, MAX(1, (int)g.imgids->len));
+  g.omp_threads = MAX(1, darktable.num_openmp_threads / threads);
+  g.done = (uint8_t *)calloc(MAX(1, g.imgids->len), sizeof(uint8_t));
+  dt_pthread_mutex_init(&g.mutex, NULL);
+  g.last_checkpoint = dt_get_wtime();
+  fprintf(stderr, _("generating thumbnails for %u images with %d threads\n"), g.imgids->len, threads);
+
+  const double start = dt_get_wtime();
+  pthread_t *thread = (pthread_t *)calloc(threads, sizeof(pthread_t));
+  int started = 0;
+  for(; started < threads; started++)
+    if(dt_pthread_create(&thread[started], _generate_thread, &g)) break;
+  // no threads at all? do it ourselves
+  if(!started) _generate_thread(&g);
+  for(int k = 0; k < started; k++) pthread_join(thread[k], NULL);
+  const double elapsed = MAX(dt_get_wtime() - start, 1e-6);
+  free(thread);
+
+  // all done, the next run starts over
+  g_unlink(g.checkpoint);
+
+  fprintf(stderr, _("done, %zu images in %.1f s: %.2f images/s, %.2f MB/s read, %.2f MB/s of thumbnails\n"),
+          g.counter, elapsed, g.counter / elapsed, g.bytes_in / (1024.0 * 1024.0) / elapsed,
+          g.bytes_out / (1024.0 * 1024.0) / elapsed);
+
+  dt_pthread_mutex_destroy(&g.mutex);
+  free(g.done);
+  g_array_free(g.imgids, TRUE);
+  for(dt_mipmap_size_t k = min_mip; k <= max_mip; k++) g_hash_table_destroy(g.existing[k]);
 
   return 0;
 }
@@ -125,13 +283,18 @@ static void usage(const char *progname)
       "usage: %s [-h, --help; --version]\n"
       "  [--min-mip <0-7> (default = 0)] [-m, --max-mip <0-7> (default = 2)]\n"
       "  [--min-imgid <N>] [--max-imgid <N>]\n"
+      "  [-j, --threads <N> (default = worker_threads)] [--no-resume]\n"
       "  [--core <darktable options>]\n"
       "\n"
       "When multiple mipmap sizes are requested, the biggest one is computed\n"
       "while the rest are quickly downsampled.\n"
       "\n"
       "The --min-imgid and --max-imgid specify the range of internal image ID\n"
-      "numbers to work on.\n",
+      "numbers to work on.\n"
+      "\n"
+      "Images are processed by several threads at once. Progress is saved\n"
+      "regularly, an interrupted run continues where it stopped unless\n"
+      "--no-resume is given.\n",
       progname);
 }
 
@@ -148,6 +311,8 @@ int main(int argc, char *arg[])
   dt_mipmap_size_t max_mip = DT_MIPMAP_2;
   int32_t min_imgid = 0;
   int32_t max_imgid = INT32_MAX;
+  int threads = 0;
+  gboolean resume = TRUE;
 
   int k;
   for(k = 1; k < argc; k++)
@@ -182,6 +347,15 @@ int main(int argc, char *arg[])
       k++;
       max_imgid = (int32_t)MIN(MAX(atoi(arg[k]), 0), INT32_MAX);
     }
+    else if((!strcmp(arg[k], "-j") || !strcmp(arg[k], "--threads")) && argc > k + 1)
+    {
+      k++;
+      threads = MAX(atoi(arg[k]), 1);
+    }
+    else if(!strcmp(arg[k], "--no-resume"))
+    {
+      resume = FALSE;
+    }
     else if(!strcmp(arg[k], "--core"))
     {
       // everything from here on should be passed to the core
@@ -225,7 +399,10 @@ int main(int argc, char *arg[])
 
   fprintf(stderr, _("creating complete lighttable thumbnail cache\n"));
 
-  if(generate_thumbnail_cache(min_mip, max_mip, min_imgid, max_imgid))
+  // the same number of threads darktable would use for its background jobs
+  if(!threads) threads = CLAMP(dt_conf_get_int("worker_threads"), 1, 8);
+
+  if(generate_thumbnail_cache(min_mip, max_mip, min_imgid, max_imgid, threads, resume))
   {
     free(m_arg);
     exit(EXIT_FAILURE);
@@ -333,6 +333,11 @@ const char *extension(dt_imageio_module_data_t *data)
   return "exr";
 }
 
+int flags(dt_imageio_module_data_t *data)
+{
+  return FORMAT_FLAGS_PARALLEL_WRITE;
+}
+
 const char *name()
 {
   return _("OpenEXR (float)");
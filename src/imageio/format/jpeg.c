@@ -556,7 +556,7 @@ const char *extension(dt_imageio_module_data_t *data)
 
 int flags(dt_imageio_module_data_t *data)
 {
-  return FORMAT_FLAGS_SUPPORT_XMP;
+  return FORMAT_FLAGS_SUPPORT_XMP | FORMAT_FLAGS_PARALLEL_WRITE;
 }
 
 void init(dt_imageio_module_format_t *self)
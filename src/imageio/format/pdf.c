@@ -411,6 +411,7 @@ const char *name()
 
 int flags(dt_imageio_module_data_t *data)
 {
+  // one document for all images, so no FORMAT_FLAGS_PARALLEL_WRITE
   return FORMAT_FLAGS_NO_TMPFILE;
 }
 
@@ -113,6 +113,11 @@ const char *extension(dt_imageio_module_data_t *data)
   return "pfm";
 }
 
+int flags(dt_imageio_module_data_t *data)
+{
+  return FORMAT_FLAGS_PARALLEL_WRITE;
+}
+
 const char *name()
 {
   return _("PFM (float)");
@@ -102,6 +102,11 @@ const char *extension(dt_imageio_module_data_t *data)
   return "ppm";
 }
 
+int flags(dt_imageio_module_data_t *data)
+{
+  return FORMAT_FLAGS_PARALLEL_WRITE;
+}
+
 const char *name()
 {
   return _("PPM (16-bit)");
@@ -342,7 +342,7 @@ void gui_reset(dt_imageio_module_format_t *self)
 int flags(dt_imageio_module_data_t *data)
 {
   // TODO(jinxos): support embedded XMP/ICC
-  return 0;
+  return FORMAT_FLAGS_PARALLEL_WRITE;
 }
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
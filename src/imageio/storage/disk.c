@@ -32,10 +32,13 @@
 #include "gui/gtk.h"
 #include "gui/gtkentry.h"
 #include "imageio/storage/imageio_storage_api.h"
+#include <errno.h>
+#include <fcntl.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 DT_MODULE(2)
 
@@ -187,6 +190,12 @@ void gui_reset(dt_imageio_module_storage_t *self)
   dt_bauhaus_combobox_set(d->overwrite, 0);
 }
 
+int flags(dt_imageio_module_storage_t *self)
+{
+  // store() synchronizes access to the shared state
+  return STORAGE_FLAGS_PARALLEL_STORE;
+}
+
 int store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, const int imgid,
           dt_imageio_module_format_t *format, dt_imageio_module_data_t *fdata, const int num, const int total,
           const gboolean high_quality, const gboolean upscale)
@@ -198,6 +207,7 @@ int store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, co
   gboolean from_cache = FALSE;
   dt_image_full_path(imgid, dirname, sizeof(dirname), &from_cache);
   int fail = 0;
+  gboolean reserved = FALSE;
   // we're potentially called in parallel. have sequence number synchronized:
   dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
   {
@@ -280,16 +290,20 @@ try_again:
 
   /* prevent overwrite of files */
   failed:
-    if(!d->overwrite)
+    if(!d->overwrite && !fail)
     {
+      // create the file right away: stores run in parallel and the name must be taken before we unlock
       int seq = 1;
-      if(!fail && g_file_test(filename, G_FILE_TEST_EXISTS))
+      int fd;
+      while((fd = g_open(filename, O_WRONLY | O_CREAT | O_EXCL, 0666)) == -1 && errno == EEXIST)
+      {
+        sprintf(c, "_%.2d.%s", seq, ext);
+        seq++;
+      }
+      if(fd != -1)
       {
-        do
-        {
-          sprintf(c, "_%.2d.%s", seq, ext);
-          seq++;
-        } while(g_file_test(filename, G_FILE_TEST_EXISTS));
+        close(fd);
+        reserved = TRUE;
       }
     }
   } // end of critical block
@@ -299,6 +313,8 @@ try_again:
   /* export image to file */
   if(dt_imageio_export(imgid, filename, format, fdata, high_quality, upscale, TRUE, self, sdata, num, total) != 0)
   {
+    // don't leave the empty placeholder behind
+    if(reserved) g_unlink(filename);
     fprintf(stderr, "[imageio_storage_disk] could not export to file: `%s'!\n", filename);
     dt_control_log(_("could not export to file `%s'!"), filename);
     return 1;
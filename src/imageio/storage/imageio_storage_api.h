@@ -68,6 +68,8 @@ int store(struct dt_imageio_module_storage_t *self, struct dt_imageio_module_dat
           const int num, const int total, const gboolean high_quality, const gboolean upscale);
 /* called once at the end (after exporting all images), if implemented. */
 void finalize_store(struct dt_imageio_module_storage_t *self, struct dt_imageio_module_data_t *data);
+/* dt_imageio_storage_flags_t of this storage, 0 if not implemented */
+int flags(struct dt_imageio_module_storage_t *self);
 
 void *legacy_params(struct dt_imageio_module_storage_t *self, const void *const old_params,
                     const size_t old_params_size, const int old_version, const int new_version,
@@ -208,6 +208,12 @@ static gint sort_pos(pair_t *a, pair_t *b)
   return a->pos - b->pos;
 }
 
+int flags(dt_imageio_module_storage_t *self)
+{
+  // store() synchronizes access to the shared state
+  return STORAGE_FLAGS_PARALLEL_STORE;
+}
+
 int store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, const int imgid,
           dt_imageio_module_format_t *format, dt_imageio_module_data_t *fdata, const int num, const int total,
           const gboolean high_quality, const gboolean upscale)
@@ -300,7 +300,7 @@ int groups()
 
 int flags()
 {
-  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING;
+  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_POINTWISE;
 }
 
 static void set_presets(dt_iop_module_so_t *self, const basecurve_preset_t *presets, int count, int *force_autoapply)
@@ -1158,6 +1158,9 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
   d->exposure_stops = p->exposure_stops;
   d->exposure_bias = p->exposure_bias;
 
+  // exposure fusion blends laplacian pyramids of the whole image
+  if(d->exposure_fusion) piece->process_bands_ready = 0;
+
   const int ch = 0;
   // take care of possible change of curve type or number of nodes (not yet implemented in UI)
   if(d->basecurve_type != p->basecurve_type[ch] || d->basecurve_nodes != p->basecurve_nodes[ch])
@@ -419,6 +419,10 @@ int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, floa
   float ma, mb, md, me, mg, mh;
   keystone_get_matrix(k_space, kxa, kxb, kxc, kxd, kya, kyb, kyc, kyd, &ma, &mb, &md, &me, &mg, &mh);
 
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) default(none) \
+    shared(d, points, points_count, k_space, ma, mb, md, me, mg, mh, factor) if(points_count > 100)
+#endif
   for(size_t i = 0; i < points_count * 2; i += 2)
   {
     float pi[2], po[2];
@@ -483,6 +487,10 @@ int distort_backtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
   float ma, mb, md, me, mg, mh;
   keystone_get_matrix(k_space, kxa, kxb, kxc, kxd, kya, kyb, kyc, kyd, &ma, &mb, &md, &me, &mg, &mh);
 
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) default(none) \
+    shared(d, points, points_count, k_space, ma, mb, md, me, mg, mh, factor) if(points_count > 100)
+#endif
   for(size_t i = 0; i < points_count * 2; i += 2)
   {
     float pi[2], po[2];
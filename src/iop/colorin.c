@@ -20,6 +20,7 @@
 #include "config.h"
 #endif
 #include "bauhaus/bauhaus.h"
+#include "common/color_lut.h"
 #include "common/colormatrices.c"
 #include "common/colorspaces.h"
 #include "common/colorspaces_inline_conversions.h"
@@ -96,6 +97,9 @@ typedef struct dt_iop_colorin_data_t
   cmsHTRANSFORM *xform_cam_Lab;
   cmsHTRANSFORM *xform_cam_nrgb;
   cmsHTRANSFORM *xform_nrgb_Lab;
+  dt_color_lut_t *clut_cam_Lab; // baked xforms, if any
+  dt_color_lut_t *clut_cam_nrgb;
+  dt_color_lut_t *clut_nrgb_Lab;
   float lut[3][LUT_SAMPLES];
   float cmatrix[9];
   float nmatrix[9];
@@ -118,7 +122,7 @@ int groups()
 
 int flags()
 {
-  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_ONE_INSTANCE;
+  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_POINTWISE;
 }
 
 int legacy_params(dt_iop_module_t *self, const void *const old_params, const int old_version,
@@ -769,11 +773,11 @@ static void process_lcms2_bm(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_
     // convert to (L,a/L,b/L) to be able to change L without changing saturation.
     if(!d->nrgb)
     {
-      cmsDoTransform(d->xform_cam_Lab, out, out, roi_out->width);
+      dt_color_lut_transform(d->clut_cam_Lab, d->xform_cam_Lab, out, out, roi_out->width);
     }
     else
     {
-      cmsDoTransform(d->xform_cam_nrgb, out, out, roi_out->width);
+      dt_color_lut_transform(d->clut_cam_nrgb, d->xform_cam_nrgb, out, out, roi_out->width);
 
       float *rgbptr = (float *)out;
       for(int j = 0; j < roi_out->width; j++, rgbptr += 4)
@@ -784,7 +788,7 @@ static void process_lcms2_bm(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_
         }
       }
 
-      cmsDoTransform(d->xform_nrgb_Lab, out, out, roi_out->width);
+      dt_color_lut_transform(d->clut_nrgb_Lab, d->xform_nrgb_Lab, out, out, roi_out->width);
     }
   }
 }
@@ -808,11 +812,11 @@ static void process_lcms2_proper(struct dt_iop_module_t *self, dt_dev_pixelpipe_
     // convert to (L,a/L,b/L) to be able to change L without changing saturation.
     if(!d->nrgb)
     {
-      cmsDoTransform(d->xform_cam_Lab, in, out, roi_out->width);
+      dt_color_lut_transform(d->clut_cam_Lab, d->xform_cam_Lab, in, out, roi_out->width);
     }
     else
     {
-      cmsDoTransform(d->xform_cam_nrgb, in, out, roi_out->width);
+      dt_color_lut_transform(d->clut_cam_nrgb, d->xform_cam_nrgb, in, out, roi_out->width);
 
       float *rgbptr = (float *)out;
       for(int j = 0; j < roi_out->width; j++, rgbptr += 4)
@@ -823,7 +827,7 @@ static void process_lcms2_proper(struct dt_iop_module_t *self, dt_dev_pixelpipe_
         }
       }
 
-      cmsDoTransform(d->xform_nrgb_Lab, out, out, roi_out->width);
+      dt_color_lut_transform(d->clut_nrgb_Lab, d->xform_nrgb_Lab, out, out, roi_out->width);
     }
   }
 }
@@ -1013,6 +1017,61 @@ static void process_sse2_cmatrix_fastpath_clipping(struct dt_iop_module_t *self,
   _mm_sfence();
 }
 
+#ifdef DT_HAVE_AVX2_CODEPATH
+__attribute__((target("avx2"))) static void
+process_avx2_cmatrix_fastpath_simple(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
+                                     const void *const ivoid, void *const ovoid, const dt_iop_roi_t *const roi_in,
+                                     const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_colorin_data_t *const d = (dt_iop_colorin_data_t *)piece->data;
+  const int ch = piece->colors;
+
+  // only color matrix, same as the sse2 fast path, but two pixels at a time
+  const float *const cmat = d->cmatrix;
+
+  const __m256 cm0 = _mm256_set_ps(0.0f, cmat[6], cmat[3], cmat[0], 0.0f, cmat[6], cmat[3], cmat[0]);
+  const __m256 cm1 = _mm256_set_ps(0.0f, cmat[7], cmat[4], cmat[1], 0.0f, cmat[7], cmat[4], cmat[1]);
+  const __m256 cm2 = _mm256_set_ps(0.0f, cmat[8], cmat[5], cmat[2], 0.0f, cmat[8], cmat[5], cmat[2]);
+
+  const size_t npixels = (size_t)roi_out->width * roi_out->height;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) schedule(static)
+#endif
+  for(size_t k = 0; k < npixels / 2; k++)
+  {
+    float *in = (float *)ivoid + (size_t)ch * 2 * k;
+    float *out = (float *)ovoid + (size_t)ch * 2 * k;
+
+    __m256 input = _mm256_load_ps(in);
+
+    __m256 xyz = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(cm0, _mm256_shuffle_ps(input, input, _MM_SHUFFLE(0, 0, 0, 0))),
+                      _mm256_mul_ps(cm1, _mm256_shuffle_ps(input, input, _MM_SHUFFLE(1, 1, 1, 1)))),
+        _mm256_mul_ps(cm2, _mm256_shuffle_ps(input, input, _MM_SHUFFLE(2, 2, 2, 2))));
+    _mm256_stream_ps(out, dt_XYZ_to_Lab_avx2(xyz));
+  }
+
+  if(npixels & 1)
+  {
+    float *in = (float *)ivoid + (size_t)ch * (npixels - 1);
+    float *out = (float *)ovoid + (size_t)ch * (npixels - 1);
+
+    __m128 input = _mm_load_ps(in);
+
+    const __m128 c0 = _mm256_castps256_ps128(cm0);
+    const __m128 c1 = _mm256_castps256_ps128(cm1);
+    const __m128 c2 = _mm256_castps256_ps128(cm2);
+
+    __m128 xyz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_shuffle_ps(input, input, _MM_SHUFFLE(0, 0, 0, 0))),
+                                       _mm_mul_ps(c1, _mm_shuffle_ps(input, input, _MM_SHUFFLE(1, 1, 1, 1)))),
+                            _mm_mul_ps(c2, _mm_shuffle_ps(input, input, _MM_SHUFFLE(2, 2, 2, 2))));
+    _mm_stream_ps(out, dt_XYZ_to_Lab_sse2(xyz));
+  }
+  _mm_sfence();
+}
+#endif
+
 static void process_sse2_cmatrix_fastpath(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
                                           const void *const ivoid, void *const ovoid,
                                           const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
@@ -1145,11 +1204,11 @@ static void process_sse2_lcms2_bm(struct dt_iop_module_t *self, dt_dev_pixelpipe
     // convert to (L,a/L,b/L) to be able to change L without changing saturation.
     if(!d->nrgb)
     {
-      cmsDoTransform(d->xform_cam_Lab, out, out, roi_out->width);
+      dt_color_lut_transform(d->clut_cam_Lab, d->xform_cam_Lab, out, out, roi_out->width);
     }
     else
     {
-      cmsDoTransform(d->xform_cam_nrgb, out, out, roi_out->width);
+      dt_color_lut_transform(d->clut_cam_nrgb, d->xform_cam_nrgb, out, out, roi_out->width);
 
       float *rgbptr = (float *)out;
       for(int j = 0; j < roi_out->width; j++, rgbptr += 4)
@@ -1162,7 +1221,7 @@ static void process_sse2_lcms2_bm(struct dt_iop_module_t *self, dt_dev_pixelpipe
       }
       _mm_sfence();
 
-      cmsDoTransform(d->xform_nrgb_Lab, out, out, roi_out->width);
+      dt_color_lut_transform(d->clut_nrgb_Lab, d->xform_nrgb_Lab, out, out, roi_out->width);
     }
   }
 }
@@ -1187,11 +1246,11 @@ static void process_sse2_lcms2_proper(struct dt_iop_module_t *self, dt_dev_pixel
     // convert to (L,a/L,b/L) to be able to change L without changing saturation.
     if(!d->nrgb)
     {
-      cmsDoTransform(d->xform_cam_Lab, in, out, roi_out->width);
+      dt_color_lut_transform(d->clut_cam_Lab, d->xform_cam_Lab, in, out, roi_out->width);
     }
     else
     {
-      cmsDoTransform(d->xform_cam_nrgb, in, out, roi_out->width);
+      dt_color_lut_transform(d->clut_cam_nrgb, d->xform_cam_nrgb, in, out, roi_out->width);
 
       float *rgbptr = (float *)out;
       for(int j = 0; j < roi_out->width; j++, rgbptr += 4)
@@ -1204,7 +1263,7 @@ static void process_sse2_lcms2_proper(struct dt_iop_module_t *self, dt_dev_pixel
       }
       _mm_sfence();
 
-      cmsDoTransform(d->xform_nrgb_Lab, out, out, roi_out->width);
+      dt_color_lut_transform(d->clut_nrgb_Lab, d->xform_nrgb_Lab, out, out, roi_out->width);
     }
   }
 }
@@ -1249,6 +1308,27 @@ void process_sse2(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, c
 }
 #endif
 
+#ifdef DT_HAVE_AVX2_CODEPATH
+__attribute__((target("avx2"))) void process_avx2(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
+                                                  const void *const ivoid, void *const ovoid,
+                                                  const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_colorin_data_t *const d = (dt_iop_colorin_data_t *)piece->data;
+  const int blue_mapping = d->blue_mapping && piece->pipe->image.flags & DT_IMAGE_RAW;
+
+  // only the plain matrix fast path has an avx2 version so far
+  if(d->type == DT_COLORSPACE_LAB || isnan(d->cmatrix[0]) || blue_mapping || d->nonlinearlut != 0 || d->nrgb)
+  {
+    process_sse2(self, piece, ivoid, ovoid, roi_in, roi_out);
+    return;
+  }
+
+  process_avx2_cmatrix_fastpath_simple(self, piece, ivoid, ovoid, roi_in, roi_out);
+
+  if(piece->pipe->mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK) dt_iop_alpha_copy(ivoid, ovoid, roi_out->width, roi_out->height);
+}
+#endif
+
 static void mat3mul(float *dst, const float *const m1, const float *const m2)
 {
   for(int k = 0; k < 3; k++)
@@ -1311,6 +1391,10 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
       d->nrgb = NULL;
   }
 
+  dt_color_lut_release(d->clut_cam_Lab);
+  dt_color_lut_release(d->clut_cam_nrgb);
+  dt_color_lut_release(d->clut_nrgb_Lab);
+  d->clut_cam_Lab = d->clut_cam_nrgb = d->clut_nrgb_Lab = NULL;
   if(d->xform_cam_Lab)
   {
     cmsDeleteTransform(d->xform_cam_Lab);
@@ -1520,6 +1604,7 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
     d->nrgb = NULL;
     d->input = dt_colorspaces_get_profile(DT_COLORSPACE_LIN_REC709, "", DT_PROFILE_DIRECTION_IN)->profile;
     d->clear_input = 0;
+    input_format = TYPE_RGBA_FLT;
     if(dt_colorspaces_get_matrix_from_input_profile(d->input, d->cmatrix, d->lut[0], d->lut[1], d->lut[2],
                                                     LUT_SAMPLES, p->intent))
     {
@@ -1529,6 +1614,18 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
     }
   }
 
+  // sample the lcms2 transforms into luts, pixels outside of the sampled range still go through lcms2
+  if(d->xform_cam_Lab && !d->nrgb)
+    d->clut_cam_Lab = dt_color_lut_get(d->xform_cam_Lab, d->input, input_format, Lab, TYPE_LabA_FLT, NULL,
+                                       p->intent, 0);
+  if(d->xform_cam_nrgb && d->xform_nrgb_Lab)
+  {
+    d->clut_cam_nrgb = dt_color_lut_get(d->xform_cam_nrgb, d->input, input_format, d->nrgb, TYPE_RGBA_FLT,
+                                        NULL, p->intent, 0);
+    d->clut_nrgb_Lab = dt_color_lut_get(d->xform_nrgb_Lab, d->nrgb, TYPE_RGBA_FLT, Lab, TYPE_LabA_FLT, NULL,
+                                        p->intent, 0);
+  }
+
   d->nonlinearlut = 0;
 
   // now try to initialize unbounded mode:
@@ -1561,6 +1658,9 @@ void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pi
   d->xform_cam_Lab = NULL;
   d->xform_cam_nrgb = NULL;
   d->xform_nrgb_Lab = NULL;
+  d->clut_cam_Lab = NULL;
+  d->clut_cam_nrgb = NULL;
+  d->clut_nrgb_Lab = NULL;
   self->commit_params(self, self->default_params, pipe, piece);
 }
 
@@ -1568,6 +1668,10 @@ void cleanup_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev
 {
   dt_iop_colorin_data_t *d = (dt_iop_colorin_data_t *)piece->data;
   if(d->input && d->clear_input) dt_colorspaces_cleanup_profile(d->input);
+  dt_color_lut_release(d->clut_cam_Lab);
+  dt_color_lut_release(d->clut_cam_nrgb);
+  dt_color_lut_release(d->clut_nrgb_Lab);
+  d->clut_cam_Lab = d->clut_cam_nrgb = d->clut_nrgb_Lab = NULL;
   if(d->xform_cam_Lab)
   {
     cmsDeleteTransform(d->xform_cam_Lab);
@@ -20,6 +20,7 @@
 #include "config.h"
 #endif
 #include "bauhaus/bauhaus.h"
+#include "common/color_lut.h"
 #include "common/colorspaces.h"
 #include "common/colorspaces_inline_conversions.h"
 #include "common/opencl.h"
@@ -53,6 +54,7 @@ typedef struct dt_iop_colorout_data_t
   float lut[3][LUT_SAMPLES];
   float cmatrix[9];
   cmsHTRANSFORM *xform;
+  dt_color_lut_t *clut; // baked xform, if any
   float unbounded_coeffs[3][3]; // for extrapolation of shaper curves
 } dt_iop_colorout_data_t;
 
@@ -86,7 +88,7 @@ int groups()
 
 int flags()
 {
-  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_ONE_INSTANCE;
+  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_POINTWISE;
 }
 
 int legacy_params(dt_iop_module_t *self, const void *const old_params, const int old_version,
@@ -372,7 +374,7 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
       const float *in = ((float *)ivoid) + (size_t)ch * k * roi_out->width;
       float *out = ((float *)ovoid) + (size_t)ch * k * roi_out->width;
 
-      cmsDoTransform(d->xform, in, out, roi_out->width);
+      dt_color_lut_transform(d->clut, d->xform, in, out, roi_out->width);
 
       if(gamutcheck)
       {
@@ -447,7 +449,7 @@ void process_sse2(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, c
       const float *in = ((float *)ivoid) + (size_t)ch * k * roi_out->width;
       float *out = ((float *)ovoid) + (size_t)ch * k * roi_out->width;
 
-      cmsDoTransform(d->xform, in, out, roi_out->width);
+      dt_color_lut_transform(d->clut, d->xform, in, out, roi_out->width);
 
       if(gamutcheck)
       {
@@ -516,6 +518,8 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
 
   d->mode = pipe->type == DT_DEV_PIXELPIPE_FULL ? darktable.color_profiles->mode : DT_PROFILE_NORMAL;
 
+  dt_color_lut_release(d->clut);
+  d->clut = NULL;
   if(d->xform)
   {
     cmsDeleteTransform(d->xform);
@@ -655,6 +659,12 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
     }
   }
 
+  // sample the transform into a lut unless the user wants lcms2 itself. the gamut check marks single
+  // pixels, interpolating between the nodes would blur that.
+  if(d->xform && !force_lcms2 && !(transformFlags & cmsFLAGS_GAMUTCHECK))
+    d->clut = dt_color_lut_get(d->xform, Lab, TYPE_LabA_FLT, output, output_format, softproof, out_intent,
+                               transformFlags);
+
   if(out_type == DT_COLORSPACE_DISPLAY) pthread_rwlock_unlock(&darktable.color_profiles->xprofile_lock);
 
   // now try to initialize unbounded mode:
@@ -687,12 +697,15 @@ void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pi
   piece->data = calloc(1, sizeof(dt_iop_colorout_data_t));
   dt_iop_colorout_data_t *d = (dt_iop_colorout_data_t *)piece->data;
   d->xform = NULL;
+  d->clut = NULL;
   self->commit_params(self, self->default_params, pipe, piece);
 }
 
 void cleanup_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
   dt_iop_colorout_data_t *d = (dt_iop_colorout_data_t *)piece->data;
+  dt_color_lut_release(d->clut);
+  d->clut = NULL;
   if(d->xform)
   {
     cmsDeleteTransform(d->xform);
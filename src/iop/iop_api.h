@@ -167,6 +167,11 @@ void process_tiling(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
 void process_sse2(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, const void *const i,
                   void *const o, const struct dt_iop_roi_t *const roi_in,
                   const struct dt_iop_roi_t *const roi_out);
+/** a variant of process_sse2(), built with __attribute__((target("avx2"))), see DT_HAVE_AVX2_CODEPATH. */
+/** can be provided by each IOP that also provides process_sse2(). */
+void process_avx2(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, const void *const i,
+                  void *const o, const struct dt_iop_roi_t *const roi_in,
+                  const struct dt_iop_roi_t *const roi_out);
 #endif
 
 #ifdef HAVE_OPENCL
@@ -793,6 +793,21 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
   return;
 }
 
+// mask shapes hand in thousands of points at once, so spread them over the threads
+static void _distort_points(lfModifier *modifier, float *points, size_t points_count)
+{
+#ifdef _OPENMP
+#pragma omp parallel for default(none) shared(modifier, points, points_count) schedule(static) if(points_count > 100)
+#endif
+  for(size_t i = 0; i < points_count * 2; i += 2)
+  {
+    float buf[2 * 3];
+    lf_modifier_apply_subpixel_geometry_distortion(modifier, points[i], points[i + 1], 1, 1, buf);
+    points[i] = buf[0];
+    points[i + 1] = buf[3];
+  }
+}
+
 int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, float *points, size_t points_count)
 {
   dt_iop_lensfun_data_t *d = (dt_iop_lensfun_data_t *)piece->data;
@@ -804,18 +819,8 @@ int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, floa
 
   int modflags = lf_modifier_initialize(modifier, d->lens, LF_PF_F32, d->focal, d->aperture, d->distance,
                                         d->scale, d->target_geom, d->modify_flags, !d->inverse);
-  float *buf = malloc(2 * 3 * sizeof(float));
-
-  for(size_t i = 0; i < points_count * 2; i += 2)
-  {
-    if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
-    {
-      lf_modifier_apply_subpixel_geometry_distortion(modifier, points[i], points[i + 1], 1, 1, buf);
-      points[i] = buf[0];
-      points[i + 1] = buf[3];
-    }
-  }
-  free(buf);
+  if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
+    _distort_points(modifier, points, points_count);
   lf_modifier_destroy(modifier);
 
   return 1;
@@ -831,18 +836,8 @@ int distort_backtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
 
   int modflags = lf_modifier_initialize(modifier, d->lens, LF_PF_F32, d->focal, d->aperture, d->distance,
                                         d->scale, d->target_geom, d->modify_flags, d->inverse);
-  float *buf = malloc(2 * 3 * sizeof(float));
-
-  for(size_t i = 0; i < points_count * 2; i += 2)
-  {
-    if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
-    {
-      lf_modifier_apply_subpixel_geometry_distortion(modifier, points[i], points[i + 1], 1, 1, buf);
-      points[i] = buf[0];
-      points[i + 1] = buf[3];
-    }
-  }
-  free(buf);
+  if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
+    _distort_points(modifier, points, points_count);
   lf_modifier_destroy(modifier);
   return 1;
 }
@@ -124,7 +124,7 @@ int groups()
 
 int flags()
 {
-  return IOP_FLAGS_SUPPORTS_BLENDING;
+  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_POINTWISE;
 }
 
 int legacy_params(dt_iop_module_t *self, const void *const old_params, const int old_version,
@@ -437,6 +437,9 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
     }
 
     // commit_params_late() will compute LUT later
+
+    // the LUT depends on the histogram of the whole image, no row bands
+    piece->process_bands_ready = 0;
   }
   else
   {
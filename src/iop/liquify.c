@@ -234,6 +234,21 @@ typedef struct {
   dt_liquify_path_data_t nodes[MAX_NODES];
 } dt_iop_liquify_params_t;
 
+// a distortion map together with what it was built for.
+
+typedef struct {
+  uint64_t hash;                  ///< hash of the (distorted) params the map was built from
+  cairo_rectangle_int_t extent;
+  float complex *map;
+} dt_liquify_map_t;
+
+typedef struct {
+  dt_iop_liquify_params_t params; ///< has to stay first, the pipe data is read as params too
+  dt_pthread_mutex_t lock;        ///< protects xmap, distort_transform() runs concurrently with process()
+  dt_liquify_map_t map;           ///< last map of process(), only touched by the pipe itself
+  dt_liquify_map_t xmap[2];       ///< last maps of distort_backtransform() and distort_transform()
+} dt_iop_liquify_data_t;
+
 typedef struct {
   int warp_kernel;
 } dt_iop_liquify_global_data_t;
@@ -838,19 +853,8 @@ static void build_round_stamp (float complex **pstamp,
     (strength * STAMP_RELOCATION) : strength;
   const float abs_strength = cabs (strength);
 
-  float complex *stamp = malloc (sizeof (float complex)
-                                 * stamp_extent->width * stamp_extent->height);
-
   // clear memory
-  #ifdef _OPENMP
-  #pragma omp parallel for schedule (static) default (shared)
-  #endif
-
-  for (int i = 0; i < stamp_extent->height; i++)
-  {
-    float complex *row = stamp + i * stamp_extent->width;
-    memset (row, 0, sizeof (float complex) * stamp_extent->width);
-  }
+  float complex *stamp = calloc (stamp_extent->width * stamp_extent->height, sizeof (float complex));
 
   // lookup table: map of distance from center point => warp
   const int table_size = iradius * LOOKUP_OVERSAMPLE;
@@ -861,11 +865,9 @@ static void build_round_stamp (float complex **pstamp,
 
   // The expensive operation here is hypotf ().  By dividing the
   // circle in octants and doing only the inside we have to calculate
-  // hypotf only for PI / 32 = 0.098 of the stamp area.
-  #ifdef _OPENMP
-  #pragma omp parallel for schedule (dynamic, 1) default (shared)
-  #endif
-
+  // hypotf only for PI / 32 = 0.098 of the stamp area.  This runs
+  // single threaded, create_global_distortion_map() builds the stamps
+  // of all warps in parallel.
   for (int y = 0; y <= iradius; y++)
   {
     for (int x = y; x <= iradius; x++)
@@ -949,11 +951,7 @@ static void add_to_global_distortion_map (float complex *global_map,
   cairo_region_t *mmreg = cairo_region_create_rectangle (&mmext);
   cairo_region_intersect_rectangle (mmreg, global_map_extent);
   cairo_region_get_extents (mmreg, &cmmext);
-  free (mmreg);
-
-  #ifdef _OPENMP
-  #pragma omp parallel for schedule (static) default (shared)
-  #endif
+  cairo_region_destroy (mmreg);
 
   for (int y = cmmext.y; y < cmmext.y + cmmext.height; y++)
   {
@@ -1062,19 +1060,59 @@ static float complex *create_global_distortion_map (const cairo_rectangle_int_t
   // allocate distortion map big enough to contain all paths
   const int mapsize = map_extent->width * map_extent->height;
   float complex * map = dt_alloc_align (16, mapsize * sizeof (float complex));
-  memset (map, 0, mapsize * sizeof (float complex));
+  if (map == NULL) return NULL;
 
-  // build map
+  // build the stamps of all warps touching the map, one warp per thread
+  const int n_warps = g_list_length (interpolated);
+  const dt_liquify_warp_t **warps = malloc (n_warps * sizeof (dt_liquify_warp_t *));
+  float complex **stamps = calloc (n_warps, sizeof (float complex *));
+  cairo_rectangle_int_t *stamp_extents = malloc (n_warps * sizeof (cairo_rectangle_int_t));
+  int k = 0;
   for (GList *i = interpolated; i != NULL; i = i->next)
+    warps[k++] = (const dt_liquify_warp_t *) i->data;
+
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule (dynamic) default (none) shared (map_extent, warps, stamps, stamp_extents)
+  #endif
+
+  for (int w = 0; w < n_warps; w++)
   {
-    const dt_liquify_warp_t *warp = ((dt_liquify_warp_t *) i->data);
-    float complex *stamp = NULL;
+    // one pixel of slack, the stamp gets placed at the rounded point
     cairo_rectangle_int_t r;
-    build_round_stamp (&stamp, &r, warp);
-    add_to_global_distortion_map (map, map_extent, warp, stamp, &r);
-    free ((void *) stamp);
+    compute_round_stamp_extent (&r, warps[w]);
+    if (r.x - 1 >= map_extent->x + map_extent->width || r.x + r.width + 1 <= map_extent->x
+        || r.y - 1 >= map_extent->y + map_extent->height || r.y + r.height + 1 <= map_extent->y)
+      continue;
+    build_round_stamp (&stamps[w], &stamp_extents[w], warps[w]);
   }
 
+  // then add them up in bands of rows, every thread adds all warps to
+  // its own rows in the same order as before, so the sums don't depend
+  // on the number of threads.
+  const int band = MAX (16, map_extent->height / (4 * dt_get_num_threads ()));
+  const int n_bands = (map_extent->height + band - 1) / band;
+
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule (dynamic) default (none) shared (map, map_extent, warps, stamps, stamp_extents)
+  #endif
+
+  for (int b = 0; b < n_bands; b++)
+  {
+    const cairo_rectangle_int_t band_extent = { map_extent->x, map_extent->y + b * band, map_extent->width,
+                                                MIN (band, map_extent->height - b * band) };
+    float complex *band_map = map + (size_t) b * band * map_extent->width;
+    memset (band_map, 0, sizeof (float complex) * band_extent.width * band_extent.height);
+    for (int w = 0; w < n_warps; w++)
+      if (stamps[w])
+        add_to_global_distortion_map (band_map, &band_extent, warps[w], stamps[w], &stamp_extents[w]);
+  }
+
+  for (int w = 0; w < n_warps; w++)
+    free ((void *) stamps[w]);
+  free (stamps);
+  free (stamp_extents);
+  free (warps);
+
   if (inverted)
   {
     float complex * const imap = dt_alloc_align (16, mapsize * sizeof (float complex));
@@ -1136,15 +1174,31 @@ static float complex *create_global_distortion_map (const cairo_rectangle_int_t
   return map;
 }
 
-static float complex *build_global_distortion_map (struct dt_iop_module_t *module,
-                                                   const dt_dev_pixelpipe_iop_t *piece,
-                                                   const dt_iop_roi_t *roi_in,
-                                                   const dt_iop_roi_t *roi_out,
-                                                   cairo_rectangle_int_t *map_extent)
+static uint64_t _params_hash (const dt_iop_liquify_params_t *p)
+{
+  // FNV-1a
+  const unsigned char *c = (const unsigned char *) p;
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t k = 0; k < sizeof (dt_iop_liquify_params_t); k++) hash = (hash ^ c[k]) * 1099511628211ull;
+  return hash;
+}
+
+// returns the distortion map for this roi, owned by the piece.  The
+// map only depends on the warps in piece coordinates and on the
+// extent, so it is kept as long as neither the params, the upstream
+// distortions, the scale nor the roi change.
+
+static const float complex *get_global_distortion_map (struct dt_iop_module_t *module,
+                                                       const dt_dev_pixelpipe_iop_t *piece,
+                                                       const dt_iop_roi_t *roi_in,
+                                                       const dt_iop_roi_t *roi_out,
+                                                       cairo_rectangle_int_t *map_extent)
 {
+  dt_iop_liquify_data_t *d = (dt_iop_liquify_data_t *) piece->data;
+
   // copy params
   dt_iop_liquify_params_t copy_params;
-  memcpy(&copy_params, (dt_iop_liquify_params_t *)piece->data, sizeof(dt_iop_liquify_params_t));
+  memcpy(&copy_params, &d->params, sizeof(dt_iop_liquify_params_t));
 
   distort_paths_raw_to_piece (module, piece->pipe, roi_in->scale, &copy_params);
 
@@ -1152,10 +1206,25 @@ static float complex *build_global_distortion_map (struct dt_iop_module_t *modul
 
   _get_map_extent (roi_out, interpolated, map_extent);
 
-  float complex *map = create_global_distortion_map(map_extent, interpolated, FALSE);
+  // nothing to do in this roi
+  if (map_extent->width == 0 || map_extent->height == 0)
+  {
+    g_list_free_full (interpolated, free);
+    return NULL;
+  }
+
+  const uint64_t hash = _params_hash (&copy_params);
+  if (d->map.map == NULL || d->map.hash != hash
+      || memcmp (&d->map.extent, map_extent, sizeof (cairo_rectangle_int_t)))
+  {
+    dt_free_align ((void *) d->map.map);
+    d->map.map = create_global_distortion_map (map_extent, interpolated, FALSE);
+    d->map.hash = hash;
+    d->map.extent = *map_extent;
+  }
 
   g_list_free_full (interpolated, free);
-  return map;
+  return d->map.map;
 }
 
 // 1st pass: how large would the output be, given this input roi?
@@ -1183,7 +1252,7 @@ void modify_roi_in (struct dt_iop_module_t *module,
 
   // copy params
   dt_iop_liquify_params_t copy_params;
-  memcpy(&copy_params, (dt_iop_liquify_params_t*)piece->data, sizeof(dt_iop_liquify_params_t));
+  memcpy(&copy_params, &((dt_iop_liquify_data_t *)piece->data)->params, sizeof(dt_iop_liquify_params_t));
 
   distort_paths_raw_to_piece (module, piece->pipe, roi_in->scale, &copy_params);
 
@@ -1224,8 +1293,20 @@ void modify_roi_in (struct dt_iop_module_t *module,
   g_list_free_full (interpolated, free);
 }
 
+// maps for distort_transform() up to this many pixels are kept for the next call, larger ones are
+// only built for the call at hand.
+#define LIQUIFY_XMAP_MAX_SIZE (2048 * 2048)
+
+static gboolean _extent_contains (const cairo_rectangle_int_t *outer, const cairo_rectangle_int_t *inner)
+{
+  return inner->x >= outer->x && inner->y >= outer->y
+    && inner->x + inner->width <= outer->x + outer->width
+    && inner->y + inner->height <= outer->y + outer->height;
+}
+
 static int _distort_xtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, float *points, size_t points_count, gboolean inverted)
 {
+  dt_iop_liquify_data_t *d = (dt_iop_liquify_data_t *) piece->data;
   const float scale = piece->iscale;
 
   // compute the extent of all points (all computations are done in RAW coordinate)
@@ -1244,23 +1325,45 @@ static int _distort_xtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *pi
   cairo_rectangle_int_t extent = { .x = (int)(xmin - .5), .y = (int)(ymin - .5),
                                    .width = (int)(xmax - xmin + 2.5), .height = (int)(ymax - ymin + 2.5) };
 
-  if (extent.width != 0 && extent.height != 0)
-  {
-    // create the distortion map for this extent
-
-    GList *interpolated = interpolate_paths ((dt_iop_liquify_params_t *)piece->data);
+  if (extent.width == 0 || extent.height == 0) return 1;
 
-    // we need to adjust the extent to be the union enclosing all the points (currently in extent) and
-    // the warps that are in (possibly partly) in this same region.
+  dt_pthread_mutex_lock (&d->lock);
 
-    dt_iop_roi_t roi_in = { .x = extent.x, .y = extent.y, .width = extent.width, .height = extent.height };
-    _get_map_extent (&roi_in, interpolated, &extent);
-
-    float complex *map = create_global_distortion_map (&extent, interpolated, inverted);
+  // we need to adjust the extent to be the union enclosing all the points (currently in extent) and
+  // the warps that are in (possibly partly) in this same region.
+  GList *interpolated = interpolate_paths (&d->params);
+  const dt_iop_roi_t roi_in = { .x = extent.x, .y = extent.y, .width = extent.width, .height = extent.height };
+  _get_map_extent (&roi_in, interpolated, &extent);
+  if (extent.width == 0 || extent.height == 0)
+  {
+    // no warp anywhere near the points
+    dt_pthread_mutex_unlock (&d->lock);
     g_list_free_full (interpolated, free);
+    return 1;
+  }
 
-    if (map == NULL) return 0;
+  // the last map is good for any points it covers, until the params change
+  dt_liquify_map_t *m = &d->xmap[inverted ? 1 : 0];
+  const float complex *map = NULL;
+  float complex *transient = NULL;
+  if (m->map && _extent_contains (&m->extent, &extent))
+  {
+    map = m->map;
+    extent = m->extent;
+  }
+  else if ((size_t) extent.width * extent.height <= LIQUIFY_XMAP_MAX_SIZE)
+  {
+    dt_free_align ((void *) m->map);
+    m->map = create_global_distortion_map (&extent, interpolated, inverted);
+    m->extent = extent;
+    map = m->map;
+  }
+  else
+    map = transient = create_global_distortion_map (&extent, interpolated, inverted);
+  g_list_free_full (interpolated, free);
 
+  if (map)
+  {
     const int map_size =  extent.width * extent.height;
     const int x_last = extent.x + extent.width;
     const int y_last = extent.y + extent.height;
@@ -1281,11 +1384,12 @@ static int _distort_xtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *pi
         *py += cimag(dist);
       }
     }
-
-    dt_free_align ((void *) map);
   }
 
-  return 1;
+  dt_pthread_mutex_unlock (&d->lock);
+  dt_free_align ((void *) transient);
+
+  return map != NULL;
 }
 
 int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, float *points, size_t points_count)
@@ -1321,16 +1425,13 @@ void process(struct dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, cons
   // 2. build the distortion map
 
   cairo_rectangle_int_t map_extent;
-  float complex *map = build_global_distortion_map (module, piece, roi_in, roi_out, &map_extent);
+  const float complex *map = get_global_distortion_map (module, piece, roi_in, roi_out, &map_extent);
   if (map == NULL)
     return;
 
   // 3. apply the map
 
-  if (map_extent.width != 0 && map_extent.height != 0)
-    apply_global_distortion_map (module, piece, in, out, roi_in, roi_out, map, &map_extent);
-
-  dt_free_align ((void *) map);
+  apply_global_distortion_map (module, piece, in, out, roi_in, roi_out, map, &map_extent);
 }
 
 #ifdef HAVE_OPENCL
@@ -1491,16 +1592,13 @@ int process_cl (struct dt_iop_module_t *module,
   // 2. build the distortion map
 
   cairo_rectangle_int_t map_extent;
-  const float complex *map = build_global_distortion_map (module, piece, roi_in, roi_out, &map_extent);
+  const float complex *map = get_global_distortion_map (module, piece, roi_in, roi_out, &map_extent);
   if (map == NULL)
     return TRUE;
 
   // 3. apply the map
 
-  if (map_extent.width != 0 && map_extent.height != 0)
-    err = apply_global_distortion_map_cl (module, piece, dev_in, dev_out, roi_in, roi_out, map, &map_extent);
-
-  dt_free_align ((void *) map);
+  err = apply_global_distortion_map_cl (module, piece, dev_in, dev_out, roi_in, roi_out, map, &map_extent);
   if (err != CL_SUCCESS) goto error;
 
   return TRUE;
@@ -1551,12 +1649,19 @@ void cleanup (dt_iop_module_t *module)
 
 void init_pipe (struct dt_iop_module_t *module, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
-  piece->data = malloc (module->params_size);
+  dt_iop_liquify_data_t *d = (dt_iop_liquify_data_t *) calloc (1, sizeof (dt_iop_liquify_data_t));
+  dt_pthread_mutex_init (&d->lock, NULL);
+  piece->data = d;
   module->commit_params (module, module->default_params, pipe, piece);
 }
 
 void cleanup_pipe (struct dt_iop_module_t *module, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_liquify_data_t *d = (dt_iop_liquify_data_t *) piece->data;
+  dt_free_align ((void *) d->map.map);
+  dt_free_align ((void *) d->xmap[0].map);
+  dt_free_align ((void *) d->xmap[1].map);
+  dt_pthread_mutex_destroy (&d->lock);
   free (piece->data);
   piece->data = NULL;
 }
@@ -1568,7 +1673,19 @@ void commit_params (struct dt_iop_module_t *module,
                     dt_dev_pixelpipe_t *pipe,
                     dt_dev_pixelpipe_iop_t *piece)
 {
-  memcpy (piece->data, params, module->params_size);
+  dt_iop_liquify_data_t *d = (dt_iop_liquify_data_t *) piece->data;
+  if (!memcmp (&d->params, params, module->params_size)) return;
+
+  // the map of process() is keyed by the params and stays, the maps of
+  // the points are only valid for these params.
+  dt_pthread_mutex_lock (&d->lock);
+  memcpy (&d->params, params, module->params_size);
+  for (int k = 0; k < 2; k++)
+  {
+    dt_free_align ((void *) d->xmap[k].map);
+    d->xmap[k].map = NULL;
+  }
+  dt_pthread_mutex_unlock (&d->lock);
 }
 
 // calculate the dot product of 2 vectors.
@@ -110,6 +110,9 @@ int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, floa
 {
   const float scale = piece->buf_in.scale / piece->iscale;
 
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) default(none) shared(piece, points, points_count) if(points_count > 100)
+#endif
   for(size_t i = 0; i < points_count * 2; i += 2)
   {
     float pi[2], po[2];
@@ -131,6 +134,9 @@ int distort_backtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
 {
   const float scale = piece->buf_in.scale / piece->iscale;
 
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) default(none) shared(piece, points, points_count) if(points_count > 100)
+#endif
   for(size_t i = 0; i < points_count * 2; i += 2)
   {
     float pi[2], po[2];
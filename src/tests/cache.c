@@ -18,11 +18,23 @@
 
 
 #define DT_UNIT_TEST
-// define dt alloc, so we don't need to include the rest of dt:
+// define the few bits of dt the cache needs, so we don't need to include the rest of dt:
 #define dt_alloc_align(A, B) malloc(B)
-#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define dt_free_align(A) free(A)
+#define ASAN_POISON_MEMORY_REGION(addr, size) ((void)(addr), (void)(size))
+#define ASAN_UNPOISON_MEMORY_REGION(addr, size) ((void)(addr), (void)(size))
+#ifndef __has_feature
+#define __has_feature(x) 0
+#endif
+#include <sys/time.h>
+static inline double dt_get_wtime(void)
+{
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec - 1290608000 + (1.0 / 1000000.0) * time.tv_usec;
+}
 
-// unit test for the concurrent hopscotch hashmap and the LRU cache built on top of it.
+// multi-threaded throughput benchmark (and sanity check) for the sharded LRU cache.
 #include "common/cache.h"
 #include "common/cache.c"
 
@@ -33,98 +45,129 @@
 #include <omp.h>
 #endif
 
-int32_t alloc_dummy(void *data, const uint32_t key, int32_t *cost, void **buf)
+#define NUM_OPS 2000000
+#define NUM_KEYS 20000
+
+static void alloc_dummy(void *data, dt_cache_entry_t *entry)
 {
-  *cost = 1; // also the default
-  *buf = (void *)(long int)key;
-  // request write lock for our buffer?
-  return 0;
+  entry->data_size = sizeof(uint32_t);
+  entry->data = malloc(entry->data_size);
+  *(uint32_t *)entry->data = entry->key;
+  entry->cost = 1; // also the default
 }
 
-int main(int argc, char *arg[])
+static void cleanup_dummy(void *data, dt_cache_entry_t *entry)
+{
+  free(entry->data);
+}
+
+// cheap per thread random numbers
+static inline uint32_t xorshift(uint32_t *state)
 {
-  dt_cache_t cache;
-  // dt_cache_init(&cache, 110000, 16, 64, 100000);
-  // really hammer it, make quota insanely low:
-  dt_cache_init(&cache, 110000, 16, 64, 100);
-  dt_cache_set_allocate_callback(&cache, alloc_dummy, NULL);
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
 
+// every thread gets random keys out of num_keys, write_ratio of them with a write lock.
+// returns million operations per second.
+static double run(dt_cache_t *cache, int threads, uint32_t num_keys, int write_percent)
+{
+  const double start = dt_get_wtime();
+  int errors = 0;
 #ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(guided) shared(cache, stderr) num_threads(16)
+#pragma omp parallel num_threads(threads) default(none) shared(cache, num_keys, write_percent) \
+    reduction(+ : errors)
 #endif
-  for(int k = 0; k < 100000; k++)
   {
-    void *data = (void *)(long int)k;
-    const int size = 0; // dt_cache_size(&cache);
-    const int con1 = dt_cache_contains(&cache, k);
-    const int val1 = (int)(long int)dt_cache_read_get(&cache, k);
-    const int val2 = (int)(long int)dt_cache_read_get(&cache, k);
-    // fprintf(stderr, "\rinserted number %d, size %d, value %d - %d, contains %d - %d", k, size, val1, val2,
-    // con1, con2);
-    const int con2 = dt_cache_contains(&cache, k);
-    assert(con1 == 0);
-    assert(con2 == 1);
-    assert(val2 == k);
-    dt_cache_read_release(&cache, k);
-    dt_cache_read_release(&cache, k);
+#ifdef _OPENMP
+    uint32_t state = 0x9e3779b9u * (omp_get_thread_num() + 1);
+    const int nthreads = omp_get_num_threads();
+#else
+    uint32_t state = 0x9e3779b9u;
+    const int nthreads = 1;
+#endif
+    for(int k = 0; k < NUM_OPS / nthreads; k++)
+    {
+      const uint32_t key = xorshift(&state) % num_keys;
+      const char mode = (xorshift(&state) % 100) < (uint32_t)write_percent ? 'w' : 'r';
+      // with an allocate callback, misses always come back write locked
+      dt_cache_entry_t *entry = dt_cache_get(cache, key, mode);
+      if(*(uint32_t *)entry->data != key) errors++;
+      dt_cache_release(cache, entry);
+    }
   }
-  dt_cache_print_locked(&cache);
-  // fprintf(stderr, "\n");
-  fprintf(stderr, "[passed] inserting 100000 entries concurrently\n");
-
-  const int size = dt_cache_size(&cache);
-  const int lru_cnt = lru_check_consistency(&cache);
-  const int lru_cnt_r = lru_check_consistency_reverse(&cache);
-  // fprintf(stderr, "lru list contains %d|%d/%d entries\n", lru_cnt, lru_cnt_r, size);
-  assert(size == lru_cnt);
-  assert(lru_cnt_r == lru_cnt);
-  fprintf(stderr, "[passed] cache lru consistency after removals, have %d entries left.\n", size);
-
-  dt_cache_cleanup(&cache);
-
-
+  const double end = dt_get_wtime();
+  assert(errors == 0);
+  (void)errors;
+  return NUM_OPS / (end - start) / 1e6;
+}
 
+static void benchmark(const char *name, size_t quota, uint32_t num_keys, int write_percent)
+{
+  fprintf(stderr, "%-40s", name);
+  for(int threads = 1; threads <= 16; threads *= 2)
   {
-    // now a harder case: a cache with only one entry and a lot of threads fighting over it:
-    dt_cache_t cache2;
-    // really hammer it, make quota insanely low:
-    // capacity 1 num threads 1 cache line size 64 ignored, quota 2 (80% => 1)
-    dt_cache_init(&cache2, 1, 1, 64, 2);
-    dt_cache_set_allocate_callback(&cache2, alloc_dummy, NULL);
+    dt_cache_t cache;
+    dt_cache_init(&cache, 0, quota);
+    dt_cache_set_allocate_callback(&cache, alloc_dummy, NULL);
+    dt_cache_set_cleanup_callback(&cache, cleanup_dummy, NULL);
+    fprintf(stderr, " %8.2f", run(&cache, threads, num_keys, write_percent));
+    // the quota is soft, but gc has to keep it in the ballpark
+    assert(cache.cost <= MAX(quota, 1.25 * quota + 16 * threads));
+    dt_cache_cleanup(&cache);
+  }
+  fprintf(stderr, "\n");
+}
 
+int main(int argc, char *arg[])
+{
+  {
+    // sanity check: everything we put in is found again, and the lru lists match the hash tables
+    dt_cache_t cache;
+    dt_cache_init(&cache, 0, 2 * NUM_KEYS);
+    dt_cache_set_allocate_callback(&cache, alloc_dummy, NULL);
+    dt_cache_set_cleanup_callback(&cache, cleanup_dummy, NULL);
 #ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(guided) shared(cache2, stderr) num_threads(16)
+#pragma omp parallel for default(none) schedule(static) shared(cache) num_threads(16)
 #endif
-    for(int k = 0; k < 100000; k++)
+    for(int k = 0; k < NUM_KEYS; k++)
     {
-      void *data = (void *)(long int)k;
-      const int size = 0; // dt_cache_size(&cache);
-      const int con1 = dt_cache_contains(&cache2, k);
-      const int val1 = (int)(long int)dt_cache_read_get(&cache2, k);
-      const int val2 = (int)(long int)dt_cache_read_get(&cache2, k);
-      // fprintf(stderr, "\rinserted number %d, size %d, value %d - %d, contains %d - %d", k, size, val1,
-      // val2, con1, con2);
-      const int con2 = dt_cache_contains(&cache2, k);
+      const int con1 = dt_cache_contains(&cache, k);
+      dt_cache_entry_t *entry = dt_cache_get(&cache, k, 'r');
+      const int con2 = dt_cache_contains(&cache, k);
       assert(con1 == 0);
       assert(con2 == 1);
-      assert(val2 == k);
-      dt_cache_read_release(&cache2, k);
-      dt_cache_read_release(&cache2, k);
+      assert(*(uint32_t *)entry->data == (uint32_t)k);
+      (void)con1;
+      (void)con2;
+      dt_cache_release(&cache, entry);
     }
-    dt_cache_print_locked(&cache2);
-    // fprintf(stderr, "\n");
-    fprintf(stderr, "[passed] inserting 100000 entries concurrently\n");
-
-    const int size = dt_cache_size(&cache2);
-    const int lru_cnt = lru_check_consistency(&cache2);
-    const int lru_cnt_r = lru_check_consistency_reverse(&cache2);
-    // fprintf(stderr, "lru list contains %d|%d/%d entries\n", lru_cnt, lru_cnt_r, size);
-    assert(size == lru_cnt);
-    assert(lru_cnt_r == lru_cnt);
-    fprintf(stderr, "[passed] cache lru consistency after removals, have %d entries left.\n", size);
-    dt_cache_cleanup(&cache2);
+    int size = 0, lru = 0;
+    for(int s = 0; s < DT_CACHE_SHARDS; s++)
+    {
+      size += g_hash_table_size(cache.shard[s].hashtable);
+      for(dt_cache_entry_t *e = cache.shard[s].lru_first; e; e = e->lru_next) lru++;
+    }
+    assert(size == NUM_KEYS);
+    assert(lru == size);
+    (void)lru;
+    for(int k = 0; k < NUM_KEYS; k += 2) dt_cache_remove(&cache, k);
+    assert(cache.cost == NUM_KEYS / 2);
+    dt_cache_cleanup(&cache);
+    fprintf(stderr, "[passed] inserting and removing %d entries concurrently\n", NUM_KEYS);
   }
 
+  fprintf(stderr, "\nmillion gets per second for 1, 2, 4, 8, 16 threads:\n");
+  benchmark("hits, read locks", 2 * NUM_KEYS, NUM_KEYS, 0);
+  benchmark("hits, 10% write locks", 2 * NUM_KEYS, NUM_KEYS, 10);
+  benchmark("hot set of 64, read locks", 2 * NUM_KEYS, 64, 0);
+  benchmark("50% misses, eviction", NUM_KEYS / 2, NUM_KEYS, 0);
+  // a cache with only one entry and a lot of threads fighting over it:
+  benchmark("quota of 2, eviction on every miss", 2, 1000, 0);
+
   exit(0);
 }
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
@@ -554,6 +554,11 @@ static void dt_dev_change_image(dt_develop_t *dev, const uint32_t imgid)
     dt_image_synch_xmp(dev->image_storage.id);
   }
 
+  // keep the preview for the next visit
+  dt_pthread_mutex_lock(&dev->preview_pipe_mutex);
+  dt_dev_pixelpipe_store_backbuf(dev->preview_pipe);
+  dt_pthread_mutex_unlock(&dev->preview_pipe_mutex);
+
   // cleanup visible masks
   if(!dev->form_gui)
   {
@@ -1819,6 +1824,9 @@ void leave(dt_view_t *self)
 
   dev->gui_leaving = 1;
 
+  // keep the preview for the next visit
+  dt_dev_pixelpipe_store_backbuf(dev->preview_pipe);
+
   dt_dev_pixelpipe_cleanup_nodes(dev->pipe);
   dt_dev_pixelpipe_cleanup_nodes(dev->preview_pipe);
 
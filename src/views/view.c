@@ -1586,16 +1586,23 @@ void dt_view_filmstrip_prefetch()
 
   sqlite3_stmt *stmt;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), qin, -1, &stmt, NULL);
-  // only get one more image:
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, offset + 1);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, offset + 2);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+  // the images before and after the current one, so stepping through the collection in either
+  // direction finds them decoded already. the next one is queued first, it's the more likely step.
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, MAX(offset - 1, 0));
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, offset > 0 ? 3 : 2);
+  uint32_t previd = 0;
+  int row = offset > 0 ? -1 : 0; // relative to the current image
+  while(sqlite3_step(stmt) == SQLITE_ROW)
   {
     const uint32_t prefetchid = sqlite3_column_int(stmt, 0);
-    // dt_control_log("prefetching image %u", prefetchid);
-    dt_mipmap_cache_get(darktable.mipmap_cache, NULL, prefetchid, DT_MIPMAP_FULL, DT_MIPMAP_PREFETCH, 'r');
+    if(row < 0)
+      previd = prefetchid;
+    else if(row > 0)
+      dt_mipmap_cache_get(darktable.mipmap_cache, NULL, prefetchid, DT_MIPMAP_FULL, DT_MIPMAP_PREFETCH, 'r');
+    row++;
   }
   sqlite3_finalize(stmt);
+  if(previd) dt_mipmap_cache_get(darktable.mipmap_cache, NULL, previd, DT_MIPMAP_FULL, DT_MIPMAP_PREFETCH, 'r');
 }
 
 void dt_view_manager_view_toolbox_add(dt_view_manager_t *vm, GtkWidget *tool, dt_view_type_flags_t views)